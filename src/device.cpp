@@ -1,6 +1,23 @@
 #include "device.hpp"
 
 namespace duckdb {
+string IOCategoryToString(IOCategory category) {
+	switch (category) {
+	case IOCategory::METADATA:
+		return "metadata";
+	case IOCategory::DATABASE:
+		return "database";
+	case IOCategory::WAL:
+		return "wal";
+	case IOCategory::TEMPORARY:
+		return "temporary";
+	case IOCategory::GENERAL:
+		return "general";
+	default:
+		throw InternalException("Unknown I/O category");
+	}
+}
+
 idx_t Device::Write(void *buffer, const CmdContext &context) {
 	throw NotImplementedException("%s: Write is not implemented", GetName());
 }
@@ -9,7 +26,52 @@ idx_t Device::Read(void *buffer, const CmdContext &context) {
 	throw NotImplementedException("%s: Read is not implemented", GetName());
 }
 
+idx_t Device::Deallocate(const CmdContext &context) {
+	return 0;
+}
+
+bool Device::Copy(const CmdContext &context, idx_t source_lba) {
+	return false;
+}
+
 DeviceGeometry Device::GetDeviceGeometry() {
 	throw NotImplementedException("%s: GetDeviceGeometry is not implemented", GetName());
 }
+
+vector<pair<string, string>> Device::GetDeviceInfo() {
+	DeviceGeometry geometry = GetDeviceGeometry();
+	return {{"device", GetName()},
+	        {"lba_size", std::to_string(geometry.lba_size)},
+	        {"lba_count", std::to_string(geometry.lba_count)},
+	        {"capacity", StringUtil::BytesToHumanReadableString(geometry.lba_size * geometry.lba_count)}};
+}
+
+string Device::GetDescription() {
+	vector<string> members;
+	for (auto &property : GetDeviceInfo()) {
+		if (property.first == "device_path") {
+			return property.second;
+		}
+		if (StringUtil::StartsWith(property.first, "member_")) {
+			members.push_back(property.second);
+		}
+	}
+	// Composite devices are described like they are configured
+	return members.empty() ? GetName() : StringUtil::Join(members, ",");
+}
+
+void Device::DescribeMembers(const vector<unique_ptr<Device>> &members, vector<pair<string, string>> &info) {
+	info.emplace_back("members", std::to_string(members.size()));
+	for (idx_t i = 0; i < members.size(); i++) {
+		info.emplace_back("member_" + std::to_string(i), members[i]->GetDescription());
+	}
+}
+
+void Device::SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) {
+	io_statistics = statistics;
+}
+
+vector<DeviceRegion> Device::GetRegions() {
+	return {};
+}
 } // namespace duckdb
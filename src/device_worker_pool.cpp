@@ -0,0 +1,104 @@
+#include "device_worker_pool.hpp"
+
+namespace duckdb {
+
+/// @brief Tracks the tasks of RunAll that run on other threads, and the first error among them
+struct DeviceWorkerBatch {
+	std::mutex lock;
+	std::condition_variable done;
+	idx_t remaining = 0;
+	std::exception_ptr error;
+
+	void Finish(std::exception_ptr task_error) {
+		std::lock_guard<std::mutex> guard(lock);
+		if (task_error && !error) {
+			error = task_error;
+		}
+		remaining--;
+		done.notify_all();
+	}
+};
+
+DeviceWorkerPool::DeviceWorkerPool(idx_t threads) : shutdown(false) {
+	for (idx_t i = 0; i < MaxValue<idx_t>(threads, 1); i++) {
+		workers.emplace_back([this]() { RunWorker(); });
+	}
+}
+
+DeviceWorkerPool::~DeviceWorkerPool() {
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		shutdown = true;
+	}
+	pool_ready.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+void DeviceWorkerPool::Schedule(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		tasks.push_back(std::move(task));
+	}
+	pool_ready.notify_one();
+}
+
+void DeviceWorkerPool::RunAll(const vector<std::function<void()>> &batch_tasks) {
+	if (batch_tasks.empty()) {
+		return;
+	}
+
+	DeviceWorkerBatch batch;
+	batch.remaining = batch_tasks.size() - 1;
+	if (batch.remaining > 0) {
+		std::lock_guard<std::mutex> guard(pool_lock);
+		for (idx_t i = 1; i < batch_tasks.size(); i++) {
+			const std::function<void()> &task = batch_tasks[i];
+			tasks.push_back([&batch, &task]() {
+				std::exception_ptr error;
+				try {
+					task();
+				} catch (...) {
+					error = std::current_exception();
+				}
+				batch.Finish(error);
+			});
+		}
+	}
+	pool_ready.notify_all();
+
+	std::exception_ptr own_error;
+	try {
+		batch_tasks[0]();
+	} catch (...) {
+		own_error = std::current_exception();
+	}
+
+	std::unique_lock<std::mutex> guard(batch.lock);
+	batch.done.wait(guard, [&batch]() { return batch.remaining == 0; });
+	if (own_error) {
+		std::rethrow_exception(own_error);
+	}
+	if (batch.error) {
+		std::rethrow_exception(batch.error);
+	}
+}
+
+void DeviceWorkerPool::RunWorker() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> guard(pool_lock);
+			pool_ready.wait(guard, [this]() { return shutdown || !tasks.empty(); });
+			if (tasks.empty()) {
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+} // namespace duckdb
@@ -0,0 +1,168 @@
+#include "direct_device.hpp"
+#include "file_backed_lbas.hpp"
+#include "nvmefs_io_statistics.hpp"
+#include "nvmefs_tracer.hpp"
+#include "nvmefs_probes.hpp"
+
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#ifdef __APPLE__
+#include <sys/disk.h>
+#endif
+
+namespace duckdb {
+
+DirectDevice::DirectDevice(const string &device_path)
+    : device_path(device_path), fd(-1), block_device(false), direct(true), geometry {0, 0} {
+	try {
+		OpenDevice();
+	} catch (...) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		throw;
+	}
+}
+
+DirectDevice::~DirectDevice() {
+	close(fd);
+}
+
+void DirectDevice::OpenDevice() {
+	struct stat path_stat;
+	if (stat(device_path.c_str(), &path_stat) != 0) {
+		throw IOException("Could not open %s: %s", device_path, strerror(errno));
+	}
+	if (!S_ISBLK(path_stat.st_mode) && !S_ISREG(path_stat.st_mode)) {
+		throw IOException("%s is neither a block device nor a file", device_path);
+	}
+	block_device = S_ISBLK(path_stat.st_mode);
+
+	fd = FileBackedLBAs::Open(device_path, direct);
+
+	if (!block_device) {
+		geometry = FileBackedLBAs::GetFileGeometry(path_stat.st_size);
+	} else {
+#if defined(__linux__)
+		int lba_size = 0;
+		uint64_t device_bytes = 0;
+		bool known = ioctl(fd, BLKSSZGET, &lba_size) == 0 && ioctl(fd, BLKGETSIZE64, &device_bytes) == 0;
+		geometry = DeviceGeometry {static_cast<idx_t>(lba_size), known ? device_bytes / lba_size : 0};
+#elif defined(__APPLE__)
+		uint32_t lba_size = 0;
+		uint64_t lba_count = 0;
+		bool known = ioctl(fd, DKIOCGETBLOCKSIZE, &lba_size) == 0 && ioctl(fd, DKIOCGETBLOCKCOUNT, &lba_count) == 0;
+		geometry = DeviceGeometry {lba_size, known ? lba_count : 0};
+#else
+		bool known = false;
+#endif
+		if (!known) {
+			throw IOException("Could not determine the geometry of %s: %s", device_path, strerror(errno));
+		}
+	}
+
+	if (geometry.lba_count == 0) {
+		throw IOException("%s has no LBAs. Files have to be created with the size of the device they emulate.",
+		                  device_path);
+	}
+}
+
+idx_t DirectDevice::Write(void *buffer, const CmdContext &context) {
+	D_ASSERT(context.nr_lbas > 0);
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+
+	if (IsDirectTransfer(buffer, context)) {
+		Transfer(true, static_cast<data_ptr_t>(buffer), context.start_lba, context.nr_lbas, context);
+		return context.nr_lbas;
+	}
+
+	AlignedBuffer staging(context.nr_lbas * geometry.lba_size);
+	FileBackedLBAs::StageWrite(buffer, context, geometry.lba_size, staging.Get(), GetTransfer(context), io_statistics);
+
+	return context.nr_lbas;
+}
+
+idx_t DirectDevice::Read(void *buffer, const CmdContext &context) {
+	D_ASSERT(context.nr_lbas > 0);
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+
+	if (IsDirectTransfer(buffer, context)) {
+		Transfer(false, static_cast<data_ptr_t>(buffer), context.start_lba, context.nr_lbas, context);
+		return context.nr_lbas;
+	}
+
+	AlignedBuffer staging(context.nr_lbas * geometry.lba_size);
+	FileBackedLBAs::StageRead(buffer, context, geometry.lba_size, staging.Get(), GetTransfer(context), io_statistics);
+
+	return context.nr_lbas;
+}
+
+idx_t DirectDevice::Deallocate(const CmdContext &context) {
+	D_ASSERT(context.nr_lbas > 0);
+	bool deallocated = FileBackedLBAs::Deallocate(fd, block_device, device_path, context.start_lba * geometry.lba_size,
+	                                              context.nr_lbas * geometry.lba_size);
+	return deallocated ? context.nr_lbas : 0;
+}
+
+DeviceGeometry DirectDevice::GetDeviceGeometry() {
+	return geometry;
+}
+
+vector<pair<string, string>> DirectDevice::GetDeviceInfo() {
+	vector<pair<string, string>> info = Device::GetDeviceInfo();
+	info.emplace_back("device_path", device_path);
+	info.emplace_back("backend", NVMEFS_DIRECT_BACKEND);
+	info.emplace_back("mode", block_device ? "block" : "file");
+	info.emplace_back("direct", direct ? "true" : "false");
+	return info;
+}
+
+bool DirectDevice::IsDirectTransfer(void *buffer, const CmdContext &context) const {
+	return FileBackedLBAs::IsDirectTransfer(buffer, context, geometry.lba_size, direct ? geometry.lba_size : 1);
+}
+
+FileBackedLBAs::transfer_t DirectDevice::GetTransfer(const CmdContext &context) {
+	return [this, &context](bool write, data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas) {
+		Transfer(write, buffer, start_lba, nr_lbas, context);
+	};
+}
+
+void DirectDevice::Transfer(bool write, data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas,
+                            const CmdContext &context) {
+	NvmeTraceSpan span(write ? "DirectWrite" : "DirectRead", context.category);
+	span.SetRange(start_lba, nr_lbas);
+	NvmeCommandProbe probe(context, write);
+	probe.Submitted();
+
+	idx_t offset = start_lba * geometry.lba_size;
+	idx_t nr_bytes = nr_lbas * geometry.lba_size;
+	for (idx_t done = 0; done < nr_bytes;) {
+		ssize_t transferred = write ? pwrite(fd, buffer + done, nr_bytes - done, offset + done)
+		                            : pread(fd, buffer + done, nr_bytes - done, offset + done);
+		if (transferred < 0 && errno == EINTR) {
+			continue;
+		}
+		if (transferred < 0) {
+			throw IOException("Could not %s %llu LBAs at LBA %llu of %s: %s", write ? "write" : "read", nr_lbas,
+			                  start_lba, device_path, strerror(errno));
+		}
+		if (transferred == 0) {
+			if (write || block_device) {
+				throw IOException("Could not %s %llu LBAs at LBA %llu of %s: short transfer", write ? "write" : "read",
+				                  nr_lbas, start_lba, device_path);
+			}
+			FileBackedLBAs::ZeroPastEndOfFile(buffer, done, nr_bytes);
+			break;
+		}
+		done += transferred;
+	}
+
+	probe.Completed();
+}
+
+} // namespace duckdb
@@ -0,0 +1,117 @@
+#include "file_backed_lbas.hpp"
+#include "nvmefs_io_statistics.hpp"
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+namespace duckdb {
+
+AlignedBuffer::AlignedBuffer(idx_t nr_bytes) {
+	void *allocation = nullptr;
+	if (posix_memalign(&allocation, NVMEFS_DIRECT_BUFFER_ALIGNMENT, nr_bytes) != 0) {
+		throw std::bad_alloc();
+	}
+	data = static_cast<data_ptr_t>(allocation);
+}
+
+AlignedBuffer::~AlignedBuffer() {
+	free(data);
+}
+
+int FileBackedLBAs::Open(const string &path, bool &direct) {
+	direct = true;
+#ifdef O_DIRECT
+	int fd = open(path.c_str(), O_RDWR | O_DIRECT);
+	// Some file systems, e.g. tmpfs, do not support direct I/O
+	if (fd < 0 && errno == EINVAL) {
+		direct = false;
+		fd = open(path.c_str(), O_RDWR);
+	}
+#else
+	int fd = open(path.c_str(), O_RDWR);
+#endif
+	if (fd < 0) {
+		throw IOException("Could not open %s: %s", path, strerror(errno));
+	}
+#ifdef F_NOCACHE
+	direct = fcntl(fd, F_NOCACHE, 1) == 0;
+#elif !defined(O_DIRECT)
+	direct = false;
+#endif
+	return fd;
+}
+
+DeviceGeometry FileBackedLBAs::GetFileGeometry(idx_t file_bytes) {
+	return DeviceGeometry {NVMEFS_FILE_LBA_SIZE, file_bytes / NVMEFS_FILE_LBA_SIZE};
+}
+
+bool FileBackedLBAs::IsDirectTransfer(void *buffer, const CmdContext &context, idx_t lba_size, idx_t alignment) {
+	if (context.offset != 0 || context.nr_bytes != context.nr_lbas * lba_size) {
+		return false;
+	}
+	return reinterpret_cast<uintptr_t>(buffer) % alignment == 0;
+}
+
+void FileBackedLBAs::StageWrite(const void *buffer, const CmdContext &context, idx_t lba_size, data_ptr_t staging,
+                                const transfer_t &transfer, optional_ptr<NvmeIOStatistics> io_statistics) {
+	idx_t first_covered = (context.offset + lba_size - 1) / lba_size;
+	idx_t end_covered = (context.offset + context.nr_bytes) / lba_size;
+	if (first_covered >= end_covered) {
+		transfer(false, staging, context.start_lba, context.nr_lbas);
+	} else {
+		if (first_covered > 0) {
+			transfer(false, staging, context.start_lba, first_covered);
+		}
+		if (end_covered < context.nr_lbas) {
+			transfer(false, staging + end_covered * lba_size, context.start_lba + end_covered,
+			         context.nr_lbas - end_covered);
+		}
+	}
+	if (io_statistics && (first_covered > 0 || end_covered < context.nr_lbas)) {
+		io_statistics->RecordReadModifyWrite(context.category);
+	}
+
+	memcpy(staging + context.offset, buffer, context.nr_bytes);
+	if (io_statistics) {
+		io_statistics->RecordBounceCopy(context.category);
+	}
+	transfer(true, staging, context.start_lba, context.nr_lbas);
+}
+
+void FileBackedLBAs::StageRead(void *buffer, const CmdContext &context, idx_t lba_size, data_ptr_t staging,
+                               const transfer_t &transfer, optional_ptr<NvmeIOStatistics> io_statistics) {
+	transfer(false, staging, context.start_lba, context.nr_lbas);
+	memcpy(buffer, staging + context.offset, context.nr_bytes);
+	if (io_statistics) {
+		io_statistics->RecordBounceCopy(context.category);
+	}
+}
+
+void FileBackedLBAs::ZeroPastEndOfFile(data_ptr_t buffer, idx_t read_bytes, idx_t nr_bytes) {
+	D_ASSERT(read_bytes <= nr_bytes);
+	memset(buffer + read_bytes, 0, nr_bytes - read_bytes);
+}
+
+bool FileBackedLBAs::Deallocate(int fd, bool block_device, const string &path, idx_t offset, idx_t nr_bytes) {
+#ifdef __linux__
+	if (block_device) {
+		uint64_t range[2] = {offset, nr_bytes};
+		if (ioctl(fd, BLKDISCARD, &range) != 0 && errno != EOPNOTSUPP) {
+			throw IOException("Could not discard LBAs of %s: %s", path, strerror(errno));
+		}
+	} else if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, nr_bytes) != 0 &&
+	           errno != EOPNOTSUPP) {
+		throw IOException("Could not punch a hole into %s: %s", path, strerror(errno));
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+} // namespace duckdb
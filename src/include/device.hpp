@@ -9,11 +9,34 @@ struct DeviceGeometry {
 	idx_t lba_count;
 };
 
+/// @brief The kind of data that a command accesses
+enum class IOCategory : uint8_t { METADATA, DATABASE, WAL, TEMPORARY, GENERAL };
+constexpr idx_t NVMEFS_IO_CATEGORY_COUNT = 5;
+
+/// @brief Returns the lower case name of an I/O category, e.g. "wal"
+string IOCategoryToString(IOCategory category);
+
+class NvmeIOStatistics;
+
 struct CmdContext {
 	idx_t nr_bytes;
 	idx_t nr_lbas;
 	idx_t start_lba;
 	idx_t offset;
+	// The placement identifier that a write is tagged with. Devices without data placement ignore it.
+	idx_t placement_identifier = 0;
+	// The kind of data the command accesses. Commands that are not issued for a file count as general.
+	IOCategory category = IOCategory::GENERAL;
+};
+
+/// @brief An LBA range of a device that is backed by a device of its own, such that the data of one category can be
+/// kept apart from the others, e.g. the WAL on a low latency drive
+struct DeviceRegion {
+	IOCategory category;
+	idx_t start_lba;
+	idx_t lba_count;
+	/// The description of the device that backs the region
+	string device_path;
 };
 
 class Device {
@@ -23,9 +46,44 @@ public:
 	virtual idx_t Write(void *buffer, const CmdContext &context);
 	virtual idx_t Read(void *buffer, const CmdContext &context);
 
+	/// @brief Tells the device that the data of an LBA range is no longer needed (DSM deallocate). Deallocation is a
+	/// hint, hence devices that do not support it ignore it.
+	/// @return The amount of LBAs deallocated
+	virtual idx_t Deallocate(const CmdContext &context);
+
+	/// @brief Copies an LBA range to another LBA range of the same length on the device (NVMe Copy), without moving
+	/// the data through the host
+	/// @param context The destination range and the placement identifier of the copy
+	/// @param source_lba The first LBA of the source range
+	/// @return True if the device copied the range, false if the device cannot copy it. The caller then copies the
+	/// data with a read and a write.
+	virtual bool Copy(const CmdContext &context, idx_t source_lba);
+
 	virtual DeviceGeometry GetDeviceGeometry();
 
 	virtual string GetName() const = 0;
+
+	/// @brief Describes the device for nvmefs_device_info()
+	/// @return Pairs of property and value, starting with the name and geometry of the device
+	virtual vector<pair<string, string>> GetDeviceInfo();
+
+	/// @brief Describes the device in one value, by its path, the comma-separated descriptions of its members, or by
+	/// its name if it has neither
+	string GetDescription();
+
+	/// @brief Sets the statistics that the device counts its own work in, e.g. copies through DMA buffers
+	virtual void SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics);
+
+	/// @brief The LBA ranges that are backed by separate devices for the database, the WAL and temporary files
+	/// @return No regions if all data shares the whole device
+	virtual vector<DeviceRegion> GetRegions();
+
+protected:
+	/// @brief Adds the number of members and the description of every member to the info of a composite device
+	static void DescribeMembers(const vector<unique_ptr<Device>> &members, vector<pair<string, string>> &info);
+
+protected:
+	optional_ptr<NvmeIOStatistics> io_statistics;
 };
 
 } // namespace duckdb
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace duckdb {
+
+/// @brief A small pool of threads on which devices that are composed of several devices run the commands of their
+/// members concurrently
+class DeviceWorkerPool {
+public:
+	/// @brief Constructor for DeviceWorkerPool
+	/// @param threads The number of threads, at least one
+	explicit DeviceWorkerPool(idx_t threads);
+	~DeviceWorkerPool();
+
+	/// @brief Runs a task on one of the threads of the pool once a thread is free
+	void Schedule(std::function<void()> task);
+
+	/// @brief Runs the tasks concurrently, the first on the calling thread and the others on the pool, and waits until
+	/// all of them are done
+	/// @throws The first exception that a task threw, once all tasks are done
+	void RunAll(const vector<std::function<void()>> &tasks);
+
+private:
+	void RunWorker();
+
+private:
+	std::mutex pool_lock;
+	std::condition_variable pool_ready;
+	std::deque<std::function<void()>> tasks;
+	bool shutdown;
+	vector<std::thread> workers;
+};
+
+} // namespace duckdb
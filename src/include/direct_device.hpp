@@ -0,0 +1,61 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include "file_backed_lbas.hpp"
+
+namespace duckdb {
+
+/// The backend name that selects the DirectDevice instead of xNVMe
+static constexpr const char *NVMEFS_DIRECT_BACKEND = "direct";
+
+/// @brief A device on a regular file or a block device, e.g. a partition or a logical volume, that is read and written
+/// with pread and pwrite while bypassing the page cache (O_DIRECT, or F_NOCACHE on macOS). It lays out nvmefs on hosts
+/// where the NVMe namespace cannot be owned by nvmefs, and needs neither xNVMe nor any privileges on a file. Every
+/// thread of DuckDB issues its commands on its own, hence commands of different threads run concurrently. Commands on
+/// whole LBAs whose buffer is aligned to the LBA size are read and written from the buffer of the caller, while the
+/// others are staged in an aligned buffer.
+class DirectDevice : public Device {
+public:
+	/// @brief Constructor for DirectDevice
+	/// @param device_path A block device, or a regular file that already has the size of the device it emulates
+	/// @throws IOException if the device cannot be opened or is empty
+	explicit DirectDevice(const string &device_path);
+	~DirectDevice();
+
+	idx_t Write(void *buffer, const CmdContext &context) override;
+	idx_t Read(void *buffer, const CmdContext &context) override;
+	/// @brief Discards the range of a block device and punches a hole into a file, where the platform supports it
+	idx_t Deallocate(const CmdContext &context) override;
+
+	DeviceGeometry GetDeviceGeometry() override;
+
+	string GetName() const override {
+		return "DirectDevice";
+	}
+
+	/// @brief Adds the path, the kind of device and whether the page cache is bypassed
+	vector<pair<string, string>> GetDeviceInfo() override;
+
+private:
+	/// @brief Opens the device and determines its geometry
+	void OpenDevice();
+
+	/// @brief Checks if a command can be sent from the buffer of the caller, which requires it to cover whole LBAs and
+	/// to be aligned for direct I/O
+	bool IsDirectTransfer(void *buffer, const CmdContext &context) const;
+	/// @brief Reads or writes whole LBAs, retrying interrupted and partial transfers
+	void Transfer(bool write, data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas, const CmdContext &context);
+	/// @brief Transfers the LBAs of a staged command
+	FileBackedLBAs::transfer_t GetTransfer(const CmdContext &context);
+
+private:
+	const string device_path;
+	int fd;
+	bool block_device;
+	/// False if the file system does not support direct I/O, in which case the page cache is used
+	bool direct;
+	DeviceGeometry geometry;
+};
+
+} // namespace duckdb
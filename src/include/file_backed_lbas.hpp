@@ -0,0 +1,75 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include <functional>
+
+namespace duckdb {
+
+/// Buffers of direct I/O are aligned to the largest LBA size
+constexpr idx_t NVMEFS_DIRECT_BUFFER_ALIGNMENT = 4096;
+/// Files emulate a device with LBAs of this size
+constexpr idx_t NVMEFS_FILE_LBA_SIZE = 4096;
+
+/// @brief A buffer aligned for direct I/O, which stages commands that cannot be sent from the buffer of the caller
+class AlignedBuffer {
+public:
+	explicit AlignedBuffer(idx_t nr_bytes);
+	~AlignedBuffer();
+
+	AlignedBuffer(const AlignedBuffer &) = delete;
+	AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+	data_ptr_t Get() {
+		return data;
+	}
+
+private:
+	data_ptr_t data;
+};
+
+/// @brief The LBAs of a block device or of a regular file that emulates a device, as read and written by the backends
+/// that bypass xNVMe. The devices open the file, move whole LBAs between a buffer and the file and wait for them, while
+/// the parts that do not depend on how the LBAs are moved live here: falling back to the page cache on file systems
+/// without direct I/O, staging commands that do not cover whole LBAs or whose buffer is not aligned, reading the LBAs
+/// that a write only covers partially, and reading past the end of a file that is shorter than the device.
+class FileBackedLBAs {
+public:
+	/// @brief Reads (write is false) or writes whole LBAs between the device and a buffer
+	typedef std::function<void(bool write, data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas)> transfer_t;
+
+	/// @brief Opens a block device or file for direct I/O. File systems without direct I/O, e.g. tmpfs, are opened
+	/// through the page cache instead.
+	/// @param direct Set to false if the page cache is used
+	/// @return The file descriptor
+	/// @throws IOException if the path cannot be opened
+	static int Open(const string &path, bool &direct);
+
+	/// @brief The geometry of a file, whose size is that of the device it emulates
+	static DeviceGeometry GetFileGeometry(idx_t file_bytes);
+
+	/// @brief Checks if a command can be sent from the buffer of the caller, which requires it to cover whole LBAs
+	/// and the buffer to have the given alignment
+	static bool IsDirectTransfer(void *buffer, const CmdContext &context, idx_t lba_size, idx_t alignment);
+
+	/// @brief Writes a command through a staging buffer of nr_lbas LBAs. The LBAs that the command only covers
+	/// partially keep the rest of their data, hence they are read first.
+	static void StageWrite(const void *buffer, const CmdContext &context, idx_t lba_size, data_ptr_t staging,
+	                       const transfer_t &transfer, optional_ptr<NvmeIOStatistics> io_statistics);
+
+	/// @brief Reads a command through a staging buffer of nr_lbas LBAs
+	static void StageRead(void *buffer, const CmdContext &context, idx_t lba_size, data_ptr_t staging,
+	                      const transfer_t &transfer, optional_ptr<NvmeIOStatistics> io_statistics);
+
+	/// @brief Completes a read that ended early at the end of a file. A file that is shorter than the device reads as
+	/// zeros past its end, like unwritten LBAs.
+	static void ZeroPastEndOfFile(data_ptr_t buffer, idx_t read_bytes, idx_t nr_bytes);
+
+	/// @brief Discards the range of a block device or punches a hole into a file. Deallocation is a hint, hence
+	/// devices and file systems that cannot deallocate are left alone.
+	/// @return False if the platform cannot deallocate at all
+	/// @throws IOException if deallocating fails for another reason
+	static bool Deallocate(int fd, bool block_device, const string &path, idx_t offset, idx_t nr_bytes);
+};
+
+} // namespace duckdb
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include "recording_device.hpp"
+
+namespace duckdb {
+
+enum class IOTraceReplayMode : uint8_t {
+	/// Every recorded thread is replayed by its own worker that submits the commands of the thread back-to-back, i.e.
+	/// the next command is submitted when the previous one completes
+	CLOSED_LOOP,
+	/// Commands are submitted at the time they were recorded, regardless of how fast the device completes them
+	OPEN_LOOP
+};
+
+struct IOTraceReplayConfig {
+	IOTraceReplayMode mode = IOTraceReplayMode::CLOSED_LOOP;
+	/// Number of workers that submit the commands of an open-loop replay. Closed-loop replays use one worker per
+	/// recorded thread.
+	idx_t workers = 8;
+	/// Open-loop replays submit commands this many times faster than they were recorded
+	double speed = 1.0;
+	/// Deallocations are skipped when false, e.g. for devices without support for deallocation
+	bool deallocate = true;
+};
+
+struct IOTraceReplayResult {
+	idx_t commands;
+	idx_t read_bytes;
+	idx_t written_bytes;
+	/// Time from the start of the replay until the last command completed
+	idx_t elapsed_ns;
+	/// Sum of the latencies of all commands, as seen by the workers
+	idx_t total_latency_ns;
+	idx_t max_latency_ns;
+	/// Open-loop commands that were submitted after the time they were scheduled for, as all workers were busy
+	idx_t late_commands;
+
+	double GetAverageLatencyNanos() const {
+		return commands == 0 ? 0.0 : static_cast<double>(total_latency_ns) / static_cast<double>(commands);
+	}
+};
+
+/// @brief Replays a trace written by a RecordingDevice on any device, such that a workload can be captured once and
+/// run again on other devices and configurations.
+class IOTraceReplayer {
+public:
+	/// @brief Constructor for IOTraceReplayer
+	/// @param header The header of the trace
+	/// @param records The records of the trace, in the order they were recorded
+	IOTraceReplayer(const IOTraceHeader &header, vector<IOTraceRecord> records);
+
+	/// @brief Replays the trace on the device. The device must have at least as many LBAs as the traced device and
+	/// the same LBA size.
+	/// @param device The device to replay the trace on
+	/// @param config The configuration of the replay
+	/// @return The statistics of the replay
+	IOTraceReplayResult Replay(Device &device, IOTraceReplayConfig config = {});
+
+private:
+	/// @brief Submits a single command and adds it to the statistics of the worker
+	void ReplayCommand(Device &device, const IOTraceRecord &record, const IOTraceReplayConfig &config,
+	                   uint8_t *buffer, IOTraceReplayResult &worker_result);
+	/// @brief Closed-loop: replays the commands of a single recorded thread in the order they were submitted
+	void ReplayThread(Device &device, const vector<idx_t> &commands, const IOTraceReplayConfig &config,
+	                  IOTraceReplayResult &result);
+	/// @brief Open-loop: takes the next command in submission order and submits it at its scheduled time
+	void ReplayScheduled(Device &device, std::atomic<idx_t> &next_command, const vector<idx_t> &schedule,
+	                     std::chrono::steady_clock::time_point start, const IOTraceReplayConfig &config,
+	                     IOTraceReplayResult &result);
+	void MergeResult(IOTraceReplayResult &result, const IOTraceReplayResult &worker_result);
+
+private:
+	IOTraceHeader header;
+	vector<IOTraceRecord> records;
+	/// The largest command of the trace in LBAs, i.e. the buffer size every worker needs
+	idx_t max_lba_count;
+	std::mutex result_lock;
+};
+
+/// @brief Parses the name of a replay mode, i.e. 'closed' or 'open'
+IOTraceReplayMode ParseIOTraceReplayMode(const string &mode);
+
+} // namespace duckdb
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include "device_worker_pool.hpp"
+#include "nvmefs_io_statistics.hpp"
+#include <atomic>
+
+namespace duckdb {
+
+/// The device layouts that combine several devices
+static constexpr const char *NVMEFS_STRIPE_LAYOUT = "stripe";
+static constexpr const char *NVMEFS_MIRROR_LAYOUT = "mirror";
+
+/// Reads are only hedged once this many reads have been timed, such that the percentile is meaningful
+constexpr idx_t NVMEFS_MIRROR_HEDGE_MIN_SAMPLES = 128;
+/// The latency histogram of the reads is halved once it holds this many reads, such that it follows the device
+constexpr idx_t NVMEFS_MIRROR_LATENCY_WINDOW = 1ULL << 14;
+/// The hedging threshold is recomputed from the histogram after this many reads
+constexpr idx_t NVMEFS_MIRROR_THRESHOLD_INTERVAL = 64;
+/// The buffers of hedged reads are kept for the next reads, up to this many buffers
+constexpr idx_t NVMEFS_MIRROR_SPARE_BUFFERS = 64;
+
+struct HedgedRead;
+
+/// @brief A device that mirrors its LBAs on several member devices (RAID-1). Writes, deallocations and copies go to
+/// all members concurrently, while a read goes to the member with the fewest outstanding commands. Reads can be hedged:
+/// a read that takes longer than a percentile of the recent read latencies is sent to another member as well, and the
+/// first completion wins, such that a member that stalls, e.g. for garbage collection, does not stall the query.
+/// Hedged reads run on the threads of the device and read into buffers of their own that are copied to the buffer of
+/// the caller, as the losing read completes after the caller moved on. The buffers are recycled, such that reads do
+/// not allocate. The device holds as many LBAs as its smallest member, and all members must have the same LBA size.
+class MirroredDevice : public Device {
+	friend struct HedgedRead;
+
+public:
+	/// @brief Constructor for MirroredDevice
+	/// @param members The devices to mirror over, at least two
+	/// @param hedge_percentile The percentile in (0, 1) of the read latency after which a read is hedged, or 0 to
+	/// not hedge reads
+	/// @param threads The threads that run the writes and hedged reads on the members
+	/// @throws InvalidInputException if the members do not fit together
+	MirroredDevice(vector<unique_ptr<Device>> members, double hedge_percentile, idx_t threads);
+
+	/// @brief Parses the hedging of reads, e.g. 'p99' or 'p99.9'
+	/// @return The percentile in (0, 1), or 0 if the hedging is empty or 'off'
+	/// @throws InvalidInputException if the hedging is neither
+	static double ParseHedgePercentile(const string &hedge_reads);
+
+	idx_t Write(void *buffer, const CmdContext &context) override;
+	/// @brief Reads from the least busy member, and from another member as well if the read is slow
+	idx_t Read(void *buffer, const CmdContext &context) override;
+	idx_t Deallocate(const CmdContext &context) override;
+	/// @brief Copies on all members, if every member can copy
+	bool Copy(const CmdContext &context, idx_t source_lba) override;
+
+	DeviceGeometry GetDeviceGeometry() override;
+
+	void SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) override;
+
+	string GetName() const override {
+		return "MirroredDevice";
+	}
+
+	/// @brief Adds the hedging and describes the members
+	vector<pair<string, string>> GetDeviceInfo() override;
+
+	idx_t GetMemberCount() const {
+		return members.size();
+	}
+
+	Device &GetMember(idx_t member) {
+		return *members[member];
+	}
+
+	/// @brief The number of reads that were sent to a second member
+	idx_t GetHedgedReadCount() const {
+		return hedged_reads.load();
+	}
+
+	/// @brief The latency after which reads are hedged, or an invalid index while reads are not hedged
+	optional_idx GetHedgeThreshold() const;
+
+private:
+	/// @brief Picks the member with the fewest outstanding commands, where ties are broken round-robin
+	/// @param excluded A member that must not be picked, or an invalid index
+	idx_t PickMember(optional_idx excluded);
+	/// @brief Reads from a member on the calling thread and times the read
+	void ReadMember(idx_t member, data_ptr_t buffer, const CmdContext &context);
+	/// @brief Counts the latency of a read, and recomputes the hedging threshold every so often
+	void RecordReadLatency(idx_t latency_ns);
+	/// @brief Runs a command on all members concurrently
+	void RunOnAllMembers(const std::function<void(Device &)> &execute);
+
+	/// @brief Takes a spare buffer of at least the given size, or allocates one
+	/// @param capacity Is set to the size of the buffer
+	unique_array<data_t> TakeBuffer(idx_t nr_bytes, idx_t &capacity);
+	/// @brief Keeps the buffers of a hedged read for the next reads
+	void ReturnBuffers(HedgedRead &read);
+
+private:
+	vector<unique_ptr<Device>> members;
+	DeviceGeometry geometry;
+	const double hedge_percentile;
+
+	unique_array<std::atomic<idx_t>> outstanding;
+	std::atomic<idx_t> next_member;
+
+	std::atomic<uint64_t> read_latency_histogram[NVMEFS_LATENCY_BUCKET_COUNT];
+	std::atomic<idx_t> timed_reads;
+	/// The hedging threshold in nanoseconds, or 0 while too few reads have been timed
+	std::atomic<idx_t> hedge_threshold_ns;
+	std::atomic<idx_t> hedged_reads;
+
+	std::mutex spare_buffers_lock;
+	vector<pair<idx_t, unique_array<data_t>>> spare_buffers;
+
+	/// Declared last, such that the reads that are still running finish before the other members are destroyed
+	DeviceWorkerPool pool;
+};
+
+} // namespace duckdb
@@ -4,6 +4,7 @@
 #include "duckdb/common/optional_idx.hpp"
 #include "duckdb/common/string_util.hpp"
 #include "device.hpp"
+#include "nvmefs_lock_statistics.hpp"
 #include <libxnvme.h>
 #include <mutex>
 #include <future>
@@ -15,6 +16,8 @@ typedef void *nvme_buf_ptr;
 static constexpr idx_t XNVME_QUEUE_DEPTH = 1 << 4;
 static constexpr std::chrono::milliseconds POKE_MAX_BACKOFF_TIME = std::chrono::milliseconds(200);
 static constexpr idx_t DATA_PLACEMENT_MODE = 2;
+/// A dataset management command carries at most 256 ranges
+static constexpr idx_t NVMEFS_MAX_DSM_RANGES = 256;
 
 struct NvmeDeviceGeometry : public DeviceGeometry {};
 struct NvmeCmdContext : public CmdContext {
@@ -44,6 +47,20 @@ public:
 	/// @return The amount of LBAs read from the device
 	idx_t Read(void *buffer, const CmdContext &context) override;
 
+	/// @brief Deallocates an LBA range with a dataset management command, such that the device no longer has to
+	/// relocate its data during garbage collection
+	/// @param context The LBA range to deallocate. The offset and placement identifier are ignored.
+	/// @return The amount of LBAs deallocated, 0 if the device does not support dataset management or the command
+	/// failed, as deallocation is only a hint
+	idx_t Deallocate(const CmdContext &context) override;
+
+	/// @brief Copies an LBA range with a simple copy command, which the device executes without transferring the data
+	/// to the host
+	/// @param context The destination range. Copies are placed like writes on devices with data placement.
+	/// @param source_lba The first LBA of the source range
+	/// @return False if the device does not support the copy command or the range is longer than a single copy
+	bool Copy(const CmdContext &context, idx_t source_lba) override;
+
 	/// @brief Fetches the geometry of the device
 	/// @return The device geometry
 	DeviceGeometry GetDeviceGeometry() override;
@@ -54,11 +71,14 @@ public:
 		return "NvmeDevice";
 	}
 
+	/// @brief Adds the backend, the data placement state and the queues to the description of the device
+	vector<pair<string, string>> GetDeviceInfo() override;
+
 private:
-	/// @brief Determines which placment handler should be used for the given path
-	/// @param path The path of the file that will be opened
-	/// @return A placement identifier
-	uint8_t GetPlacementIdentifierOrDefault(const string &path);
+	/// @brief Determines the placement handle of the reclaim unit handle that a write is placed in
+	/// @param placement_identifier The placement identifier chosen by the placement policy
+	/// @return A placement handle. Identifiers beyond the handles of the device wrap around.
+	uint16_t GetPlacementHandle(idx_t placement_identifier);
 
 	/// @brief Allocates a device specific buffer. Should be freed with FreeDeviceBuffer.
 	/// @param nr_bytes The number of bytes to allocate (The allocated buffer mighr be larger)
@@ -73,7 +93,8 @@ private:
 	/// @return The device geometry
 	DeviceGeometry LoadDeviceGeometry();
 
-	/// @brief Specifies the backend and sync/async used for the device
+	/// @brief Specifies the backend and sync/async used for the device. Regular files are opened through the file
+	/// backends of xNVMe, which emulate a namespace on top of the file.
 	/// @param opts xNVMe options
 	void PrepareOpts(xnvme_opts &opts);
 
@@ -82,13 +103,17 @@ private:
 	idx_t ReadAsync(void *buffer, const CmdContext &context);
 	idx_t WriteAsync(void *buffer, const CmdContext &context);
 
-	void PrepareIOCmdContext(xnvme_cmd_ctx *ctx, const CmdContext &cmd_ctx, idx_t plid_idx, idx_t dtype, bool write);
+	void PrepareIOCmdContext(xnvme_cmd_ctx *ctx, const CmdContext &cmd_ctx, idx_t dtype, bool write);
 	bool CheckFDP();
+	/// @brief Determines how many LBAs a copy command with a single source range can copy
+	/// @return The number of LBAs, or 0 if the device does not support the copy command
+	idx_t LoadMaxCopyLBAs();
+	/// @brief Checks if the controller supports the dataset management command, which deallocates LBAs
+	bool CheckDSM();
 	void InitializePlacementHandles();
 	idx_t GetThreadIndex();
 
 private:
-	map<string, uint8_t> allocated_placement_identifiers;
 	vector<uint16_t> placement_handlers;
 	xnvme_dev *device;
 	const string dev_path;
@@ -96,7 +121,15 @@ private:
 	const string backend;
 	const bool async;
 	bool fdp;
+	/// True if the device is a regular file rather than an NVMe device
+	bool file_backed;
+	/// The most LBAs that a single copy command copies, 0 if the device cannot copy
+	idx_t max_copy_lbas;
+	/// True if the device deallocates LBAs with dataset management commands
+	bool dsm;
 	vector<xnvme_queue *> queues;
+	/// Threads share a queue when there are more threads than queues, and a queue only takes one thread at a time
+	vector<unique_ptr<InstrumentedMutex<std::mutex>>> queue_locks;
 	const idx_t max_threads;
 	atomic<idx_t> thread_id_counter;
 	static thread_local optional_idx index;
@@ -5,30 +5,87 @@
 #include "duckdb/common/map.hpp"
 
 #include "device.hpp"
+#include "direct_device.hpp"
 #include "nvme_device.hpp"
 #include "nvmefs_config.hpp"
+#include "nvmefs_database_catalog.hpp"
+#include "nvmefs_extent_allocator.hpp"
+#include "nvmefs_file_directory.hpp"
+#include "nvmefs_io_scheduler.hpp"
+#include "nvmefs_io_statistics.hpp"
+#include "nvmefs_placement_policy.hpp"
+#include "nvmefs_temporary_spill.hpp"
+#include "recording_device.hpp"
+#include "striped_device.hpp"
+#include "region_device.hpp"
+#include "mirrored_device.hpp"
 #include "temporary_file_metadata_manager.hpp"
+#include "uring_device.hpp"
 
 namespace duckdb {
 
 constexpr idx_t NVMEFS_GLOBAL_METADATA_LOCATION = 0;
+constexpr idx_t NVMEFS_EXTENT_TABLE_LOCATION = 1;
+constexpr uint64_t NVMEFS_METADATA_VERSION = 5;
 constexpr char NVMEFS_MAGIC_BYTES[] = "NVMEFS";
 const string NVMEFS_PATH_PREFIX = "nvmefs://";
 const string NVMEFS_TMP_DIR_PATH = "nvmefs:///tmp";
 const string NVMEFS_GLOBAL_METADATA_PATH = "nvmefs://.global_metadata";
 
-enum MetadataType { DATABASE, WAL, TEMPORARY };
+enum MetadataType { DATABASE, WAL, TEMPORARY, GENERAL };
+
+/// A device has at most a database, a WAL and a temporary region
+constexpr idx_t NVMEFS_MAX_REGIONS = 3;
+/// The paths of the devices of a region are recorded up to this many characters
+constexpr idx_t NVMEFS_REGION_PATH_LENGTH = 96;
+
+/// @brief A region of the device as it was formatted. Extents are placed on the device of their region, hence the
+/// regions must be the same whenever the device is opened.
+struct GlobalRegionMetadata {
+	uint64_t category;
+	uint64_t start_lba;
+	uint64_t lba_count;
+	char device_path[NVMEFS_REGION_PATH_LENGTH];
+};
 
 struct GlobalMetadata {
-	uint64_t db_path_size;
-	char db_path[101];
+	uint64_t version;
+
+	// The device is divided into extents that are handed out on demand. The extent table that records the owner of
+	// each extent is stored from NVMEFS_EXTENT_TABLE_LOCATION and onwards.
+	uint64_t extent_lba_count;
+	uint64_t extent_count;
+
+	// The database catalog is stored after the extent table with one LBA per database
+	uint64_t catalog_location;
+	uint64_t max_databases;
 
-	uint64_t db_start;
-	uint64_t wal_start;
-	uint64_t tmp_start;
+	// The directory index of the general file namespace is stored after the database catalog
+	uint64_t file_index_location;
+	uint64_t max_files;
 
-	uint64_t db_location;
-	uint64_t wal_location;
+	// The regions of the device, if the WALs or the temporary files are placed on devices of their own
+	uint64_t region_count;
+	GlobalRegionMetadata regions[NVMEFS_MAX_REGIONS];
+};
+
+// The global metadata is stored in the first LBA, which holds at least 512 bytes
+static_assert(sizeof(NVMEFS_MAGIC_BYTES) + sizeof(GlobalMetadata) <= 512, "The global metadata must fit in an LBA");
+
+/// @brief The space of a part of the device. Metadata regions have a fixed location, while the data regions consist of
+/// the extents that the files of a kind own, which can be anywhere on the device.
+struct NvmeRegionInfo {
+	string name;
+	/// The first LBA of a metadata region, or invalid for data regions
+	optional_idx start_lba;
+	/// LBAs that the region occupies
+	idx_t lba_count;
+	/// LBAs that hold data, the rest of the region can be used without allocating
+	idx_t used_lbas;
+	/// The most LBAs that the region may grow to, or invalid if it can take all free extents
+	optional_idx max_lbas;
+	idx_t extent_count;
+	idx_t file_count;
 };
 
 struct TemporaryFileMetadata {
@@ -66,6 +123,14 @@ private:
 
 private:
 	idx_t cursor_offset;
+	/// @brief The database that the file belongs to. Only set for database and WAL files.
+	shared_ptr<NvmeDatabase> database;
+	/// @brief The file in the general file namespace. Only set for general files.
+	shared_ptr<NvmeFile> file;
+	/// @brief The placement identifier that writes of the file are tagged with
+	idx_t placement_identifier;
+	/// @brief The category that commands of the file are accounted to
+	IOCategory category;
 };
 
 class NvmeFileSystem : public FileSystem {
@@ -97,39 +162,160 @@ public:
 	               FileOpener *opener = nullptr);
 	optional_idx GetAvailableDiskSpace(const string &path);
 	bool Trim(FileHandle &handle, idx_t offset_bytes, idx_t length_bytes) override;
+	vector<string> Glob(const string &path, FileOpener *opener = nullptr) override;
 
 	Device &GetDevice();
+	/// @return The scheduler of the device, or nullptr if no scheduler is configured
+	optional_ptr<SchedulingDevice> GetScheduler();
 
 	string GetName() const {
 		return "NvmeFileSystem";
 	}
 
+	NvmeExtentAllocator &GetExtentAllocator();
+	NvmeDatabaseCatalog &GetDatabaseCatalog();
+	NvmeFileDirectory &GetFileDirectory();
+	const NvmePlacementPolicy &GetPlacementPolicy() const;
+	NvmeIOStatistics &GetIOStatistics();
+	/// @throws IOException if the device is not formatted
+	TemporaryFileMetadataManager &GetTemporaryFileMetadataManager();
+
+	/// @brief Describes the layout of the device and how full each region is, ending with the free extents
+	/// @throws IOException if the device is not formatted
+	vector<NvmeRegionInfo> GetRegions();
+
+	/// @brief Describes the device and the layout of the metadata on it, as pairs of property and value
+	/// @throws IOException if the device is not formatted
+	vector<pair<string, string>> GetDeviceInfo();
+
+	/// @brief Moves temporary blocks out of the emptiest temporary extents, such that the extents can be used as a
+	/// whole again
+	/// @throws IOException if the device is not formatted
+	TemporaryCompactionResult CompactTemporaryFiles();
+
 private:
 	bool TryLoadMetadata();
-	void InitializeMetadata(const string &filename);
+	/// @brief Loads the metadata if it is not loaded yet
+	/// @throws IOException if the device is not formatted
+	void RequireMetadata();
+	void InitializeMetadata();
 	unique_ptr<GlobalMetadata> ReadMetadata();
 	void WriteMetadata(GlobalMetadata &global);
-	void UpdateMetadata(CmdContext &Context);
+	void UpdateMetadata(NvmeFileHandle &handle, idx_t lba_location);
 	MetadataType GetMetadataType(const string &filename);
-	idx_t GetLBA(const string &filename, idx_t nr_bytes, idx_t location, idx_t nr_lbas);
+	/// @brief Checks if a path is in the temporary directory, which is at the root or directly below a database
+	static bool IsTemporaryPath(const string &filename);
+
+	/// @brief Creates the extent allocator, the database catalog and the temporary file manager for the given metadata
+	/// @param global The global metadata describing the extent layout
+	/// @param load If true, the extent table and catalog are read from the device. Otherwise, they are created empty.
+	void InitializeExtents(GlobalMetadata &global, bool load);
+
+	/// @brief Records the regions of the device in the global metadata
+	void RecordRegions(GlobalMetadata &global);
+
+	/// @brief Checks that the device has the regions it was formatted with
+	/// @throws IOException if the regions of the device differ from the regions in the global metadata
+	void VerifyRegions(const GlobalMetadata &global);
+
+	/// @brief Restricts the extent pools to the regions of the device, such that the WAL and the temporary files are
+	/// placed on the devices of their regions. Regions that the device lacks are placed in the database region.
+	void ConfigureExtentPools();
+
+	/// @brief Writes the parts of the extent table that have changed since it was last written
+	void WriteExtentTable();
 
-	/// @brief Checks that the start_lba is within the assigned metadata range and that lba_start+lba_count is within
-	/// the assigned metadata range
-	/// @param filename name of the file to check
-	/// @param start_lba Start LBA of the IO operation to be performed
+	/// @brief Writes the catalog entry of a single database
+	void WriteCatalogEntry(NvmeDatabase &database);
+
+	/// @brief Writes the parts of the directory index of the general file namespace that have changed
+	void WriteFileIndex();
+
+	/// @brief Reads a byte range of a general file. Only LBAs that are partially covered by the range are read
+	/// through a bounce buffer, the rest is read directly into the output buffer.
+	void ReadGeneralFile(NvmeFileHandle &handle, data_ptr_t buffer, idx_t nr_bytes, idx_t location);
+
+	/// @brief Writes a byte range of a general file. LBAs that are partially covered by the range are read, modified
+	/// and written back, the rest is written directly from the input buffer.
+	void WriteGeneralFile(NvmeFileHandle &handle, const_data_ptr_t buffer, idx_t nr_bytes, idx_t location);
+
+	/// @brief Reads whole logical LBAs of a general file. Unmapped LBAs are read as zeros.
+	void ReadFileLBAs(NvmeFileHandle &handle, data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas);
+
+	/// @brief Writes whole logical LBAs of a general file, allocating extents as needed
+	void WriteFileLBAs(NvmeFileHandle &handle, const_data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas);
+
+	/// @brief Reads a single LBA of a general file, where all bytes past the end of the file are zeroed
+	void ReadFileLBAForUpdate(NvmeFileHandle &handle, data_ptr_t buffer, idx_t lba);
+
+	/// @brief Determines the placement identifier of a file according to the placement policy
+	idx_t GetPlacementIdentifier(const string &path);
+
+	/// @brief Determines the category that the commands of a file are accounted to
+	static IOCategory GetIOCategory(MetadataType type);
+
+	/// @brief Determines the placement identifier of a single write. Database writes are placed by the expected
+	/// lifetime of the written blocks if the placement policy separates hot and cold database blocks.
+	idx_t GetWritePlacementIdentifier(NvmeFileHandle &handle, idx_t lba_location, idx_t nr_lbas);
+
+	/// @brief Fetches the database that a database or WAL file belongs to
+	/// @return The database or nullptr if the database is not in the catalog
+	shared_ptr<NvmeDatabase> GetDatabase(const string &filename);
+
+	/// @brief Translates a byte range of a file into the device LBA runs that back it
+	/// @param handle The file handle of the file
+	/// @param nr_bytes Number of bytes in the range
+	/// @param location Byte location in the file
+	/// @param nr_lbas Number of LBAs required for the IO operation
+	/// @param allocate If true, extents are allocated for unmapped parts of the range
+	/// @param pin Keeps the block of a temporary file in place until the I/O is done
+	/// @return The LBA runs in file order, or no runs if the range is a temporary block on the spill tier
+	vector<ExtentRun> GetLBA(NvmeFileHandle &handle, idx_t nr_bytes, idx_t location, idx_t nr_lbas, bool allocate,
+	                         TemporaryBlockPin &pin);
+
+	/// @brief Checks that the logical LBA range of the file is within the bounds that the file is allowed to grow to
+	/// @param handle The file handle of the file to check
+	/// @param start_lba Logical start LBA of the IO operation to be performed
 	/// @param lba_count Number of LBAs to be read/written
 	/// @return True if it is in range, false otherwise
-	bool IsLBAInRange(const string &filename, idx_t start_lba, idx_t lba_count);
+	bool IsLBAInRange(NvmeFileHandle &handle, idx_t start_lba, idx_t lba_count);
+
+	/// @brief Copies a temporary block to another LBA range during compaction. The copy command of the device is used
+	/// if the device supports it, otherwise the block is read and written back.
+	void RelocateTemporaryBlock(const string &path, idx_t source_lba, idx_t destination_lba, idx_t nr_lbas);
+
+	/// @brief Copies a temporary block from the device to the spill directory, once the temporary space is full
+	void SpillTemporaryBlock(const string &path, idx_t block_index, idx_t lba, idx_t nr_lbas);
+
+	/// @brief Reads from the device and counts the command in the I/O statistics
+	void DeviceRead(void *buffer, const CmdContext &context);
+	/// @brief Writes to the device and counts the command in the I/O statistics
+	void DeviceWrite(void *buffer, const CmdContext &context);
+
+private:
+	/// @brief Puts a SchedulingDevice in front of the device when a scheduler policy is configured
+	void ConfigureScheduler(const string &policy);
 
 private:
 	Allocator &allocator;
 	unique_ptr<GlobalMetadata> metadata;
+	/// @brief Counts the commands sent to the device. Declared before the device, which refers to it.
+	NvmeIOStatistics io_statistics;
 	unique_ptr<Device> device;
+	optional_ptr<SchedulingDevice> scheduler;
+	unique_ptr<NvmeExtentAllocator> extent_allocator;
+	unique_ptr<NvmeDatabaseCatalog> catalog;
+	unique_ptr<NvmeFileDirectory> file_directory;
 	unique_ptr<TemporaryFileMetadataManager> temp_meta_manager;
-	atomic<idx_t> db_location;
-	atomic<idx_t> wal_location;
+	/// @brief The spill tier of the temporary files, if a spill directory is configured
+	unique_ptr<NvmeTemporarySpillDirectory> temp_spill;
+	/// @brief Serializes writes of the extent table, which is shared by all databases
+	std::mutex extent_table_lock;
+	/// @brief Serializes writes of the directory index
+	std::mutex file_index_lock;
 	idx_t max_temp_size;
 	idx_t max_wal_size;
+	NvmePlacementPolicy placement_policy;
 	static std::recursive_mutex temp_lock;
 };
 } // namespace duckdb
@@ -15,12 +15,32 @@ public:
 };
 
 struct NvmeConfig {
+	/// The device, or a comma-separated list of devices that are striped over or mirrored
 	string device_path;
 	string backend;
 	bool async;
 	uint64_t max_temp_size;
 	uint64_t max_wal_size;
 	uint64_t max_threads;
+	string placement_policy;
+	/// When set, every command sent to the device is recorded in a trace file at this path
+	string trace_path;
+	/// When set, commands are sent to the device through a SchedulingDevice with this policy
+	string io_scheduler;
+	/// The setup of the rings when the device is opened with the liburing backend
+	string uring_options;
+	/// The stripe unit when several devices are given, e.g. '1MiB'. Empty means NVMEFS_DEFAULT_STRIPE_SIZE.
+	string stripe_size;
+	/// How several devices are combined, 'stripe' (or empty) or 'mirror'
+	string device_layout;
+	/// The percentile of the read latency after which reads of mirrored devices are hedged, e.g. 'p99', or 'off'
+	string hedge_reads;
+	/// When set, the WALs are placed on this device, or on these striped devices, instead of the database device
+	string wal_device_path;
+	/// When set, the temporary files are placed on this device, or on these striped devices
+	string temp_device_path;
+	/// When set, temporary blocks that do not fit into the temporary space of the device are spilled to this directory
+	string temp_spill_directory;
 };
 
 class NvmeConfigManager {
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/map.hpp"
+#include "nvmefs_extent_allocator.hpp"
+#include "nvmefs_lifetime_estimator.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace duckdb {
+
+/// The maximum number of databases that can be stored on a single device
+constexpr idx_t NVMEFS_MAX_DATABASES = 64;
+constexpr idx_t NVMEFS_MAX_DATABASE_NAME_LENGTH = 100;
+
+/// @brief The persisted catalog entry of a database. Every entry is stored in its own LBA, such that databases can be
+/// synced independently of each other.
+struct DatabaseCatalogEntry {
+	uint64_t in_use;
+	uint64_t db_path_size;
+	char db_path[NVMEFS_MAX_DATABASE_NAME_LENGTH + 1];
+
+	// Size of the database and write-ahead log in LBAs
+	uint64_t db_location;
+	uint64_t wal_location;
+};
+
+/// @brief Runtime state of a database stored on the device. File handles keep a pointer to it, such that IO on one
+/// database never has to go through the catalog or touch the state of another database.
+class NvmeDatabase {
+public:
+	NvmeDatabase(NvmeExtentAllocator &allocator, idx_t slot, const string &name);
+
+	/// @brief Creates the catalog entry describing the current state of the database. The entry of a removed database
+	/// is not in use.
+	DatabaseCatalogEntry GetCatalogEntry() const;
+
+	idx_t slot;
+	string name;
+	NvmeExtentMap db_extents;
+	NvmeExtentMap wal_extents;
+	std::atomic<idx_t> db_location;
+	std::atomic<idx_t> wal_location;
+	/// @brief Set when the database has been removed. Open handles can no longer write to the database or its WAL.
+	std::atomic<bool> removed;
+
+	/// @brief Tracks how often the blocks of the database are rewritten to separate hot from cold data
+	NvmeLifetimeEstimator lifetime_estimator;
+
+	/// @brief Serializes writes of the catalog entry of this database
+	std::mutex sync_lock;
+};
+
+/// @brief Keeps track of the databases stored on the device and the catalog slot of each of them
+class NvmeDatabaseCatalog {
+public:
+	NvmeDatabaseCatalog(NvmeExtentAllocator &allocator, idx_t max_databases);
+
+	/// @brief Extracts the name of the database that a database or WAL path belongs to
+	/// @param filename Path of the database or WAL file, e.g. nvmefs:///test.db.wal
+	/// @return The database name, e.g. test.db
+	static string GetDatabaseName(const string &filename);
+
+	/// @brief Fetches a database by name
+	/// @return The database or nullptr if it is not in the catalog
+	shared_ptr<NvmeDatabase> GetDatabase(const string &name);
+
+	/// @brief Fetches a database by name and adds it to the catalog if it does not exist
+	/// @param name Name of the database
+	/// @param created Set to true if the database was added to the catalog
+	/// @return The database
+	shared_ptr<NvmeDatabase> GetOrCreateDatabase(const string &name, bool &created);
+
+	/// @brief Removes a database from the catalog and marks it as removed. Its catalog slot and extents stay reserved
+	/// until ReleaseDatabase is called, such that the persisted entry can be cleared first.
+	/// @return The removed database or nullptr if it is not in the catalog
+	shared_ptr<NvmeDatabase> RemoveDatabase(const string &name);
+
+	/// @brief Returns the extents of the database and its WAL to the device and frees its catalog slot
+	/// @param database A database returned by RemoveDatabase
+	void ReleaseDatabase(NvmeDatabase &database);
+
+	/// @brief Adds a database that was persisted on the device to the catalog
+	/// @param slot The catalog slot that the entry was read from
+	/// @param entry The persisted entry
+	void LoadDatabase(idx_t slot, const DatabaseCatalogEntry &entry);
+
+	/// @brief Calls the callback for every database in the catalog
+	void Scan(const std::function<void(NvmeDatabase &)> &callback);
+
+	idx_t GetMaxDatabases() const {
+		return max_databases;
+	}
+
+private:
+	NvmeExtentAllocator &allocator;
+	const idx_t max_databases;
+	map<string, shared_ptr<NvmeDatabase>> databases;
+	vector<bool> used_slots;
+	boost::shared_mutex catalog_mutex;
+};
+
+} // namespace duckdb
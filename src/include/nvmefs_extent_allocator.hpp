@@ -0,0 +1,191 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include "duckdb/common/map.hpp"
+#include "duckdb/common/optional_idx.hpp"
+#include "duckdb/common/set.hpp"
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <functional>
+#include <mutex>
+
+namespace duckdb {
+
+/// The smallest extent nvmefs hands out. Keeps the extent table of small devices tiny.
+constexpr idx_t NVMEFS_MIN_EXTENT_SIZE = 1ULL << 20; // 1 MiB
+/// Upper bound on the number of extents. Larger devices get larger extents instead.
+constexpr idx_t NVMEFS_MAX_EXTENT_COUNT = 1ULL << 16;
+
+/// Owners of extents. An owner of 0 means that the extent is free.
+constexpr uint32_t NVMEFS_EXTENT_OWNER_FREE = 0;
+constexpr uint32_t NVMEFS_EXTENT_OWNER_METADATA = 1;
+constexpr uint32_t NVMEFS_EXTENT_OWNER_TEMPORARY = 2;
+/// Every database in the catalog owns two ids, one for the database file and one for its WAL. The database in catalog
+/// slot i owns NVMEFS_EXTENT_OWNER_DATABASE + 2i and NVMEFS_EXTENT_OWNER_WAL + 2i.
+constexpr uint32_t NVMEFS_EXTENT_OWNER_DATABASE = 3;
+constexpr uint32_t NVMEFS_EXTENT_OWNER_WAL = 4;
+
+inline uint32_t GetDatabaseExtentOwner(idx_t slot) {
+	return NVMEFS_EXTENT_OWNER_DATABASE + 2 * slot;
+}
+
+inline uint32_t GetWALExtentOwner(idx_t slot) {
+	return NVMEFS_EXTENT_OWNER_WAL + 2 * slot;
+}
+
+/// Files in the general file namespace own NVMEFS_EXTENT_OWNER_FILE + i, where i is the slot of the file in the
+/// directory index. Kept far above the database owners such that the two ranges never overlap.
+constexpr uint32_t NVMEFS_EXTENT_OWNER_FILE = 1U << 16;
+
+inline uint32_t GetFileExtentOwner(idx_t slot) {
+	return NVMEFS_EXTENT_OWNER_FILE + slot;
+}
+
+/// @brief The extents that an owner may allocate from. Devices that place the regions of the file system on devices
+/// of their own restrict each pool to the extents of its region, otherwise every pool spans all data extents.
+enum class ExtentPool : uint8_t { DATA, WAL, TEMPORARY };
+constexpr idx_t NVMEFS_EXTENT_POOL_COUNT = 3;
+
+/// @brief Fetches the pool of extents that the given owner allocates from
+ExtentPool GetExtentPool(uint32_t owner);
+
+/// @brief Fetches the I/O category of the file that the given owner belongs to
+IOCategory GetExtentOwnerCategory(uint32_t owner);
+
+/// @brief A single entry of the persisted extent table
+struct ExtentEntry {
+	uint32_t owner;
+	uint32_t logical_index;
+};
+
+/// @brief A contiguous range of LBAs on the device that backs a logical range of a file
+struct ExtentRun {
+	idx_t start_lba;
+	idx_t nr_lbas;
+	bool mapped;
+};
+
+/// @brief Divides the whole device into equally sized extents and hands them out to the database, WAL and temporary
+/// files on demand. Extent 0 is reserved for the global metadata and the extent table itself.
+class NvmeExtentAllocator {
+public:
+	/// @brief Constructor for NvmeExtentAllocator
+	/// @param extent_count Number of extents on the device (including the reserved metadata extent)
+	/// @param extent_lba_count Number of LBAs in each extent
+	/// @param lba_size Size of a single LBA in bytes
+	NvmeExtentAllocator(idx_t extent_count, idx_t extent_lba_count, idx_t lba_size);
+
+	/// @brief Calculates the extent size in LBAs for a device with the given geometry
+	static idx_t CalculateExtentLBACount(idx_t lba_count, idx_t lba_size);
+
+	/// @brief Allocates a free extent for the given owner
+	/// @param owner The owner of the extent
+	/// @param logical_index The logical position of the extent within the owner
+	/// @param preferred_extent The extent that should be used if it is free. Otherwise, the next free extent after it.
+	/// @return The index of the allocated extent, or an invalid index if the pool of the owner is full
+	optional_idx TryAllocateExtent(uint32_t owner, uint32_t logical_index, idx_t preferred_extent = 0);
+
+	/// @brief Restricts the extents that the owners of a pool may allocate
+	/// @param pool The pool to restrict
+	/// @param first_extent The first extent of the pool, at least 1
+	/// @param end_extent The extent after the last extent of the pool
+	void SetPoolExtents(ExtentPool pool, idx_t first_extent, idx_t end_extent);
+
+	/// @brief Returns the extent to the pool of free extents
+	void FreeExtent(idx_t extent);
+
+	/// @brief Frees every extent owned by the given owner
+	void FreeOwner(uint32_t owner);
+
+	/// @brief Fetches the extents of an owner ordered by their logical index
+	vector<idx_t> GetOwnedExtents(uint32_t owner);
+
+	idx_t GetExtentStartLBA(idx_t extent) const {
+		return extent * extent_lba_count;
+	}
+
+	idx_t GetExtentLBACount() const {
+		return extent_lba_count;
+	}
+
+	idx_t GetExtentCount() const {
+		return extent_count;
+	}
+
+	idx_t GetFreeExtentCount();
+
+	/// @brief Counts the extents of every owner that owns any
+	/// @return The number of extents per owner, excluding the reserved metadata extent and free extents
+	unordered_map<uint32_t, idx_t> GetExtentCountPerOwner();
+
+	/// @brief Number of LBAs that can be used for data, i.e. excluding the reserved metadata extent
+	idx_t GetDataLBACount() const {
+		return (extent_count - 1) * extent_lba_count;
+	}
+
+	/// @brief The extent table is stored directly after the global metadata in the reserved extent
+	idx_t GetTableLBACount() const;
+	void SerializeTable(data_ptr_t buffer);
+	void DeserializeTable(const_data_ptr_t buffer);
+
+	/// @brief Returns the LBA ranges (relative to the start of the table) that have changed since the last call
+	vector<pair<idx_t, idx_t>> TakeDirtyTableRanges();
+
+	/// @brief Calls the callback for every contiguous LBA range of extents that have been freed since the last call
+	/// and are still free, such that the device can be told that their data is no longer needed. The callback runs
+	/// without the allocator lock, and the extents are only handed out again once it returns.
+	/// @throws The exception of the callback, after which the extents are free without being deallocated
+	void DeallocateFreedExtents(const std::function<void(idx_t start_lba, idx_t nr_lbas)> &deallocate);
+
+private:
+	void MarkDirty(idx_t extent);
+
+private:
+	const idx_t extent_count;
+	const idx_t extent_lba_count;
+	const idx_t lba_size;
+	std::mutex allocator_lock;
+	vector<ExtentEntry> table;
+	set<idx_t> free_extents;
+	vector<bool> dirty_table_lbas;
+	set<idx_t> deallocation_pending;
+	/// The first extent and the extent after the last extent of every pool
+	pair<idx_t, idx_t> pool_extents[NVMEFS_EXTENT_POOL_COUNT];
+};
+
+/// @brief Maps the logical LBAs of a file (e.g. the database or the WAL) onto the extents that it owns. The file grows
+/// by allocating new extents when it is written past its end, and shrinks again when it is truncated.
+class NvmeExtentMap {
+public:
+	NvmeExtentMap(NvmeExtentAllocator &allocator, uint32_t owner);
+
+	/// @brief Loads the extents that are already owned by the file from the allocator
+	void Load();
+
+	/// @brief Translates a logical LBA range into the device LBA runs that back it
+	/// @param logical_lba The first logical LBA of the range
+	/// @param nr_lbas Number of LBAs in the range
+	/// @param allocate If true, extents are allocated for the unmapped part of the range
+	/// @return The runs that covers the range in logical order
+	vector<ExtentRun> Map(idx_t logical_lba, idx_t nr_lbas, bool allocate);
+
+	/// @brief Frees all extents that are not needed to store the given amount of LBAs
+	void Truncate(idx_t nr_lbas);
+
+	/// @brief Number of LBAs that are currently backed by extents
+	idx_t GetAllocatedLBACount();
+
+private:
+	void Grow(idx_t extent_amount);
+	/// @brief Translates a logical LBA range into runs. The caller holds the map mutex.
+	vector<ExtentRun> MapRuns(idx_t logical_lba, idx_t nr_lbas);
+
+private:
+	NvmeExtentAllocator &allocator;
+	const uint32_t owner;
+	vector<idx_t> extents;
+	boost::shared_mutex map_mutex;
+};
+
+} // namespace duckdb
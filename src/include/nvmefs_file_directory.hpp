@@ -0,0 +1,103 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/map.hpp"
+#include "nvmefs_extent_allocator.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace duckdb {
+
+/// The maximum number of files in the general file namespace of a device
+constexpr idx_t NVMEFS_MAX_FILES = 512;
+constexpr idx_t NVMEFS_MAX_FILE_NAME_LENGTH = 239;
+
+/// @brief The persisted entry of a file in the directory index. Entries are 256 bytes, such that an LBA always holds a
+/// whole number of entries.
+struct FileDirectoryEntry {
+	uint64_t in_use;
+	// Size of the file in bytes
+	uint64_t size;
+	char path[NVMEFS_MAX_FILE_NAME_LENGTH + 1];
+};
+
+/// @brief Runtime state of a file in the general file namespace, e.g. a Parquet or CSV file. The file grows by
+/// allocating extents on write, and its size is tracked in bytes as opposed to database files which are sized in LBAs.
+class NvmeFile {
+public:
+	NvmeFile(NvmeExtentAllocator &allocator, idx_t slot, const string &name);
+
+	idx_t slot;
+	string name;
+	NvmeExtentMap extents;
+	std::atomic<idx_t> size;
+
+	/// @brief Set when the size of the file has changed since the directory index was last written
+	std::atomic<bool> dirty;
+
+	/// @brief Set when the file has been removed. Open handles can no longer write to the file.
+	std::atomic<bool> removed;
+
+	/// @brief Serializes read-modify-write of LBAs that are only partially covered by a write
+	std::mutex partial_write_lock;
+};
+
+/// @brief Keeps track of the files in the general file namespace and persists them in the directory index
+class NvmeFileDirectory {
+public:
+	NvmeFileDirectory(NvmeExtentAllocator &allocator, idx_t max_files, idx_t lba_size);
+
+	/// @brief Extracts the name of a file from its path
+	/// @param path Path of the file, e.g. nvmefs:///exports/lineitem.parquet
+	/// @return The name of the file, e.g. exports/lineitem.parquet
+	static string GetFileName(const string &path);
+
+	/// @brief Fetches a file by name
+	/// @return The file or nullptr if it does not exist
+	shared_ptr<NvmeFile> GetFile(const string &name);
+
+	/// @brief Fetches a file by name and creates it if it does not exist
+	shared_ptr<NvmeFile> GetOrCreateFile(const string &name);
+
+	/// @brief Removes the file and returns its extents to the device
+	/// @return True if the file existed
+	bool RemoveFile(const string &name);
+
+	/// @brief Lists the files and directories directly inside a directory
+	/// @param directory Name of the directory. The empty string is the root directory.
+	/// @param callback Called with the name of each entry relative to the directory, and if the entry is a directory
+	/// @return True if the directory contains any files
+	bool ListFiles(const string &directory, const std::function<void(const string &, bool)> &callback);
+
+	/// @brief Calls the callback for every file in the namespace
+	void Scan(const std::function<void(NvmeFile &)> &callback);
+
+	/// @brief Number of LBAs that the directory index occupies on the device
+	idx_t GetIndexLBACount() const;
+
+	/// @brief Serializes the whole directory index into the buffer
+	/// @return The LBA ranges (relative to the start of the index) that have changed since the last call
+	vector<pair<idx_t, idx_t>> SerializeDirtyIndex(data_ptr_t buffer);
+
+	/// @brief Loads the files of a persisted directory index
+	void DeserializeIndex(const_data_ptr_t buffer);
+
+	idx_t GetMaxFiles() const {
+		return max_files;
+	}
+
+private:
+	NvmeExtentAllocator &allocator;
+	const idx_t max_files;
+	const idx_t lba_size;
+	map<string, shared_ptr<NvmeFile>> files;
+	vector<bool> used_slots;
+	/// @brief Slots that have been created or removed since the directory index was last written
+	vector<bool> dirty_slots;
+	boost::shared_mutex directory_mutex;
+};
+
+} // namespace duckdb
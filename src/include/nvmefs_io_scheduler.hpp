@@ -0,0 +1,189 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace duckdb {
+
+/// @brief The classes that the scheduler queues commands in, from the most to the least latency sensitive
+enum class IOClass : uint8_t { WAL, METADATA, DATABASE_READ, DATABASE_WRITE, TEMPORARY };
+constexpr idx_t NVMEFS_IO_CLASS_COUNT = 5;
+
+/// Waiting commands check this often whether their class has been given new tokens
+constexpr std::chrono::microseconds NVMEFS_SCHEDULER_REFILL_INTERVAL = std::chrono::microseconds(500);
+
+/// @brief Returns the lower case name of an I/O class, e.g. "database_read"
+string IOClassToString(IOClass io_class);
+
+/// @brief Determines the class of a command. General files, e.g. the output of COPY TO, are scheduled like the database.
+IOClass GetIOClass(IOCategory category, bool write);
+
+/// @brief How the commands of a single class are dispatched
+struct IOClassPolicy {
+	/// Share of the device that the class gets while other classes are waiting as well
+	idx_t weight;
+	/// Bytes per second that the class may transfer, or 0 if the class is not limited
+	idx_t rate;
+	/// Bytes that the class may transfer at once after it has been idle
+	idx_t burst;
+};
+
+/// @brief Configures the I/O scheduler. A policy is given as a comma-separated list of settings, e.g.
+/// 'depth=8,wal=32,temporary=1,temporary:rate=200MB'. 'depth=<commands>' limits the commands in flight on the device,
+/// '<class>=<weight>' sets the weight of a class, and '<class>:rate=<size>' and '<class>:burst=<size>' limit the
+/// bandwidth of a class with a token bucket. The classes are wal, metadata, database_read, database_write and
+/// temporary. Settings that are not given keep their default.
+class NvmeSchedulerPolicy {
+public:
+	/// @brief Creates the default policy, which weighs the classes by their priority and limits none of them
+	NvmeSchedulerPolicy();
+
+	/// @brief Parses a scheduler policy. An empty string yields the default policy.
+	/// @throws InvalidInputException if the policy is malformed
+	static NvmeSchedulerPolicy Parse(const string &policy);
+
+	idx_t GetDepth() const {
+		return depth;
+	}
+
+	const IOClassPolicy &GetClassPolicy(IOClass io_class) const {
+		return classes[static_cast<idx_t>(io_class)];
+	}
+
+	/// @brief Describes the policy for nvmefs_device_info()
+	string ToString() const;
+
+private:
+	static IOClass ParseClass(const string &name);
+
+private:
+	idx_t depth;
+	IOClassPolicy classes[NVMEFS_IO_CLASS_COUNT];
+};
+
+/// @brief A snapshot of the work the scheduler did for a class
+struct IOClassStatistics {
+	IOClass io_class;
+	idx_t commands;
+	/// Commands that could not be sent to the device right away
+	idx_t queued;
+	idx_t wait_ns;
+	idx_t max_wait_ns;
+};
+
+/// @brief A device that limits the commands in flight on another device and decides which of the waiting commands is
+/// sent next. Each class has its own queue. Classes share the device by their weight with stride scheduling: every
+/// dispatched command advances the pass of its class by its size divided by the weight of the class, and the waiting
+/// class with the lowest pass is served next, where ties go to the more latency sensitive class. A class with a rate
+/// additionally waits until its token bucket holds tokens again, such that background I/O such as temporary spills
+/// cannot take the whole device. Commands are sent right away as long as the device has room and nothing is waiting.
+class SchedulingDevice : public Device {
+public:
+	/// @brief Constructor for SchedulingDevice
+	/// @param device The device that the commands are sent to
+	/// @param policy The depth, weights and rates of the scheduler
+	SchedulingDevice(unique_ptr<Device> device, NvmeSchedulerPolicy policy);
+
+	idx_t Write(void *buffer, const CmdContext &context) override;
+	idx_t Read(void *buffer, const CmdContext &context) override;
+	/// @brief Deallocations only update the mapping of the device, hence they are not scheduled
+	idx_t Deallocate(const CmdContext &context) override;
+	bool Copy(const CmdContext &context, idx_t source_lba) override;
+
+	DeviceGeometry GetDeviceGeometry() override;
+
+	void SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) override;
+
+	string GetName() const override {
+		return "SchedulingDevice";
+	}
+
+	/// @brief Describes the scheduled device and adds the scheduler policy
+	vector<pair<string, string>> GetDeviceInfo() override;
+
+	vector<DeviceRegion> GetRegions() override {
+		return device->GetRegions();
+	}
+
+	const NvmeSchedulerPolicy &GetPolicy() const {
+		return policy;
+	}
+
+	/// @return The statistics of every class, in the order of IOClass
+	vector<IOClassStatistics> GetStatistics();
+
+	/// @brief Number of commands that are waiting to be sent to the device
+	idx_t GetQueuedCommandCount();
+
+private:
+	/// @brief A command that waits in the queue of its class. It lives on the stack of the waiting thread.
+	struct QueuedCommand {
+		QueuedCommand(IOClass io_class, idx_t nr_bytes) : io_class(io_class), nr_bytes(nr_bytes), dispatched(false) {
+		}
+
+		const IOClass io_class;
+		const idx_t nr_bytes;
+		bool dispatched;
+		std::condition_variable ready;
+	};
+
+	struct ClassState {
+		std::deque<QueuedCommand *> queue;
+		/// The virtual time at which the class is served next
+		double pass = 0;
+		/// The bytes the class may still transfer. Can become negative, as a command is not split.
+		double tokens = 0;
+		idx_t commands = 0;
+		idx_t queued = 0;
+		idx_t wait_ns = 0;
+		idx_t max_wait_ns = 0;
+	};
+
+	/// @brief Releases the slot of a dispatched command when the command is done, even if it failed
+	class DispatchedCommand {
+	public:
+		explicit DispatchedCommand(SchedulingDevice &scheduler) : scheduler(scheduler) {
+		}
+		~DispatchedCommand() {
+			scheduler.Complete();
+		}
+
+	private:
+		SchedulingDevice &scheduler;
+	};
+
+	/// @brief Waits until the command may be sent to the device
+	void Admit(IOClass io_class, idx_t nr_bytes);
+	/// @brief Frees the slot of a command that the device has completed and dispatches the next command
+	void Complete();
+
+	/// @brief Sends waiting commands to the device while it has room. Requires the scheduler_lock to be held.
+	void DispatchCommands();
+	/// @brief Checks if a class may send a command. Requires the scheduler_lock to be held.
+	bool CanDispatch(IOClass io_class);
+	/// @brief Charges a dispatched command to its class. Requires the scheduler_lock to be held.
+	void ChargeCommand(IOClass io_class, idx_t nr_bytes);
+	/// @brief Adds the tokens that the classes earned since the last refill. Requires the scheduler_lock to be held.
+	void RefillTokens();
+
+	ClassState &GetClassState(IOClass io_class) {
+		return classes[static_cast<idx_t>(io_class)];
+	}
+
+private:
+	unique_ptr<Device> device;
+	const NvmeSchedulerPolicy policy;
+	std::mutex scheduler_lock;
+	idx_t in_flight;
+	/// The pass of the last dispatched command. Classes that start waiting begin at this pass, such that a class cannot
+	/// save up credit while it is idle.
+	double virtual_time;
+	std::chrono::steady_clock::time_point last_refill;
+	ClassState classes[NVMEFS_IO_CLASS_COUNT];
+};
+
+} // namespace duckdb
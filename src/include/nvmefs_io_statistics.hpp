@@ -0,0 +1,103 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace duckdb {
+
+/// Latencies are counted in power of two buckets of nanoseconds, i.e. bucket b holds latencies in [2^b, 2^(b+1)).
+/// The last bucket holds everything from roughly nine minutes and up.
+constexpr idx_t NVMEFS_LATENCY_BUCKET_COUNT = 40;
+constexpr idx_t NVMEFS_CACHE_LINE_SIZE = 64;
+
+enum class IODirection : uint8_t { READ, WRITE };
+constexpr idx_t NVMEFS_IO_DIRECTION_COUNT = 2;
+
+/// @brief The counters of a single thread for a single category. Only the owning thread writes them, hence relaxed
+/// atomics suffice and the counters cost no more than plain increments.
+struct IOCategoryCounters {
+	std::atomic<uint64_t> ops[NVMEFS_IO_DIRECTION_COUNT];
+	std::atomic<uint64_t> bytes[NVMEFS_IO_DIRECTION_COUNT];
+	std::atomic<uint64_t> latency_ns[NVMEFS_IO_DIRECTION_COUNT];
+	std::atomic<uint64_t> read_modify_writes;
+	std::atomic<uint64_t> bounce_copies;
+	std::atomic<uint64_t> latency_histogram[NVMEFS_IO_DIRECTION_COUNT][NVMEFS_LATENCY_BUCKET_COUNT];
+};
+
+/// @brief The counters of a single thread. The counters are padded on both sides, such that the counters of two
+/// threads never share a cache line, regardless of where the allocator places them.
+struct IOThreadCounters {
+	char front_padding[NVMEFS_CACHE_LINE_SIZE];
+	IOCategoryCounters categories[NVMEFS_IO_CATEGORY_COUNT];
+	char back_padding[NVMEFS_CACHE_LINE_SIZE];
+};
+
+/// @brief A snapshot of the counters of a category, summed over all threads
+struct IOCategoryStatistics {
+	IOCategory category;
+	idx_t ops[NVMEFS_IO_DIRECTION_COUNT];
+	idx_t bytes[NVMEFS_IO_DIRECTION_COUNT];
+	/// Sum of the latencies of all commands, i.e. the time spent waiting for the device
+	idx_t latency_ns[NVMEFS_IO_DIRECTION_COUNT];
+	idx_t read_modify_writes;
+	idx_t bounce_copies;
+	idx_t latency_histogram[NVMEFS_IO_DIRECTION_COUNT][NVMEFS_LATENCY_BUCKET_COUNT];
+
+	/// @brief Estimates a latency percentile from the histogram by interpolating within the bucket of the percentile
+	/// @param direction Reads or writes
+	/// @param percentile The percentile in [0, 1], e.g. 0.99
+	/// @return The latency in nanoseconds, or an invalid index when no command was counted
+	optional_idx GetLatencyPercentile(IODirection direction, double percentile) const;
+};
+
+/// @brief Counts the commands that nvmefs sends to its device per category. Every thread counts in its own padded
+/// counters, which are only summed when the statistics are requested.
+class NvmeIOStatistics {
+public:
+	NvmeIOStatistics();
+
+	/// @brief Counts a command that completed
+	/// @param category The category of the data of the command
+	/// @param direction Whether the command read or wrote
+	/// @param nr_bytes The amount of bytes that the command transferred
+	/// @param latency_ns The time from submission to completion
+	void RecordIO(IOCategory category, IODirection direction, idx_t nr_bytes, idx_t latency_ns);
+	/// @brief Counts an LBA that was read, partially modified and written back, as a write did not cover it fully
+	void RecordReadModifyWrite(IOCategory category);
+	/// @brief Counts a copy of data between the buffer of the caller and an intermediate buffer
+	void RecordBounceCopy(IOCategory category);
+
+	/// @brief Sums the counters of all threads
+	/// @return The statistics of every category, in the order of IOCategory
+	vector<IOCategoryStatistics> GetStatistics();
+
+	/// @brief Sets all counters to zero. Commands that complete during the reset may be partially counted.
+	void Reset();
+
+	/// @brief The histogram bucket of a latency
+	static idx_t GetLatencyBucket(idx_t latency_ns);
+
+	/// @brief The difference between two snapshots, e.g. the I/O of a single query. Counters that were reset in
+	/// between count from zero.
+	static vector<IOCategoryStatistics> Subtract(const vector<IOCategoryStatistics> &after,
+	                                             const vector<IOCategoryStatistics> &before);
+
+	/// @brief Describes the reads and writes of every category that had any, one line per category and direction,
+	/// e.g. "temporary write: 12 ops, 3.0 MiB, 1.52 ms"
+	static vector<string> Describe(const vector<IOCategoryStatistics> &statistics);
+
+private:
+	IOCategoryCounters &GetCounters(IOCategory category);
+	IOThreadCounters &RegisterThread();
+
+private:
+	/// Identifies the statistics in the cache of each thread. Unlike the address, it is never reused.
+	const idx_t id;
+	std::mutex threads_lock;
+	unordered_map<std::thread::id, unique_ptr<IOThreadCounters>> threads;
+};
+
+} // namespace duckdb
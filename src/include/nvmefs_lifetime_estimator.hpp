@@ -0,0 +1,42 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include <mutex>
+
+namespace duckdb {
+
+/// The database is tracked in ranges of 256 KiB, i.e. the default DuckDB block size with 4 KiB LBAs
+constexpr idx_t NVMEFS_LIFETIME_RANGE_LBA_COUNT = 64;
+/// Every write adds this to the score of the written range
+constexpr uint8_t NVMEFS_REWRITE_SCORE = 2;
+/// A range is hot once its score reaches this threshold, i.e. when it was also written in the previous epoch
+constexpr uint8_t NVMEFS_HOT_REWRITE_THRESHOLD = 3;
+
+/// @brief Estimates how long the data written to a range of the database lives, based on how often the range has been
+/// rewritten recently. Every range keeps a rewrite score that is halved for every checkpoint (epoch) that passes.
+/// Ranges that are rewritten by consecutive checkpoints, such as the database header and metadata blocks, stay hot,
+/// while data that is written once and then left alone is cold.
+class NvmeLifetimeEstimator {
+public:
+	NvmeLifetimeEstimator(idx_t range_lba_count = NVMEFS_LIFETIME_RANGE_LBA_COUNT);
+
+	/// @brief Records a write to a logical LBA range of the database
+	/// @param lba_location The first logical LBA of the write
+	/// @param nr_lbas Number of LBAs written
+	/// @return True if the written data is expected to be short-lived
+	bool RecordWrite(idx_t lba_location, idx_t nr_lbas);
+
+	/// @brief Starts a new epoch. Called whenever the database is checkpointed.
+	void AdvanceEpoch();
+
+	idx_t GetEpoch();
+
+private:
+	const idx_t range_lba_count;
+	std::mutex estimator_lock;
+	uint32_t epoch;
+	vector<uint8_t> rewrite_scores;
+	vector<uint32_t> last_write_epochs;
+};
+
+} // namespace duckdb
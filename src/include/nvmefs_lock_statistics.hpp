@@ -0,0 +1,183 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "nvmefs_io_statistics.hpp"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <boost/thread/shared_mutex.hpp>
+
+namespace duckdb {
+
+/// @brief The synchronization points of nvmefs whose contention is measured
+enum class LockSite : uint8_t {
+	/// The lock of the file map of the temporary file metadata manager
+	TEMP_MUTEX,
+	/// The locks of the block maps of the temporary files
+	FILE_MUTEX,
+	/// The compare-and-swap loops that advance the end of a database file
+	DB_LOCATION,
+	/// The compare-and-swap loops that advance the end of a write-ahead log
+	WAL_LOCATION,
+	/// The xNVMe queues, which threads share when there are more threads than queues
+	DEVICE_QUEUE
+};
+constexpr idx_t NVMEFS_LOCK_SITE_COUNT = 5;
+
+string LockSiteToString(LockSite site);
+
+/// @brief The counters of a single thread for a single lock site. Only the owning thread writes them.
+struct LockSiteCounters {
+	std::atomic<uint64_t> acquisitions;
+	/// Acquisitions that had to wait for another thread, or compare-and-swap loops that had to retry
+	std::atomic<uint64_t> contended;
+	std::atomic<uint64_t> wait_ns;
+	std::atomic<uint64_t> max_wait_ns;
+};
+
+/// @brief The counters of a single thread, padded like IOThreadCounters
+struct LockThreadCounters {
+	char front_padding[NVMEFS_CACHE_LINE_SIZE];
+	LockSiteCounters sites[NVMEFS_LOCK_SITE_COUNT];
+	char back_padding[NVMEFS_CACHE_LINE_SIZE];
+};
+
+/// @brief A snapshot of the counters of a lock site, summed over all threads
+struct LockSiteStatistics {
+	LockSite site;
+	idx_t acquisitions;
+	idx_t contended;
+	idx_t wait_ns;
+	idx_t max_wait_ns;
+};
+
+/// @brief Counts the acquisitions of the lock sites of the process and the time spent waiting for them. The temporary
+/// metadata lock is shared by all file systems of the process, hence so are the statistics. An acquisition that does
+/// not have to wait costs a relaxed increment of a counter of the calling thread.
+class NvmeLockStatistics {
+public:
+	static NvmeLockStatistics &Get();
+
+	void RecordAcquisition(LockSite site) {
+		GetCounters(site).acquisitions.fetch_add(1, std::memory_order_relaxed);
+	}
+	void RecordContendedAcquisition(LockSite site, idx_t wait_ns);
+
+	/// @brief Sums the counters of all threads
+	/// @return The statistics of every lock site, in the order of LockSite
+	vector<LockSiteStatistics> GetStatistics();
+
+	void Reset();
+
+private:
+	NvmeLockStatistics() = default;
+	LockSiteCounters &GetCounters(LockSite site);
+
+private:
+	std::mutex threads_lock;
+	/// Counters outlive their threads, such that the acquisitions of finished threads are still counted
+	vector<unique_ptr<LockThreadCounters>> threads;
+};
+
+/// @brief Nanoseconds on the clock that waits are measured with
+inline uint64_t LockWaitClock() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+	           std::chrono::steady_clock::now().time_since_epoch())
+	    .count();
+}
+
+/// @brief A mutex that counts its acquisitions. It first tries to take the mutex, and only reads the clock when that
+/// fails, such that uncontended acquisitions are not slowed down by the measurement.
+template <class MUTEX>
+class InstrumentedMutex {
+public:
+	explicit InstrumentedMutex(LockSite site) : site(site) {
+	}
+
+	void lock() {
+		if (mutex.try_lock()) {
+			NvmeLockStatistics::Get().RecordAcquisition(site);
+			return;
+		}
+		uint64_t start = LockWaitClock();
+		mutex.lock();
+		NvmeLockStatistics::Get().RecordContendedAcquisition(site, LockWaitClock() - start);
+	}
+
+	bool try_lock() {
+		if (!mutex.try_lock()) {
+			return false;
+		}
+		NvmeLockStatistics::Get().RecordAcquisition(site);
+		return true;
+	}
+
+	void unlock() {
+		mutex.unlock();
+	}
+
+protected:
+	const LockSite site;
+	MUTEX mutex;
+};
+
+/// @brief A shared mutex that counts its shared and exclusive acquisitions
+class InstrumentedSharedMutex : public InstrumentedMutex<boost::shared_mutex> {
+public:
+	explicit InstrumentedSharedMutex(LockSite site) : InstrumentedMutex<boost::shared_mutex>(site) {
+	}
+
+	void lock_shared() {
+		if (mutex.try_lock_shared()) {
+			NvmeLockStatistics::Get().RecordAcquisition(site);
+			return;
+		}
+		uint64_t start = LockWaitClock();
+		mutex.lock_shared();
+		NvmeLockStatistics::Get().RecordContendedAcquisition(site, LockWaitClock() - start);
+	}
+
+	bool try_lock_shared() {
+		if (!mutex.try_lock_shared()) {
+			return false;
+		}
+		NvmeLockStatistics::Get().RecordAcquisition(site);
+		return true;
+	}
+
+	void unlock_shared() {
+		mutex.unlock_shared();
+	}
+};
+
+/// @brief Counts a compare-and-swap loop as an acquisition of a lock site. The loop calls Retry() after every failed
+/// exchange, and a loop that retried counts as contended for the time from its first failure until it finishes.
+/// Spurious failures of compare_exchange_weak count as contention as well.
+class InstrumentedCASLoop {
+public:
+	explicit InstrumentedCASLoop(LockSite site) : site(site), retries(0), start(0) {
+	}
+
+	~InstrumentedCASLoop() {
+		if (retries == 0) {
+			NvmeLockStatistics::Get().RecordAcquisition(site);
+		} else {
+			NvmeLockStatistics::Get().RecordContendedAcquisition(site, LockWaitClock() - start);
+		}
+	}
+
+	/// @return Always true, such that it can be chained after the exchange in the condition of the loop
+	bool Retry() {
+		if (retries++ == 0) {
+			start = LockWaitClock();
+		}
+		return true;
+	}
+
+private:
+	const LockSite site;
+	idx_t retries;
+	uint64_t start;
+};
+
+} // namespace duckdb
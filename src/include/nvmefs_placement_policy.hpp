@@ -0,0 +1,63 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/map.hpp"
+#include "duckdb/common/optional_idx.hpp"
+
+namespace duckdb {
+
+/// @brief The regions of the device that have their writes placed independently of each other
+enum class PlacementRegion : uint8_t { METADATA, DATABASE, WAL, TEMPORARY, GENERAL };
+
+constexpr idx_t NVMEFS_PLACEMENT_REGION_COUNT = 5;
+
+/// @brief Decides which placement identifier (i.e. which reclaim unit handle of an FDP device) the writes of each
+/// region are tagged with. Data with different lifetimes, such as the WAL, checkpointed database blocks and temporary
+/// spills, should not share reclaim units, as the device would otherwise have to move the long-lived data during
+/// garbage collection.
+///
+/// A policy is given as a comma-separated list of region=identifier pairs, e.g.
+/// 'database=0,wal=1,temporary=2,temporary:S32K=3'. Temporary files can be placed per size class by suffixing the
+/// region with the size class of the temporary file (S32K ... S224K, DEFAULT). Database blocks that are rewritten
+/// frequently can be separated from the rest of the database with 'database:hot=<identifier>'. Regions that are not
+/// given keep their default identifier.
+class NvmePlacementPolicy {
+public:
+	/// @brief Creates the default policy, which separates temporary data and the WAL from the database
+	NvmePlacementPolicy();
+
+	/// @brief Parses a placement policy. An empty string yields the default policy.
+	/// @throws InvalidInputException if the policy is malformed
+	static NvmePlacementPolicy Parse(const string &policy);
+
+	/// @brief Fetches the placement identifier of a region
+	idx_t GetPlacementIdentifier(PlacementRegion region) const;
+
+	/// @brief Fetches the placement identifier of a temporary file, taking its size class into account
+	/// @param path Path of the temporary file, e.g. nvmefs:///tmp/duckdb_temp_storage_S32K-0.tmp
+	idx_t GetTemporaryPlacementIdentifier(const string &path) const;
+
+	/// @brief Extracts the size class of a temporary file from its path
+	/// @return The size class, e.g. S32K, or the empty string if the path has none
+	static string GetTemporarySizeClass(const string &path);
+
+	/// @brief Fetches the placement identifier of frequently rewritten database blocks
+	/// @return The identifier, or an invalid index if hot and cold database blocks are not separated
+	optional_idx GetHotDatabasePlacementIdentifier() const {
+		return hot_database_identifier;
+	}
+
+	/// @brief Formats the policy in the same format as it is parsed from
+	string ToString() const;
+
+private:
+	static PlacementRegion ParseRegion(const string &region);
+	static string GetRegionName(PlacementRegion region);
+
+private:
+	idx_t region_identifiers[NVMEFS_PLACEMENT_REGION_COUNT];
+	map<string, idx_t> temporary_size_class_identifiers;
+	optional_idx hot_database_identifier;
+};
+
+} // namespace duckdb
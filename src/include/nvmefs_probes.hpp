@@ -0,0 +1,106 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include <chrono>
+
+// Static tracepoints (USDT) on the I/O path, for bpftrace, perf and other eBPF tools. A probe is a nop until a tracer
+// attaches to it, and arguments that cost more than a register move, such as latencies, are only computed while the
+// semaphore of the probe shows that a tracer is attached. Categories are the values of IOCategory.
+//
+//   nvmefs:read, nvmefs:write           (category, offset, bytes, latency_ns) when a file system call returns
+//   nvmefs:submit                       (category, lba, nr_lbas, is_write) when a command is sent to the device
+//   nvmefs:complete                     (category, lba, nr_lbas, is_write, latency_ns) when the command completed
+//   nvmefs:temp__alloc, nvmefs:temp__free (lba, nr_lbas) when a temporary block is allocated or freed
+//
+// The probes are only compiled in with NVMEFS_USDT, which requires sys/sdt.h.
+#ifdef NVMEFS_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+extern "C" {
+extern unsigned short nvmefs_read_semaphore;
+extern unsigned short nvmefs_write_semaphore;
+extern unsigned short nvmefs_submit_semaphore;
+extern unsigned short nvmefs_complete_semaphore;
+extern unsigned short nvmefs_temp__alloc_semaphore;
+extern unsigned short nvmefs_temp__free_semaphore;
+}
+
+#define NVMEFS_PROBE_ENABLED(name) __builtin_expect(nvmefs_##name##_semaphore != 0, 0)
+#define NVMEFS_PROBE(name, ...)    STAP_PROBEV(nvmefs, name, __VA_ARGS__)
+#else
+#define NVMEFS_PROBE_ENABLED(name) false
+#define NVMEFS_PROBE(name, ...)                                                                                        \
+	do {                                                                                                               \
+	} while (0)
+#endif
+
+namespace duckdb {
+
+inline uint64_t NvmeProbeClock() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+	    .count();
+}
+
+/// @brief Fires the read or write probe when a file system call returns. The clock is only read if a tracer is
+/// attached to the probe when the call starts.
+class NvmeFileProbe {
+public:
+	NvmeFileProbe(bool write, IOCategory category, idx_t offset, idx_t bytes)
+	    : write(write), category(category), offset(offset), bytes(bytes), start(0) {
+		if (write ? NVMEFS_PROBE_ENABLED(write) : NVMEFS_PROBE_ENABLED(read)) {
+			start = NvmeProbeClock();
+		}
+	}
+
+	void Done() {
+#ifdef NVMEFS_USDT
+		if (start == 0) {
+			return;
+		}
+		uint64_t latency_ns = NvmeProbeClock() - start;
+		if (write) {
+			NVMEFS_PROBE(write, static_cast<uint8_t>(category), offset, bytes, latency_ns);
+		} else {
+			NVMEFS_PROBE(read, static_cast<uint8_t>(category), offset, bytes, latency_ns);
+		}
+#endif
+	}
+
+private:
+	const bool write;
+	const IOCategory category;
+	const idx_t offset;
+	const idx_t bytes;
+	uint64_t start;
+};
+
+/// @brief Fires the submit probe of a device command on Submitted() and the complete probe on Completed()
+class NvmeCommandProbe {
+public:
+	NvmeCommandProbe(const CmdContext &context, bool write) : context(context), write(write), start(0) {
+	}
+
+	void Submitted() {
+		if (NVMEFS_PROBE_ENABLED(complete)) {
+			start = NvmeProbeClock();
+		}
+		NVMEFS_PROBE(submit, static_cast<uint8_t>(context.category), context.start_lba, context.nr_lbas, write);
+	}
+
+	void Completed() {
+		if (start == 0) {
+			return;
+		}
+		NVMEFS_PROBE(complete, static_cast<uint8_t>(context.category), context.start_lba, context.nr_lbas, write,
+		             NvmeProbeClock() - start);
+	}
+
+private:
+	const CmdContext &context;
+	const bool write;
+	uint64_t start;
+};
+
+} // namespace duckdb
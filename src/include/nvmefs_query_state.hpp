@@ -0,0 +1,53 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/main/client_context_state.hpp"
+#include "nvmefs_io_statistics.hpp"
+
+namespace duckdb {
+
+/// @brief Counts the queries that are running on a database instance, such that a query can tell whether the I/O
+/// during its execution is its own
+struct NvmefsQueryTracker {
+	std::atomic<idx_t> running_queries {0};
+	std::atomic<idx_t> started_queries {0};
+};
+
+/// @brief Attributes the I/O of nvmefs to the queries of a connection. The I/O of a query is the difference between
+/// the statistics of the file system at the start and at the end of the query. Queries of other connections that
+/// run at the same time are counted as well, hence the accounting is marked as shared when queries overlap.
+class NvmefsQueryState : public ClientContextState {
+public:
+	NvmefsQueryState(NvmeIOStatistics &statistics, shared_ptr<NvmefsQueryTracker> tracker);
+
+	void QueryBegin(ClientContext &context) override;
+	void QueryEnd(ClientContext &context) override;
+
+	/// @brief Adds the I/O of the running query to the output of EXPLAIN ANALYZE and the query tree profiler
+	void WriteProfilingInformation(std::ostream &ss) override;
+
+	/// @brief The I/O of the last query that completed on the connection
+	/// @param shared Is set to true if other queries ran at the same time
+	vector<IOCategoryStatistics> GetLastQueryStatistics(bool &shared);
+
+	/// @brief Registers the state with a connection, unless it already is
+	static NvmefsQueryState &Register(ClientContext &context, NvmeIOStatistics &statistics,
+	                                  shared_ptr<NvmefsQueryTracker> tracker);
+
+private:
+	/// @brief The I/O of the running query so far
+	vector<IOCategoryStatistics> GetQueryStatistics(bool &shared);
+
+private:
+	NvmeIOStatistics &statistics;
+	shared_ptr<NvmefsQueryTracker> tracker;
+	std::mutex state_lock;
+	/// False if the state was registered while a query was running, such that the query has no start snapshot
+	bool running;
+	idx_t started_queries;
+	vector<IOCategoryStatistics> query_start;
+	bool last_query_shared;
+	vector<IOCategoryStatistics> last_query;
+};
+
+} // namespace duckdb
@@ -1,9 +1,32 @@
 #pragma once
 
 #include "duckdb.hpp"
+#include "duckdb/common/map.hpp"
+#include "duckdb/common/set.hpp"
 
 namespace duckdb {
 
+/// Free blocks are counted in size classes of 8 LBAs up to 64 LBAs, and larger free blocks in a final class
+constexpr idx_t NVMEFS_TEMP_FREE_SIZE_CLASSES = 9;
+
+/// @brief Describes how the free LBAs of the temporary ranges are split up
+struct TemporaryFragmentationStatistics {
+	idx_t range_count;
+	idx_t managed_lbas;
+	idx_t free_lbas;
+	idx_t free_blocks;
+	idx_t largest_free_block;
+	/// Element i counts the free blocks of up to 8 * (i + 1) LBAs, the last element the free blocks above 64 LBAs
+	vector<idx_t> free_block_histogram;
+};
+
+/// @brief The LBAs of a single range that are used by temporary blocks
+struct TemporaryRangeUsage {
+	idx_t start_lba;
+	idx_t lba_amount;
+	idx_t used_lbas;
+};
+
 /// @brief TemporaryBlock is a class that represents a block of LBAs that are use to store temporary data.
 class TemporaryBlock {
 	friend class NvmeTemporaryBlockManager;
@@ -16,6 +39,7 @@ public:
 	idx_t GetSizeInBytes();
 	idx_t GetStartLBA();
 	idx_t GetEndLBA();
+	idx_t GetLBAAmount();
 
 	bool IsFree();
 
@@ -35,15 +59,59 @@ private:
 
 class NvmeTemporaryBlockManager {
 public:
+	/// @brief Creates a block manager without any LBAs. LBA ranges must be added with AddRange before allocating.
+	NvmeTemporaryBlockManager();
 	NvmeTemporaryBlockManager(idx_t allocated_lba_start, idx_t allocated_lba_end);
 
 public:
 	TemporaryBlock *AllocateBlock(idx_t lba_amount);
+
+	/// @brief Allocates a block without throwing if the manager is out of space
+	/// @param lba_amount Number of LBAs in the block
+	/// @return The allocated block or nullptr if no free block is large enough
+	TemporaryBlock *TryAllocateBlock(idx_t lba_amount);
 	void FreeBlock(TemporaryBlock *block);
 
+	/// @brief Adds a new range of LBAs that blocks can be allocated from. The range does not need to be adjacent to
+	/// the already managed ranges.
+	/// @param start_lba Start LBA of the range (inclusive)
+	/// @param lba_amount Number of LBAs in the range
+	void AddRange(idx_t start_lba, idx_t lba_amount);
+
+	/// @brief Removes all ranges where every block is free
+	/// @return The start LBA and LBA amount of the removed ranges
+	vector<pair<idx_t, idx_t>> ReleaseFreeRanges();
+
+	/// @brief Total number of LBAs in the managed ranges
+	idx_t GetManagedLBACount();
+
+	/// @brief Walks all blocks to describe the free LBAs of the managed ranges
+	TemporaryFragmentationStatistics GetFragmentationStatistics();
+
+	/// @brief Sums the LBAs of the used blocks of every range
+	/// @return The usage of every range, in the order of their start LBA
+	vector<TemporaryRangeUsage> GetRangeUsage();
+
+	/// @brief Stops allocating blocks from the given ranges, such that their used blocks can be moved out of them
+	/// @param range_starts The start LBAs of the ranges to drain
+	void SetDrainingRanges(const vector<idx_t> &range_starts);
+
+	/// @brief Allows allocations from all ranges again
+	void ClearDrainingRanges();
+
+	/// @brief Checks if a block lies in a range that is being drained
+	bool IsDraining(TemporaryBlock *block);
+
 private:
 	uint8_t GetFreeListIndex(idx_t lba_amount);
 
+	/// @brief Checks if two neighbouring blocks are allowed to be merged into one block. Blocks can only be merged if
+	/// they are contiguous on the device and are part of the same range.
+	bool CanMerge(TemporaryBlock *left, TemporaryBlock *right);
+
+	/// @brief Unlinks the block from the linked list of blocks
+	unique_ptr<TemporaryBlock> UnlinkBlock(TemporaryBlock *block);
+
 	/// @brief Splits a block into two blocks. The first block will be the requested size and the second block will be
 	/// the remaining size.
 	/// @param block The block to split
@@ -59,6 +127,13 @@ private:
 
 	void PushFreeBlock(TemporaryBlock *block);
 	TemporaryBlock *PopFreeBlock(uint8_t free_list_index);
+
+	/// @brief Takes the first block of a free list that does not lie in a draining range
+	/// @return The block or nullptr if the free list has no such block
+	TemporaryBlock *TakeFreeBlock(uint8_t free_list_index);
+
+	/// @brief Finds the start LBA of the range that a block lies in
+	idx_t GetRangeStart(TemporaryBlock *block);
 	void RemoveFreeBlock(TemporaryBlock *block);
 
 private:
@@ -69,6 +144,12 @@ private:
 
 	idx_t allocated_start_lba;
 	idx_t allocated_end_lba;
+
+	/// @brief The start LBA and LBA amount of each range managed by the block manager
+	map<idx_t, idx_t> ranges;
+
+	/// @brief The start LBAs of the ranges that no blocks are allocated from while they are compacted
+	set<idx_t> draining_ranges;
 };
 
 } // namespace duckdb
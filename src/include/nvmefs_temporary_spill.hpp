@@ -0,0 +1,52 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/local_file_system.hpp"
+#include "duckdb/common/map.hpp"
+#include <mutex>
+
+namespace duckdb {
+
+/// @brief The spill tier of the temporary files: a directory of a local file system that holds the temporary blocks
+/// that do not fit into the temporary space of the device. Every temporary file has a file of the same name in the
+/// directory, where its spilled blocks are stored at the same byte location as in the temporary file.
+class NvmeTemporarySpillDirectory {
+public:
+	/// @brief Constructor for NvmeTemporarySpillDirectory
+	/// @param directory The directory to spill to, which is created if it does not exist
+	/// @throws IOException if the directory cannot be created
+	NvmeTemporarySpillDirectory(const string &directory);
+
+	/// @brief Reads the spilled bytes of a temporary file
+	/// @param path The path of the temporary file on the device
+	void Read(const string &path, void *buffer, idx_t nr_bytes, idx_t location);
+	/// @brief Writes the bytes of a temporary file to its spill file, which is created on the first write
+	/// @param path The path of the temporary file on the device
+	void Write(const string &path, void *buffer, idx_t nr_bytes, idx_t location);
+
+	/// @brief Removes the spill file of a temporary file, if it has one
+	void DeleteFile(const string &path);
+	/// @brief Removes the spill files of all temporary files
+	void Clear();
+
+	/// @brief The free space of the file system of the directory, if it is known
+	optional_idx GetAvailableSpace();
+
+	const string &GetDirectory() const {
+		return directory;
+	}
+
+private:
+	/// @brief Opens the spill file of a temporary file, which stays open until the file is deleted. Blocks are spilled
+	/// without holding the locks of the temporary files, hence a file can be deleted while its spill file is in use.
+	shared_ptr<FileHandle> GetHandle(const string &path, bool create);
+	string GetSpillPath(const string &path);
+
+private:
+	LocalFileSystem fs;
+	string directory;
+	std::mutex handles_lock;
+	map<string, shared_ptr<FileHandle>> handles;
+};
+
+} // namespace duckdb
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+namespace duckdb {
+
+/// Every thread keeps this many of its most recent spans. Must be a power of two.
+constexpr idx_t NVMEFS_TRACE_RING_SIZE = 1 << 14;
+
+/// @brief A timed section of nvmefs, e.g. a file system call or the completion of a device command
+struct NvmeTraceEvent {
+	/// A string literal, as events only keep the pointer
+	const char *name;
+	uint64_t start_ns;
+	uint64_t duration_ns;
+	uint64_t lba;
+	uint64_t nr_lbas;
+	IOCategory category;
+};
+
+/// @brief The spans of a single thread. Only the owning thread writes it, hence recording takes no lock: the event is
+/// written first and then published by advancing the head. Once the ring is full, the oldest events are overwritten.
+struct NvmeTraceRing {
+	explicit NvmeTraceRing(idx_t thread_index) : thread_index(thread_index), head(0), tail(0) {
+	}
+
+	const idx_t thread_index;
+	/// Number of events the thread has recorded
+	std::atomic<uint64_t> head;
+	/// Events before the tail have already been dumped. Only touched by the tracer.
+	uint64_t tail;
+	NvmeTraceEvent events[NVMEFS_TRACE_RING_SIZE];
+};
+
+/// @brief Records spans of all threads of the process in per-thread ring buffers. Tracing is off until it is enabled,
+/// in which case a span costs two clock reads. Building with NVMEFS_DISABLE_TRACING removes the spans altogether.
+class NvmeTracer {
+public:
+	static NvmeTracer &Get();
+
+	void SetEnabled(bool enabled);
+	bool IsEnabled() const {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	/// @brief Nanoseconds since the tracer was created
+	uint64_t Now() const;
+
+	/// @brief Records a finished span in the ring of the calling thread
+	void Record(const NvmeTraceEvent &event);
+
+	/// @brief Takes the events that were recorded since the last call, in the order they started. Events that were
+	/// overwritten before they could be taken are lost.
+	vector<pair<idx_t, NvmeTraceEvent>> TakeEvents();
+
+	/// @brief Writes the events recorded since the last dump in the Chrome trace event format, which can be opened
+	/// with Perfetto or chrome://tracing
+	/// @return The number of events written
+	idx_t WriteChromeTrace(const string &path);
+
+private:
+	NvmeTracer();
+	NvmeTraceRing &GetThreadRing();
+
+private:
+	std::atomic<bool> enabled;
+	const std::chrono::steady_clock::time_point epoch;
+	std::mutex rings_lock;
+	/// Rings outlive their threads, such that the spans of finished threads can still be dumped
+	vector<unique_ptr<NvmeTraceRing>> rings;
+};
+
+#ifndef NVMEFS_DISABLE_TRACING
+/// @brief Records the time from its construction to its destruction as a span, if tracing is enabled
+class NvmeTraceSpan {
+public:
+	NvmeTraceSpan(const char *name, IOCategory category = IOCategory::GENERAL) : active(false) {
+		NvmeTracer &tracer = NvmeTracer::Get();
+		if (!tracer.IsEnabled()) {
+			return;
+		}
+		active = true;
+		event = NvmeTraceEvent {name, tracer.Now(), 0, 0, 0, category};
+	}
+
+	~NvmeTraceSpan() {
+		if (active) {
+			NvmeTracer &tracer = NvmeTracer::Get();
+			event.duration_ns = tracer.Now() - event.start_ns;
+			tracer.Record(event);
+		}
+	}
+
+	/// @brief Annotates the span with the LBA range it accessed
+	void SetRange(idx_t lba, idx_t nr_lbas) {
+		event.lba = lba;
+		event.nr_lbas = nr_lbas;
+	}
+
+private:
+	bool active;
+	NvmeTraceEvent event;
+};
+#else
+class NvmeTraceSpan {
+public:
+	NvmeTraceSpan(const char *name, IOCategory category = IOCategory::GENERAL) {
+	}
+
+	void SetRange(idx_t lba, idx_t nr_lbas) {
+	}
+};
+#endif
+
+} // namespace duckdb
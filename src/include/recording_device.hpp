@@ -0,0 +1,113 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+namespace duckdb {
+
+constexpr char NVMEFS_TRACE_MAGIC_BYTES[8] = "NVMETRC";
+constexpr uint32_t NVMEFS_TRACE_VERSION = 1;
+/// Records are buffered and written to the trace file in batches of this many records
+constexpr idx_t NVMEFS_TRACE_BUFFER_RECORDS = 4096;
+
+enum class IOTraceOperation : uint8_t { READ, WRITE, DEALLOCATE };
+
+/// @brief The header at the start of every trace file
+struct IOTraceHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t lba_size;
+	uint64_t lba_count;
+};
+
+/// @brief A single command in a trace file. Records are stored in the order the commands completed.
+struct IOTraceRecord {
+	/// Time the command was submitted, relative to the start of the trace
+	uint64_t submit_ns;
+	uint64_t start_lba;
+	uint32_t nr_lbas;
+	/// Time from submission to completion. Saturates at roughly 4.3 seconds.
+	uint32_t latency_ns;
+	/// Index of the thread that submitted the command, in the order threads first submitted a command
+	uint16_t thread;
+	IOCategory category;
+	IOTraceOperation operation;
+	uint16_t placement_identifier;
+	uint16_t reserved;
+};
+
+/// @brief A device that forwards every command to another device and records it in a binary trace file. A trace
+/// consists of an IOTraceHeader followed by IOTraceRecords.
+class RecordingDevice : public Device {
+public:
+	/// @brief Constructor for RecordingDevice
+	/// @param device The device that the commands are forwarded to
+	/// @param trace_path Path of the trace file. An existing file is overwritten.
+	RecordingDevice(unique_ptr<Device> device, const string &trace_path);
+	/// @brief Closes the trace file if it is still open. Errors are printed rather than thrown, call Close() to see
+	/// them.
+	~RecordingDevice() override;
+
+	idx_t Write(void *buffer, const CmdContext &context) override;
+	idx_t Read(void *buffer, const CmdContext &context) override;
+	idx_t Deallocate(const CmdContext &context) override;
+
+	/// @brief Copies are not forwarded, such that they reach the device as a read and a write which the trace records
+	bool Copy(const CmdContext &context, idx_t source_lba) override {
+		return false;
+	}
+
+	DeviceGeometry GetDeviceGeometry() override;
+
+	void SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) override;
+
+	string GetName() const override {
+		return "RecordingDevice";
+	}
+
+	/// @brief Describes the recorded device and adds the trace path
+	vector<pair<string, string>> GetDeviceInfo() override;
+
+	vector<DeviceRegion> GetRegions() override {
+		return device->GetRegions();
+	}
+
+	/// @brief Writes all buffered records to the trace file
+	void Flush();
+
+	/// @brief Writes all buffered records and closes the trace file. Commands after closing are no longer recorded.
+	/// @throws IOException if the records cannot be written
+	void Close();
+
+	/// @brief Number of commands recorded so far
+	idx_t GetRecordedCommands();
+
+private:
+	void Record(IOTraceOperation operation, const CmdContext &context, std::chrono::steady_clock::time_point submit,
+	            std::chrono::steady_clock::time_point complete);
+	uint16_t GetThreadIndex();
+	/// @brief Writes the buffered records. Requires the trace_lock to be held.
+	void FlushBuffer();
+
+private:
+	unique_ptr<Device> device;
+	const string trace_path;
+	const std::chrono::steady_clock::time_point start;
+	std::mutex trace_lock;
+	FILE *trace_file;
+	vector<IOTraceRecord> buffer;
+	idx_t recorded_commands;
+	std::atomic<uint16_t> thread_counter;
+};
+
+/// @brief Reads a trace file written by a RecordingDevice
+/// @param trace_path Path of the trace file
+/// @param header Is set to the header of the trace
+/// @return All records of the trace in the order they were recorded
+vector<IOTraceRecord> ReadIOTrace(const string &trace_path, IOTraceHeader &header);
+
+} // namespace duckdb
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include "nvme_device.hpp"
+#include <functional>
+
+namespace duckdb {
+
+/// @brief A device that places the database, the WAL and the temporary files on devices of their own. The devices are
+/// laid out one after the other in a single LBA space, starting with the database device, which also holds the global
+/// metadata. The file system only allocates the extents of a category within its region, hence every category is sent
+/// to its own device and queues, e.g. such that spilling does not delay commits.
+class RegionDevice : public Device {
+public:
+	/// @brief Constructor for RegionDevice
+	/// @param database_device The device of the metadata, the databases and the general files
+	/// @param wal_device The device of the WALs, or null to keep them on the database device
+	/// @param temporary_device The device of the temporary files, or null to keep them on the database device
+	/// @throws InvalidInputException if the devices have different LBA sizes
+	RegionDevice(unique_ptr<Device> database_device, unique_ptr<Device> wal_device,
+	             unique_ptr<Device> temporary_device);
+
+	idx_t Write(void *buffer, const CmdContext &context) override;
+	idx_t Read(void *buffer, const CmdContext &context) override;
+	idx_t Deallocate(const CmdContext &context) override;
+	/// @brief Copies on a device if the source and destination are on the same device
+	bool Copy(const CmdContext &context, idx_t source_lba) override;
+
+	DeviceGeometry GetDeviceGeometry() override;
+
+	void SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) override;
+
+	string GetName() const override {
+		return "RegionDevice";
+	}
+
+	/// @brief Describes the database device and adds the ranges and devices of the regions
+	vector<pair<string, string>> GetDeviceInfo() override;
+
+	vector<DeviceRegion> GetRegions() override;
+
+	/// @brief The device that holds the region of a category, or null if the device has no such region
+	optional_ptr<Device> GetRegionDevice(IOCategory category);
+
+private:
+	struct RegionMember {
+		DeviceRegion region;
+		unique_ptr<Device> device;
+	};
+
+	/// @brief Runs a command on the members that hold its LBAs, where every member gets the part within its region
+	void Route(const CmdContext &context, const std::function<void(Device &, const CmdContext &, idx_t)> &execute);
+	RegionMember &FindMember(idx_t lba);
+
+private:
+	vector<RegionMember> members;
+	DeviceGeometry geometry;
+};
+
+} // namespace duckdb
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include "nvme_device.hpp"
+#include "device_worker_pool.hpp"
+#include <functional>
+
+namespace duckdb {
+
+/// The stripe unit when none is configured, which places every block of DuckDB on a single member
+constexpr idx_t NVMEFS_DEFAULT_STRIPE_SIZE = 1ULL << 18;
+
+/// @brief A device that stripes its LBAs over several member devices (RAID-0). The LBAs are split into stripe units
+/// that are assigned to the members round-robin, such that unit u lives on member u % members at unit u / members of
+/// that member. A command that spans several members is split at the stripe units, and the members run their part of
+/// the command concurrently on a small pool of threads, while a command on a single member runs on the calling thread.
+/// The device holds as many stripe rows as its smallest member, and all members must have the same LBA size.
+class StripedDevice : public Device {
+public:
+	/// @brief Constructor for StripedDevice
+	/// @param members The devices to stripe over, at least two
+	/// @param stripe_size The size of a stripe unit in bytes, a multiple of the LBA size of the members
+	/// @param threads The threads that run the parts of commands that span several members
+	/// @throws InvalidInputException if the members or the stripe size do not fit together
+	StripedDevice(vector<unique_ptr<Device>> members, idx_t stripe_size, idx_t threads);
+
+	idx_t Write(void *buffer, const CmdContext &context) override;
+	idx_t Read(void *buffer, const CmdContext &context) override;
+	/// @brief Deallocates the contiguous range that a command covers on every member with a single command
+	idx_t Deallocate(const CmdContext &context) override;
+	/// @brief Copies on the members if the source and destination have the same position within a stripe row, such
+	/// that every stripe unit is copied within its member
+	bool Copy(const CmdContext &context, idx_t source_lba) override;
+
+	DeviceGeometry GetDeviceGeometry() override;
+
+	void SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) override;
+
+	string GetName() const override {
+		return "StripedDevice";
+	}
+
+	/// @brief Adds the stripe size and describes the members
+	vector<pair<string, string>> GetDeviceInfo() override;
+
+	idx_t GetMemberCount() const {
+		return members.size();
+	}
+
+	Device &GetMember(idx_t member) {
+		return *members[member];
+	}
+
+private:
+	/// @brief The part of a command that lies within a single stripe unit
+	struct StripeSegment {
+		idx_t member;
+		/// The context of the segment on the member, which NvmeDevice members expect to be an NvmeCmdContext
+		NvmeCmdContext context;
+		/// The bytes of the segment within the buffer of the command
+		idx_t buffer_offset;
+	};
+
+	/// @brief Splits a command into its stripe units, in the order of the LBAs of the command
+	vector<StripeSegment> Split(const CmdContext &context);
+	/// @brief Runs the segments of a command, concurrently on their members if they are on more than one member
+	void Execute(const vector<StripeSegment> &segments, const std::function<void(const StripeSegment &)> &execute);
+	/// @brief Maps an LBA of the device to its member and the LBA on that member
+	pair<idx_t, idx_t> MapLBA(idx_t lba) const;
+
+private:
+	vector<unique_ptr<Device>> members;
+	DeviceGeometry geometry;
+	idx_t stripe_lbas;
+	DeviceWorkerPool pool;
+};
+
+} // namespace duckdb
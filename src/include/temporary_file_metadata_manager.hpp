@@ -1,17 +1,24 @@
 #pragma once
 
 #include "duckdb.hpp"
+#include "nvmefs_extent_allocator.hpp"
+#include "nvmefs_io_statistics.hpp"
+#include "nvmefs_lock_statistics.hpp"
 #include "nvmefs_temporary_block_manager.hpp"
+#include <array>
 #include <atomic>
+#include <functional>
 #include <boost/thread/shared_mutex.hpp> // sudo apt-get install libboost-all-dev
 #include <boost/thread/locks.hpp>
+#include <mutex>
 #include <shared_mutex>
 
 namespace duckdb {
 
 class TempFileMetadata {
 public:
-	TempFileMetadata() : file_index(0), block_size(0), nr_blocks(0) /*, block_range(nullptr)*/ {
+	TempFileMetadata()
+	    : file_index(0), block_size(0), nr_blocks(0), file_mutex(LockSite::FILE_MUTEX) /*, block_range(nullptr)*/ {
 	}
 
 	std::atomic<bool> is_active;
@@ -20,20 +27,108 @@ public:
 	idx_t nr_blocks;
 	std::atomic<idx_t> lba_location;
 	map<idx_t, TemporaryBlock *> block_map;
-	boost::shared_mutex file_mutex;
+	/// The blocks that live on the spill tier instead of the device
+	set<idx_t> spilled_blocks;
+	/// The position of the blocks on the device in the write order of the manager, if blocks can be spilled
+	map<idx_t, idx_t> write_sequences;
+	/// The blocks on the device that are being copied to the spill tier, guarded by the write order lock of the manager
+	set<idx_t> spilling_blocks;
+	/// The blocks that a compaction is copying to other LBAs, guarded by the write order lock of the manager. Writing,
+	/// truncating or deleting a block takes it out, which keeps it in place.
+	set<idx_t> relocating_blocks;
+	InstrumentedSharedMutex file_mutex;
+};
+
+/// Pins are counted in this many stripes, which are selected by the start LBA of the pinned block
+constexpr idx_t NVMEFS_TEMP_PIN_STRIPES = 1 << 6;
+
+/// @brief A pin counter on its own cache line
+struct TemporaryPinStripe {
+	std::atomic<idx_t> pins {0};
+	char padding[NVMEFS_CACHE_LINE_SIZE - sizeof(std::atomic<idx_t>)];
+};
+
+/// @brief Keeps a temporary block in place while it is read or written. Compaction does not move blocks whose
+/// stripe is pinned, hence the LBA returned with the pin stays valid until the pin is released.
+class TemporaryBlockPin {
+public:
+	TemporaryBlockPin() : stripe(nullptr) {
+	}
+	~TemporaryBlockPin() {
+		Release();
+	}
+
+	TemporaryBlockPin(const TemporaryBlockPin &) = delete;
+	TemporaryBlockPin &operator=(const TemporaryBlockPin &) = delete;
+
+	void Pin(TemporaryPinStripe &pin_stripe) {
+		Release();
+		stripe = &pin_stripe;
+		stripe->pins.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Release() {
+		if (stripe) {
+			stripe->pins.fetch_sub(1, std::memory_order_release);
+			stripe = nullptr;
+		}
+	}
+
+private:
+	TemporaryPinStripe *stripe;
+};
+
+/// @brief Copies the data of a temporary block to another LBA range of the same length. Arguments are the path of the
+/// temporary file, the source LBA, the destination LBA and the number of LBAs.
+typedef std::function<void(const string &, idx_t, idx_t, idx_t)> temporary_block_relocator_t;
+
+/// @brief Moves the data of a temporary block from the device to the spill tier. Arguments are the path of the
+/// temporary file, the index of the block within the file, the LBA of the block and the number of LBAs.
+typedef std::function<void(const string &, idx_t, idx_t, idx_t)> temporary_block_spiller_t;
+
+/// @brief The work done by a compaction of the temporary blocks
+struct TemporaryCompactionResult {
+	idx_t relocated_blocks;
+	idx_t relocated_lbas;
+	/// Blocks that had to stay in a drained range, because they were being read or written or no free block was large
+	/// enough to take them
+	idx_t skipped_blocks;
+	idx_t released_extents;
 };
 
 class TemporaryFileMetadataManager {
 public:
 	TemporaryFileMetadataManager(idx_t start_lba, idx_t end_lba, idx_t lba_size)
-	    : block_manager(make_uniq<NvmeTemporaryBlockManager>(start_lba, end_lba)), lba_size(lba_size),
-	      lba_amount(end_lba - start_lba) {
+	    : lba_size(lba_size), lba_amount(end_lba - start_lba),
+	      block_manager(make_uniq<NvmeTemporaryBlockManager>(start_lba, end_lba)), extent_allocator(nullptr) {
+	}
+
+	/// @brief Creates a manager that allocates extents for temporary blocks on demand
+	/// @param extent_allocator The allocator that temporary extents are taken from and returned to
+	/// @param max_lba_amount The maximum amount of LBAs that temporary files are allowed to occupy
+	/// @param lba_size Size of a single LBA in bytes
+	TemporaryFileMetadataManager(NvmeExtentAllocator &extent_allocator, idx_t max_lba_amount, idx_t lba_size)
+	    : lba_size(lba_size), lba_amount(max_lba_amount), block_manager(make_uniq<NvmeTemporaryBlockManager>()),
+	      extent_allocator(&extent_allocator) {
 	}
 
 	void CreateFile(const string &filename);
 
 	idx_t GetLBA(const string &filename, idx_t location, idx_t nr_lbas);
 
+	/// @brief Looks up the LBA of a temporary block, allocating the block if it does not exist yet
+	/// @param pin Keeps the block from being relocated by a compaction until it is released
+	/// @return The start LBA of the block
+	idx_t GetLBA(const string &filename, idx_t location, idx_t nr_lbas, TemporaryBlockPin &pin);
+
+	/// @brief Looks up where a temporary block lives. Blocks that are written are placed on the device, and once the
+	/// temporary space is full, the least recently written blocks are moved to the spill tier to make room.
+	/// @param write Whether the block is about to be written, which moves a spilled block back onto the device
+	/// @param pin Keeps the block from being relocated or spilled until it is released
+	/// @return The start LBA of the block, or an invalid index if the block lives on the spill tier
+	optional_idx LocateBlock(const string &filename, idx_t location, idx_t nr_lbas, bool write,
+	                         TemporaryBlockPin &pin);
+
 	void TruncateFile(const string &filename, idx_t new_size);
 
 	void DeleteFile(const string &filename);
@@ -46,19 +141,150 @@ public:
 
 	void ListFiles(const string &directory, const std::function<void(const string &, bool)> &callback);
 
-	idx_t GetAvailableSpace(idx_t lba_count, idx_t lba_start);
+	idx_t GetAvailableSpace();
+
+	/// @brief Number of LBAs inside the temporary extents that are not used by any temporary block
+	idx_t GetUnusedAllocatedLBACount();
+
+	/// @brief Calls the callback for every temporary file with its path, block size and size in bytes
+	void Scan(const std::function<void(const string &, idx_t, idx_t)> &callback);
 
 	idx_t GetSeekBound(const string &filename);
 
+	/// @brief Describes how fragmented the free LBAs of the temporary extents are
+	TemporaryFragmentationStatistics GetFragmentationStatistics();
+
+	/// @brief Sets how the data of temporary blocks is copied when they are relocated. Without a relocator, temporary
+	/// blocks are never compacted.
+	void SetBlockRelocator(temporary_block_relocator_t relocator);
+
+	/// @brief Moves the used blocks out of the emptiest temporary extents into the free blocks of the other extents,
+	/// and returns the emptied extents to the extent allocator. The blocks are copied while temporary I/O continues,
+	/// and blocks that are written in the meantime stay where they are.
+	TemporaryCompactionResult Compact();
+
+	/// @brief Sets how temporary blocks are moved to the spill tier. Without a spiller, temporary blocks cannot be
+	/// allocated once the temporary space is full.
+	void SetBlockSpiller(temporary_block_spiller_t spiller);
+
+	/// @brief Number of temporary blocks that live on the spill tier
+	idx_t GetSpilledBlockCount();
+
 	void Clear();
 
 	const TempFileMetadata *GetOrCreateFile(const string &filename);
 
+private:
+	/// @brief Allocates a new extent for the temporary blocks. Requires the temp_mutex to be held exclusively.
+	/// @return True if the temporary space could be grown
+	bool GrowTemporarySpace();
+
+	/// @brief Returns the extents with no used temporary blocks. Requires the temp_mutex to be held exclusively.
+	/// @return The number of extents returned
+	idx_t ReleaseFreeExtents();
+
+	/// @brief Allocates a temporary block, growing the temporary space if the free blocks are too small. Blocks are
+	/// neither compacted nor spilled to make room. Requires the temp_mutex to be held exclusively.
+	/// @return The block or nullptr if the temporary space is full
+	TemporaryBlock *AllocateBlock(idx_t nr_lbas);
+
+	/// @brief A block that is being copied to another LBA range by a compaction
+	struct PendingRelocation {
+		string filename;
+		idx_t block_index;
+		idx_t lba;
+		idx_t nr_lbas;
+		/// The block that the data is copied to, which the compaction owns until the block is moved
+		TemporaryBlock *target;
+		/// Keeps the block from being spilled or relocated again while it is copied
+		TemporaryBlockPin pin;
+	};
+
+	/// @brief Compacts the temporary blocks. The blocks are copied without holding the temp_mutex, hence the caller
+	/// must not hold any lock of the manager.
+	TemporaryCompactionResult CompactBlocks();
+
+	/// @brief Selects the blocks in the emptiest ranges that are not in use, and allocates their targets in the other
+	/// ranges. Requires the temp_mutex to be held exclusively.
+	/// @return False if no block can be relocated
+	bool SelectBlocksToRelocate(vector<unique_ptr<PendingRelocation>> &relocations, TemporaryCompactionResult &result);
+
+	/// @brief Moves the blocks that were copied to their targets, and frees the targets of the other blocks. Requires
+	/// the temp_mutex to be held exclusively.
+	/// @param copied The number of relocations, in order, whose blocks were copied
+	void FinishRelocations(vector<unique_ptr<PendingRelocation>> &relocations, idx_t copied,
+	                       TemporaryCompactionResult &result);
+
+	/// @brief Keeps a block that is about to be written in place, if a compaction is copying it. Requires the
+	/// file_mutex of the file.
+	void CancelRelocation(TempFileMetadata &file, idx_t block_index);
+
+	/// @brief A block that is being copied to the spill tier
+	struct PendingSpill {
+		string filename;
+		idx_t block_index;
+		idx_t lba;
+		idx_t nr_lbas;
+		/// Keeps compactions from moving the block while it is copied
+		TemporaryBlockPin pin;
+	};
+
+	/// @brief Moves the least recently written block that is not in use to the spill tier. The block is copied without
+	/// holding the temp_mutex, hence the caller must not hold any lock of the manager.
+	/// @return False if every block on the device is in use
+	bool SpillBlock(idx_t nr_lbas);
+
+	/// @brief Selects the least recently written block that is not in use, preferring blocks that are large enough to
+	/// make room for a block of the given size, and takes it out of the write order. The block stays on the device
+	/// until FinishSpill. Requires the temp_mutex to be held exclusively.
+	/// @return False if every block on the device is in use
+	bool SelectBlockToSpill(idx_t nr_lbas, PendingSpill &spill);
+
+	/// @brief Frees the device block of a block that was copied to the spill tier. A block that was written, truncated
+	/// or deleted while it was copied stays as it is. Requires the temp_mutex to be held exclusively.
+	/// @param copied Whether the block was copied, otherwise it is put back into the write order
+	void FinishSpill(PendingSpill &spill, bool copied);
+
+	/// @brief Makes a block on the device the most recently written block. Requires the file_mutex of the file.
+	void TouchBlock(const string &filename, TempFileMetadata &file, idx_t block_index);
+
+	/// @brief Removes a block from the write order, once it left the device. Requires the file_mutex of the file.
+	void ForgetBlock(TempFileMetadata &file, idx_t block_index);
+
+	/// @brief Selects the emptiest ranges whose used blocks fit into the free blocks of the other ranges
+	/// @return The start LBAs of the selected ranges
+	vector<idx_t> SelectRangesToDrain();
+
+	TemporaryPinStripe &GetPinStripe(TemporaryBlock *block) {
+		// Blocks are multiples of 8 LBAs, hence blocks that are close to each other never share a stripe
+		return pin_stripes[(block->GetStartLBA() / 8) % NVMEFS_TEMP_PIN_STRIPES];
+	}
+
+	idx_t GetUsedLBACount();
+
+	/// @brief A block on the device in the write order
+	struct WrittenBlock {
+		const string *filename;
+		TempFileMetadata *file;
+		idx_t block_index;
+	};
+
 private:
 	idx_t lba_size;
 	idx_t lba_amount;
 	unique_ptr<NvmeTemporaryBlockManager> block_manager;
+	NvmeExtentAllocator *extent_allocator;
 	map<string, unique_ptr<TempFileMetadata>> file_to_temp_meta;
-	static boost::shared_mutex temp_mutex;
+	temporary_block_relocator_t relocator;
+	temporary_block_spiller_t spiller;
+	/// Guards the write order, which writes of blocks on the device update while holding the temp_mutex shared
+	std::mutex write_order_lock;
+	/// The blocks on the device by their write sequence, such that the least recently written block comes first
+	map<idx_t, WrittenBlock> write_order;
+	idx_t write_sequence = 0;
+	std::array<TemporaryPinStripe, NVMEFS_TEMP_PIN_STRIPES> pin_stripes;
+	/// The number of blocks that compactions are copying, such that writes only take the write order lock meanwhile
+	std::atomic<idx_t> pending_relocations {0};
+	static InstrumentedSharedMutex temp_mutex;
 };
 } // namespace duckdb
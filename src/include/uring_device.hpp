@@ -0,0 +1,131 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "device.hpp"
+#include "file_backed_lbas.hpp"
+#include "nvmefs_lock_statistics.hpp"
+#include <mutex>
+
+struct io_uring_sqe;
+
+namespace duckdb {
+
+/// The backend name that selects the UringDevice instead of xNVMe
+static constexpr const char *NVMEFS_URING_BACKEND = "liburing";
+
+/// @brief How the UringDevice sets up its rings. Options are given as a comma-separated list, e.g.
+/// 'rings=2,sqpoll,iopoll'. 'rings=<n>' is the number of rings that the threads are spread over, 'queue_depth=<n>' the
+/// number of entries of a ring, 'sqpoll' lets a kernel thread submit the commands, 'sqpoll_idle=<ms>' is the time
+/// after which that thread goes to sleep, 'iopoll' polls for completions instead of waiting for interrupts, and
+/// 'fixed_buffers=<n>' and 'fixed_buffer_size=<size>' configure the registered buffers of a ring.
+struct UringDeviceOptions {
+	/// 0 means one ring per thread, like the queues of the NvmeDevice
+	idx_t rings = 0;
+	idx_t queue_depth = 64;
+	bool sqpoll = false;
+	idx_t sqpoll_idle_ms = 1000;
+	bool iopoll = false;
+	/// Registered buffers per ring, which stage commands that cannot be sent from the buffer of the caller
+	idx_t fixed_buffers = 16;
+	/// The size of a registered buffer, which covers the largest block of DuckDB by default
+	idx_t fixed_buffer_size = 1ULL << 18;
+
+	/// @brief Parses the options of the liburing backend. An empty string yields the defaults.
+	/// @throws InvalidInputException if the options are malformed
+	static UringDeviceOptions Parse(const string &options);
+
+	/// @brief Describes the options for nvmefs_device_info()
+	string ToString() const;
+};
+
+/// @brief How the UringDevice accesses its device
+enum class UringDeviceMode : uint8_t {
+	/// NVMe commands are sent through the generic character device (/dev/ngXnY) with IORING_OP_URING_CMD
+	PASSTHROUGH,
+	/// Reads and writes with O_DIRECT on a block device
+	BLOCK,
+	/// Reads and writes on a regular file, with O_DIRECT if the file system supports it
+	FILE
+};
+
+struct UringRing;
+struct UringRequest;
+
+/// @brief A device that talks to io_uring directly through liburing, instead of going through xNVMe. Threads are spread
+/// over a number of rings, and every ring registers the file and a pool of fixed buffers. Commands on whole LBAs whose
+/// buffer is aligned to the LBA size are sent from the buffer of the caller, while the others are staged in a fixed
+/// buffer. A ring has separate locks for submitting and reaping, such that threads that share a ring keep several
+/// commands in flight, and the thread that reaps collects all completions that are ready in one batch. Character
+/// devices use NVMe passthrough, including data placement on FDP devices, while block devices and files are read and
+/// written with O_DIRECT. The device is only available if nvmefs was built with liburing.
+class UringDevice : public Device {
+public:
+	/// @brief Constructor for UringDevice
+	/// @param device_path A generic NVMe character device, a block device or a regular file. A file must already have
+	/// the size of the namespace it emulates.
+	/// @param options The setup of the rings
+	/// @param max_threads The number of threads that use the device
+	/// @throws IOException if the device cannot be opened or the rings cannot be set up
+	UringDevice(const string &device_path, const UringDeviceOptions &options, idx_t max_threads);
+	~UringDevice();
+
+	idx_t Write(void *buffer, const CmdContext &context) override;
+	idx_t Read(void *buffer, const CmdContext &context) override;
+	/// @brief Deallocates with a dataset management command on character devices, discards the range of a block device
+	/// and punches a hole into a file
+	idx_t Deallocate(const CmdContext &context) override;
+
+	DeviceGeometry GetDeviceGeometry() override;
+
+	string GetName() const override {
+		return "UringDevice";
+	}
+
+	/// @brief Adds the mode, the rings and their options to the description of the device
+	vector<pair<string, string>> GetDeviceInfo() override;
+
+private:
+	/// @brief Opens the device and determines its mode and geometry
+	void OpenDevice();
+	/// @brief Reads the geometry, the transfer limit and the placement handles of an NVMe namespace with admin
+	/// commands
+	void IdentifyNamespace();
+	void CreateRings();
+
+	/// @brief Checks if a command can be sent from the buffer of the caller, which requires it to cover whole LBAs and
+	/// to be aligned for direct I/O
+	bool IsDirectTransfer(void *buffer, const CmdContext &context) const;
+	/// @brief Reads or writes whole LBAs, split into commands of at most max_transfer_lbas, and waits for them
+	/// @param buffer_index The fixed buffer that the buffer lies in, if it lies in one
+	void Transfer(UringRing &ring, bool write, data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas,
+	              optional_idx buffer_index, const CmdContext &context);
+	/// @brief Transfers the LBAs of a command that is staged in the given buffer
+	FileBackedLBAs::transfer_t GetTransfer(UringRing &ring, optional_idx buffer_index, const CmdContext &context);
+	/// @brief Submits a request and waits until it completes. Completions of other threads on the same ring are reaped
+	/// along the way.
+	/// @return The result of the completion
+	int32_t SubmitAndWait(UringRing &ring, UringRequest &request);
+	void PrepareSubmission(io_uring_sqe *sqe, UringRequest &request);
+
+	uint16_t GetPlacementHandle(idx_t placement_identifier);
+	UringRing &GetRing();
+
+private:
+	const string device_path;
+	const UringDeviceOptions options;
+	const idx_t max_threads;
+	UringDeviceMode mode;
+	int fd;
+	/// False if the file system of a file does not support O_DIRECT
+	bool direct;
+	DeviceGeometry geometry;
+	/// The most LBAs that a single command transfers
+	idx_t max_transfer_lbas;
+	/// The namespace of a character device
+	uint32_t nsid;
+	bool fdp;
+	vector<uint16_t> placement_handles;
+	vector<unique_ptr<UringRing>> rings;
+};
+
+} // namespace duckdb
@@ -0,0 +1,167 @@
+#include "io_trace_replayer.hpp"
+#include "nvme_device.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace duckdb {
+
+IOTraceReplayer::IOTraceReplayer(const IOTraceHeader &header, vector<IOTraceRecord> records_p)
+    : header(header), records(std::move(records_p)), max_lba_count(0) {
+	for (const auto &record : records) {
+		if (record.operation != IOTraceOperation::DEALLOCATE) {
+			max_lba_count = MaxValue<idx_t>(max_lba_count, record.nr_lbas);
+		}
+	}
+}
+
+IOTraceReplayResult IOTraceReplayer::Replay(Device &device, IOTraceReplayConfig config) {
+	DeviceGeometry geo = device.GetDeviceGeometry();
+	if (geo.lba_size != header.lba_size) {
+		throw InvalidInputException("Trace was recorded with %llu byte LBAs, but the device has %llu byte LBAs",
+		                            static_cast<idx_t>(header.lba_size), geo.lba_size);
+	}
+	if (geo.lba_count < header.lba_count) {
+		throw InvalidInputException("Trace was recorded on a device with %llu LBAs, but the device only has %llu LBAs",
+		                            static_cast<idx_t>(header.lba_count), geo.lba_count);
+	}
+	if (config.speed <= 0) {
+		throw InvalidInputException("Replay speed must be positive");
+	}
+
+	// Records are stored in the order the commands completed, whereas they are replayed in the order they were
+	// submitted
+	vector<idx_t> schedule(records.size());
+	for (idx_t i = 0; i < records.size(); i++) {
+		schedule[i] = i;
+	}
+	std::stable_sort(schedule.begin(), schedule.end(),
+	                 [&](idx_t a, idx_t b) { return records[a].submit_ns < records[b].submit_ns; });
+
+	IOTraceReplayResult result {};
+	vector<std::thread> workers;
+	std::atomic<idx_t> next_command(0);
+	vector<vector<idx_t>> thread_commands;
+	auto start = std::chrono::steady_clock::now();
+	if (config.mode == IOTraceReplayMode::CLOSED_LOOP) {
+		for (idx_t command : schedule) {
+			idx_t thread = records[command].thread;
+			if (thread >= thread_commands.size()) {
+				thread_commands.resize(thread + 1);
+			}
+			thread_commands[thread].push_back(command);
+		}
+		for (const auto &commands : thread_commands) {
+			workers.emplace_back([&]() { ReplayThread(device, commands, config, result); });
+		}
+	} else {
+		for (idx_t worker = 0; worker < MaxValue<idx_t>(config.workers, 1); worker++) {
+			workers.emplace_back(
+			    [&]() { ReplayScheduled(device, next_command, schedule, start, config, result); });
+		}
+	}
+
+	for (auto &worker : workers) {
+		worker.join();
+	}
+	result.elapsed_ns =
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+	return result;
+}
+
+void IOTraceReplayer::ReplayCommand(Device &device, const IOTraceRecord &record, const IOTraceReplayConfig &config,
+                                    uint8_t *buffer, IOTraceReplayResult &worker_result) {
+	NvmeCmdContext context;
+	context.nr_lbas = record.nr_lbas;
+	context.nr_bytes = record.nr_lbas * header.lba_size;
+	context.start_lba = record.start_lba;
+	context.offset = 0;
+	context.placement_identifier = record.placement_identifier;
+	context.category = record.category;
+
+	auto submit = std::chrono::steady_clock::now();
+	switch (record.operation) {
+	case IOTraceOperation::READ:
+		device.Read(buffer, context);
+		worker_result.read_bytes += context.nr_bytes;
+		break;
+	case IOTraceOperation::WRITE:
+		device.Write(buffer, context);
+		worker_result.written_bytes += context.nr_bytes;
+		break;
+	case IOTraceOperation::DEALLOCATE:
+		if (!config.deallocate) {
+			return;
+		}
+		device.Deallocate(context);
+		break;
+	}
+	idx_t latency_ns =
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - submit).count();
+
+	worker_result.commands++;
+	worker_result.total_latency_ns += latency_ns;
+	worker_result.max_latency_ns = MaxValue<idx_t>(worker_result.max_latency_ns, latency_ns);
+}
+
+void IOTraceReplayer::ReplayThread(Device &device, const vector<idx_t> &commands, const IOTraceReplayConfig &config,
+                                   IOTraceReplayResult &result) {
+	// Written data is a fixed pattern, as the trace only holds the location of the commands
+	vector<uint8_t> buffer(max_lba_count * header.lba_size, 0xA5);
+	IOTraceReplayResult worker_result {};
+
+	for (idx_t command : commands) {
+		ReplayCommand(device, records[command], config, buffer.data(), worker_result);
+	}
+
+	MergeResult(result, worker_result);
+}
+
+void IOTraceReplayer::ReplayScheduled(Device &device, std::atomic<idx_t> &next_command, const vector<idx_t> &schedule,
+                                      std::chrono::steady_clock::time_point start, const IOTraceReplayConfig &config,
+                                      IOTraceReplayResult &result) {
+	// A command that is submitted this much after its scheduled time counts as late
+	const auto late_threshold = std::chrono::microseconds(100);
+
+	vector<uint8_t> buffer(max_lba_count * header.lba_size, 0xA5);
+	IOTraceReplayResult worker_result {};
+
+	idx_t index;
+	while ((index = next_command.fetch_add(1)) < schedule.size()) {
+		const IOTraceRecord &record = records[schedule[index]];
+		auto scheduled = start + std::chrono::nanoseconds(static_cast<idx_t>(record.submit_ns / config.speed));
+		auto now = std::chrono::steady_clock::now();
+		if (now < scheduled) {
+			std::this_thread::sleep_until(scheduled);
+		} else if (now - scheduled > late_threshold) {
+			worker_result.late_commands++;
+		}
+
+		ReplayCommand(device, record, config, buffer.data(), worker_result);
+	}
+
+	MergeResult(result, worker_result);
+}
+
+void IOTraceReplayer::MergeResult(IOTraceReplayResult &result, const IOTraceReplayResult &worker_result) {
+	std::lock_guard<std::mutex> lock(result_lock);
+	result.commands += worker_result.commands;
+	result.read_bytes += worker_result.read_bytes;
+	result.written_bytes += worker_result.written_bytes;
+	result.total_latency_ns += worker_result.total_latency_ns;
+	result.max_latency_ns = MaxValue<idx_t>(result.max_latency_ns, worker_result.max_latency_ns);
+	result.late_commands += worker_result.late_commands;
+}
+
+IOTraceReplayMode ParseIOTraceReplayMode(const string &mode) {
+	if (StringUtil::CIEquals(mode, "closed")) {
+		return IOTraceReplayMode::CLOSED_LOOP;
+	}
+	if (StringUtil::CIEquals(mode, "open")) {
+		return IOTraceReplayMode::OPEN_LOOP;
+	}
+	throw InvalidInputException("Unknown replay mode '%s', expected 'closed' or 'open'", mode);
+}
+
+} // namespace duckdb
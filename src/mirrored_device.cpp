@@ -0,0 +1,315 @@
+#include "mirrored_device.hpp"
+#include "nvme_device.hpp"
+
+#include <chrono>
+
+namespace duckdb {
+
+/// @brief A read that may be sent to several members, of which the first that completes wins. The reads hold on to
+/// it, such that the losers can complete after the caller returned.
+struct HedgedRead {
+	explicit HedgedRead(MirroredDevice &device) : device(device) {
+	}
+	/// @brief Hands the buffers back to the device once the last read is done
+	~HedgedRead() {
+		device.ReturnBuffers(*this);
+	}
+
+	MirroredDevice &device;
+	std::mutex lock;
+	std::condition_variable done;
+	/// Every member reads into a buffer of its own, as the member that loses still writes to it after the caller
+	/// returned. Buffers are paired with their capacity.
+	vector<pair<idx_t, unique_array<data_t>>> buffers;
+	optional_ptr<data_t> winner;
+	idx_t failed = 0;
+	std::exception_ptr error;
+
+	bool IsDone() const {
+		return winner || failed == buffers.size();
+	}
+};
+
+/// @brief Copies a context into a context of its own, which members that are NvmeDevices expect
+static NvmeCmdContext CopyContext(const CmdContext &context) {
+	NvmeCmdContext member_context;
+	static_cast<CmdContext &>(member_context) = context;
+	return member_context;
+}
+
+MirroredDevice::MirroredDevice(vector<unique_ptr<Device>> members_p, double hedge_percentile_p, idx_t threads)
+    : members(std::move(members_p)), hedge_percentile(hedge_percentile_p), next_member(0), timed_reads(0),
+      hedge_threshold_ns(0), hedged_reads(0), pool(threads) {
+	if (members.size() < 2) {
+		throw InvalidInputException("A mirrored device needs at least two devices, but got %llu", members.size());
+	}
+	if (hedge_percentile < 0 || hedge_percentile >= 1) {
+		throw InvalidInputException("The hedging percentile must lie in [0, 1), but got %f", hedge_percentile);
+	}
+
+	geometry = members[0]->GetDeviceGeometry();
+	for (idx_t i = 1; i < members.size(); i++) {
+		DeviceGeometry other = members[i]->GetDeviceGeometry();
+		if (other.lba_size != geometry.lba_size) {
+			throw InvalidInputException("Cannot mirror devices with LBA sizes of %llu and %llu bytes",
+			                            geometry.lba_size, other.lba_size);
+		}
+		// Every member holds all LBAs, hence the larger members are only used up to the size of the smallest one
+		geometry.lba_count = MinValue<idx_t>(geometry.lba_count, other.lba_count);
+	}
+
+	outstanding = make_uniq_array<std::atomic<idx_t>>(members.size());
+	for (auto &bucket : read_latency_histogram) {
+		bucket.store(0);
+	}
+}
+
+double MirroredDevice::ParseHedgePercentile(const string &hedge_reads) {
+	string hedging = StringUtil::Lower(hedge_reads);
+	StringUtil::Trim(hedging);
+	if (hedging.empty() || hedging == "off") {
+		return 0;
+	}
+
+	double percentile = 0;
+	size_t parsed = 0;
+	try {
+		if (hedging[0] == 'p' && hedging.size() > 1) {
+			percentile = std::stod(hedging.substr(1), &parsed);
+			parsed++;
+		}
+	} catch (std::exception &) {
+		parsed = 0;
+	}
+	if (parsed != hedging.size() || percentile <= 0 || percentile >= 100) {
+		throw InvalidInputException("Invalid hedging of reads '%s', expected a percentile such as 'p99', or 'off'",
+		                            hedge_reads);
+	}
+	return percentile / 100;
+}
+
+idx_t MirroredDevice::Write(void *buffer, const CmdContext &context) {
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+	NvmeCmdContext member_context = CopyContext(context);
+	RunOnAllMembers([buffer, &member_context](Device &member) { member.Write(buffer, member_context); });
+	return context.nr_lbas;
+}
+
+idx_t MirroredDevice::Read(void *buffer, const CmdContext &context) {
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+	NvmeCmdContext member_context = CopyContext(context);
+	idx_t threshold_ns = hedge_threshold_ns.load(std::memory_order_relaxed);
+	if (threshold_ns == 0) {
+		ReadMember(PickMember(optional_idx()), static_cast<data_ptr_t>(buffer), member_context);
+		return context.nr_lbas;
+	}
+
+	auto read = std::make_shared<HedgedRead>(*this);
+	auto issue = [this, read, member_context](idx_t member) {
+		idx_t capacity;
+		unique_array<data_t> buffer = TakeBuffer(member_context.nr_bytes, capacity);
+		data_ptr_t member_buffer = buffer.get();
+		{
+			std::lock_guard<std::mutex> guard(read->lock);
+			read->buffers.emplace_back(capacity, std::move(buffer));
+		}
+		pool.Schedule([this, read, member, member_buffer, member_context]() {
+			std::exception_ptr error;
+			try {
+				ReadMember(member, member_buffer, member_context);
+			} catch (...) {
+				error = std::current_exception();
+			}
+
+			std::lock_guard<std::mutex> guard(read->lock);
+			if (error) {
+				read->failed++;
+				read->error = read->error ? read->error : error;
+			} else if (!read->winner) {
+				read->winner = member_buffer;
+			}
+			read->done.notify_all();
+		});
+	};
+
+	idx_t first_member = PickMember(optional_idx());
+	issue(first_member);
+
+	std::unique_lock<std::mutex> guard(read->lock);
+	auto is_done = [&read]() {
+		return read->IsDone();
+	};
+	if (!read->done.wait_for(guard, std::chrono::nanoseconds(threshold_ns), is_done)) {
+		// The read takes longer than most reads, hence another member is likely to answer sooner
+		guard.unlock();
+		issue(PickMember(first_member));
+		hedged_reads++;
+		guard.lock();
+	}
+	read->done.wait(guard, is_done);
+
+	// Every member failed if there is no winner, and another member would most likely fail as well
+	if (!read->winner) {
+		std::rethrow_exception(read->error);
+	}
+	memcpy(buffer, read->winner.get(), context.nr_bytes);
+	return context.nr_lbas;
+}
+
+idx_t MirroredDevice::Deallocate(const CmdContext &context) {
+	NvmeCmdContext member_context = CopyContext(context);
+	RunOnAllMembers([&member_context](Device &member) { member.Deallocate(member_context); });
+	return context.nr_lbas;
+}
+
+bool MirroredDevice::Copy(const CmdContext &context, idx_t source_lba) {
+	NvmeCmdContext member_context = CopyContext(context);
+	if (!members[0]->Copy(member_context, source_lba)) {
+		return false;
+	}
+
+	// Members that copied are written again by the caller if another member cannot copy
+	std::atomic<bool> copied(true);
+	vector<std::function<void()>> tasks;
+	for (idx_t i = 1; i < members.size(); i++) {
+		tasks.push_back([this, i, &copied, &member_context, source_lba]() {
+			if (!members[i]->Copy(member_context, source_lba)) {
+				copied = false;
+			}
+		});
+	}
+	pool.RunAll(tasks);
+	return copied;
+}
+
+DeviceGeometry MirroredDevice::GetDeviceGeometry() {
+	return geometry;
+}
+
+void MirroredDevice::SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) {
+	Device::SetIOStatistics(statistics);
+	for (auto &member : members) {
+		member->SetIOStatistics(statistics);
+	}
+}
+
+vector<pair<string, string>> MirroredDevice::GetDeviceInfo() {
+	vector<pair<string, string>> info = Device::GetDeviceInfo();
+	string hedging = "off";
+	if (hedge_percentile > 0) {
+		hedging = StringUtil::Format("p%g", hedge_percentile * 100);
+	}
+	info.emplace_back("hedge_reads", hedging);
+	optional_idx threshold = GetHedgeThreshold();
+	if (threshold.IsValid()) {
+		info.emplace_back("hedge_threshold", StringUtil::Format("%llu us", threshold.GetIndex() / 1000));
+	}
+	info.emplace_back("hedged_reads", std::to_string(GetHedgedReadCount()));
+	DescribeMembers(members, info);
+	return info;
+}
+
+optional_idx MirroredDevice::GetHedgeThreshold() const {
+	idx_t threshold_ns = hedge_threshold_ns.load();
+	return threshold_ns == 0 ? optional_idx() : optional_idx(threshold_ns);
+}
+
+idx_t MirroredDevice::PickMember(optional_idx excluded) {
+	idx_t start = next_member.fetch_add(1, std::memory_order_relaxed);
+	optional_idx picked;
+	idx_t picked_outstanding = 0;
+	for (idx_t i = 0; i < members.size(); i++) {
+		idx_t member = (start + i) % members.size();
+		if (excluded.IsValid() && member == excluded.GetIndex()) {
+			continue;
+		}
+		idx_t member_outstanding = outstanding[member].load(std::memory_order_relaxed);
+		if (!picked.IsValid() || member_outstanding < picked_outstanding) {
+			picked = member;
+			picked_outstanding = member_outstanding;
+		}
+	}
+	return picked.GetIndex();
+}
+
+void MirroredDevice::ReadMember(idx_t member, data_ptr_t buffer, const CmdContext &context) {
+	outstanding[member]++;
+	auto start = std::chrono::steady_clock::now();
+	try {
+		members[member]->Read(buffer, context);
+	} catch (...) {
+		outstanding[member]--;
+		throw;
+	}
+	auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+	outstanding[member]--;
+	RecordReadLatency(latency.count());
+}
+
+void MirroredDevice::RecordReadLatency(idx_t latency_ns) {
+	if (hedge_percentile == 0) {
+		return;
+	}
+	read_latency_histogram[NvmeIOStatistics::GetLatencyBucket(latency_ns)].fetch_add(1, std::memory_order_relaxed);
+	if (++timed_reads % NVMEFS_MIRROR_THRESHOLD_INTERVAL != 0) {
+		return;
+	}
+
+	IOCategoryStatistics snapshot {};
+	idx_t total = 0;
+	idx_t *histogram = snapshot.latency_histogram[static_cast<idx_t>(IODirection::READ)];
+	for (idx_t bucket = 0; bucket < NVMEFS_LATENCY_BUCKET_COUNT; bucket++) {
+		histogram[bucket] = read_latency_histogram[bucket].load(std::memory_order_relaxed);
+		total += histogram[bucket];
+	}
+	if (total < NVMEFS_MIRROR_HEDGE_MIN_SAMPLES) {
+		return;
+	}
+	// Older reads count half as much, such that the threshold follows the latency of the members
+	if (total >= NVMEFS_MIRROR_LATENCY_WINDOW) {
+		for (idx_t bucket = 0; bucket < NVMEFS_LATENCY_BUCKET_COUNT; bucket++) {
+			read_latency_histogram[bucket].fetch_sub(histogram[bucket] / 2, std::memory_order_relaxed);
+		}
+	}
+
+	optional_idx threshold = snapshot.GetLatencyPercentile(IODirection::READ, hedge_percentile);
+	hedge_threshold_ns.store(MaxValue<idx_t>(threshold.GetIndex(), 1), std::memory_order_relaxed);
+}
+
+unique_array<data_t> MirroredDevice::TakeBuffer(idx_t nr_bytes, idx_t &capacity) {
+	{
+		std::lock_guard<std::mutex> guard(spare_buffers_lock);
+		for (idx_t i = 0; i < spare_buffers.size(); i++) {
+			if (spare_buffers[i].first < nr_bytes) {
+				continue;
+			}
+			capacity = spare_buffers[i].first;
+			unique_array<data_t> buffer = std::move(spare_buffers[i].second);
+			spare_buffers.erase(spare_buffers.begin() + static_cast<int64_t>(i));
+			return buffer;
+		}
+	}
+	capacity = nr_bytes;
+	return make_uniq_array<data_t>(nr_bytes);
+}
+
+void MirroredDevice::ReturnBuffers(HedgedRead &read) {
+	std::lock_guard<std::mutex> guard(spare_buffers_lock);
+	for (auto &buffer : read.buffers) {
+		if (spare_buffers.size() >= NVMEFS_MIRROR_SPARE_BUFFERS) {
+			break;
+		}
+		spare_buffers.push_back(std::move(buffer));
+	}
+}
+
+void MirroredDevice::RunOnAllMembers(const std::function<void(Device &)> &execute) {
+	vector<std::function<void()>> tasks;
+	for (auto &member : members) {
+		Device &device = *member;
+		tasks.push_back([&execute, &device]() { execute(device); });
+	}
+	pool.RunAll(tasks);
+}
+
+} // namespace duckdb
@@ -1,9 +1,17 @@
 #include "nvme_device.hpp"
+#include "nvmefs_io_statistics.hpp"
+#include "nvmefs_tracer.hpp"
+#include "nvmefs_probes.hpp"
+
+#include <sys/stat.h>
 
 namespace duckdb {
 thread_local optional_idx NvmeDevice::index = optional_idx();
 NvmeDevice::NvmeDevice(const string &device_path, const string &backend, const bool async, const idx_t max_threads)
     : dev_path(device_path), backend(backend), async(async), max_threads(max_threads) {
+	struct stat path_stat;
+	file_backed = stat(device_path.c_str(), &path_stat) == 0 && S_ISREG(path_stat.st_mode);
+
 	xnvme_opts opts = xnvme_opts_default();
 	PrepareOpts(opts);
 	device = xnvme_dev_open(device_path.c_str(), &opts);
@@ -15,18 +23,23 @@ NvmeDevice::NvmeDevice(const string &device_path, const string &backend, const b
 	// Initialize the xnvme queue for asynchronous IO
 	if (async) {
 		queues = vector<xnvme_queue *>(max_threads, nullptr);
+		for (idx_t i = 0; i < max_threads; i++) {
+			queue_locks.push_back(make_uniq<InstrumentedMutex<std::mutex>>(LockSite::DEVICE_QUEUE));
+		}
 		// Set the callback function for completed commands. No callback arguments, hence last argument equal to NULL
 	}
 
-	fdp = CheckFDP();
+	// Files do not support admin commands, and hence never use data placement
+	fdp = !file_backed && CheckFDP();
 
 	if (fdp) {
 		InitializePlacementHandles();
 	}
 
 	GetThreadIndex();
-	allocated_placement_identifiers["nvmefs:///tmp"] = 1;
 	geometry = LoadDeviceGeometry();
+	max_copy_lbas = file_backed ? 0 : LoadMaxCopyLBAs();
+	dsm = !file_backed && CheckDSM();
 }
 
 NvmeDevice::~NvmeDevice() {
@@ -54,20 +67,30 @@ idx_t NvmeDevice::Write(void *buffer, const CmdContext &context) {
 		D_ASSERT(ctx.offset + ctx.nr_bytes < geometry.lba_size);
 		// Read the whole LBA block
 		Read(dev_buffer, ctx);
+		if (io_statistics) {
+			io_statistics->RecordReadModifyWrite(ctx.category);
+		}
 	}
 	memcpy(dev_buffer, (char *)buffer + ctx.offset, ctx.nr_bytes);
+	if (io_statistics) {
+		io_statistics->RecordBounceCopy(ctx.category);
+	}
 
 	uint32_t nsid = xnvme_dev_get_nsid(device);
-	uint8_t plid_idx = GetPlacementIdentifierOrDefault(ctx.filepath);
 	xnvme_cmd_ctx xnvme_ctx = xnvme_cmd_ctx_from_dev(device);
 
-	PrepareIOCmdContext(&xnvme_ctx, context, plid_idx, DATA_PLACEMENT_MODE, true);
+	PrepareIOCmdContext(&xnvme_ctx, context, DATA_PLACEMENT_MODE, true);
 
+	NvmeTraceSpan span("WriteCommand", ctx.category);
+	span.SetRange(ctx.start_lba, ctx.nr_lbas);
+	NvmeCommandProbe probe(ctx, true);
+	probe.Submitted();
 	int err = xnvme_nvm_write(&xnvme_ctx, nsid, ctx.start_lba, ctx.nr_lbas - 1, dev_buffer, nullptr);
 	if (err) {
 		xnvme_cli_perr("Could not write to device with xnvme_nvme_write(): ", err);
 		throw IOException("Encountered error when writing to NVMe device");
 	}
+	probe.Completed();
 
 	FreeDeviceBuffer(dev_buffer);
 
@@ -87,37 +110,110 @@ idx_t NvmeDevice::Read(void *buffer, const CmdContext &context) {
 	nvme_buf_ptr dev_buffer = AllocateDeviceBuffer(ctx.nr_bytes);
 
 	uint32_t nsid = xnvme_dev_get_nsid(device);
-	uint8_t plid_idx = GetPlacementIdentifierOrDefault(ctx.filepath);
 	xnvme_cmd_ctx xnvme_ctx = xnvme_cmd_ctx_from_dev(device);
 
-	PrepareIOCmdContext(&xnvme_ctx, context, plid_idx, 0, false);
+	PrepareIOCmdContext(&xnvme_ctx, context, 0, false);
 
+	NvmeTraceSpan span("ReadCommand", ctx.category);
+	span.SetRange(ctx.start_lba, ctx.nr_lbas);
+	NvmeCommandProbe probe(ctx, false);
+	probe.Submitted();
 	int err = xnvme_nvm_read(&xnvme_ctx, nsid, ctx.start_lba, ctx.nr_lbas - 1, dev_buffer, nullptr);
 	if (err) {
 		xnvme_cli_perr("Could not write to device with xnvme_nvme_write(): ", err);
 		throw IOException("Encountered error when writing to NVMe device");
 	}
+	probe.Completed();
 
 	memcpy(buffer, (char *)dev_buffer + ctx.offset, ctx.nr_bytes);
+	if (io_statistics) {
+		io_statistics->RecordBounceCopy(ctx.category);
+	}
 
 	FreeDeviceBuffer(dev_buffer);
 
 	return ctx.nr_lbas;
 }
 
-DeviceGeometry NvmeDevice::GetDeviceGeometry() {
-	return geometry;
+idx_t NvmeDevice::Deallocate(const CmdContext &context) {
+	D_ASSERT(context.nr_lbas > 0);
+	// Deallocation is a hint, hence files and devices without dataset management keep their LBAs
+	if (!dsm) {
+		return 0;
+	}
+
+	// The length of a single range is limited to 32 bits, hence large deallocations are split over several ranges
+	const idx_t max_range_lbas = NumericLimits<uint32_t>::Maximum();
+	const idx_t nr_ranges = (context.nr_lbas + max_range_lbas - 1) / max_range_lbas;
+	if (nr_ranges > NVMEFS_MAX_DSM_RANGES) {
+		throw IOException("Cannot deallocate %llu LBAs with a single dataset management command", context.nr_lbas);
+	}
+
+	xnvme_spec_dsm_range *ranges =
+	    (xnvme_spec_dsm_range *)AllocateDeviceBuffer(nr_ranges * sizeof(xnvme_spec_dsm_range));
+	for (idx_t i = 0; i < nr_ranges; i++) {
+		idx_t range_start = i * max_range_lbas;
+		ranges[i].cattr = 0;
+		ranges[i].llb = MinValue<idx_t>(max_range_lbas, context.nr_lbas - range_start);
+		ranges[i].slba = context.start_lba + range_start;
+	}
+
+	uint32_t nsid = xnvme_dev_get_nsid(device);
+	xnvme_cmd_ctx xnvme_ctx = xnvme_cmd_ctx_from_dev(device);
+
+	// The number of ranges is 0-based, and only the deallocate attribute is set
+	int err = xnvme_nvm_dsm(&xnvme_ctx, nsid, ranges, nr_ranges - 1, true, false, false);
+	FreeDeviceBuffer(ranges);
+	if (err) {
+		// The LBAs stay allocated on the device, which only costs garbage collection work
+		xnvme_cli_perr("Could not deallocate LBAs with xnvme_nvm_dsm(): ", err);
+		return 0;
+	}
+
+	return context.nr_lbas;
 }
 
-uint8_t NvmeDevice::GetPlacementIdentifierOrDefault(const string &path) {
-	uint8_t placement_identifier = 0;
-	for (const auto &kv : allocated_placement_identifiers) {
-		if (StringUtil::StartsWith(path, kv.first)) {
-			placement_identifier = kv.second;
-		}
+bool NvmeDevice::Copy(const CmdContext &context, idx_t source_lba) {
+	D_ASSERT(context.nr_lbas > 0);
+	if (context.nr_lbas > max_copy_lbas) {
+		return false;
 	}
 
-	return placement_identifier;
+	xnvme_spec_nvm_scopy_source_range *source =
+	    (xnvme_spec_nvm_scopy_source_range *)AllocateDeviceBuffer(sizeof(xnvme_spec_nvm_scopy_source_range));
+	memset(source, 0, sizeof(xnvme_spec_nvm_scopy_source_range));
+	source->entry[0].slba = source_lba;
+	source->entry[0].nlb = context.nr_lbas - 1;
+
+	uint32_t nsid = xnvme_dev_get_nsid(device);
+	xnvme_cmd_ctx xnvme_ctx = xnvme_cmd_ctx_from_dev(device);
+	if (fdp && !placement_handlers.empty()) {
+		// The copy command carries the directive type and placement handle in the same fields as a write
+		xnvme_ctx.cmd.common.cdw12 = DATA_PLACEMENT_MODE << 20;
+		xnvme_ctx.cmd.common.cdw13 = GetPlacementHandle(context.placement_identifier) << 16;
+	}
+
+	NvmeTraceSpan span("CopyCommand", context.category);
+	span.SetRange(context.start_lba, context.nr_lbas);
+	// The number of source ranges is 0-based
+	int err = xnvme_nvm_scopy(&xnvme_ctx, nsid, context.start_lba, source, 0, XNVME_NVM_SCOPY_FMT_ZERO);
+	FreeDeviceBuffer(source);
+	if (err) {
+		xnvme_cli_perr("Could not copy LBAs with xnvme_nvm_scopy(): ", err);
+		throw IOException("Encountered error when copying LBAs on NVMe device");
+	}
+
+	return true;
+}
+
+DeviceGeometry NvmeDevice::GetDeviceGeometry() {
+	return geometry;
+}
+
+uint16_t NvmeDevice::GetPlacementHandle(idx_t placement_identifier) {
+	// A policy can name more placement identifiers than the device has reclaim unit handles. Such writes share a
+	// handle with other identifiers, rather than failing on devices with few handles.
+	return placement_handlers[placement_identifier % placement_handlers.size()];
 }
 
 nvme_buf_ptr NvmeDevice::AllocateDeviceBuffer(idx_t nr_bytes) {
@@ -146,6 +242,18 @@ void NvmeDevice::PrepareOpts(xnvme_opts &opts) {
 		return;
 	}
 
+	if (file_backed) {
+		// The namespace is emulated on top of the file. Synchronous I/O always uses pread/pwrite, while asynchronous
+		// I/O uses the requested file backend, e.g. posix, emu, thrpool or io_uring.
+		opts.be = "linux";
+		opts.admin = "file_as_ns";
+		opts.sync = "psync";
+		if (this->async) {
+			opts.async = this->backend.data();
+		}
+		return;
+	}
+
 	if (this->async) {
 		opts.async = this->backend.data();
 		if (StringUtil::Equals(this->backend.data(), "io_uring_cmd")) {
@@ -181,9 +289,9 @@ idx_t NvmeDevice::ReadAsync(void *buffer, const CmdContext &context) {
 	nvme_buf_ptr dev_buffer = AllocateDeviceBuffer(ctx.nr_bytes);
 
 	uint32_t nsid = xnvme_dev_get_nsid(device);
-	uint8_t plid_idx = GetPlacementIdentifierOrDefault(ctx.filepath);
 
 	idx_t thread_index = GetThreadIndex();
+	std::lock_guard<InstrumentedMutex<std::mutex>> queue_lock(*queue_locks[thread_index]);
 
 	xnvme_queue *queue = queues[thread_index];
 
@@ -197,7 +305,7 @@ idx_t NvmeDevice::ReadAsync(void *buffer, const CmdContext &context) {
 	}
 
 	xnvme_cmd_ctx *xnvme_ctx = xnvme_queue_get_cmd_ctx(queue);
-	PrepareIOCmdContext(xnvme_ctx, context, plid_idx, 0, false);
+	PrepareIOCmdContext(xnvme_ctx, context, 0, false);
 
 	std::promise<void> cb_notify;
 	std::future<void> fut = cb_notify.get_future();
@@ -207,31 +315,37 @@ idx_t NvmeDevice::ReadAsync(void *buffer, const CmdContext &context) {
 	std::future_status status;
 	std::chrono::milliseconds interval = std::chrono::milliseconds(0);
 
-	int err = xnvme_nvm_read(xnvme_ctx, nsid, ctx.start_lba, ctx.nr_lbas - 1, dev_buffer, nullptr);
-	if (err) {
-		xnvme_cli_perr("Could not submit command to queue with xnvme_nvme_read(): ", err);
-		throw IOException("Encountered error when writing to NVMe device");
+	NvmeCommandProbe probe(ctx, false);
+	{
+		NvmeTraceSpan span("SubmitRead", ctx.category);
+		span.SetRange(ctx.start_lba, ctx.nr_lbas);
+		probe.Submitted();
+		int err = xnvme_nvm_read(xnvme_ctx, nsid, ctx.start_lba, ctx.nr_lbas - 1, dev_buffer, nullptr);
+		if (err) {
+			xnvme_cli_perr("Could not submit command to queue with xnvme_nvme_read(): ", err);
+			throw IOException("Encountered error when writing to NVMe device");
+		}
 	}
 
+	NvmeTraceSpan span("CompleteRead", ctx.category);
+	span.SetRange(ctx.start_lba, ctx.nr_lbas);
 	do {
 		xnvme_queue_poke(queue, 0);
 		status = fut.wait_for(interval);
 	} while (status != std::future_status::ready);
+	probe.Completed();
 
 	memcpy(buffer, dev_buffer + ctx.offset, ctx.nr_bytes);
+	if (io_statistics) {
+		io_statistics->RecordBounceCopy(ctx.category);
+	}
 
 	FreeDeviceBuffer(dev_buffer);
 
-	// auto end_time = std::chrono::high_resolution_clock::now();
-	// auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-	// // Print the duration
-	// printf("ReadAsync took %d milliseconds.\n", duration.count());
-
 	return ctx.nr_lbas;
 }
 
 idx_t NvmeDevice::WriteAsync(void *buffer, const CmdContext &context) {
-	// auto start_time = std::chrono::high_resolution_clock::now();
 	const NvmeCmdContext &ctx = static_cast<const NvmeCmdContext &>(context);
 	D_ASSERT(ctx.nr_lbas > 0);
 	// We only support offset reads within a single block
@@ -240,11 +354,14 @@ idx_t NvmeDevice::WriteAsync(void *buffer, const CmdContext &context) {
 	// Prepare buffer
 	nvme_buf_ptr dev_buffer = AllocateDeviceBuffer(ctx.nr_bytes);
 	memcpy(dev_buffer, buffer + ctx.offset, ctx.nr_bytes);
+	if (io_statistics) {
+		io_statistics->RecordBounceCopy(ctx.category);
+	}
 
 	uint32_t nsid = xnvme_dev_get_nsid(device);
-	uint8_t plid_idx = GetPlacementIdentifierOrDefault(ctx.filepath);
 
 	idx_t thread_index = GetThreadIndex();
+	std::lock_guard<InstrumentedMutex<std::mutex>> queue_lock(*queue_locks[thread_index]);
 
 	xnvme_queue *queue = queues[thread_index];
 	if (!queue) {
@@ -257,7 +374,7 @@ idx_t NvmeDevice::WriteAsync(void *buffer, const CmdContext &context) {
 	}
 
 	xnvme_cmd_ctx *xnvme_ctx = xnvme_queue_get_cmd_ctx(queue);
-	PrepareIOCmdContext(xnvme_ctx, context, plid_idx, DATA_PLACEMENT_MODE, true);
+	PrepareIOCmdContext(xnvme_ctx, context, DATA_PLACEMENT_MODE, true);
 
 	std::promise<void> cb_notify;
 	std::future<void> fut = cb_notify.get_future();
@@ -267,29 +384,54 @@ idx_t NvmeDevice::WriteAsync(void *buffer, const CmdContext &context) {
 	std::future_status status;
 	std::chrono::milliseconds interval = std::chrono::milliseconds(0);
 
-	int err = xnvme_nvm_write(xnvme_ctx, nsid, ctx.start_lba, ctx.nr_lbas - 1, dev_buffer, nullptr);
-	if (err) {
-		xnvme_cli_perr("Could not submit command to queue with xnvme_nvme_write(): ", err);
-		throw IOException("Encountered error when writing to NVMe device");
+	NvmeCommandProbe probe(ctx, true);
+	{
+		NvmeTraceSpan span("SubmitWrite", ctx.category);
+		span.SetRange(ctx.start_lba, ctx.nr_lbas);
+		probe.Submitted();
+		int err = xnvme_nvm_write(xnvme_ctx, nsid, ctx.start_lba, ctx.nr_lbas - 1, dev_buffer, nullptr);
+		if (err) {
+			xnvme_cli_perr("Could not submit command to queue with xnvme_nvme_write(): ", err);
+			throw IOException("Encountered error when writing to NVMe device");
+		}
 	}
 
+	NvmeTraceSpan span("CompleteWrite", ctx.category);
+	span.SetRange(ctx.start_lba, ctx.nr_lbas);
 	do {
 		xnvme_queue_poke(queue, 0);
 		status = fut.wait_for(interval);
 	} while (status != std::future_status::ready);
+	probe.Completed();
 
 	FreeDeviceBuffer(dev_buffer);
 
-	// auto end_time = std::chrono::high_resolution_clock::now();
-	// auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-	// // Print the duration
-	// printf("WriteAsync took %d milliseconds.\n", duration.count());
-
 	return ctx.nr_lbas;
 }
 
-void NvmeDevice::PrepareIOCmdContext(xnvme_cmd_ctx *ctx, const CmdContext &cmd_ctx, idx_t plid_idx, idx_t dtype,
-                                     bool write) {
+vector<pair<string, string>> NvmeDevice::GetDeviceInfo() {
+	vector<pair<string, string>> info = Device::GetDeviceInfo();
+	info.emplace_back("device_path", dev_path);
+	info.emplace_back("file_backed", file_backed ? "true" : "false");
+	info.emplace_back("backend", backend);
+	info.emplace_back("async", async ? "true" : "false");
+	info.emplace_back("fdp", fdp ? "true" : "false");
+
+	vector<string> handles;
+	for (auto handle : placement_handlers) {
+		handles.push_back(std::to_string(handle));
+	}
+	info.emplace_back("placement_handles", StringUtil::Join(handles, ","));
+
+	// Synchronous backends complete every command on the submitting thread without a queue
+	info.emplace_back("queues", std::to_string(async ? queues.size() : 0));
+	info.emplace_back("queue_depth", std::to_string(async ? XNVME_QUEUE_DEPTH : 0));
+	info.emplace_back("max_copy_lbas", std::to_string(max_copy_lbas));
+	info.emplace_back("dsm", dsm ? "true" : "false");
+	return info;
+}
+
+void NvmeDevice::PrepareIOCmdContext(xnvme_cmd_ctx *ctx, const CmdContext &cmd_ctx, idx_t dtype, bool write) {
 	const NvmeCmdContext &nvme_cmd_ctx = static_cast<const NvmeCmdContext &>(cmd_ctx);
 
 	// Specified by the command set specification:
@@ -299,10 +441,10 @@ void NvmeDevice::PrepareIOCmdContext(xnvme_cmd_ctx *ctx, const CmdContext &cmd_c
 	uint16_t nr_lbas = nvme_cmd_ctx.nr_lbas - 1;
 
 	ctx->cmd.common.cdw12 = nr_lbas;
-	if (write && fdp) {
+	if (write && fdp && !placement_handlers.empty()) {
 		ctx->cmd.common.cdw12 |= dtype << 20;
 
-		uint16_t phid = placement_handlers[plid_idx];
+		uint16_t phid = GetPlacementHandle(cmd_ctx.placement_identifier);
 		ctx->cmd.common.cdw13 = phid << 16;
 	}
 }
@@ -326,6 +468,22 @@ bool NvmeDevice::CheckFDP() {
 	return ctx.cpl.cdw0 & 0x1;
 }
 
+idx_t NvmeDevice::LoadMaxCopyLBAs() {
+	const xnvme_spec_idfy_ctrlr *ctrlr = xnvme_dev_get_ctrlr_css(device);
+	const xnvme_spec_nvm_idfy_ns *ns = (const xnvme_spec_nvm_idfy_ns *)xnvme_dev_get_ns_css(device);
+	if (!ctrlr || !ns || !ctrlr->oncs.copy) {
+		return 0;
+	}
+
+	// A copy with a single source range is limited by both the length of a source range and the length of a copy
+	return MinValue<idx_t>(ns->mssrl, ns->mcl);
+}
+
+bool NvmeDevice::CheckDSM() {
+	const xnvme_spec_idfy_ctrlr *ctrlr = xnvme_dev_get_ctrlr_css(device);
+	return ctrlr && ctrlr->oncs.dsm;
+}
+
 void NvmeDevice::InitializePlacementHandles() {
 	uint32_t nsid = xnvme_dev_get_nsid(device);
 	xnvme_cmd_ctx xnvme_ctx = xnvme_cmd_ctx_from_dev(device);
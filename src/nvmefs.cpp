@@ -1,8 +1,14 @@
 #include "nvmefs.hpp"
+#include "nvmefs_tracer.hpp"
+#include "nvmefs_lock_statistics.hpp"
+#include "nvmefs_probes.hpp"
+
+#include "duckdb/main/config.hpp"
 
 namespace duckdb {
 NvmeFileHandle::NvmeFileHandle(FileSystem &file_system, string path, FileOpenFlags flags)
-    : FileHandle(file_system, path, flags), cursor_offset(0) {
+    : FileHandle(file_system, path, flags), cursor_offset(0), database(nullptr), placement_identifier(0),
+      category(IOCategory::GENERAL) {
 }
 
 void NvmeFileHandle::Read(void *buffer, idx_t nr_bytes, idx_t location) {
@@ -31,6 +37,8 @@ unique_ptr<CmdContext> NvmeFileHandle::PrepareWriteCommand(idx_t nr_bytes, idx_t
 	nvme_cmd_ctx->offset = offset;
 	nvme_cmd_ctx->start_lba = start_lba;
 	nvme_cmd_ctx->nr_lbas = CalculateRequiredLBACount(nr_bytes);
+	nvme_cmd_ctx->placement_identifier = placement_identifier;
+	nvme_cmd_ctx->category = category;
 
 	return std::move(nvme_cmd_ctx);
 }
@@ -42,6 +50,7 @@ unique_ptr<CmdContext> NvmeFileHandle::PrepareReadCommand(idx_t nr_bytes, idx_t
 	nvme_cmd_ctx->offset = offset;
 	nvme_cmd_ctx->start_lba = start_lba;
 	nvme_cmd_ctx->nr_lbas = CalculateRequiredLBACount(nr_bytes);
+	nvme_cmd_ctx->category = category;
 
 	return std::move(nvme_cmd_ctx);
 }
@@ -65,15 +74,101 @@ idx_t NvmeFileHandle::GetFilePointer() {
 
 std::recursive_mutex NvmeFileSystem::temp_lock;
 
+/// @brief Opens a device with liburing, pread and pwrite or xNVMe, depending on the backend
+static unique_ptr<Device> OpenDevice(const NvmeConfig &config, const string &device_path) {
+	if (config.backend == NVMEFS_DIRECT_BACKEND) {
+		return make_uniq<DirectDevice>(device_path);
+	}
+	if (config.backend == NVMEFS_URING_BACKEND) {
+		return make_uniq<UringDevice>(device_path, UringDeviceOptions::Parse(config.uring_options),
+		                              config.max_threads);
+	}
+	return make_uniq<NvmeDevice>(device_path, config.backend, config.async, config.max_threads);
+}
+
+/// @brief Opens the devices of a region. A comma-separated list of paths is striped over or mirrored.
+static unique_ptr<Device> OpenRegionDevice(const NvmeConfig &config, const string &region_path) {
+	vector<string> device_paths = StringUtil::Split(region_path, ',');
+	if (device_paths.size() <= 1) {
+		return OpenDevice(config, region_path);
+	}
+
+	vector<unique_ptr<Device>> members;
+	for (auto &device_path : device_paths) {
+		StringUtil::Trim(device_path);
+		members.push_back(OpenDevice(config, device_path));
+	}
+	string layout = StringUtil::Lower(config.device_layout);
+	if (layout == NVMEFS_MIRROR_LAYOUT) {
+		return make_uniq<MirroredDevice>(std::move(members), MirroredDevice::ParseHedgePercentile(config.hedge_reads),
+		                                 config.max_threads);
+	}
+	if (!layout.empty() && layout != NVMEFS_STRIPE_LAYOUT) {
+		throw InvalidInputException("Unknown device layout '%s', expected '%s' or '%s'", config.device_layout,
+		                            NVMEFS_STRIPE_LAYOUT, NVMEFS_MIRROR_LAYOUT);
+	}
+	idx_t stripe_size =
+	    config.stripe_size.empty() ? NVMEFS_DEFAULT_STRIPE_SIZE : DBConfig::ParseMemoryLimit(config.stripe_size);
+	return make_uniq<StripedDevice>(std::move(members), stripe_size, config.max_threads);
+}
+
+/// @brief Opens the device of the configuration, with the WALs and temporary files on devices of their own if set
+static unique_ptr<Device> OpenDevice(const NvmeConfig &config) {
+	unique_ptr<Device> device = OpenRegionDevice(config, config.device_path);
+	if (config.wal_device_path.empty() && config.temp_device_path.empty()) {
+		return device;
+	}
+
+	unique_ptr<Device> wal_device;
+	unique_ptr<Device> temporary_device;
+	if (!config.wal_device_path.empty()) {
+		wal_device = OpenRegionDevice(config, config.wal_device_path);
+	}
+	if (!config.temp_device_path.empty()) {
+		temporary_device = OpenRegionDevice(config, config.temp_device_path);
+	}
+	return make_uniq<RegionDevice>(std::move(device), std::move(wal_device), std::move(temporary_device));
+}
+
+/// @brief Wraps the device in a RecordingDevice when tracing is enabled in the configuration
+static unique_ptr<Device> ConfigureDevice(const NvmeConfig &config, unique_ptr<Device> device) {
+	if (config.trace_path.empty()) {
+		return device;
+	}
+	return make_uniq<RecordingDevice>(std::move(device), config.trace_path);
+}
+
 NvmeFileSystem::NvmeFileSystem(NvmeConfig config)
     : allocator(Allocator::DefaultAllocator()),
-      device(make_uniq<NvmeDevice>(config.device_path, config.backend, config.async, config.max_threads)),
-      max_temp_size(config.max_temp_size), max_wal_size(config.max_wal_size), db_location(0), wal_location(0) {
+      device(ConfigureDevice(config, OpenDevice(config))),
+      max_temp_size(config.max_temp_size), max_wal_size(config.max_wal_size),
+      placement_policy(NvmePlacementPolicy::Parse(config.placement_policy)) {
+	ConfigureScheduler(config.io_scheduler);
+	this->device->SetIOStatistics(&io_statistics);
+	if (!config.temp_spill_directory.empty()) {
+		temp_spill = make_uniq<NvmeTemporarySpillDirectory>(config.temp_spill_directory);
+	}
 }
 
 NvmeFileSystem::NvmeFileSystem(NvmeConfig config, unique_ptr<Device> device)
-    : allocator(Allocator::DefaultAllocator()), device(std::move(device)), max_temp_size(config.max_temp_size),
-      max_wal_size(config.max_wal_size), db_location(0), wal_location(0) {
+    : allocator(Allocator::DefaultAllocator()), device(ConfigureDevice(config, std::move(device))),
+      max_temp_size(config.max_temp_size), max_wal_size(config.max_wal_size),
+      placement_policy(NvmePlacementPolicy::Parse(config.placement_policy)) {
+	ConfigureScheduler(config.io_scheduler);
+	this->device->SetIOStatistics(&io_statistics);
+	if (!config.temp_spill_directory.empty()) {
+		temp_spill = make_uniq<NvmeTemporarySpillDirectory>(config.temp_spill_directory);
+	}
+}
+
+void NvmeFileSystem::ConfigureScheduler(const string &policy) {
+	if (policy.empty()) {
+		return;
+	}
+	// The scheduler wraps a RecordingDevice, such that traces show the commands in the order the device received them
+	auto scheduling_device = make_uniq<SchedulingDevice>(std::move(device), NvmeSchedulerPolicy::Parse(policy));
+	scheduler = scheduling_device.get();
+	device = std::move(scheduling_device);
 }
 
 NvmeFileSystem::~NvmeFileSystem() {
@@ -85,69 +180,209 @@ NvmeFileSystem::~NvmeFileSystem() {
 unique_ptr<FileHandle> NvmeFileSystem::OpenFile(const string &path, FileOpenFlags flags,
                                                 optional_ptr<FileOpener> opener) {
 	bool internal = StringUtil::Equals(NVMEFS_GLOBAL_METADATA_PATH.data(), path.data());
-	if (!internal && !TryLoadMetadata()) {
-		if (GetMetadataType(path) != MetadataType::DATABASE) {
+	if (internal) {
+		unique_ptr<NvmeFileHandle> handle = make_uniq<NvmeFileHandle>(*this, path, flags);
+		handle->placement_identifier = placement_policy.GetPlacementIdentifier(PlacementRegion::METADATA);
+		handle->category = IOCategory::METADATA;
+		return std::move(handle);
+	}
+
+	MetadataType type = GetMetadataType(path);
+	bool create_general_file =
+	    type == MetadataType::GENERAL && (flags.CreateFileIfNotExists() || flags.OverwriteExistingFile());
+	if (!TryLoadMetadata()) {
+		// The device is formatted by the first database or file that is created on it
+		if (type != MetadataType::DATABASE && !create_general_file) {
 			throw IOException("No database is attached");
 		} else {
-			InitializeMetadata(path);
+			InitializeMetadata();
 		}
 	}
 
-	if (path == NVMEFS_GLOBAL_METADATA_PATH) {
-		return make_uniq<NvmeFileHandle>(*this, path, flags);
+	if (flags.CreateFileIfNotExists() && type == MetadataType::TEMPORARY) {
+		temp_meta_manager->CreateFile(path); // Create temporary file here since we ensure it is duckdb synchronized
 	}
 
-	if (flags.CreateFileIfNotExists() && GetMetadataType(path) == MetadataType::TEMPORARY) {
-		temp_meta_manager->CreateFile(path); // Create temporary file here since we ensure it is duckdb synchronized
+	unique_ptr<NvmeFileHandle> handle = make_uniq<NvmeFileHandle>(*this, path, flags);
+	handle->placement_identifier = GetPlacementIdentifier(path);
+	handle->category = GetIOCategory(type);
+
+	if (type == MetadataType::DATABASE || type == MetadataType::WAL) {
+		// Databases are added to the catalog the first time they are opened. The handle keeps a pointer to the
+		// database such that IO does not need to look it up in the catalog.
+		bool created = false;
+		handle->database = catalog->GetOrCreateDatabase(NvmeDatabaseCatalog::GetDatabaseName(path), created);
+		if (created) {
+			WriteExtentTable();
+			WriteCatalogEntry(*handle->database);
+		}
+	}
+
+	if (type == MetadataType::GENERAL) {
+		string name = NvmeFileDirectory::GetFileName(path);
+		handle->file = create_general_file ? file_directory->GetOrCreateFile(name) : file_directory->GetFile(name);
+		if (!handle->file) {
+			if (flags.ReturnNullIfNotExists()) {
+				return nullptr;
+			}
+			throw IOException("Cannot open file \"%s\": No such file or directory", path);
+		}
+
+		if (flags.OverwriteExistingFile()) {
+			handle->file->size.store(0);
+			handle->file->extents.Truncate(0);
+			handle->file->dirty.store(true);
+		}
+		if (flags.OpenForAppending()) {
+			handle->SetFilePointer(handle->file->size.load());
+		}
 	}
 
-	unique_ptr<FileHandle> handle = make_uniq<NvmeFileHandle>(*this, path, flags);
 	return std::move(handle);
 }
 
 void NvmeFileSystem::Read(FileHandle &handle, void *buffer, int64_t nr_bytes, idx_t location) {
 	NvmeFileHandle &fh = handle.Cast<NvmeFileHandle>();
 	DeviceGeometry geo = device->GetDeviceGeometry();
+	NvmeTraceSpan span("Read", fh.category);
+	span.SetRange(location / geo.lba_size, (location % geo.lba_size + nr_bytes + geo.lba_size - 1) / geo.lba_size);
+	NvmeFileProbe probe(false, fh.category, location, nr_bytes);
+
+	// General files are read at the exact byte location, independent of the file pointer
+	if (fh.file) {
+		ReadGeneralFile(fh, static_cast<data_ptr_t>(buffer), nr_bytes, location);
+		probe.Done();
+		return;
+	}
 
 	idx_t cursor_offset = SeekPosition(handle);
 	location += cursor_offset;
 	idx_t nr_lbas = fh.CalculateRequiredLBACount(nr_bytes);
-	idx_t start_lba = GetLBA(handle.path, nr_bytes, location, nr_lbas);
 	idx_t in_block_offset = location % geo.lba_size;
-	unique_ptr<CmdContext> cmd_ctx = fh.PrepareReadCommand(nr_bytes, start_lba, in_block_offset);
 
-	if (!IsLBAInRange(handle.path, start_lba, cmd_ctx->nr_lbas)) {
+	if (!IsLBAInRange(fh, location / geo.lba_size, nr_lbas)) {
 		throw IOException("Read out of range");
 	}
 
-	device->Read(buffer, *cmd_ctx);
+	// A read can span several extents. Each run is read with its own command, while unmapped runs have never been
+	// written and are read as zeros.
+	TemporaryBlockPin pin;
+	vector<ExtentRun> runs = GetLBA(fh, nr_bytes, location, nr_lbas, false, pin);
+	if (runs.empty() && fh.category == IOCategory::TEMPORARY) {
+		// Blocks only move to the spill tier if there is one
+		if (!temp_spill) {
+			throw InternalException("Cannot read from \"%s\": the block is spilled, but there is no spill tier",
+			                        fh.path);
+		}
+		temp_spill->Read(fh.path, buffer, nr_bytes, location);
+		probe.Done();
+		return;
+	}
+	idx_t bytes_read = 0;
+	for (const auto &run : runs) {
+		idx_t run_bytes = MinValue<idx_t>(nr_bytes - bytes_read, run.nr_lbas * geo.lba_size - in_block_offset);
+		char *run_buffer = static_cast<char *>(buffer) + bytes_read;
+
+		if (run.mapped) {
+			unique_ptr<CmdContext> cmd_ctx = fh.PrepareReadCommand(run_bytes, run.start_lba, in_block_offset);
+			DeviceRead(run_buffer, *cmd_ctx);
+		} else {
+			memset(run_buffer, 0, run_bytes);
+		}
+
+		bytes_read += run_bytes;
+		in_block_offset = 0;
+	}
+	probe.Done();
 }
 
 void NvmeFileSystem::Write(FileHandle &handle, void *buffer, int64_t nr_bytes, idx_t location) {
 	NvmeFileHandle &fh = handle.Cast<NvmeFileHandle>();
 	DeviceGeometry geo = device->GetDeviceGeometry();
+	NvmeTraceSpan span("Write", fh.category);
+	span.SetRange(location / geo.lba_size, (location % geo.lba_size + nr_bytes + geo.lba_size - 1) / geo.lba_size);
+	NvmeFileProbe probe(true, fh.category, location, nr_bytes);
+
+	if (fh.file) {
+		WriteGeneralFile(fh, static_cast<const_data_ptr_t>(buffer), nr_bytes, location);
+		probe.Done();
+		return;
+	}
 
 	idx_t cursor_offset = SeekPosition(handle);
 	location += cursor_offset;
 	idx_t nr_lbas = fh.CalculateRequiredLBACount(nr_bytes);
-	idx_t start_lba = GetLBA(fh.path, nr_bytes, location, nr_lbas);
+	idx_t lba_location = location / geo.lba_size;
 	idx_t in_block_offset = location % geo.lba_size;
-	unique_ptr<CmdContext> cmd_ctx = fh.PrepareWriteCommand(nr_bytes, start_lba, in_block_offset);
 
-	if (!IsLBAInRange(handle.path, start_lba, cmd_ctx->nr_lbas)) {
-		throw IOException("Read out of range");
+	if (!IsLBAInRange(fh, lba_location, nr_lbas)) {
+		throw IOException("Write out of range");
+	}
+
+	TemporaryBlockPin pin;
+	vector<ExtentRun> runs = GetLBA(fh, nr_bytes, location, nr_lbas, true, pin);
+	if (runs.empty() && fh.category == IOCategory::TEMPORARY) {
+		// The temporary space is full and the block was written less recently than all blocks on the device
+		if (!temp_spill) {
+			throw InternalException("Cannot write to \"%s\": the block is spilled, but there is no spill tier",
+			                        fh.path);
+		}
+		temp_spill->Write(fh.path, buffer, nr_bytes, location);
+		UpdateMetadata(fh, lba_location + nr_lbas);
+		probe.Done();
+		return;
+	}
+	idx_t placement_identifier = GetWritePlacementIdentifier(fh, lba_location, nr_lbas);
+	idx_t bytes_written = 0;
+	for (const auto &run : runs) {
+		if (!run.mapped) {
+			throw InternalException("Cannot write to \"%s\": the LBAs at %llu are not mapped", fh.path, lba_location);
+		}
+		idx_t run_bytes = MinValue<idx_t>(nr_bytes - bytes_written, run.nr_lbas * geo.lba_size - in_block_offset);
+		char *run_buffer = static_cast<char *>(buffer) + bytes_written;
+
+		unique_ptr<CmdContext> cmd_ctx = fh.PrepareWriteCommand(run_bytes, run.start_lba, in_block_offset);
+		cmd_ctx->placement_identifier = placement_identifier;
+		DeviceWrite(run_buffer, *cmd_ctx);
+
+		bytes_written += run_bytes;
+		in_block_offset = 0;
 	}
 
-	idx_t written_lbas = device->Write(buffer, *cmd_ctx);
-	UpdateMetadata(*cmd_ctx);
+	UpdateMetadata(fh, lba_location + nr_lbas);
+	probe.Done();
 }
 
 int64_t NvmeFileSystem::Read(FileHandle &handle, void *buffer, int64_t nr_bytes) {
+	NvmeFileHandle &fh = handle.Cast<NvmeFileHandle>();
+
+	// General files are read sequentially from the file pointer and the read stops at the end of the file
+	if (fh.file) {
+		idx_t position = fh.GetFilePointer();
+		idx_t size = fh.file->size.load();
+		idx_t bytes_to_read = position >= size ? 0 : MinValue<idx_t>(nr_bytes, size - position);
+
+		ReadGeneralFile(fh, static_cast<data_ptr_t>(buffer), bytes_to_read, position);
+		fh.SetFilePointer(position + bytes_to_read);
+		return bytes_to_read;
+	}
+
 	Read(handle, buffer, nr_bytes, 0);
 	return nr_bytes;
 }
 
 int64_t NvmeFileSystem::Write(FileHandle &handle, void *buffer, int64_t nr_bytes) {
+	NvmeFileHandle &fh = handle.Cast<NvmeFileHandle>();
+
+	// General files are appended to at the file pointer, e.g. when DuckDB writes a CSV file
+	if (fh.file) {
+		idx_t position = fh.GetFilePointer();
+
+		WriteGeneralFile(fh, static_cast<const_data_ptr_t>(buffer), nr_bytes, position);
+		fh.SetFilePointer(position + nr_bytes);
+		return nr_bytes;
+	}
+
 	Write(handle, buffer, nr_bytes, 0);
 	return nr_bytes;
 }
@@ -162,40 +397,27 @@ bool NvmeFileSystem::FileExists(const string &filename, optional_ptr<FileOpener>
 	}
 
 	MetadataType type = GetMetadataType(filename);
-	string path_no_ext = StringUtil::GetFileStem(filename);
-	string db_path_no_ext = StringUtil::GetFileStem(metadata->db_path);
 
 	bool exists = false;
 
 	switch (type) {
 
 	case WAL:
-		/*
-		    Need to remove the '.wal' and db ext before evaluating if the file exists.
-		    Example:
-		        string filename = "test.db.wal"
-		        // After two calls to GetFileStem would be: "test"
-		*/
-		path_no_ext = StringUtil::GetFileStem(path_no_ext);
-		if (StringUtil::Equals(path_no_ext.data(), db_path_no_ext.data())) {
-			exists = true;
-		}
+		// The WAL exists as long as the database it belongs to is in the catalog
+		exists = GetDatabase(filename) != nullptr;
 		break;
-	case DATABASE:
-		if (StringUtil::Equals(path_no_ext.data(), db_path_no_ext.data())) {
-			idx_t start_lba = metadata->db_start;
-			idx_t location_lba = db_location.load();
-
-			if ((location_lba - start_lba) > 0) {
-				exists = true;
-			}
-		} else {
-			throw IOException("Not possible to have multiple databases");
+	case DATABASE: {
+		shared_ptr<NvmeDatabase> database = GetDatabase(filename);
+		if (database && database->db_location.load() > 0) {
+			exists = true;
 		}
-		break;
+	} break;
 	case TEMPORARY:
 		exists = temp_meta_manager->FileExists(filename);
 		break;
+	case GENERAL:
+		exists = file_directory->GetFile(NvmeFileDirectory::GetFileName(filename)) != nullptr;
+		break;
 	default:
 		throw IOException("No such metadata type");
 		break;
@@ -211,15 +433,18 @@ int64_t NvmeFileSystem::GetFileSize(FileHandle &handle) {
 	idx_t nr_lbas {};
 	switch (type) {
 	case MetadataType::DATABASE:
-		nr_lbas = db_location.load() - metadata->db_start;
+		nr_lbas = fh.database->db_location.load();
 		break;
 	case MetadataType::TEMPORARY: {
 		nr_lbas = temp_meta_manager->GetFileSizeLBA(fh.path);
 		break;
 	}
 	case MetadataType::WAL:
-		nr_lbas = wal_location.load() - metadata->wal_start;
+		nr_lbas = fh.database->wal_location.load();
 		break;
+	case MetadataType::GENERAL:
+		// General files are sized in bytes
+		return fh.file->size.load();
 	default:
 		throw InvalidInputException("Unknown metadata type!");
 		break;
@@ -228,8 +453,26 @@ int64_t NvmeFileSystem::GetFileSize(FileHandle &handle) {
 }
 
 void NvmeFileSystem::FileSync(FileHandle &handle) {
-	WriteMetadata(*metadata);
-	// No need for sync. All writes are directly to disk.
+	NvmeFileHandle &fh = handle.Cast<NvmeFileHandle>();
+	if (fh.database && fh.database->removed.load()) {
+		// The catalog slot of a removed database can already belong to another database
+		return;
+	}
+
+	// No need for sync of the data. All writes are directly to disk. Only the metadata of the database that the file
+	// belongs to is written, such that syncing one database does not interfere with the others.
+	if (fh.database) {
+		// DuckDB syncs the database file at the end of every checkpoint, which ends the epoch that the rewrite
+		// frequency of the database blocks is measured in
+		if (GetMetadataType(fh.path) == MetadataType::DATABASE) {
+			fh.database->lifetime_estimator.AdvanceEpoch();
+		}
+		WriteExtentTable();
+		WriteCatalogEntry(*fh.database);
+	} else if (fh.file) {
+		WriteExtentTable();
+		WriteFileIndex();
+	}
 }
 
 bool NvmeFileSystem::OnDiskFile(FileHandle &handle) {
@@ -247,22 +490,34 @@ void NvmeFileSystem::Truncate(FileHandle &handle, int64_t new_size) {
 
 		switch (type) {
 		case MetadataType::WAL: {
+			atomic<idx_t> &wal_location = nvme_handle.database->wal_location;
 			idx_t expected_location = wal_location.load();
-			idx_t new_location = metadata->wal_start + new_lba_location;
+			idx_t new_location = new_lba_location;
 
-			while (!wal_location.compare_exchange_weak(expected_location, new_location))
+			InstrumentedCASLoop cas_loop(LockSite::WAL_LOCATION);
+			while (!wal_location.compare_exchange_weak(expected_location, new_location) && cas_loop.Retry())
 				;
+			// Return the extents that are no longer needed, such that other files can use the space
+			nvme_handle.database->wal_extents.Truncate(new_location);
 		} break;
 		case MetadataType::DATABASE: {
+			atomic<idx_t> &db_location = nvme_handle.database->db_location;
 			idx_t expected_location = db_location.load();
-			idx_t new_location = metadata->db_start + new_lba_location;
+			idx_t new_location = new_lba_location;
 
-			while (!db_location.compare_exchange_weak(expected_location, new_location))
+			InstrumentedCASLoop cas_loop(LockSite::DB_LOCATION);
+			while (!db_location.compare_exchange_weak(expected_location, new_location) && cas_loop.Retry())
 				;
+			nvme_handle.database->db_extents.Truncate(new_location);
 		} break;
 		case MetadataType::TEMPORARY: {
 			temp_meta_manager->TruncateFile(nvme_handle.path, new_size);
 		} break;
+		case MetadataType::GENERAL: {
+			nvme_handle.file->size.store(new_size);
+			nvme_handle.file->extents.Truncate(new_lba_location);
+			nvme_handle.file->dirty.store(true);
+		} break;
 		default:
 			throw InvalidInputException("Unknown metadata type");
 			break;
@@ -281,13 +536,35 @@ bool NvmeFileSystem::DirectoryExists(const string &directory, optional_ptr<FileO
 }
 
 void NvmeFileSystem::RemoveDirectory(const string &directory, optional_ptr<FileOpener> opener) {
-	// We only support removal of temporary directory
+	// We support removal of the temporary directory and directories in the general file namespace
 	MetadataType type = GetMetadataType(directory);
 	if (type == MetadataType::TEMPORARY) {
 		temp_meta_manager->Clear();
-	} else {
+		if (temp_spill) {
+			temp_spill->Clear();
+		}
+		return;
+	}
+
+	vector<string> files_to_remove;
+	if (type == MetadataType::GENERAL && TryLoadMetadata()) {
+		string prefix = NvmeFileDirectory::GetFileName(directory) + "/";
+		file_directory->Scan([&files_to_remove, &prefix](NvmeFile &file) {
+			if (StringUtil::StartsWith(file.name, prefix)) {
+				files_to_remove.push_back(file.name);
+			}
+		});
+	}
+
+	if (files_to_remove.empty()) {
 		throw IOException("Cannot delete unknown directory");
 	}
+
+	for (const auto &name : files_to_remove) {
+		file_directory->RemoveFile(name);
+	}
+	WriteFileIndex();
+	WriteExtentTable();
 }
 
 void NvmeFileSystem::CreateDirectory(const string &directory, optional_ptr<FileOpener> opener) {
@@ -302,16 +579,45 @@ void NvmeFileSystem::RemoveFile(const string &filename, optional_ptr<FileOpener>
 	MetadataType type = GetMetadataType(filename);
 
 	switch (type) {
-	case WAL:
+	case WAL: {
 		// Reset the location poitner (next lba to write to) to the start effectively removing the wal
-		wal_location.store(metadata->wal_start);
-		break;
+		shared_ptr<NvmeDatabase> database = GetDatabase(filename);
+		if (database) {
+			database->wal_location.store(0);
+			database->wal_extents.Truncate(0);
+		}
+	} break;
 
 	case TEMPORARY: {
 		temp_meta_manager->DeleteFile(filename);
+		if (temp_spill) {
+			temp_spill->DeleteFile(filename);
+		}
+	} break;
+	case GENERAL: {
+		if (!TryLoadMetadata() || !file_directory->RemoveFile(NvmeFileDirectory::GetFileName(filename))) {
+			throw IOException("Could not remove file \"%s\": No such file or directory", filename);
+		}
+		// The directory entry is removed before the extents are marked as free, such that a crash in between never
+		// leaves a file that points to extents owned by another file
+		WriteFileIndex();
+		WriteExtentTable();
+	} break;
+	case DATABASE: {
+		shared_ptr<NvmeDatabase> database;
+		if (TryLoadMetadata()) {
+			database = catalog->RemoveDatabase(NvmeDatabaseCatalog::GetDatabaseName(filename));
+		}
+		if (!database) {
+			throw IOException("Could not remove file \"%s\": No such file or directory", filename);
+		}
+		// The catalog entry is cleared before the extents of the database and its WAL are marked as free, such that a
+		// crash in between never leaves a database that points to extents owned by another file
+		WriteCatalogEntry(*database);
+		catalog->ReleaseDatabase(*database);
+		WriteExtentTable();
 	} break;
 	default:
-		// No other files to delete - we only have the database file, temporary files and the write_ahead_log
 		break;
 	}
 }
@@ -319,24 +625,25 @@ void NvmeFileSystem::RemoveFile(const string &filename, optional_ptr<FileOpener>
 void NvmeFileSystem::Seek(FileHandle &handle, idx_t location) {
 	NvmeFileHandle &nvme_handle = handle.Cast<NvmeFileHandle>();
 	DeviceGeometry geo = device->GetDeviceGeometry();
-	// We only support seek to start of an LBA block
-	D_ASSERT(location % geo.lba_size == 0);
+	// We only support seek to start of an LBA block, except for general files which are byte addressable
+	D_ASSERT(nvme_handle.file || location % geo.lba_size == 0);
 
-	// The order of the LBA ranges is:
-	// Database, Write-Ahead Log, Temporary
+	// The database and write-ahead log can grow until the device or their maximum size is reached
 	MetadataType type = GetMetadataType(nvme_handle.path);
 	idx_t max_seek_bound = 0;
 	switch (type) {
 	case WAL:
-		// Reset the location poitner (next lba to write to) to the start effectively removing the wal
-		max_seek_bound = ((metadata->tmp_start - 1) - metadata->wal_start) * geo.lba_size;
+		max_seek_bound = (max_wal_size / geo.lba_size) * geo.lba_size;
 		break;
 	case DATABASE:
-		max_seek_bound = ((metadata->wal_start - 1) - metadata->db_start) * geo.lba_size;
+		max_seek_bound = extent_allocator->GetDataLBACount() * geo.lba_size;
 		break;
 	case TEMPORARY: {
 		max_seek_bound = temp_meta_manager->GetFileSizeLBA(nvme_handle.path) * geo.lba_size;
 	} break;
+	case GENERAL:
+		max_seek_bound = extent_allocator->GetDataLBACount() * geo.lba_size;
+		break;
 	default:
 		// No other files to delete - we only have the database file, temporary files and the write_ahead_log
 		break;
@@ -360,46 +667,65 @@ idx_t NvmeFileSystem::SeekPosition(FileHandle &handle) {
 
 bool NvmeFileSystem::ListFiles(const string &directory, const std::function<void(const string &, bool)> &callback,
                                FileOpener *opener) {
+	if (!TryLoadMetadata()) {
+		return false;
+	}
+
 	bool dir = false;
 	if (StringUtil::Equals(directory.data(), NVMEFS_PATH_PREFIX.data())) {
-		const string db_filename_no_ext = StringUtil::GetFileStem(metadata->db_path);
-		const string db_filename_with_ext = db_filename_no_ext + ".db";
-		const string db_wal = db_filename_with_ext + ".wal";
 		const string db_tmp = "/tmp";
 
-		callback(db_filename_with_ext, false);
+		catalog->Scan([&callback](NvmeDatabase &database) {
+			callback(database.name, false);
+			callback(database.name + ".wal", false);
+		});
 		callback(db_tmp, true);
-		callback(db_wal, false);
+		file_directory->ListFiles("", callback);
 
 		dir = true;
 	} else if (StringUtil::Equals(directory.data(), NVMEFS_TMP_DIR_PATH.data())) {
 		dir = true;
 		temp_meta_manager->ListFiles(directory, callback);
+	} else {
+		dir = file_directory->ListFiles(NvmeFileDirectory::GetFileName(directory), callback);
 	}
 	return dir;
 }
 
 optional_idx NvmeFileSystem::GetAvailableDiskSpace(const string &path) {
 	DeviceGeometry geo = device->GetDeviceGeometry();
-	const string db_filename_no_ext = StringUtil::GetFileStem(metadata->db_path);
-	const string db_filepath = NVMEFS_PATH_PREFIX + db_filename_no_ext + ".db";
-	const string wal_filepath = db_filepath + ".wal";
 
 	optional_idx remaining;
 
-	if (StringUtil::Equals(path.data(), NVMEFS_PATH_PREFIX.data())) {
-		idx_t db_max_bytes = ((metadata->wal_start - 1) - metadata->db_start) * geo.lba_size;
-		idx_t wal_max_bytes = ((metadata->tmp_start - 1) - metadata->wal_start) * geo.lba_size;
-
-		idx_t db_used_bytes = (db_location.load() - metadata->db_start) * geo.lba_size;
-		idx_t wal_used_bytes = (wal_location.load() - metadata->wal_start) * geo.lba_size;
-		idx_t temp_used_bytes {};
-
-		idx_t temp_avail_bytes = temp_meta_manager->GetAvailableSpace(geo.lba_count, metadata->tmp_start);
+	// Free extents can be used by any file. Additionally, each file can use the unused part of its own extents.
+	idx_t free_extent_bytes =
+	    extent_allocator->GetFreeExtentCount() * extent_allocator->GetExtentLBACount() * geo.lba_size;
+	idx_t temp_unused_bytes = temp_meta_manager->GetUnusedAllocatedLBACount() * geo.lba_size;
+	idx_t file_unused_bytes = 0;
+	file_directory->Scan([&file_unused_bytes, &geo](NvmeFile &file) {
+		idx_t used_lbas = (file.size.load() + geo.lba_size - 1) / geo.lba_size;
+		idx_t allocated_lbas = file.extents.GetAllocatedLBACount();
+		file_unused_bytes += (allocated_lbas - MinValue<idx_t>(used_lbas, allocated_lbas)) * geo.lba_size;
+	});
 
-		remaining = (db_max_bytes - db_used_bytes) + (wal_max_bytes - wal_used_bytes) + temp_avail_bytes;
+	if (StringUtil::Equals(path.data(), NVMEFS_PATH_PREFIX.data())) {
+		idx_t db_unused_bytes = 0;
+		catalog->Scan([&db_unused_bytes, &geo](NvmeDatabase &database) {
+			idx_t db_unused_lbas = database.db_extents.GetAllocatedLBACount() - database.db_location.load();
+			idx_t wal_unused_lbas = database.wal_extents.GetAllocatedLBACount() - database.wal_location.load();
+			db_unused_bytes += (db_unused_lbas + wal_unused_lbas) * geo.lba_size;
+		});
+
+		remaining = free_extent_bytes + db_unused_bytes + temp_unused_bytes + file_unused_bytes;
 	} else if (StringUtil::Equals(path.data(), NVMEFS_TMP_DIR_PATH.data())) {
-		remaining = temp_meta_manager->GetAvailableSpace(geo.lba_count, metadata->tmp_start);
+		remaining = MinValue<idx_t>(temp_meta_manager->GetAvailableSpace(), free_extent_bytes + temp_unused_bytes);
+		// Blocks that do not fit on the device go to the spill directory
+		optional_idx spill_bytes = temp_spill ? temp_spill->GetAvailableSpace() : optional_idx();
+		if (spill_bytes.IsValid()) {
+			remaining = remaining.GetIndex() + spill_bytes.GetIndex();
+		}
+	} else if (GetMetadataType(path) == MetadataType::GENERAL) {
+		remaining = free_extent_bytes + file_unused_bytes;
 	}
 	return remaining;
 }
@@ -408,6 +734,172 @@ Device &NvmeFileSystem::GetDevice() {
 	return *device;
 }
 
+optional_ptr<SchedulingDevice> NvmeFileSystem::GetScheduler() {
+	return scheduler;
+}
+
+NvmeIOStatistics &NvmeFileSystem::GetIOStatistics() {
+	return io_statistics;
+}
+
+NvmeExtentAllocator &NvmeFileSystem::GetExtentAllocator() {
+	return *extent_allocator;
+}
+
+NvmeDatabaseCatalog &NvmeFileSystem::GetDatabaseCatalog() {
+	return *catalog;
+}
+
+NvmeFileDirectory &NvmeFileSystem::GetFileDirectory() {
+	return *file_directory;
+}
+
+const NvmePlacementPolicy &NvmeFileSystem::GetPlacementPolicy() const {
+	return placement_policy;
+}
+
+TemporaryFileMetadataManager &NvmeFileSystem::GetTemporaryFileMetadataManager() {
+	RequireMetadata();
+	return *temp_meta_manager;
+}
+
+void NvmeFileSystem::RequireMetadata() {
+	if (!TryLoadMetadata()) {
+		throw IOException("The device is not formatted for nvmefs yet, as no database was attached");
+	}
+}
+
+vector<NvmeRegionInfo> NvmeFileSystem::GetRegions() {
+	RequireMetadata();
+	DeviceGeometry geo = device->GetDeviceGeometry();
+	idx_t extent_lbas = extent_allocator->GetExtentLBACount();
+
+	// The first extent holds the global metadata, the extent table, the database catalog and the directory index
+	NvmeRegionInfo metadata_region {"metadata", 0, extent_lbas, 0, extent_lbas, 1, 0};
+	metadata_region.used_lbas = metadata->file_index_location + file_directory->GetIndexLBACount();
+	NvmeRegionInfo database_region {"database", optional_idx(), 0, 0, optional_idx(), 0, 0};
+	NvmeRegionInfo wal_region {"wal", optional_idx(), 0, 0, optional_idx(), 0, 0};
+	NvmeRegionInfo temporary_region {"temporary", optional_idx(), 0, 0, max_temp_size / geo.lba_size, 0, 0};
+	NvmeRegionInfo general_region {"general", optional_idx(), 0, 0, optional_idx(), 0, 0};
+
+	for (const auto &owner : extent_allocator->GetExtentCountPerOwner()) {
+		if (owner.first == NVMEFS_EXTENT_OWNER_TEMPORARY) {
+			temporary_region.extent_count += owner.second;
+		} else if (owner.first >= NVMEFS_EXTENT_OWNER_FILE) {
+			general_region.extent_count += owner.second;
+		} else if (owner.first >= NVMEFS_EXTENT_OWNER_DATABASE) {
+			bool wal = (owner.first - NVMEFS_EXTENT_OWNER_DATABASE) % 2 == 1;
+			(wal ? wal_region : database_region).extent_count += owner.second;
+		}
+	}
+
+	catalog->Scan([&](NvmeDatabase &database) {
+		database_region.used_lbas +=
+		    MinValue<idx_t>(database.db_location.load(), database.db_extents.GetAllocatedLBACount());
+		database_region.file_count++;
+		wal_region.used_lbas +=
+		    MinValue<idx_t>(database.wal_location.load(), database.wal_extents.GetAllocatedLBACount());
+		wal_region.file_count++;
+	});
+	// Every WAL is limited on its own
+	wal_region.max_lbas = wal_region.file_count * (max_wal_size / geo.lba_size);
+
+	temp_meta_manager->Scan([&temporary_region, &geo](const string &path, idx_t block_size, idx_t size) {
+		temporary_region.used_lbas += size / geo.lba_size;
+		temporary_region.file_count++;
+	});
+
+	file_directory->Scan([&general_region, &geo](NvmeFile &file) {
+		idx_t used_lbas = (file.size.load() + geo.lba_size - 1) / geo.lba_size;
+		general_region.used_lbas += MinValue<idx_t>(used_lbas, file.extents.GetAllocatedLBACount());
+		general_region.file_count++;
+	});
+
+	vector<NvmeRegionInfo> regions {metadata_region, database_region, wal_region, temporary_region, general_region};
+	for (idx_t i = 1; i < regions.size(); i++) {
+		regions[i].lba_count = regions[i].extent_count * extent_lbas;
+	}
+
+	idx_t free_extents = extent_allocator->GetFreeExtentCount();
+	regions.push_back(NvmeRegionInfo {"free", optional_idx(), free_extents * extent_lbas, 0, optional_idx(),
+	                                  free_extents, 0});
+	return regions;
+}
+
+vector<pair<string, string>> NvmeFileSystem::GetDeviceInfo() {
+	RequireMetadata();
+	DeviceGeometry geo = device->GetDeviceGeometry();
+	vector<pair<string, string>> info = device->GetDeviceInfo();
+
+	info.emplace_back("extent_size",
+	                  StringUtil::BytesToHumanReadableString(extent_allocator->GetExtentLBACount() * geo.lba_size));
+	info.emplace_back("extent_count", std::to_string(extent_allocator->GetExtentCount()));
+	info.emplace_back("extent_table_location", std::to_string(NVMEFS_EXTENT_TABLE_LOCATION));
+	info.emplace_back("catalog_location", std::to_string(metadata->catalog_location));
+	info.emplace_back("max_databases", std::to_string(metadata->max_databases));
+	info.emplace_back("file_index_location", std::to_string(metadata->file_index_location));
+	info.emplace_back("max_files", std::to_string(metadata->max_files));
+	info.emplace_back("max_temp_size", StringUtil::BytesToHumanReadableString(max_temp_size));
+	info.emplace_back("max_wal_size", StringUtil::BytesToHumanReadableString(max_wal_size));
+	return info;
+}
+
+/// @brief Matches a file name against a glob pattern, where * and ? do not match across directories
+static bool MatchGlobPattern(const string &name, const string &pattern) {
+	idx_t name_pos = 0;
+	idx_t pattern_pos = 0;
+	idx_t star_pattern_pos = string::npos;
+	idx_t star_name_pos = 0;
+
+	while (name_pos < name.length()) {
+		if (pattern_pos < pattern.length() &&
+		    (pattern[pattern_pos] == name[name_pos] || (pattern[pattern_pos] == '?' && name[name_pos] != '/'))) {
+			name_pos++;
+			pattern_pos++;
+		} else if (pattern_pos < pattern.length() && pattern[pattern_pos] == '*') {
+			star_pattern_pos = pattern_pos++;
+			star_name_pos = name_pos;
+		} else if (star_pattern_pos != string::npos && name[star_name_pos] != '/') {
+			// Let the last star consume one more character and retry
+			pattern_pos = star_pattern_pos + 1;
+			name_pos = ++star_name_pos;
+		} else {
+			return false;
+		}
+	}
+
+	while (pattern_pos < pattern.length() && pattern[pattern_pos] == '*') {
+		pattern_pos++;
+	}
+	return pattern_pos == pattern.length();
+}
+
+vector<string> NvmeFileSystem::Glob(const string &path, FileOpener *opener) {
+	vector<string> result;
+	if (!TryLoadMetadata()) {
+		return result;
+	}
+
+	string pattern = NvmeFileDirectory::GetFileName(path);
+	if (pattern.find_first_of("*?") == string::npos) {
+		if (FileExists(path)) {
+			result.push_back(path);
+		}
+		return result;
+	}
+
+	// Results keep the prefix of the given path, e.g. nvmefs:/// or nvmefs://
+	string prefix = StringUtil::EndsWith(path, pattern) ? path.substr(0, path.length() - pattern.length())
+	                                                     : NVMEFS_PATH_PREFIX + "/";
+	file_directory->Scan([&result, &pattern, &prefix](NvmeFile &file) {
+		if (MatchGlobPattern(file.name, pattern)) {
+			result.push_back(prefix + file.name);
+		}
+	});
+
+	return result;
+}
+
 bool NvmeFileSystem::Trim(FileHandle &handle, idx_t offset_bytes, idx_t length_bytes) {
 	data_ptr_t data = allocator.AllocateData(length_bytes);
 
@@ -425,52 +917,114 @@ bool NvmeFileSystem::TryLoadMetadata() {
 
 	unique_ptr<GlobalMetadata> global = ReadMetadata();
 	if (global) {
+		VerifyRegions(*global);
 		metadata = std::move(global);
-		db_location.store(metadata->db_location);
-		wal_location.store(metadata->wal_location);
-
-		DeviceGeometry geo = device->GetDeviceGeometry();
-		temp_meta_manager =
-		    make_uniq<TemporaryFileMetadataManager>(metadata->tmp_start, geo.lba_count - 1, geo.lba_size);
+		InitializeExtents(*metadata, true);
 		return true;
 	}
 
 	return false;
 }
 
-void NvmeFileSystem::InitializeMetadata(const string &filename) {
-	// We only support database paths/names up to 100 characters (this includes NVMEFS_PATH_PREFIX)
-	if (filename.length() > 100) {
-		throw IOException("Database name is too long.");
+void NvmeFileSystem::InitializeMetadata() {
+	DeviceGeometry geo = device->GetDeviceGeometry();
+
+	// The device is divided into extents. The first extent is reserved for the global metadata, the extent table and
+	// the database catalog.
+	idx_t extent_lba_count = NvmeExtentAllocator::CalculateExtentLBACount(geo.lba_count, geo.lba_size);
+	idx_t extent_count = geo.lba_count / extent_lba_count;
+	if (extent_count < 2) {
+		throw IOException("Device is too small to hold nvmefs metadata and data");
+	}
+
+	unique_ptr<GlobalMetadata> global = make_uniq<GlobalMetadata>(GlobalMetadata {});
+
+	global->version = NVMEFS_METADATA_VERSION;
+	global->extent_lba_count = extent_lba_count;
+	global->extent_count = extent_count;
+	global->catalog_location = NVMEFS_EXTENT_TABLE_LOCATION +
+	                           NvmeExtentAllocator(extent_count, extent_lba_count, geo.lba_size).GetTableLBACount();
+	global->max_databases = NVMEFS_MAX_DATABASES;
+	global->file_index_location = global->catalog_location + global->max_databases;
+	global->max_files = NVMEFS_MAX_FILES;
+	RecordRegions(*global);
+
+	idx_t file_index_lbas = (global->max_files * sizeof(FileDirectoryEntry) + geo.lba_size - 1) / geo.lba_size;
+	if (global->file_index_location + file_index_lbas > extent_lba_count) {
+		throw IOException("The nvmefs metadata does not fit in the reserved metadata extent");
 	}
 
+	InitializeExtents(*global, false);
+
+	// The metadata is set before it is written, since the directory index is written relative to it
+	metadata = std::move(global);
+	WriteMetadata(*metadata);
+}
+
+void NvmeFileSystem::InitializeExtents(GlobalMetadata &global, bool load) {
 	DeviceGeometry geo = device->GetDeviceGeometry();
 
-	idx_t temp_start = (geo.lba_count - 1) - (max_temp_size / geo.lba_size);
-	idx_t wal_lba_count = max_wal_size / geo.lba_size;
-	idx_t wal_start = (temp_start - 1) - wal_lba_count;
+	extent_allocator = make_uniq<NvmeExtentAllocator>(global.extent_count, global.extent_lba_count, geo.lba_size);
+	catalog = make_uniq<NvmeDatabaseCatalog>(*extent_allocator, global.max_databases);
+	file_directory = make_uniq<NvmeFileDirectory>(*extent_allocator, global.max_files, geo.lba_size);
+	ConfigureExtentPools();
 
-	unique_ptr<GlobalMetadata> global = make_uniq<GlobalMetadata>(GlobalMetadata {});
+	if (load) {
+		FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_READ;
+		unique_ptr<FileHandle> fh = OpenFile(NVMEFS_GLOBAL_METADATA_PATH, flags);
+		NvmeFileHandle &nvme_fh = fh->Cast<NvmeFileHandle>();
 
-	// 1 is the first LBA for the database because 0 is used for device metadata (global metadata)
-	global->db_start = 1;
-	global->wal_start = wal_start;
-	global->tmp_start = temp_start;
-	global->db_location = 1;
-	global->wal_location = wal_start;
-	global->db_path_size = filename.length();
+		idx_t table_bytes = extent_allocator->GetTableLBACount() * geo.lba_size;
+		data_ptr_t buffer = allocator.AllocateData(table_bytes);
+		unique_ptr<CmdContext> cmd_ctx = nvme_fh.PrepareReadCommand(table_bytes, NVMEFS_EXTENT_TABLE_LOCATION, 0);
 
-	strncpy(global->db_path, filename.data(), filename.length());
-	global->db_path[100] = '\0';
+		DeviceRead(buffer, *cmd_ctx);
+		extent_allocator->DeserializeTable(buffer);
 
-	temp_meta_manager = make_uniq<TemporaryFileMetadataManager>(temp_start, geo.lba_count - 1, geo.lba_size);
+		allocator.FreeData(buffer, table_bytes);
 
-	WriteMetadata(*global);
+		// Temporary files do not survive a restart, hence their extents can be reused right away
+		extent_allocator->FreeOwner(NVMEFS_EXTENT_OWNER_TEMPORARY);
 
-	db_location.store(1);
-	wal_location.store(wal_start);
+		// Each database has its catalog entry in a separate LBA
+		idx_t catalog_bytes = global.max_databases * geo.lba_size;
+		data_ptr_t catalog_buffer = allocator.AllocateData(catalog_bytes);
+		unique_ptr<CmdContext> catalog_cmd_ctx =
+		    nvme_fh.PrepareReadCommand(catalog_bytes, global.catalog_location, 0);
 
-	metadata = std::move(global);
+		DeviceRead(catalog_buffer, *catalog_cmd_ctx);
+		for (idx_t slot = 0; slot < global.max_databases; slot++) {
+			DatabaseCatalogEntry entry;
+			memcpy(&entry, catalog_buffer + slot * geo.lba_size, sizeof(DatabaseCatalogEntry));
+			if (entry.in_use) {
+				catalog->LoadDatabase(slot, entry);
+			}
+		}
+
+		allocator.FreeData(catalog_buffer, catalog_bytes);
+
+		idx_t index_bytes = file_directory->GetIndexLBACount() * geo.lba_size;
+		data_ptr_t index_buffer = allocator.AllocateData(index_bytes);
+		unique_ptr<CmdContext> index_cmd_ctx =
+		    nvme_fh.PrepareReadCommand(index_bytes, global.file_index_location, 0);
+
+		DeviceRead(index_buffer, *index_cmd_ctx);
+		file_directory->DeserializeIndex(index_buffer);
+
+		allocator.FreeData(index_buffer, index_bytes);
+	}
+
+	temp_meta_manager =
+	    make_uniq<TemporaryFileMetadataManager>(*extent_allocator, max_temp_size / geo.lba_size, geo.lba_size);
+	temp_meta_manager->SetBlockRelocator(
+	    [this](const string &path, idx_t source_lba, idx_t destination_lba, idx_t nr_lbas) {
+		    RelocateTemporaryBlock(path, source_lba, destination_lba, nr_lbas);
+	    });
+	if (temp_spill) {
+		temp_meta_manager->SetBlockSpiller([this](const string &path, idx_t block_index, idx_t lba, idx_t nr_lbas) {
+			SpillTemporaryBlock(path, block_index, lba, nr_lbas);
+		});
+	}
 }
 
 unique_ptr<GlobalMetadata> NvmeFileSystem::ReadMetadata() {
@@ -486,17 +1040,19 @@ unique_ptr<GlobalMetadata> NvmeFileSystem::ReadMetadata() {
 	unique_ptr<CmdContext> cmd_ctx =
 	    fh->Cast<NvmeFileHandle>().PrepareReadCommand(bytes_to_read, NVMEFS_GLOBAL_METADATA_LOCATION, 0);
 
-	device->Read(buffer, *cmd_ctx);
+	DeviceRead(buffer, *cmd_ctx);
 
 	if (memcmp(buffer, NVMEFS_MAGIC_BYTES, nr_bytes_magic) == 0) {
-		DeviceGeometry geo = device->GetDeviceGeometry();
 		global = make_uniq<GlobalMetadata>(GlobalMetadata {});
 		memcpy(global.get(), buffer + nr_bytes_magic, nr_bytes_global);
-		temp_meta_manager = make_uniq<TemporaryFileMetadataManager>(global->tmp_start, geo.lba_count - 1, geo.lba_size);
 	}
 
 	allocator.FreeData(buffer, bytes_to_read);
 
+	if (global && global->version != NVMEFS_METADATA_VERSION) {
+		throw IOException("Device is formatted with an unsupported nvmefs metadata version %llu", global->version);
+	}
+
 	return std::move(global);
 }
 
@@ -505,10 +1061,6 @@ void NvmeFileSystem::WriteMetadata(GlobalMetadata &global) {
 	idx_t nr_bytes_global = sizeof(GlobalMetadata);
 	idx_t bytes_to_write = nr_bytes_magic + nr_bytes_global;
 
-	// update locations
-	global.db_location = db_location.load();
-	global.wal_location = wal_location.load();
-
 	data_ptr_t buffer = allocator.AllocateData(bytes_to_write);
 	memcpy(buffer, NVMEFS_MAGIC_BYTES, nr_bytes_magic);
 	memcpy(buffer + nr_bytes_magic, &global, nr_bytes_global);
@@ -518,126 +1070,595 @@ void NvmeFileSystem::WriteMetadata(GlobalMetadata &global) {
 	unique_ptr<CmdContext> cmd_ctx =
 	    fh->Cast<NvmeFileHandle>().PrepareWriteCommand(bytes_to_write, NVMEFS_GLOBAL_METADATA_LOCATION, 0);
 
-	device->Write(buffer, *cmd_ctx);
+	DeviceWrite(buffer, *cmd_ctx);
 
 	allocator.FreeData(buffer, bytes_to_write);
+
+	WriteExtentTable();
+	catalog->Scan([this](NvmeDatabase &database) { WriteCatalogEntry(database); });
+	WriteFileIndex();
+}
+
+void NvmeFileSystem::RecordRegions(GlobalMetadata &global) {
+	vector<DeviceRegion> regions = device->GetRegions();
+	D_ASSERT(regions.size() <= NVMEFS_MAX_REGIONS);
+
+	global.region_count = regions.size();
+	for (idx_t i = 0; i < regions.size(); i++) {
+		GlobalRegionMetadata &region = global.regions[i];
+		region.category = static_cast<uint64_t>(regions[i].category);
+		region.start_lba = regions[i].start_lba;
+		region.lba_count = regions[i].lba_count;
+		memset(region.device_path, 0, NVMEFS_REGION_PATH_LENGTH);
+		strncpy(region.device_path, regions[i].device_path.c_str(), NVMEFS_REGION_PATH_LENGTH - 1);
+	}
+}
+
+/// @brief Describes the regions of the global metadata for error messages
+static string DescribeRegions(const GlobalMetadata &global) {
+	if (global.region_count == 0) {
+		return "a single device";
+	}
+	vector<string> regions;
+	for (idx_t i = 0; i < global.region_count; i++) {
+		const GlobalRegionMetadata &region = global.regions[i];
+		regions.push_back(StringUtil::Format("the %s region on %s with %llu LBAs",
+		                                     IOCategoryToString(static_cast<IOCategory>(region.category)),
+		                                     string(region.device_path), region.lba_count));
+	}
+	return StringUtil::Join(regions, ", ");
+}
+
+void NvmeFileSystem::VerifyRegions(const GlobalMetadata &global) {
+	GlobalMetadata current {};
+	RecordRegions(current);
+
+	bool same_regions = current.region_count == global.region_count;
+	for (idx_t i = 0; same_regions && i < global.region_count; i++) {
+		const GlobalRegionMetadata &expected = global.regions[i];
+		const GlobalRegionMetadata &actual = current.regions[i];
+		same_regions = expected.category == actual.category && expected.start_lba == actual.start_lba &&
+		               expected.lba_count == actual.lba_count &&
+		               strncmp(expected.device_path, actual.device_path, NVMEFS_REGION_PATH_LENGTH) == 0;
+	}
+	if (!same_regions) {
+		throw IOException("The device was formatted with %s, but is opened with %s. Open it with the same database, "
+		                  "WAL and temporary devices as it was formatted with.",
+		                  DescribeRegions(global), DescribeRegions(current));
+	}
+}
+
+void NvmeFileSystem::ConfigureExtentPools() {
+	vector<DeviceRegion> regions = device->GetRegions();
+	idx_t extent_lbas = extent_allocator->GetExtentLBACount();
+	idx_t lba_size = device->GetDeviceGeometry().lba_size;
+
+	// The regions of the device come in the order of their LBAs, starting with the database region. The WAL and the
+	// temporary files stay in the database region unless the device has a region for them.
+	for (auto &region : regions) {
+		// Extents that straddle two regions belong to neither, such that no pool spills onto the device of another
+		idx_t first_extent = MaxValue<idx_t>((region.start_lba + extent_lbas - 1) / extent_lbas, 1);
+		idx_t end_extent = MinValue<idx_t>((region.start_lba + region.lba_count) / extent_lbas,
+		                                   extent_allocator->GetExtentCount());
+		if (first_extent >= end_extent) {
+			throw IOException("The %s region of the device is too small to hold a single extent of %s",
+			                  IOCategoryToString(region.category),
+			                  StringUtil::BytesToHumanReadableString(extent_lbas * lba_size));
+		}
+
+		switch (region.category) {
+		case IOCategory::DATABASE:
+			extent_allocator->SetPoolExtents(ExtentPool::DATA, first_extent, end_extent);
+			extent_allocator->SetPoolExtents(ExtentPool::WAL, first_extent, end_extent);
+			extent_allocator->SetPoolExtents(ExtentPool::TEMPORARY, first_extent, end_extent);
+			break;
+		case IOCategory::WAL:
+			extent_allocator->SetPoolExtents(ExtentPool::WAL, first_extent, end_extent);
+			break;
+		case IOCategory::TEMPORARY:
+			extent_allocator->SetPoolExtents(ExtentPool::TEMPORARY, first_extent, end_extent);
+			break;
+		default:
+			throw InternalException("Devices cannot have a region for %s", IOCategoryToString(region.category));
+		}
+	}
+}
+
+void NvmeFileSystem::WriteExtentTable() {
+	// The extent table is shared by all databases. Writes are serialized such that an older version of a table LBA
+	// never overwrites a newer one.
+	std::lock_guard<std::mutex> lock(extent_table_lock);
+
+	// Only the parts of the extent table that have changed since the last write are written to the device
+	vector<pair<idx_t, idx_t>> dirty_ranges = extent_allocator->TakeDirtyTableRanges();
+	if (dirty_ranges.empty()) {
+		return;
+	}
+
+	DeviceGeometry geo = device->GetDeviceGeometry();
+	idx_t table_bytes = extent_allocator->GetTableLBACount() * geo.lba_size;
+	data_ptr_t table_buffer = allocator.AllocateData(table_bytes);
+	extent_allocator->SerializeTable(table_buffer);
+
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE;
+	unique_ptr<FileHandle> fh = OpenFile(NVMEFS_GLOBAL_METADATA_PATH, flags);
+	NvmeFileHandle &nvme_fh = fh->Cast<NvmeFileHandle>();
+
+	for (const auto &range : dirty_ranges) {
+		idx_t range_bytes = range.second * geo.lba_size;
+		unique_ptr<CmdContext> cmd_ctx =
+		    nvme_fh.PrepareWriteCommand(range_bytes, NVMEFS_EXTENT_TABLE_LOCATION + range.first, 0);
+		DeviceWrite(table_buffer + range.first * geo.lba_size, *cmd_ctx);
+	}
+
+	allocator.FreeData(table_buffer, table_bytes);
+
+	// Freed extents are deallocated once the table no longer refers to them, such that the device does not have to
+	// keep their data around during garbage collection
+	extent_allocator->DeallocateFreedExtents([&](idx_t start_lba, idx_t nr_lbas) {
+		unique_ptr<CmdContext> cmd_ctx = nvme_fh.PrepareWriteCommand(nr_lbas * geo.lba_size, start_lba, 0);
+		device->Deallocate(*cmd_ctx);
+	});
+}
+
+void NvmeFileSystem::WriteCatalogEntry(NvmeDatabase &database) {
+	std::lock_guard<std::mutex> lock(database.sync_lock);
+
+	DeviceGeometry geo = device->GetDeviceGeometry();
+	DatabaseCatalogEntry entry = database.GetCatalogEntry();
+
+	data_ptr_t buffer = allocator.AllocateData(geo.lba_size);
+	memset(buffer, 0, geo.lba_size);
+	memcpy(buffer, &entry, sizeof(DatabaseCatalogEntry));
+
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE;
+	unique_ptr<FileHandle> fh = OpenFile(NVMEFS_GLOBAL_METADATA_PATH, flags);
+	unique_ptr<CmdContext> cmd_ctx =
+	    fh->Cast<NvmeFileHandle>().PrepareWriteCommand(geo.lba_size, metadata->catalog_location + database.slot, 0);
+
+	DeviceWrite(buffer, *cmd_ctx);
+
+	allocator.FreeData(buffer, geo.lba_size);
+}
+
+void NvmeFileSystem::WriteFileIndex() {
+	std::lock_guard<std::mutex> lock(file_index_lock);
+
+	DeviceGeometry geo = device->GetDeviceGeometry();
+	idx_t index_bytes = file_directory->GetIndexLBACount() * geo.lba_size;
+	data_ptr_t index_buffer = allocator.AllocateData(index_bytes);
+
+	// Only the LBAs holding entries that have changed since the last write are written to the device
+	vector<pair<idx_t, idx_t>> dirty_ranges = file_directory->SerializeDirtyIndex(index_buffer);
+	if (!dirty_ranges.empty()) {
+		FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE;
+		unique_ptr<FileHandle> fh = OpenFile(NVMEFS_GLOBAL_METADATA_PATH, flags);
+		NvmeFileHandle &nvme_fh = fh->Cast<NvmeFileHandle>();
+
+		for (const auto &range : dirty_ranges) {
+			idx_t range_bytes = range.second * geo.lba_size;
+			unique_ptr<CmdContext> cmd_ctx =
+			    nvme_fh.PrepareWriteCommand(range_bytes, metadata->file_index_location + range.first, 0);
+			DeviceWrite(index_buffer + range.first * geo.lba_size, *cmd_ctx);
+		}
+	}
+
+	allocator.FreeData(index_buffer, index_bytes);
+}
+
+void NvmeFileSystem::ReadGeneralFile(NvmeFileHandle &handle, data_ptr_t buffer, idx_t nr_bytes, idx_t location) {
+	NvmeFile &file = *handle.file;
+	if (location + nr_bytes > file.size.load()) {
+		throw IOException("Read out of range");
+	}
+	if (nr_bytes == 0) {
+		return;
+	}
+
+	DeviceGeometry geo = device->GetDeviceGeometry();
+	idx_t lba = location / geo.lba_size;
+	idx_t in_block_offset = location % geo.lba_size;
+	idx_t bytes_read = 0;
+
+	// The device can only read whole LBAs at an offset, hence unaligned edges are read through a bounce buffer
+	data_ptr_t bounce_buffer = nullptr;
+	if (in_block_offset != 0 || (location + nr_bytes) % geo.lba_size != 0) {
+		bounce_buffer = allocator.AllocateData(geo.lba_size);
+	}
+
+	if (in_block_offset != 0 || nr_bytes < geo.lba_size) {
+		idx_t head_bytes = MinValue<idx_t>(nr_bytes, geo.lba_size - in_block_offset);
+		ReadFileLBAs(handle, bounce_buffer, lba, 1);
+		memcpy(buffer, bounce_buffer + in_block_offset, head_bytes);
+		io_statistics.RecordBounceCopy(handle.category);
+		bytes_read += head_bytes;
+		lba++;
+	}
+
+	idx_t aligned_lbas = (nr_bytes - bytes_read) / geo.lba_size;
+	if (aligned_lbas > 0) {
+		ReadFileLBAs(handle, buffer + bytes_read, lba, aligned_lbas);
+		bytes_read += aligned_lbas * geo.lba_size;
+		lba += aligned_lbas;
+	}
+
+	if (bytes_read < nr_bytes) {
+		ReadFileLBAs(handle, bounce_buffer, lba, 1);
+		memcpy(buffer + bytes_read, bounce_buffer, nr_bytes - bytes_read);
+		io_statistics.RecordBounceCopy(handle.category);
+	}
+
+	if (bounce_buffer) {
+		allocator.FreeData(bounce_buffer, geo.lba_size);
+	}
 }
 
-void NvmeFileSystem::UpdateMetadata(CmdContext &context) {
-	NvmeCmdContext &ctx = static_cast<NvmeCmdContext &>(context);
-	MetadataType type = GetMetadataType(ctx.filepath);
+void NvmeFileSystem::WriteGeneralFile(NvmeFileHandle &handle, const_data_ptr_t buffer, idx_t nr_bytes,
+                                      idx_t location) {
+	NvmeFile &file = *handle.file;
+	if (file.removed.load()) {
+		throw IOException("Cannot write to \"%s\": the file has been removed", handle.path);
+	}
+
+	DeviceGeometry geo = device->GetDeviceGeometry();
+	idx_t end_location = location + nr_bytes;
+	if ((end_location + geo.lba_size - 1) / geo.lba_size > extent_allocator->GetDataLBACount()) {
+		throw IOException("Write out of range");
+	}
+	if (nr_bytes == 0) {
+		return;
+	}
+
+	idx_t lba = location / geo.lba_size;
+	idx_t in_block_offset = location % geo.lba_size;
+	idx_t bytes_written = 0;
+
+	// LBAs that are only partially covered by the write are read, modified and written back. Concurrent writers of the
+	// same LBA, e.g. two appends that meet inside an LBA, are serialized until the file size covers their bytes.
+	bool partial = in_block_offset != 0 || end_location % geo.lba_size != 0;
+	std::unique_lock<std::mutex> partial_lock(file.partial_write_lock, std::defer_lock);
+	data_ptr_t bounce_buffer = nullptr;
+	if (partial) {
+		partial_lock.lock();
+		bounce_buffer = allocator.AllocateData(geo.lba_size);
+	}
+
+	if (in_block_offset != 0 || nr_bytes < geo.lba_size) {
+		idx_t head_bytes = MinValue<idx_t>(nr_bytes, geo.lba_size - in_block_offset);
+		ReadFileLBAForUpdate(handle, bounce_buffer, lba);
+		memcpy(bounce_buffer + in_block_offset, buffer, head_bytes);
+		WriteFileLBAs(handle, bounce_buffer, lba, 1);
+		io_statistics.RecordReadModifyWrite(handle.category);
+		io_statistics.RecordBounceCopy(handle.category);
+		bytes_written += head_bytes;
+		lba++;
+	}
+
+	idx_t aligned_lbas = (nr_bytes - bytes_written) / geo.lba_size;
+	if (aligned_lbas > 0) {
+		WriteFileLBAs(handle, buffer + bytes_written, lba, aligned_lbas);
+		bytes_written += aligned_lbas * geo.lba_size;
+		lba += aligned_lbas;
+	}
+
+	if (bytes_written < nr_bytes) {
+		ReadFileLBAForUpdate(handle, bounce_buffer, lba);
+		memcpy(bounce_buffer, buffer + bytes_written, nr_bytes - bytes_written);
+		WriteFileLBAs(handle, bounce_buffer, lba, 1);
+		io_statistics.RecordReadModifyWrite(handle.category);
+		io_statistics.RecordBounceCopy(handle.category);
+	}
+
+	idx_t expected_size = file.size.load();
+	do {
+		// Another thread has already written past the end of this write
+		if (end_location <= expected_size) {
+			break;
+		}
+	} while (!file.size.compare_exchange_weak(expected_size, end_location));
+	file.dirty.store(true);
+
+	if (bounce_buffer) {
+		allocator.FreeData(bounce_buffer, geo.lba_size);
+	}
+}
+
+void NvmeFileSystem::ReadFileLBAs(NvmeFileHandle &handle, data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas) {
+	DeviceGeometry geo = device->GetDeviceGeometry();
+
+	vector<ExtentRun> runs = handle.file->extents.Map(start_lba, nr_lbas, false);
+	for (const auto &run : runs) {
+		idx_t run_bytes = run.nr_lbas * geo.lba_size;
+		if (run.mapped) {
+			unique_ptr<CmdContext> cmd_ctx = handle.PrepareReadCommand(run_bytes, run.start_lba, 0);
+			DeviceRead(buffer, *cmd_ctx);
+		} else {
+			memset(buffer, 0, run_bytes);
+		}
+		buffer += run_bytes;
+	}
+}
+
+void NvmeFileSystem::WriteFileLBAs(NvmeFileHandle &handle, const_data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas) {
+	DeviceGeometry geo = device->GetDeviceGeometry();
+
+	vector<ExtentRun> runs = handle.file->extents.Map(start_lba, nr_lbas, true);
+	for (const auto &run : runs) {
+		if (!run.mapped) {
+			throw InternalException("Cannot write to \"%s\": the LBAs at %llu are not mapped", handle.path, start_lba);
+		}
+		idx_t run_bytes = run.nr_lbas * geo.lba_size;
+		unique_ptr<CmdContext> cmd_ctx = handle.PrepareWriteCommand(run_bytes, run.start_lba, 0);
+		DeviceWrite(const_cast<data_ptr_t>(buffer), *cmd_ctx);
+		buffer += run_bytes;
+	}
+}
+
+void NvmeFileSystem::ReadFileLBAForUpdate(NvmeFileHandle &handle, data_ptr_t buffer, idx_t lba) {
+	DeviceGeometry geo = device->GetDeviceGeometry();
+	ReadFileLBAs(handle, buffer, lba, 1);
+
+	// Bytes past the end of the file can hold stale data of a truncated part of the file
+	idx_t size = handle.file->size.load();
+	idx_t lba_start = lba * geo.lba_size;
+	idx_t valid_bytes = size <= lba_start ? 0 : MinValue<idx_t>(size - lba_start, geo.lba_size);
+	memset(buffer + valid_bytes, 0, geo.lba_size - valid_bytes);
+}
+
+idx_t NvmeFileSystem::GetPlacementIdentifier(const string &path) {
+	switch (GetMetadataType(path)) {
+	case MetadataType::DATABASE:
+		return placement_policy.GetPlacementIdentifier(PlacementRegion::DATABASE);
+	case MetadataType::WAL:
+		return placement_policy.GetPlacementIdentifier(PlacementRegion::WAL);
+	case MetadataType::TEMPORARY:
+		return placement_policy.GetTemporaryPlacementIdentifier(path);
+	case MetadataType::GENERAL:
+		return placement_policy.GetPlacementIdentifier(PlacementRegion::GENERAL);
+	default:
+		throw InvalidInputException("No such metadata type");
+	}
+}
+
+IOCategory NvmeFileSystem::GetIOCategory(MetadataType type) {
+	switch (type) {
+	case MetadataType::DATABASE:
+		return IOCategory::DATABASE;
+	case MetadataType::WAL:
+		return IOCategory::WAL;
+	case MetadataType::TEMPORARY:
+		return IOCategory::TEMPORARY;
+	case MetadataType::GENERAL:
+		return IOCategory::GENERAL;
+	default:
+		throw InvalidInputException("No such metadata type");
+	}
+}
+
+idx_t NvmeFileSystem::GetWritePlacementIdentifier(NvmeFileHandle &handle, idx_t lba_location, idx_t nr_lbas) {
+	optional_idx hot_identifier = placement_policy.GetHotDatabasePlacementIdentifier();
+	if (!hot_identifier.IsValid() || GetMetadataType(handle.path) != MetadataType::DATABASE) {
+		return handle.placement_identifier;
+	}
+
+	// Blocks that are rewritten by every checkpoint die together, hence they are kept apart from the long-lived blocks
+	bool hot = handle.database->lifetime_estimator.RecordWrite(lba_location, nr_lbas);
+	return hot ? hot_identifier.GetIndex() : handle.placement_identifier;
+}
+
+shared_ptr<NvmeDatabase> NvmeFileSystem::GetDatabase(const string &filename) {
+	return catalog->GetDatabase(NvmeDatabaseCatalog::GetDatabaseName(filename));
+}
+
+void NvmeFileSystem::UpdateMetadata(NvmeFileHandle &handle, idx_t lba_location) {
+	MetadataType type = GetMetadataType(handle.path);
 
 	switch (type) {
 	case MetadataType::WAL: {
+		atomic<idx_t> &wal_location = handle.database->wal_location;
 		idx_t expected_location = wal_location.load();
-		idx_t new_location = ctx.start_lba + ctx.nr_lbas;
+		idx_t new_location = lba_location;
+		InstrumentedCASLoop cas_loop(LockSite::WAL_LOCATION);
 		do {
 			// Location does not need to be updated from this thread anymore
 			// Another thread have surpassed it
 			if (new_location < expected_location) {
 				break;
 			}
-		} while (!wal_location.compare_exchange_weak(expected_location, new_location));
+		} while (!wal_location.compare_exchange_weak(expected_location, new_location) && cas_loop.Retry());
 	} break;
 	case MetadataType::TEMPORARY:
 		// The temporary metadata remain static given that location is unused.
 		// The file_to_temp_meta map will be updated during GetLBA, hence
 		// no action is required here.
-		temp_meta_manager->MoveLBALocation(ctx.filepath, ctx.start_lba + ctx.nr_lbas);
+		temp_meta_manager->MoveLBALocation(handle.path, lba_location);
 		break;
 	case MetadataType::DATABASE: {
+		atomic<idx_t> &db_location = handle.database->db_location;
 		idx_t expected_location = db_location.load();
-		idx_t new_location = ctx.start_lba + ctx.nr_lbas;
+		idx_t new_location = lba_location;
+		InstrumentedCASLoop cas_loop(LockSite::DB_LOCATION);
 		do {
 			// Location does not need to be updated from this thread anymore
 			// Another thread have surpassed it
 			if (new_location < expected_location) {
 				break;
 			}
-		} while (!db_location.compare_exchange_weak(expected_location, new_location));
+		} while (!db_location.compare_exchange_weak(expected_location, new_location) && cas_loop.Retry());
 	} break;
 	default:
 		throw InvalidInputException("no such metadatatype");
 	}
 }
 
+bool NvmeFileSystem::IsTemporaryPath(const string &filename) {
+	if (!StringUtil::StartsWith(filename, NVMEFS_PATH_PREFIX)) {
+		return false;
+	}
+
+	// Temporary files live in the tmp directory at the root or directly below a database, e.g. nvmefs:///tmp/x.tmp or
+	// nvmefs://test.db/tmp/x.tmp. Other directories named tmp belong to the general file namespace.
+	string path = filename.substr(NVMEFS_PATH_PREFIX.size());
+	path = path.substr(MinValue<idx_t>(path.find_first_not_of('/'), path.size()));
+	idx_t separator = path.find('/');
+	if (separator != string::npos && StringUtil::EndsWith(path.substr(0, separator), ".db")) {
+		path = path.substr(separator + 1);
+	}
+	return path == "tmp" || StringUtil::StartsWith(path, "tmp/");
+}
+
 MetadataType NvmeFileSystem::GetMetadataType(const string &filename) {
-	if (StringUtil::Contains(filename, ".wal")) {
+	// Anything that is not a database, WAL or temporary file belongs to the general file namespace, e.g. the output of
+	// COPY TO. Hence the database and WAL have to be matched on their extension only.
+	if (StringUtil::EndsWith(filename, ".wal")) {
 		return MetadataType::WAL;
-	} else if (StringUtil::Contains(filename, "/tmp")) {
+	} else if (IsTemporaryPath(filename)) {
 		return MetadataType::TEMPORARY;
-	} else if (StringUtil::Contains(filename, ".db")) {
+	} else if (StringUtil::EndsWith(filename, ".db")) {
 		return MetadataType::DATABASE;
 	} else {
-		throw InvalidInputException("Unknown file format");
+		return MetadataType::GENERAL;
 	}
 }
 
-idx_t NvmeFileSystem::GetLBA(const string &filename, idx_t nr_bytes, idx_t location, idx_t nr_lbas) {
-	// auto start_time = std::chrono::high_resolution_clock::now();
-	idx_t lba {};
-	MetadataType type = GetMetadataType(filename);
+vector<ExtentRun> NvmeFileSystem::GetLBA(NvmeFileHandle &handle, idx_t nr_bytes, idx_t location, idx_t nr_lbas,
+                                         bool allocate, TemporaryBlockPin &pin) {
+	vector<ExtentRun> runs;
+	MetadataType type = GetMetadataType(handle.path);
+	NvmeTraceSpan span("GetLBA", GetIOCategory(type));
 	DeviceGeometry geo = device->GetDeviceGeometry();
 
 	idx_t lba_location = location / geo.lba_size;
+	// The LBAs touched by the bytes, which can be one more than nr_lbas if the IO starts inside an LBA
+	idx_t touched_lbas =
+	    MaxValue<idx_t>(nr_lbas, ((location % geo.lba_size) + nr_bytes + geo.lba_size - 1) / geo.lba_size);
+
+	if (allocate && handle.database && handle.database->removed.load()) {
+		throw IOException("Cannot write to \"%s\": the database has been removed", handle.path);
+	}
 
 	switch (type) {
 	case MetadataType::WAL:
-		lba = metadata->wal_start + lba_location;
+		runs = handle.database->wal_extents.Map(lba_location, touched_lbas, allocate);
 		break;
 	case MetadataType::TEMPORARY: {
-		lba = temp_meta_manager->GetLBA(filename, location, nr_lbas);
+		optional_idx lba = temp_meta_manager->LocateBlock(handle.path, location, nr_lbas, allocate, pin);
+		if (lba.IsValid()) {
+			runs.push_back(ExtentRun {lba.GetIndex(), nr_lbas, true});
+		}
 	} break;
 	case MetadataType::DATABASE:
-		lba = metadata->db_start + lba_location;
+		runs = handle.database->db_extents.Map(lba_location, touched_lbas, allocate);
 		break;
 	default:
 		throw InvalidInputException("No such metadata type");
 		break;
 	}
 
-	// auto end_time = std::chrono::high_resolution_clock::now();
-	// auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-	// // Print the duration
-	// std::cout << "GetLBA took " << duration.count() << " milliseconds." << std::endl;
-
-	return lba;
+	if (!runs.empty() && runs[0].mapped) {
+		span.SetRange(runs[0].start_lba, touched_lbas);
+	}
+	return runs;
 }
 
-bool NvmeFileSystem::IsLBAInRange(const string &filename, idx_t start_lba, idx_t lba_count) {
+bool NvmeFileSystem::IsLBAInRange(NvmeFileHandle &handle, idx_t start_lba, idx_t lba_count) {
 	DeviceGeometry geo = device->GetDeviceGeometry();
-	MetadataType type = GetMetadataType(filename);
-	idx_t current_start {};
-	idx_t current_end {};
+	MetadataType type = GetMetadataType(handle.path);
+	idx_t max_lba_count {};
 
 	switch (type) {
 	case MetadataType::WAL:
-		current_start = metadata->wal_start;
-		current_end = metadata->tmp_start - 1;
+		max_lba_count = max_wal_size / geo.lba_size;
 		break;
 	case MetadataType::TEMPORARY:
-		current_start = metadata->tmp_start;
-		current_end = geo.lba_count - 1;
-		break;
+		// Temporary blocks are placed by the temporary block manager
+		return true;
 	case MetadataType::DATABASE:
-		current_start = metadata->db_start;
-		current_end = metadata->wal_start - 1;
+		max_lba_count = extent_allocator->GetDataLBACount();
 		break;
 	default:
 		throw InvalidInputException("No such metadata type");
 		break;
 	}
 
-	// Check if the LBA start location is within the range of the metadata range
-	if ((start_lba < current_start || start_lba > current_end)) {
+	// Check that the IO operation does not go beyond the size that the file is allowed to grow to
+	if (start_lba >= max_lba_count || (start_lba + lba_count) > max_lba_count) {
 		return false;
 	}
 
-	// Check that if the lba is in range that we are not going to read or write out of range
-	if ((start_lba + lba_count) > current_end) {
-		return false;
+	return true;
+}
+
+TemporaryCompactionResult NvmeFileSystem::CompactTemporaryFiles() {
+	RequireMetadata();
+	return temp_meta_manager->Compact();
+}
+
+void NvmeFileSystem::RelocateTemporaryBlock(const string &path, idx_t source_lba, idx_t destination_lba,
+                                            idx_t nr_lbas) {
+	DeviceGeometry geo = device->GetDeviceGeometry();
+	idx_t nr_bytes = nr_lbas * geo.lba_size;
+
+	NvmeCmdContext write_context;
+	write_context.filepath = path;
+	write_context.nr_bytes = nr_bytes;
+	write_context.nr_lbas = nr_lbas;
+	write_context.start_lba = destination_lba;
+	write_context.offset = 0;
+	write_context.placement_identifier = placement_policy.GetTemporaryPlacementIdentifier(path);
+	write_context.category = IOCategory::TEMPORARY;
+
+	if (device->Copy(write_context, source_lba)) {
+		return;
 	}
 
-	return true;
+	NvmeCmdContext read_context = write_context;
+	read_context.start_lba = source_lba;
+
+	data_ptr_t buffer = allocator.AllocateData(nr_bytes);
+	DeviceRead(buffer, read_context);
+	DeviceWrite(buffer, write_context);
+	allocator.FreeData(buffer, nr_bytes);
+}
+
+void NvmeFileSystem::SpillTemporaryBlock(const string &path, idx_t block_index, idx_t lba, idx_t nr_lbas) {
+	DeviceGeometry geo = device->GetDeviceGeometry();
+	idx_t nr_bytes = nr_lbas * geo.lba_size;
+
+	NvmeCmdContext read_context;
+	read_context.filepath = path;
+	read_context.nr_bytes = nr_bytes;
+	read_context.nr_lbas = nr_lbas;
+	read_context.start_lba = lba;
+	read_context.offset = 0;
+	read_context.placement_identifier = placement_policy.GetTemporaryPlacementIdentifier(path);
+	read_context.category = IOCategory::TEMPORARY;
+
+	// The spill file holds the block at the same byte location as the temporary file
+	data_ptr_t buffer = allocator.AllocateData(nr_bytes);
+	try {
+		DeviceRead(buffer, read_context);
+		temp_spill->Write(path, buffer, nr_bytes, block_index * nr_bytes);
+	} catch (...) {
+		allocator.FreeData(buffer, nr_bytes);
+		throw;
+	}
+	allocator.FreeData(buffer, nr_bytes);
+}
+
+void NvmeFileSystem::DeviceRead(void *buffer, const CmdContext &context) {
+	auto submit = std::chrono::steady_clock::now();
+	device->Read(buffer, context);
+	idx_t latency_ns =
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - submit).count();
+	io_statistics.RecordIO(context.category, IODirection::READ, context.nr_bytes, latency_ns);
+}
+
+void NvmeFileSystem::DeviceWrite(void *buffer, const CmdContext &context) {
+	auto submit = std::chrono::steady_clock::now();
+	device->Write(buffer, context);
+	idx_t latency_ns =
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - submit).count();
+	io_statistics.RecordIO(context.category, IODirection::WRITE, context.nr_bytes, latency_ns);
 }
 } // namespace duckdb
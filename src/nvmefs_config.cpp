@@ -1,4 +1,7 @@
 #include "nvmefs_config.hpp"
+#include "direct_device.hpp"
+#include "nvmefs_tracer.hpp"
+#include "uring_device.hpp"
 
 #include "duckdb/main/extension_util.hpp"
 
@@ -7,7 +10,7 @@ namespace duckdb {
 const unordered_set<string> NVMEFS_BACKENDS_ASYNC = {
     "io_uring", "io_uring_cmd", "spdk_async", "libaio", "io_ring", "iocp", "iocp_th", "posix", "emu", "thrpool", "nil"};
 
-const unordered_set<string> NVMEFS_BACKENDS_SYNC = {"spdk_sync", "nvme"};
+const unordered_set<string> NVMEFS_BACKENDS_SYNC = {"spdk_sync", "nvme", "psync"};
 
 static unique_ptr<BaseSecret> CreateNvmefsSecretFromConfig(ClientContext &context, CreateSecretInput &input) {
 	auto scope = input.scope;
@@ -26,9 +29,23 @@ static unique_ptr<BaseSecret> CreateNvmefsSecretFromConfig(ClientContext &contex
 	return std::move(config);
 }
 
+static void SetNvmeTracing(ClientContext &context, SetScope scope, Value &parameter) {
+	NvmeTracer::Get().SetEnabled(BooleanValue::Get(parameter));
+}
+
 void SetNvmefsSecretParameters(CreateSecretFunction &function) {
 	function.named_parameters["nvme_device_path"] = LogicalType::VARCHAR;
 	function.named_parameters["backend"] = LogicalType::VARCHAR;
+	function.named_parameters["placement_policy"] = LogicalType::VARCHAR;
+	function.named_parameters["trace_path"] = LogicalType::VARCHAR;
+	function.named_parameters["io_scheduler"] = LogicalType::VARCHAR;
+	function.named_parameters["uring_options"] = LogicalType::VARCHAR;
+	function.named_parameters["stripe_size"] = LogicalType::VARCHAR;
+	function.named_parameters["device_layout"] = LogicalType::VARCHAR;
+	function.named_parameters["hedge_reads"] = LogicalType::VARCHAR;
+	function.named_parameters["wal_device_path"] = LogicalType::VARCHAR;
+	function.named_parameters["temp_device_path"] = LogicalType::VARCHAR;
+	function.named_parameters["temp_spill_directory"] = LogicalType::VARCHAR;
 }
 
 void RegisterCreateNvmefsSecretFunciton(DatabaseInstance &instance) {
@@ -60,6 +77,16 @@ NvmeConfig NvmeConfigManager::LoadConfig(DatabaseInstance &instance) {
 
 	string device;
 	string backend;
+	string placement_policy;
+	string trace_path;
+	string io_scheduler;
+	string uring_options;
+	string stripe_size;
+	string device_layout;
+	string hedge_reads;
+	string wal_device;
+	string temp_device;
+	string temp_spill_directory;
 	// TODO: ensure that we always have value here. It is possible to not have value
 	idx_t max_temp_size = 200ULL << 30; // 200 GiB
 	if (config.options.maximum_swap_space != DConstants::INVALID_INDEX) {
@@ -71,9 +98,51 @@ NvmeConfig NvmeConfigManager::LoadConfig(DatabaseInstance &instance) {
 
 	secret_reader.TryGetSecretKeyOrSetting<string>("nvme_device_path", "nvme_device_path", device);
 	secret_reader.TryGetSecretKeyOrSetting<string>("backend", "backend", backend);
-
-	config.AddExtensionOption("nvme_device_path", "Path to NVMe device", {LogicalType::VARCHAR}, Value(device));
+	secret_reader.TryGetSecretKeyOrSetting<string>("placement_policy", "nvme_placement_policy", placement_policy);
+	secret_reader.TryGetSecretKeyOrSetting<string>("trace_path", "nvme_trace_path", trace_path);
+	secret_reader.TryGetSecretKeyOrSetting<string>("io_scheduler", "nvme_io_scheduler", io_scheduler);
+	secret_reader.TryGetSecretKeyOrSetting<string>("uring_options", "nvme_uring_options", uring_options);
+	secret_reader.TryGetSecretKeyOrSetting<string>("stripe_size", "nvme_stripe_size", stripe_size);
+	secret_reader.TryGetSecretKeyOrSetting<string>("device_layout", "nvme_device_layout", device_layout);
+	secret_reader.TryGetSecretKeyOrSetting<string>("hedge_reads", "nvme_hedge_reads", hedge_reads);
+	secret_reader.TryGetSecretKeyOrSetting<string>("wal_device_path", "nvme_wal_device_path", wal_device);
+	secret_reader.TryGetSecretKeyOrSetting<string>("temp_device_path", "nvme_temp_device_path", temp_device);
+	secret_reader.TryGetSecretKeyOrSetting<string>("temp_spill_directory", "nvme_temp_spill_directory",
+	                                               temp_spill_directory);
+
+	config.AddExtensionOption("nvme_device_path",
+	                          "Path to NVMe device, or comma-separated paths to stripe over or mirror",
+	                          {LogicalType::VARCHAR}, Value(device));
 	config.AddExtensionOption("backend", "xnvme backend used for IO", {LogicalType::VARCHAR}, Value(backend));
+	config.AddExtensionOption("nvme_placement_policy",
+	                          "Placement identifiers of the regions on FDP devices, e.g. 'database=0,wal=1,temporary=2'",
+	                          {LogicalType::VARCHAR}, Value(placement_policy));
+	config.AddExtensionOption("nvme_trace_path", "File that every command sent to the NVMe device is recorded in",
+	                          {LogicalType::VARCHAR}, Value(trace_path));
+	config.AddExtensionOption("nvme_io_scheduler",
+	                          "Depth, weights and rates of the I/O scheduler, e.g. 'depth=8,temporary:rate=200MB'",
+	                          {LogicalType::VARCHAR}, Value(io_scheduler));
+	config.AddExtensionOption("nvme_uring_options",
+	                          "Rings, polling and fixed buffers of the liburing backend, e.g. 'rings=2,sqpoll'",
+	                          {LogicalType::VARCHAR}, Value(uring_options));
+	config.AddExtensionOption("nvme_stripe_size", "Stripe unit when several devices are given, e.g. '1MiB'",
+	                          {LogicalType::VARCHAR}, Value(stripe_size));
+	config.AddExtensionOption("nvme_device_layout", "Whether several devices are striped over or mirrored",
+	                          {LogicalType::VARCHAR}, Value(device_layout));
+	config.AddExtensionOption("nvme_hedge_reads",
+	                          "Latency percentile after which reads of mirrored devices are sent to another device",
+	                          {LogicalType::VARCHAR}, Value(hedge_reads));
+	config.AddExtensionOption("nvme_wal_device_path", "Path to the NVMe device of the WALs, if not the database device",
+	                          {LogicalType::VARCHAR}, Value(wal_device));
+	config.AddExtensionOption("nvme_temp_device_path",
+	                          "Path to the NVMe device of the temporary files, if not the database device",
+	                          {LogicalType::VARCHAR}, Value(temp_device));
+	config.AddExtensionOption("nvme_temp_spill_directory",
+	                          "Local directory that temporary blocks are spilled to once the temporary space is full",
+	                          {LogicalType::VARCHAR}, Value(temp_spill_directory));
+	config.AddExtensionOption("nvme_tracing",
+	                          "Record spans of file system calls and device commands for nvmefs_trace_dump()",
+	                          {LogicalType::BOOLEAN}, Value::BOOLEAN(false), SetNvmeTracing);
 
 	backend = SanatizeBackend(backend);
 
@@ -82,7 +151,17 @@ NvmeConfig NvmeConfigManager::LoadConfig(DatabaseInstance &instance) {
 	                   .async = IsAsynchronousBackend(backend),
 	                   .max_temp_size = max_temp_size,
 	                   .max_wal_size = max_wal_size,
-	                   .max_threads = max_threads};
+	                   .max_threads = max_threads,
+	                   .placement_policy = placement_policy,
+	                   .trace_path = trace_path,
+	                   .io_scheduler = io_scheduler,
+	                   .uring_options = uring_options,
+	                   .stripe_size = stripe_size,
+	                   .device_layout = device_layout,
+	                   .hedge_reads = hedge_reads,
+	                   .wal_device_path = wal_device,
+	                   .temp_device_path = temp_device,
+	                   .temp_spill_directory = temp_spill_directory};
 }
 
 bool NvmeConfigManager::IsAsynchronousBackend(const string &backend) {
@@ -91,6 +170,11 @@ bool NvmeConfigManager::IsAsynchronousBackend(const string &backend) {
 
 string NvmeConfigManager::SanatizeBackend(const string &backend) {
 
+	// The liburing and direct backends bypass xNVMe
+	if (backend == NVMEFS_URING_BACKEND || backend == NVMEFS_DIRECT_BACKEND) {
+		return backend;
+	}
+
 	if (backend.empty() || (NVMEFS_BACKENDS_SYNC.find(backend) == NVMEFS_BACKENDS_SYNC.end() &&
 	                        NVMEFS_BACKENDS_ASYNC.find(backend) == NVMEFS_BACKENDS_ASYNC.end())) {
 		return "nvme";
@@ -0,0 +1,146 @@
+#include "nvmefs_database_catalog.hpp"
+
+namespace duckdb {
+
+NvmeDatabase::NvmeDatabase(NvmeExtentAllocator &allocator, idx_t slot, const string &name)
+    : slot(slot), name(name), db_extents(allocator, GetDatabaseExtentOwner(slot)),
+      wal_extents(allocator, GetWALExtentOwner(slot)), db_location(0), wal_location(0),
+      removed(false) {
+}
+
+DatabaseCatalogEntry NvmeDatabase::GetCatalogEntry() const {
+	DatabaseCatalogEntry entry {};
+
+	entry.in_use = removed.load() ? 0 : 1;
+	entry.db_path_size = name.length();
+	strncpy(entry.db_path, name.data(), NVMEFS_MAX_DATABASE_NAME_LENGTH);
+	entry.db_path[NVMEFS_MAX_DATABASE_NAME_LENGTH] = '\0';
+	entry.db_location = db_location.load();
+	entry.wal_location = wal_location.load();
+
+	return entry;
+}
+
+////////////////////////////////////////
+
+NvmeDatabaseCatalog::NvmeDatabaseCatalog(NvmeExtentAllocator &allocator, idx_t max_databases)
+    : allocator(allocator), max_databases(max_databases), used_slots(max_databases, false) {
+}
+
+string NvmeDatabaseCatalog::GetDatabaseName(const string &filename) {
+	string name = filename;
+	if (StringUtil::StartsWith(name, "nvmefs://")) {
+		name = name.substr(string("nvmefs://").length());
+	}
+
+	// nvmefs://test.db and nvmefs:///test.db refer to the same database
+	idx_t name_start = name.find_first_not_of('/');
+	name = name_start == string::npos ? string() : name.substr(name_start);
+
+	if (StringUtil::EndsWith(name, ".wal")) {
+		name = name.substr(0, name.length() - 4);
+	}
+
+	return name;
+}
+
+shared_ptr<NvmeDatabase> NvmeDatabaseCatalog::GetDatabase(const string &name) {
+	boost::shared_lock<boost::shared_mutex> lock(catalog_mutex);
+
+	auto it = databases.find(name);
+	if (it == databases.end()) {
+		return nullptr;
+	}
+	return it->second;
+}
+
+shared_ptr<NvmeDatabase> NvmeDatabaseCatalog::GetOrCreateDatabase(const string &name, bool &created) {
+	created = false;
+
+	shared_ptr<NvmeDatabase> database = GetDatabase(name);
+	if (database) {
+		return database;
+	}
+
+	if (name.length() > NVMEFS_MAX_DATABASE_NAME_LENGTH) {
+		throw IOException("Database name '%s' is longer than %llu characters", name, NVMEFS_MAX_DATABASE_NAME_LENGTH);
+	}
+
+	boost::unique_lock<boost::shared_mutex> lock(catalog_mutex);
+
+	// Another thread could have created the database while waiting for the lock
+	auto it = databases.find(name);
+	if (it != databases.end()) {
+		return it->second;
+	}
+
+	for (idx_t slot = 0; slot < max_databases; slot++) {
+		if (used_slots[slot]) {
+			continue;
+		}
+
+		// Reclaim extents that a handle of a previously removed database in this slot might have left behind
+		allocator.FreeOwner(GetDatabaseExtentOwner(slot));
+		allocator.FreeOwner(GetWALExtentOwner(slot));
+
+		database = make_shared_ptr<NvmeDatabase>(allocator, slot, name);
+		used_slots[slot] = true;
+		databases[name] = database;
+		created = true;
+		return database;
+	}
+
+	throw IOException("No free database slots left on the device. At most %llu databases are supported",
+	                  max_databases);
+}
+
+void NvmeDatabaseCatalog::LoadDatabase(idx_t slot, const DatabaseCatalogEntry &entry) {
+	boost::unique_lock<boost::shared_mutex> lock(catalog_mutex);
+	D_ASSERT(slot < max_databases && !used_slots[slot]);
+
+	string name(entry.db_path, MinValue<idx_t>(entry.db_path_size, NVMEFS_MAX_DATABASE_NAME_LENGTH));
+	shared_ptr<NvmeDatabase> database = make_shared_ptr<NvmeDatabase>(allocator, slot, name);
+	database->db_location.store(entry.db_location);
+	database->wal_location.store(entry.wal_location);
+	database->db_extents.Load();
+	database->wal_extents.Load();
+
+	used_slots[slot] = true;
+	databases[name] = std::move(database);
+}
+
+shared_ptr<NvmeDatabase> NvmeDatabaseCatalog::RemoveDatabase(const string &name) {
+	boost::unique_lock<boost::shared_mutex> lock(catalog_mutex);
+
+	auto it = databases.find(name);
+	if (it == databases.end()) {
+		return nullptr;
+	}
+
+	shared_ptr<NvmeDatabase> database = it->second;
+	databases.erase(it);
+	database->removed.store(true);
+
+	return database;
+}
+
+void NvmeDatabaseCatalog::ReleaseDatabase(NvmeDatabase &database) {
+	boost::unique_lock<boost::shared_mutex> lock(catalog_mutex);
+	D_ASSERT(database.removed.load() && used_slots[database.slot]);
+
+	database.db_extents.Truncate(0);
+	database.wal_extents.Truncate(0);
+	database.db_location.store(0);
+	database.wal_location.store(0);
+	used_slots[database.slot] = false;
+}
+
+void NvmeDatabaseCatalog::Scan(const std::function<void(NvmeDatabase &)> &callback) {
+	boost::shared_lock<boost::shared_mutex> lock(catalog_mutex);
+
+	for (auto &kv : databases) {
+		callback(*kv.second);
+	}
+}
+
+} // namespace duckdb
@@ -1,11 +1,16 @@
 #define DUCKDB_EXTENSION_MAIN
 
 #include "nvmefs_extension.hpp"
+#include "nvmefs_query_state.hpp"
+#include "nvmefs_tracer.hpp"
+#include "nvmefs_lock_statistics.hpp"
 
 #include "duckdb.hpp"
 #include "duckdb/common/exception.hpp"
 #include "duckdb/common/string_util.hpp"
 #include "duckdb/main/extension_util.hpp"
+#include "duckdb/main/client_context.hpp"
+#include "duckdb/planner/extension_callback.hpp"
 #include "duckdb/main/secret/secret_manager.hpp"
 #include "duckdb/main/settings.hpp"
 
@@ -24,7 +29,10 @@ static void ConfigPrint(ClientContext &context, TableFunctionInput &data_p, Data
 		return;
 	}
 
-	vector<string> settings {"nvme_device_path", "temp_directory", "backend", "worker_threads"};
+	vector<string> settings {"nvme_device_path", "temp_directory", "backend", "nvme_placement_policy",
+	                         "nvme_trace_path", "nvme_io_scheduler", "nvme_uring_options", "nvme_tracing",
+	                         "nvme_stripe_size", "nvme_device_layout", "nvme_hedge_reads", "nvme_wal_device_path",
+	                         "nvme_temp_device_path", "nvme_temp_spill_directory", "worker_threads"};
 	idx_t chunk_count = 0;
 
 	for (string setting : settings) {
@@ -54,7 +62,578 @@ static unique_ptr<FunctionData> ConfigPrintBind(ClientContext &ctx, TableFunctio
 	return std::move(result);
 }
 
-static void AddConfig(DatabaseInstance &instance) {
+/// @brief Gives the table functions access to the file system of the database instance
+struct NvmefsFunctionInfo : public TableFunctionInfo {
+	NvmefsFunctionInfo(optional_ptr<NvmeFileSystem> file_system, shared_ptr<NvmefsQueryTracker> tracker)
+	    : file_system(file_system), tracker(std::move(tracker)) {
+	}
+
+	optional_ptr<NvmeFileSystem> file_system;
+	shared_ptr<NvmefsQueryTracker> tracker;
+};
+
+static NvmeFileSystem &GetFileSystem(TableFunctionBindInput &input) {
+	auto &info = input.info->Cast<NvmefsFunctionInfo>();
+	if (!info.file_system) {
+		throw InvalidInputException("The NvmeFileSystem is not registered, as no nvme_device_path was specified");
+	}
+	return *info.file_system;
+}
+
+/// @brief Attributes the I/O of the queries of every new connection. Connections that were opened before the extension
+/// was loaded, such as the one that loaded it, are registered by nvmefs_last_query_io() instead.
+class NvmefsExtensionCallback : public ExtensionCallback {
+public:
+	NvmefsExtensionCallback(NvmeFileSystem &file_system, shared_ptr<NvmefsQueryTracker> tracker)
+	    : file_system(file_system), tracker(std::move(tracker)) {
+	}
+
+	void OnConnectionOpened(ClientContext &context) override {
+		NvmefsQueryState::Register(context, file_system.GetIOStatistics(), tracker);
+	}
+
+private:
+	NvmeFileSystem &file_system;
+	shared_ptr<NvmefsQueryTracker> tracker;
+};
+
+struct IOStatsFunctionData : public TableFunctionData {
+	vector<IOCategoryStatistics> statistics;
+	idx_t offset = 0;
+};
+
+static Value LatencyPercentileToValue(const IOCategoryStatistics &statistics, IODirection direction,
+                                      double percentile) {
+	optional_idx latency_ns = statistics.GetLatencyPercentile(direction, percentile);
+	if (!latency_ns.IsValid()) {
+		return Value(LogicalType::DOUBLE);
+	}
+	return Value::DOUBLE(static_cast<double>(latency_ns.GetIndex()) / 1000.0);
+}
+
+static Value LatencyHistogramToValue(const IOCategoryStatistics &statistics, IODirection direction) {
+	vector<Value> buckets;
+	for (idx_t bucket = 0; bucket < NVMEFS_LATENCY_BUCKET_COUNT; bucket++) {
+		buckets.push_back(Value::UBIGINT(statistics.latency_histogram[static_cast<idx_t>(direction)][bucket]));
+	}
+	return Value::LIST(LogicalType::UBIGINT, std::move(buckets));
+}
+
+static void IOStats(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<IOStatsFunctionData>();
+
+	idx_t chunk_count = 0;
+	for (; data.offset < data.statistics.size() && chunk_count < STANDARD_VECTOR_SIZE; data.offset++) {
+		const IOCategoryStatistics &statistics = data.statistics[data.offset];
+		const idx_t read = static_cast<idx_t>(IODirection::READ);
+		const idx_t write = static_cast<idx_t>(IODirection::WRITE);
+
+		idx_t column = 0;
+		output.SetValue(column++, chunk_count, Value(IOCategoryToString(statistics.category)));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(statistics.ops[read]));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(statistics.bytes[read]));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(statistics.ops[write]));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(statistics.bytes[write]));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(statistics.read_modify_writes));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(statistics.bounce_copies));
+		for (auto direction : {IODirection::READ, IODirection::WRITE}) {
+			output.SetValue(column++, chunk_count, LatencyPercentileToValue(statistics, direction, 0.5));
+			output.SetValue(column++, chunk_count, LatencyPercentileToValue(statistics, direction, 0.99));
+			output.SetValue(column++, chunk_count, LatencyPercentileToValue(statistics, direction, 0.999));
+			output.SetValue(column++, chunk_count, LatencyHistogramToValue(statistics, direction));
+		}
+		chunk_count++;
+	}
+
+	output.SetCardinality(chunk_count);
+}
+
+static unique_ptr<FunctionData> IOStatsBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                            vector<LogicalType> &return_types, vector<string> &names) {
+	auto result = make_uniq<IOStatsFunctionData>();
+	result->statistics = GetFileSystem(input).GetIOStatistics().GetStatistics();
+
+	names.emplace_back("category");
+	return_types.emplace_back(LogicalType::VARCHAR);
+	for (const string &column : {"read_ops", "read_bytes", "write_ops", "write_bytes", "read_modify_writes",
+	                             "bounce_copies"}) {
+		names.emplace_back(column);
+		return_types.emplace_back(LogicalType::UBIGINT);
+	}
+	// Latencies are in microseconds. Bucket i of a histogram counts the commands that took [2^i, 2^(i+1))
+	// nanoseconds.
+	for (const string &direction : {"read", "write"}) {
+		for (const string &percentile : {"p50", "p99", "p999"}) {
+			names.emplace_back(direction + "_latency_" + percentile + "_us");
+			return_types.emplace_back(LogicalType::DOUBLE);
+		}
+		names.emplace_back(direction + "_latency_histogram");
+		return_types.emplace_back(LogicalType::LIST(LogicalType::UBIGINT));
+	}
+
+	return std::move(result);
+}
+
+struct LastQueryIOFunctionData : public TableFunctionData {
+	vector<IOCategoryStatistics> statistics;
+	bool shared = false;
+	idx_t offset = 0;
+};
+
+static void LastQueryIO(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<LastQueryIOFunctionData>();
+
+	idx_t chunk_count = 0;
+	for (; data.offset < data.statistics.size() && chunk_count < STANDARD_VECTOR_SIZE; data.offset++) {
+		const IOCategoryStatistics &statistics = data.statistics[data.offset];
+
+		idx_t column = 0;
+		output.SetValue(column++, chunk_count, Value(IOCategoryToString(statistics.category)));
+		for (auto direction : {IODirection::READ, IODirection::WRITE}) {
+			idx_t dir = static_cast<idx_t>(direction);
+			output.SetValue(column++, chunk_count, Value::UBIGINT(statistics.ops[dir]));
+			output.SetValue(column++, chunk_count, Value::UBIGINT(statistics.bytes[dir]));
+			double time_ms = static_cast<double>(statistics.latency_ns[dir]) / 1e6;
+			output.SetValue(column++, chunk_count, Value::DOUBLE(time_ms));
+		}
+		output.SetValue(column++, chunk_count, Value::BOOLEAN(data.shared));
+		chunk_count++;
+	}
+
+	output.SetCardinality(chunk_count);
+}
+
+static unique_ptr<FunctionData> LastQueryIOBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                                vector<LogicalType> &return_types, vector<string> &names) {
+	// Connections that were opened before the extension was loaded are attributed from their next query onwards
+	auto &info = input.info->Cast<NvmefsFunctionInfo>();
+	NvmefsQueryState &state = NvmefsQueryState::Register(ctx, GetFileSystem(input).GetIOStatistics(), info.tracker);
+
+	auto result = make_uniq<LastQueryIOFunctionData>();
+	result->statistics = state.GetLastQueryStatistics(result->shared);
+
+	names.emplace_back("category");
+	return_types.emplace_back(LogicalType::VARCHAR);
+	for (const string &direction : {"read", "write"}) {
+		names.emplace_back(direction + "_ops");
+		return_types.emplace_back(LogicalType::UBIGINT);
+		names.emplace_back(direction + "_bytes");
+		return_types.emplace_back(LogicalType::UBIGINT);
+		names.emplace_back(direction + "_time_ms");
+		return_types.emplace_back(LogicalType::DOUBLE);
+	}
+	// True if other queries ran at the same time, whose I/O is included
+	names.emplace_back("shared");
+	return_types.emplace_back(LogicalType::BOOLEAN);
+
+	return std::move(result);
+}
+
+struct IOStatsResetFunctionData : public TableFunctionData {
+	optional_ptr<NvmeFileSystem> file_system;
+	bool finished = false;
+};
+
+static void IOStatsReset(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<IOStatsResetFunctionData>();
+
+	if (data.finished) {
+		return;
+	}
+
+	data.file_system->GetIOStatistics().Reset();
+	output.SetValue(0, 0, Value::BOOLEAN(true));
+	output.SetCardinality(1);
+
+	data.finished = true;
+}
+
+static unique_ptr<FunctionData> IOStatsResetBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                                 vector<LogicalType> &return_types, vector<string> &names) {
+	auto result = make_uniq<IOStatsResetFunctionData>();
+	result->file_system = &GetFileSystem(input);
+
+	names.emplace_back("Success");
+	return_types.emplace_back(LogicalType::BOOLEAN);
+
+	return std::move(result);
+}
+
+struct RegionsFunctionData : public TableFunctionData {
+	vector<NvmeRegionInfo> regions;
+	idx_t offset = 0;
+};
+
+static Value OptionalToValue(optional_idx value) {
+	return value.IsValid() ? Value::UBIGINT(value.GetIndex()) : Value(LogicalType::UBIGINT);
+}
+
+static void Regions(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<RegionsFunctionData>();
+
+	idx_t chunk_count = 0;
+	for (; data.offset < data.regions.size() && chunk_count < STANDARD_VECTOR_SIZE; data.offset++) {
+		const NvmeRegionInfo &region = data.regions[data.offset];
+
+		idx_t column = 0;
+		output.SetValue(column++, chunk_count, Value(region.name));
+		output.SetValue(column++, chunk_count, OptionalToValue(region.start_lba));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(region.lba_count));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(region.used_lbas));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(region.lba_count - region.used_lbas));
+		output.SetValue(column++, chunk_count, OptionalToValue(region.max_lbas));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(region.extent_count));
+		output.SetValue(column++, chunk_count, Value::UBIGINT(region.file_count));
+		chunk_count++;
+	}
+
+	output.SetCardinality(chunk_count);
+}
+
+static unique_ptr<FunctionData> RegionsBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                            vector<LogicalType> &return_types, vector<string> &names) {
+	auto result = make_uniq<RegionsFunctionData>();
+	result->regions = GetFileSystem(input).GetRegions();
+
+	names.emplace_back("region");
+	return_types.emplace_back(LogicalType::VARCHAR);
+	// Only the metadata region has a fixed location, the others consist of extents anywhere on the device
+	for (const string &column :
+	     {"start_lba", "lba_count", "used_lbas", "free_lbas", "max_lbas", "extent_count", "file_count"}) {
+		names.emplace_back(column);
+		return_types.emplace_back(LogicalType::UBIGINT);
+	}
+
+	return std::move(result);
+}
+
+struct DeviceInfoFunctionData : public TableFunctionData {
+	vector<pair<string, string>> info;
+	idx_t offset = 0;
+};
+
+static void DeviceInfo(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<DeviceInfoFunctionData>();
+
+	idx_t chunk_count = 0;
+	for (; data.offset < data.info.size() && chunk_count < STANDARD_VECTOR_SIZE; data.offset++) {
+		output.SetValue(0, chunk_count, Value(data.info[data.offset].first));
+		output.SetValue(1, chunk_count, Value(data.info[data.offset].second));
+		chunk_count++;
+	}
+
+	output.SetCardinality(chunk_count);
+}
+
+static unique_ptr<FunctionData> DeviceInfoBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                               vector<LogicalType> &return_types, vector<string> &names) {
+	auto result = make_uniq<DeviceInfoFunctionData>();
+	result->info = GetFileSystem(input).GetDeviceInfo();
+
+	names.emplace_back("property");
+	return_types.emplace_back(LogicalType::VARCHAR);
+	names.emplace_back("value");
+	return_types.emplace_back(LogicalType::VARCHAR);
+
+	return std::move(result);
+}
+
+struct TempFileInfo {
+	string path;
+	idx_t block_size;
+	idx_t size;
+};
+
+struct TempFilesFunctionData : public TableFunctionData {
+	vector<TempFileInfo> files;
+	idx_t offset = 0;
+};
+
+static void TempFiles(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<TempFilesFunctionData>();
+
+	idx_t chunk_count = 0;
+	for (; data.offset < data.files.size() && chunk_count < STANDARD_VECTOR_SIZE; data.offset++) {
+		const TempFileInfo &file = data.files[data.offset];
+		output.SetValue(0, chunk_count, Value(file.path));
+		output.SetValue(1, chunk_count, Value::UBIGINT(file.block_size));
+		output.SetValue(2, chunk_count, Value::UBIGINT(file.size));
+		chunk_count++;
+	}
+
+	output.SetCardinality(chunk_count);
+}
+
+static unique_ptr<FunctionData> TempFilesBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                              vector<LogicalType> &return_types, vector<string> &names) {
+	auto result = make_uniq<TempFilesFunctionData>();
+	GetFileSystem(input).GetTemporaryFileMetadataManager().Scan(
+	    [&result](const string &path, idx_t block_size, idx_t size) {
+		    result->files.push_back(TempFileInfo {path, block_size, size});
+	    });
+
+	names.emplace_back("path");
+	return_types.emplace_back(LogicalType::VARCHAR);
+	names.emplace_back("block_size");
+	return_types.emplace_back(LogicalType::UBIGINT);
+	names.emplace_back("size");
+	return_types.emplace_back(LogicalType::UBIGINT);
+
+	return std::move(result);
+}
+
+struct TempFragmentationFunctionData : public TableFunctionData {
+	TemporaryFragmentationStatistics statistics;
+	bool finished = false;
+};
+
+static void TempFragmentation(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<TempFragmentationFunctionData>();
+
+	if (data.finished) {
+		return;
+	}
+
+	const TemporaryFragmentationStatistics &statistics = data.statistics;
+	// The share of the free LBAs that lies outside of the largest free block, 0 if all free LBAs are contiguous
+	double fragmentation =
+	    statistics.free_lbas == 0
+	        ? 0
+	        : 1 - static_cast<double>(statistics.largest_free_block) / static_cast<double>(statistics.free_lbas);
+	vector<Value> histogram;
+	for (idx_t free_blocks : statistics.free_block_histogram) {
+		histogram.push_back(Value::UBIGINT(free_blocks));
+	}
+
+	output.SetValue(0, 0, Value::UBIGINT(statistics.range_count));
+	output.SetValue(1, 0, Value::UBIGINT(statistics.managed_lbas));
+	output.SetValue(2, 0, Value::UBIGINT(statistics.free_lbas));
+	output.SetValue(3, 0, Value::UBIGINT(statistics.free_blocks));
+	output.SetValue(4, 0, Value::UBIGINT(statistics.largest_free_block));
+	output.SetValue(5, 0, Value::DOUBLE(fragmentation));
+	output.SetValue(6, 0, Value::LIST(LogicalType::UBIGINT, std::move(histogram)));
+	output.SetCardinality(1);
+
+	data.finished = true;
+}
+
+static unique_ptr<FunctionData> TempFragmentationBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                                      vector<LogicalType> &return_types, vector<string> &names) {
+	auto result = make_uniq<TempFragmentationFunctionData>();
+	result->statistics = GetFileSystem(input).GetTemporaryFileMetadataManager().GetFragmentationStatistics();
+
+	for (const string &column : {"extent_count", "lba_count", "free_lbas", "free_blocks", "largest_free_lbas"}) {
+		names.emplace_back(column);
+		return_types.emplace_back(LogicalType::UBIGINT);
+	}
+	names.emplace_back("fragmentation");
+	return_types.emplace_back(LogicalType::DOUBLE);
+	// Element i counts the free blocks of up to 8 * (i + 1) LBAs, the last element the larger ones
+	names.emplace_back("free_block_histogram");
+	return_types.emplace_back(LogicalType::LIST(LogicalType::UBIGINT));
+
+	return std::move(result);
+}
+
+struct CompactTempFunctionData : public TableFunctionData {
+	optional_ptr<NvmeFileSystem> file_system;
+	bool finished = false;
+};
+
+static void CompactTemp(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<CompactTempFunctionData>();
+
+	if (data.finished) {
+		return;
+	}
+
+	TemporaryCompactionResult result = data.file_system->CompactTemporaryFiles();
+	output.SetValue(0, 0, Value::UBIGINT(result.relocated_blocks));
+	output.SetValue(1, 0, Value::UBIGINT(result.relocated_lbas));
+	output.SetValue(2, 0, Value::UBIGINT(result.skipped_blocks));
+	output.SetValue(3, 0, Value::UBIGINT(result.released_extents));
+	output.SetCardinality(1);
+
+	data.finished = true;
+}
+
+static unique_ptr<FunctionData> CompactTempBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                                vector<LogicalType> &return_types, vector<string> &names) {
+	auto result = make_uniq<CompactTempFunctionData>();
+	result->file_system = &GetFileSystem(input);
+
+	for (const string &column : {"relocated_blocks", "relocated_lbas", "skipped_blocks", "released_extents"}) {
+		names.emplace_back(column);
+		return_types.emplace_back(LogicalType::UBIGINT);
+	}
+
+	return std::move(result);
+}
+
+struct SchedulerStatsFunctionData : public TableFunctionData {
+	NvmeSchedulerPolicy policy;
+	vector<IOClassStatistics> statistics;
+	idx_t offset = 0;
+};
+
+static void SchedulerStats(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<SchedulerStatsFunctionData>();
+
+	idx_t chunk_count = 0;
+	for (; data.offset < data.statistics.size() && chunk_count < STANDARD_VECTOR_SIZE; data.offset++) {
+		const IOClassStatistics &statistics = data.statistics[data.offset];
+		const IOClassPolicy &class_policy = data.policy.GetClassPolicy(statistics.io_class);
+
+		output.SetValue(0, chunk_count, Value(IOClassToString(statistics.io_class)));
+		output.SetValue(1, chunk_count, Value::UBIGINT(class_policy.weight));
+		output.SetValue(2, chunk_count, class_policy.rate > 0 ? Value::UBIGINT(class_policy.rate) : Value());
+		output.SetValue(3, chunk_count, Value::UBIGINT(statistics.commands));
+		output.SetValue(4, chunk_count, Value::UBIGINT(statistics.queued));
+		output.SetValue(5, chunk_count, Value::DOUBLE(static_cast<double>(statistics.wait_ns) / 1e6));
+		output.SetValue(6, chunk_count, Value::DOUBLE(static_cast<double>(statistics.max_wait_ns) / 1e3));
+		chunk_count++;
+	}
+
+	output.SetCardinality(chunk_count);
+}
+
+static unique_ptr<FunctionData> SchedulerStatsBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                                   vector<LogicalType> &return_types, vector<string> &names) {
+	auto result = make_uniq<SchedulerStatsFunctionData>();
+	// Without a configured scheduler the commands go straight to the device, hence there is nothing to report
+	optional_ptr<SchedulingDevice> scheduler = GetFileSystem(input).GetScheduler();
+	if (scheduler) {
+		result->policy = scheduler->GetPolicy();
+		result->statistics = scheduler->GetStatistics();
+	}
+
+	names.emplace_back("class");
+	return_types.emplace_back(LogicalType::VARCHAR);
+	names.emplace_back("weight");
+	return_types.emplace_back(LogicalType::UBIGINT);
+	// Bytes per second, NULL if the class is not limited
+	names.emplace_back("rate");
+	return_types.emplace_back(LogicalType::UBIGINT);
+	names.emplace_back("commands");
+	return_types.emplace_back(LogicalType::UBIGINT);
+	// Commands that could not be sent to the device right away
+	names.emplace_back("queued");
+	return_types.emplace_back(LogicalType::UBIGINT);
+	names.emplace_back("wait_time_ms");
+	return_types.emplace_back(LogicalType::DOUBLE);
+	names.emplace_back("max_wait_us");
+	return_types.emplace_back(LogicalType::DOUBLE);
+
+	return std::move(result);
+}
+
+struct LockStatsFunctionData : public TableFunctionData {
+	vector<LockSiteStatistics> statistics;
+	idx_t offset = 0;
+};
+
+static void LockStats(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<LockStatsFunctionData>();
+
+	idx_t chunk_count = 0;
+	for (; data.offset < data.statistics.size() && chunk_count < STANDARD_VECTOR_SIZE; data.offset++) {
+		const LockSiteStatistics &statistics = data.statistics[data.offset];
+
+		output.SetValue(0, chunk_count, Value(LockSiteToString(statistics.site)));
+		output.SetValue(1, chunk_count, Value::UBIGINT(statistics.acquisitions));
+		output.SetValue(2, chunk_count, Value::UBIGINT(statistics.contended));
+		output.SetValue(3, chunk_count, Value::DOUBLE(static_cast<double>(statistics.wait_ns) / 1e6));
+		output.SetValue(4, chunk_count, Value::DOUBLE(static_cast<double>(statistics.max_wait_ns) / 1e3));
+		chunk_count++;
+	}
+
+	output.SetCardinality(chunk_count);
+}
+
+static unique_ptr<FunctionData> LockStatsBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                              vector<LogicalType> &return_types, vector<string> &names) {
+	auto result = make_uniq<LockStatsFunctionData>();
+	result->statistics = NvmeLockStatistics::Get().GetStatistics();
+
+	names.emplace_back("lock");
+	return_types.emplace_back(LogicalType::VARCHAR);
+	names.emplace_back("acquisitions");
+	return_types.emplace_back(LogicalType::UBIGINT);
+	// Acquisitions that waited for another thread. Compare-and-swap loops count as contended when they retried.
+	names.emplace_back("contended");
+	return_types.emplace_back(LogicalType::UBIGINT);
+	names.emplace_back("wait_time_ms");
+	return_types.emplace_back(LogicalType::DOUBLE);
+	names.emplace_back("max_wait_us");
+	return_types.emplace_back(LogicalType::DOUBLE);
+
+	return std::move(result);
+}
+
+struct LockStatsResetFunctionData : public TableFunctionData {
+	bool finished = false;
+};
+
+static void LockStatsReset(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<LockStatsResetFunctionData>();
+
+	if (data.finished) {
+		return;
+	}
+
+	NvmeLockStatistics::Get().Reset();
+	output.SetValue(0, 0, Value::BOOLEAN(true));
+	output.SetCardinality(1);
+
+	data.finished = true;
+}
+
+static unique_ptr<FunctionData> LockStatsResetBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                                   vector<LogicalType> &return_types, vector<string> &names) {
+	names.emplace_back("Success");
+	return_types.emplace_back(LogicalType::BOOLEAN);
+
+	return make_uniq<LockStatsResetFunctionData>();
+}
+
+struct TraceDumpFunctionData : public TableFunctionData {
+	string path;
+	bool finished = false;
+};
+
+static void TraceDump(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+	auto &data = data_p.bind_data->CastNoConst<TraceDumpFunctionData>();
+
+	if (data.finished) {
+		return;
+	}
+
+	idx_t events = NvmeTracer::Get().WriteChromeTrace(data.path);
+	output.SetValue(0, 0, Value(data.path));
+	output.SetValue(1, 0, Value::UBIGINT(events));
+	output.SetCardinality(1);
+
+	data.finished = true;
+}
+
+static unique_ptr<FunctionData> TraceDumpBind(ClientContext &ctx, TableFunctionBindInput &input,
+                                              vector<LogicalType> &return_types, vector<string> &names) {
+	if (input.inputs[0].IsNull()) {
+		throw InvalidInputException("nvmefs_trace_dump requires the path of the trace file, but the path is NULL");
+	}
+	auto result = make_uniq<TraceDumpFunctionData>();
+	result->path = StringValue::Get(input.inputs[0]);
+
+	names.emplace_back("path");
+	return_types.emplace_back(LogicalType::VARCHAR);
+
+	names.emplace_back("events");
+	return_types.emplace_back(LogicalType::UBIGINT);
+
+	return std::move(result);
+}
+
+static optional_ptr<NvmeFileSystem> AddConfig(DatabaseInstance &instance) {
 
 	DBConfig &config = DBConfig::GetConfig(instance);
 
@@ -65,20 +644,76 @@ static void AddConfig(DatabaseInstance &instance) {
 	if (!nvmeConfig.device_path.empty()) {
 
 		auto &fs = instance.GetFileSystem();
-		fs.RegisterSubSystem(make_uniq<NvmeFileSystem>(nvmeConfig));
+		auto nvme_fs = make_uniq<NvmeFileSystem>(nvmeConfig);
+		optional_ptr<NvmeFileSystem> registered_fs = nvme_fs.get();
+		fs.RegisterSubSystem(std::move(nvme_fs));
+		return registered_fs;
 	} else {
 		duckdb::Printer::Print(
 		    "Nvmefs extension loaded but no nvme_device_path specified. NvmeFileSystem will not be registered.");
 		duckdb::Printer::Print(
 		    "To use the NvmeFileSystem, set the 'nvme_device_path' configuration option to the path of the NVMe device and restart the database.");
 	}
+	return nullptr;
 }
 
 static void LoadInternal(DatabaseInstance &instance) {
-	AddConfig(instance);
+	optional_ptr<NvmeFileSystem> file_system = AddConfig(instance);
+	auto tracker = make_shared_ptr<NvmefsQueryTracker>();
+	auto function_info = make_shared_ptr<NvmefsFunctionInfo>(file_system, tracker);
+	if (file_system) {
+		DBConfig &config = DBConfig::GetConfig(instance);
+		config.extension_callbacks.push_back(make_uniq<NvmefsExtensionCallback>(*file_system, tracker));
+	}
 
 	TableFunction config_print_function("print_config", {}, ConfigPrint, ConfigPrintBind);
 	ExtensionUtil::RegisterFunction(instance, config_print_function);
+
+	TableFunction io_stats_function("nvmefs_io_stats", {}, IOStats, IOStatsBind);
+	io_stats_function.function_info = function_info;
+	ExtensionUtil::RegisterFunction(instance, io_stats_function);
+
+	TableFunction io_stats_reset_function("nvmefs_io_stats_reset", {}, IOStatsReset, IOStatsResetBind);
+	io_stats_reset_function.function_info = function_info;
+	ExtensionUtil::RegisterFunction(instance, io_stats_reset_function);
+
+	TableFunction last_query_io_function("nvmefs_last_query_io", {}, LastQueryIO, LastQueryIOBind);
+	last_query_io_function.function_info = function_info;
+	ExtensionUtil::RegisterFunction(instance, last_query_io_function);
+
+	TableFunction regions_function("nvmefs_regions", {}, Regions, RegionsBind);
+	regions_function.function_info = function_info;
+	ExtensionUtil::RegisterFunction(instance, regions_function);
+
+	TableFunction device_info_function("nvmefs_device_info", {}, DeviceInfo, DeviceInfoBind);
+	device_info_function.function_info = function_info;
+	ExtensionUtil::RegisterFunction(instance, device_info_function);
+
+	TableFunction temp_files_function("nvmefs_temp_files", {}, TempFiles, TempFilesBind);
+	temp_files_function.function_info = function_info;
+	ExtensionUtil::RegisterFunction(instance, temp_files_function);
+
+	TableFunction temp_fragmentation_function("nvmefs_temp_fragmentation", {}, TempFragmentation,
+	                                          TempFragmentationBind);
+	temp_fragmentation_function.function_info = function_info;
+	ExtensionUtil::RegisterFunction(instance, temp_fragmentation_function);
+
+	TableFunction compact_temp_function("nvmefs_compact_temp", {}, CompactTemp, CompactTempBind);
+	compact_temp_function.function_info = function_info;
+	ExtensionUtil::RegisterFunction(instance, compact_temp_function);
+
+	TableFunction scheduler_stats_function("nvmefs_scheduler_stats", {}, SchedulerStats, SchedulerStatsBind);
+	scheduler_stats_function.function_info = function_info;
+	ExtensionUtil::RegisterFunction(instance, scheduler_stats_function);
+
+	TableFunction lock_stats_function("nvmefs_lock_stats", {}, LockStats, LockStatsBind);
+	ExtensionUtil::RegisterFunction(instance, lock_stats_function);
+
+	TableFunction lock_stats_reset_function("nvmefs_lock_stats_reset", {}, LockStatsReset, LockStatsResetBind);
+	ExtensionUtil::RegisterFunction(instance, lock_stats_reset_function);
+
+	TableFunction trace_dump_function("nvmefs_trace_dump", {LogicalType::VARCHAR}, TraceDump, TraceDumpBind);
+	ExtensionUtil::RegisterFunction(instance, trace_dump_function);
 }
 
 void NvmefsExtension::Load(DuckDB &db) {
@@ -0,0 +1,329 @@
+#include "nvmefs_extent_allocator.hpp"
+#include "nvmefs_tracer.hpp"
+
+namespace duckdb {
+
+ExtentPool GetExtentPool(uint32_t owner) {
+	if (owner == NVMEFS_EXTENT_OWNER_TEMPORARY) {
+		return ExtentPool::TEMPORARY;
+	}
+	if (owner >= NVMEFS_EXTENT_OWNER_DATABASE && owner < NVMEFS_EXTENT_OWNER_FILE &&
+	    (owner - NVMEFS_EXTENT_OWNER_DATABASE) % 2 == 1) {
+		return ExtentPool::WAL;
+	}
+	return ExtentPool::DATA;
+}
+
+IOCategory GetExtentOwnerCategory(uint32_t owner) {
+	if (owner == NVMEFS_EXTENT_OWNER_METADATA) {
+		return IOCategory::METADATA;
+	}
+	if (owner == NVMEFS_EXTENT_OWNER_TEMPORARY) {
+		return IOCategory::TEMPORARY;
+	}
+	if (owner >= NVMEFS_EXTENT_OWNER_FILE) {
+		return IOCategory::GENERAL;
+	}
+	return GetExtentPool(owner) == ExtentPool::WAL ? IOCategory::WAL : IOCategory::DATABASE;
+}
+
+NvmeExtentAllocator::NvmeExtentAllocator(idx_t extent_count, idx_t extent_lba_count, idx_t lba_size)
+    : extent_count(extent_count), extent_lba_count(extent_lba_count), lba_size(lba_size),
+      table(extent_count, ExtentEntry {NVMEFS_EXTENT_OWNER_FREE, 0}) {
+	D_ASSERT(extent_count > 0);
+
+	// The first extent holds the global metadata and the extent table
+	table[0].owner = NVMEFS_EXTENT_OWNER_METADATA;
+	for (idx_t i = 1; i < extent_count; i++) {
+		free_extents.insert(i);
+	}
+	for (auto &pool : pool_extents) {
+		pool = make_pair(idx_t(1), extent_count);
+	}
+
+	dirty_table_lbas = vector<bool>(GetTableLBACount(), true);
+}
+
+idx_t NvmeExtentAllocator::CalculateExtentLBACount(idx_t lba_count, idx_t lba_size) {
+	idx_t min_extent_lbas = NVMEFS_MIN_EXTENT_SIZE / lba_size;
+	idx_t count_extent_lbas = (lba_count + NVMEFS_MAX_EXTENT_COUNT - 1) / NVMEFS_MAX_EXTENT_COUNT;
+
+	return MaxValue<idx_t>(min_extent_lbas, count_extent_lbas);
+}
+
+optional_idx NvmeExtentAllocator::TryAllocateExtent(uint32_t owner, uint32_t logical_index, idx_t preferred_extent) {
+	NvmeTraceSpan span("AllocateExtent", GetExtentOwnerCategory(owner));
+	std::lock_guard<std::mutex> lock(allocator_lock);
+
+	// Prefer the extent after the previous extent of the owner, such that files stay contiguous when possible
+	const pair<idx_t, idx_t> &pool = pool_extents[static_cast<uint8_t>(GetExtentPool(owner))];
+	auto it = free_extents.lower_bound(MaxValue<idx_t>(preferred_extent, pool.first));
+	if (it == free_extents.end() || *it >= pool.second) {
+		it = free_extents.lower_bound(pool.first);
+	}
+	if (it == free_extents.end() || *it >= pool.second) {
+		return optional_idx();
+	}
+
+	idx_t extent = *it;
+	free_extents.erase(it);
+	// The new owner writes the extent before reading it, hence a pending deallocation must not destroy its data
+	deallocation_pending.erase(extent);
+
+	table[extent].owner = owner;
+	table[extent].logical_index = logical_index;
+	MarkDirty(extent);
+	span.SetRange(GetExtentStartLBA(extent), GetExtentLBACount());
+
+	return extent;
+}
+
+void NvmeExtentAllocator::SetPoolExtents(ExtentPool pool, idx_t first_extent, idx_t end_extent) {
+	std::lock_guard<std::mutex> lock(allocator_lock);
+	D_ASSERT(first_extent > 0 && first_extent <= end_extent && end_extent <= extent_count);
+	pool_extents[static_cast<uint8_t>(pool)] = make_pair(first_extent, end_extent);
+}
+
+void NvmeExtentAllocator::FreeExtent(idx_t extent) {
+	std::lock_guard<std::mutex> lock(allocator_lock);
+	D_ASSERT(extent > 0 && extent < extent_count);
+
+	table[extent].owner = NVMEFS_EXTENT_OWNER_FREE;
+	table[extent].logical_index = 0;
+	free_extents.insert(extent);
+	deallocation_pending.insert(extent);
+	MarkDirty(extent);
+}
+
+void NvmeExtentAllocator::FreeOwner(uint32_t owner) {
+	std::lock_guard<std::mutex> lock(allocator_lock);
+
+	for (idx_t i = 1; i < extent_count; i++) {
+		if (table[i].owner == owner) {
+			table[i].owner = NVMEFS_EXTENT_OWNER_FREE;
+			table[i].logical_index = 0;
+			free_extents.insert(i);
+			deallocation_pending.insert(i);
+			MarkDirty(i);
+		}
+	}
+}
+
+vector<idx_t> NvmeExtentAllocator::GetOwnedExtents(uint32_t owner) {
+	std::lock_guard<std::mutex> lock(allocator_lock);
+
+	map<idx_t, idx_t> logical_to_extent;
+	for (idx_t i = 1; i < extent_count; i++) {
+		if (table[i].owner == owner) {
+			logical_to_extent[table[i].logical_index] = i;
+		}
+	}
+
+	vector<idx_t> extents;
+	for (const auto &kv : logical_to_extent) {
+		D_ASSERT(kv.first == extents.size());
+		extents.push_back(kv.second);
+	}
+
+	return extents;
+}
+
+idx_t NvmeExtentAllocator::GetFreeExtentCount() {
+	std::lock_guard<std::mutex> lock(allocator_lock);
+	return free_extents.size();
+}
+
+unordered_map<uint32_t, idx_t> NvmeExtentAllocator::GetExtentCountPerOwner() {
+	std::lock_guard<std::mutex> lock(allocator_lock);
+
+	unordered_map<uint32_t, idx_t> counts;
+	for (idx_t i = 1; i < extent_count; i++) {
+		if (table[i].owner != NVMEFS_EXTENT_OWNER_FREE) {
+			counts[table[i].owner]++;
+		}
+	}
+	return counts;
+}
+
+idx_t NvmeExtentAllocator::GetTableLBACount() const {
+	idx_t table_bytes = extent_count * sizeof(ExtentEntry);
+	return (table_bytes + lba_size - 1) / lba_size;
+}
+
+void NvmeExtentAllocator::SerializeTable(data_ptr_t buffer) {
+	std::lock_guard<std::mutex> lock(allocator_lock);
+
+	idx_t table_bytes = extent_count * sizeof(ExtentEntry);
+	memset(buffer, 0, GetTableLBACount() * lba_size);
+	memcpy(buffer, table.data(), table_bytes);
+}
+
+void NvmeExtentAllocator::DeserializeTable(const_data_ptr_t buffer) {
+	std::lock_guard<std::mutex> lock(allocator_lock);
+
+	memcpy(table.data(), buffer, extent_count * sizeof(ExtentEntry));
+
+	free_extents.clear();
+	for (idx_t i = 1; i < extent_count; i++) {
+		if (table[i].owner == NVMEFS_EXTENT_OWNER_FREE) {
+			free_extents.insert(i);
+		}
+	}
+
+	std::fill(dirty_table_lbas.begin(), dirty_table_lbas.end(), false);
+	deallocation_pending.clear();
+}
+
+void NvmeExtentAllocator::DeallocateFreedExtents(const std::function<void(idx_t, idx_t)> &deallocate) {
+	// The pending extents are taken out of the free list while the device deallocates them without the lock, such
+	// that no extent is handed out and written in the meantime
+	set<idx_t> deallocating;
+	{
+		std::lock_guard<std::mutex> lock(allocator_lock);
+		deallocating.swap(deallocation_pending);
+		for (idx_t extent : deallocating) {
+			free_extents.erase(extent);
+		}
+	}
+
+	// Deallocation is a hint, hence the extents are not deallocated again if the device fails
+	auto release = [&]() {
+		std::lock_guard<std::mutex> lock(allocator_lock);
+		for (idx_t extent : deallocating) {
+			if (table[extent].owner == NVMEFS_EXTENT_OWNER_FREE) {
+				free_extents.insert(extent);
+			}
+		}
+	};
+
+	try {
+		auto it = deallocating.begin();
+		while (it != deallocating.end()) {
+			idx_t first_extent = *it;
+			idx_t last_extent = first_extent;
+			for (it++; it != deallocating.end() && *it == last_extent + 1; it++) {
+				last_extent++;
+			}
+			deallocate(GetExtentStartLBA(first_extent), (last_extent - first_extent + 1) * extent_lba_count);
+		}
+	} catch (...) {
+		release();
+		throw;
+	}
+	release();
+}
+
+vector<pair<idx_t, idx_t>> NvmeExtentAllocator::TakeDirtyTableRanges() {
+	std::lock_guard<std::mutex> lock(allocator_lock);
+
+	vector<pair<idx_t, idx_t>> ranges;
+	idx_t i = 0;
+	while (i < dirty_table_lbas.size()) {
+		if (!dirty_table_lbas[i]) {
+			i++;
+			continue;
+		}
+
+		idx_t start = i;
+		while (i < dirty_table_lbas.size() && dirty_table_lbas[i]) {
+			dirty_table_lbas[i] = false;
+			i++;
+		}
+		ranges.emplace_back(start, i - start);
+	}
+
+	return ranges;
+}
+
+void NvmeExtentAllocator::MarkDirty(idx_t extent) {
+	dirty_table_lbas[(extent * sizeof(ExtentEntry)) / lba_size] = true;
+}
+
+////////////////////////////////////////
+
+NvmeExtentMap::NvmeExtentMap(NvmeExtentAllocator &allocator, uint32_t owner) : allocator(allocator), owner(owner) {
+}
+
+void NvmeExtentMap::Load() {
+	boost::unique_lock<boost::shared_mutex> lock(map_mutex);
+	extents = allocator.GetOwnedExtents(owner);
+}
+
+vector<ExtentRun> NvmeExtentMap::Map(idx_t logical_lba, idx_t nr_lbas, bool allocate) {
+	idx_t extent_lbas = allocator.GetExtentLBACount();
+	idx_t last_extent = (logical_lba + nr_lbas - 1) / extent_lbas;
+
+	if (allocate) {
+		// The range is mapped under the same lock that grew the map, such that a concurrent truncate cannot free the
+		// new extents before the runs refer to them
+		boost::unique_lock<boost::shared_mutex> lock(map_mutex);
+		if (last_extent >= extents.size()) {
+			Grow(last_extent + 1 - extents.size());
+		}
+		return MapRuns(logical_lba, nr_lbas);
+	}
+
+	boost::shared_lock<boost::shared_mutex> lock(map_mutex);
+	return MapRuns(logical_lba, nr_lbas);
+}
+
+vector<ExtentRun> NvmeExtentMap::MapRuns(idx_t logical_lba, idx_t nr_lbas) {
+	idx_t extent_lbas = allocator.GetExtentLBACount();
+
+	vector<ExtentRun> runs;
+	idx_t lba = logical_lba;
+	idx_t remaining = nr_lbas;
+	while (remaining > 0) {
+		idx_t extent_index = lba / extent_lbas;
+		idx_t in_extent_offset = lba % extent_lbas;
+		idx_t run_lbas = MinValue<idx_t>(remaining, extent_lbas - in_extent_offset);
+
+		ExtentRun run {0, run_lbas, extent_index < extents.size()};
+		if (run.mapped) {
+			run.start_lba = allocator.GetExtentStartLBA(extents[extent_index]) + in_extent_offset;
+		}
+
+		// Merge runs that are contiguous on the device
+		if (!runs.empty() && runs.back().mapped == run.mapped &&
+		    (!run.mapped || runs.back().start_lba + runs.back().nr_lbas == run.start_lba)) {
+			runs.back().nr_lbas += run.nr_lbas;
+		} else {
+			runs.push_back(run);
+		}
+
+		lba += run_lbas;
+		remaining -= run_lbas;
+	}
+
+	return runs;
+}
+
+void NvmeExtentMap::Truncate(idx_t nr_lbas) {
+	boost::unique_lock<boost::shared_mutex> lock(map_mutex);
+
+	idx_t extent_lbas = allocator.GetExtentLBACount();
+	idx_t required_extents = (nr_lbas + extent_lbas - 1) / extent_lbas;
+
+	while (extents.size() > required_extents) {
+		allocator.FreeExtent(extents.back());
+		extents.pop_back();
+	}
+}
+
+idx_t NvmeExtentMap::GetAllocatedLBACount() {
+	boost::shared_lock<boost::shared_mutex> lock(map_mutex);
+	return extents.size() * allocator.GetExtentLBACount();
+}
+
+void NvmeExtentMap::Grow(idx_t extent_amount) {
+	for (idx_t i = 0; i < extent_amount; i++) {
+		idx_t preferred_extent = extents.empty() ? 1 : extents.back() + 1;
+		optional_idx extent = allocator.TryAllocateExtent(owner, extents.size(), preferred_extent);
+		if (!extent.IsValid()) {
+			throw IOException("No free extents left on the device");
+		}
+		extents.push_back(extent.GetIndex());
+	}
+}
+
+} // namespace duckdb
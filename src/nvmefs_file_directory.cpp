@@ -0,0 +1,216 @@
+#include "nvmefs_file_directory.hpp"
+#include "duckdb/common/set.hpp"
+
+namespace duckdb {
+
+static_assert(sizeof(FileDirectoryEntry) == 256, "Directory entries must evenly divide an LBA");
+
+NvmeFile::NvmeFile(NvmeExtentAllocator &allocator, idx_t slot, const string &name)
+    : slot(slot), name(name), extents(allocator, GetFileExtentOwner(slot)), size(0), dirty(true), removed(false) {
+}
+
+////////////////////////////////////////
+
+NvmeFileDirectory::NvmeFileDirectory(NvmeExtentAllocator &allocator, idx_t max_files, idx_t lba_size)
+    : allocator(allocator), max_files(max_files), lba_size(lba_size), used_slots(max_files, false),
+      dirty_slots(max_files, true) {
+	D_ASSERT(lba_size % sizeof(FileDirectoryEntry) == 0);
+}
+
+string NvmeFileDirectory::GetFileName(const string &path) {
+	string name = path;
+	if (StringUtil::StartsWith(name, "nvmefs://")) {
+		name = name.substr(string("nvmefs://").length());
+	}
+
+	// nvmefs://out.csv and nvmefs:///out.csv refer to the same file
+	idx_t name_start = name.find_first_not_of('/');
+	name = name_start == string::npos ? string() : name.substr(name_start);
+
+	// Directories are given both with and without a trailing slash
+	while (!name.empty() && name.back() == '/') {
+		name.pop_back();
+	}
+
+	return name;
+}
+
+shared_ptr<NvmeFile> NvmeFileDirectory::GetFile(const string &name) {
+	boost::shared_lock<boost::shared_mutex> lock(directory_mutex);
+
+	auto it = files.find(name);
+	if (it == files.end()) {
+		return nullptr;
+	}
+	return it->second;
+}
+
+shared_ptr<NvmeFile> NvmeFileDirectory::GetOrCreateFile(const string &name) {
+	shared_ptr<NvmeFile> file = GetFile(name);
+	if (file) {
+		return file;
+	}
+
+	if (name.empty() || name.length() > NVMEFS_MAX_FILE_NAME_LENGTH) {
+		throw IOException("File name '%s' must be between 1 and %llu characters", name, NVMEFS_MAX_FILE_NAME_LENGTH);
+	}
+
+	boost::unique_lock<boost::shared_mutex> lock(directory_mutex);
+
+	// Another thread could have created the file while waiting for the lock
+	auto it = files.find(name);
+	if (it != files.end()) {
+		return it->second;
+	}
+
+	for (idx_t slot = 0; slot < max_files; slot++) {
+		if (used_slots[slot]) {
+			continue;
+		}
+
+		// Reclaim extents that a previously removed file in this slot might have left behind
+		allocator.FreeOwner(GetFileExtentOwner(slot));
+
+		file = make_shared_ptr<NvmeFile>(allocator, slot, name);
+		used_slots[slot] = true;
+		dirty_slots[slot] = true;
+		files[name] = file;
+		return file;
+	}
+
+	throw IOException("No free file slots left on the device. At most %llu files are supported", max_files);
+}
+
+bool NvmeFileDirectory::RemoveFile(const string &name) {
+	boost::unique_lock<boost::shared_mutex> lock(directory_mutex);
+
+	auto it = files.find(name);
+	if (it == files.end()) {
+		return false;
+	}
+
+	shared_ptr<NvmeFile> file = it->second;
+	files.erase(it);
+
+	file->removed.store(true);
+	file->extents.Truncate(0);
+	used_slots[file->slot] = false;
+	dirty_slots[file->slot] = true;
+
+	return true;
+}
+
+bool NvmeFileDirectory::ListFiles(const string &directory, const std::function<void(const string &, bool)> &callback) {
+	string prefix = directory.empty() ? string() : directory + "/";
+	vector<string> entries;
+	set<string> directories;
+
+	{
+		boost::shared_lock<boost::shared_mutex> lock(directory_mutex);
+
+		// Files are ordered by name, hence all files of the directory are next to each other
+		for (auto it = files.lower_bound(prefix); it != files.end(); it++) {
+			if (!StringUtil::StartsWith(it->first, prefix)) {
+				break;
+			}
+
+			string relative_name = it->first.substr(prefix.length());
+			idx_t separator = relative_name.find('/');
+			if (separator == string::npos) {
+				entries.push_back(relative_name);
+			} else {
+				directories.insert(relative_name.substr(0, separator));
+			}
+		}
+	}
+
+	// The callback is called without holding the lock, such that it can use the file system
+	for (const auto &entry : entries) {
+		callback(entry, false);
+	}
+	for (const auto &entry : directories) {
+		callback(entry, true);
+	}
+
+	return !entries.empty() || !directories.empty();
+}
+
+void NvmeFileDirectory::Scan(const std::function<void(NvmeFile &)> &callback) {
+	boost::shared_lock<boost::shared_mutex> lock(directory_mutex);
+
+	for (auto &kv : files) {
+		callback(*kv.second);
+	}
+}
+
+idx_t NvmeFileDirectory::GetIndexLBACount() const {
+	idx_t index_bytes = max_files * sizeof(FileDirectoryEntry);
+	return (index_bytes + lba_size - 1) / lba_size;
+}
+
+vector<pair<idx_t, idx_t>> NvmeFileDirectory::SerializeDirtyIndex(data_ptr_t buffer) {
+	boost::unique_lock<boost::shared_mutex> lock(directory_mutex);
+
+	memset(buffer, 0, GetIndexLBACount() * lba_size);
+	for (auto &kv : files) {
+		NvmeFile &file = *kv.second;
+
+		FileDirectoryEntry entry {};
+		entry.in_use = 1;
+		entry.size = file.size.load();
+		strncpy(entry.path, file.name.data(), NVMEFS_MAX_FILE_NAME_LENGTH);
+		memcpy(buffer + file.slot * sizeof(FileDirectoryEntry), &entry, sizeof(FileDirectoryEntry));
+
+		if (file.dirty.exchange(false)) {
+			dirty_slots[file.slot] = true;
+		}
+	}
+
+	idx_t entries_per_lba = lba_size / sizeof(FileDirectoryEntry);
+	vector<pair<idx_t, idx_t>> ranges;
+	for (idx_t lba = 0; lba < GetIndexLBACount(); lba++) {
+		bool dirty = false;
+		for (idx_t slot = lba * entries_per_lba; slot < MinValue<idx_t>((lba + 1) * entries_per_lba, max_files);
+		     slot++) {
+			dirty |= dirty_slots[slot];
+			dirty_slots[slot] = false;
+		}
+
+		if (!dirty) {
+			continue;
+		}
+
+		if (!ranges.empty() && ranges.back().first + ranges.back().second == lba) {
+			ranges.back().second++;
+		} else {
+			ranges.emplace_back(lba, 1);
+		}
+	}
+
+	return ranges;
+}
+
+void NvmeFileDirectory::DeserializeIndex(const_data_ptr_t buffer) {
+	boost::unique_lock<boost::shared_mutex> lock(directory_mutex);
+
+	for (idx_t slot = 0; slot < max_files; slot++) {
+		FileDirectoryEntry entry;
+		memcpy(&entry, buffer + slot * sizeof(FileDirectoryEntry), sizeof(FileDirectoryEntry));
+		dirty_slots[slot] = false;
+
+		if (!entry.in_use) {
+			continue;
+		}
+
+		entry.path[NVMEFS_MAX_FILE_NAME_LENGTH] = '\0';
+		shared_ptr<NvmeFile> file = make_shared_ptr<NvmeFile>(allocator, slot, string(entry.path));
+		file->size.store(entry.size);
+		file->dirty.store(false);
+		file->extents.Load();
+
+		used_slots[slot] = true;
+		files[file->name] = file;
+	}
+}
+
+} // namespace duckdb
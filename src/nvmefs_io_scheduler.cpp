@@ -0,0 +1,308 @@
+#include "nvmefs_io_scheduler.hpp"
+
+#include "duckdb/main/config.hpp"
+
+namespace duckdb {
+
+/// Token buckets without an explicit burst hold the bytes of this fraction of a second, but at least 1 MiB
+constexpr idx_t NVMEFS_SCHEDULER_BURST_DIVISOR = 10;
+constexpr idx_t NVMEFS_SCHEDULER_MIN_BURST = 1ULL << 20;
+
+string IOClassToString(IOClass io_class) {
+	switch (io_class) {
+	case IOClass::WAL:
+		return "wal";
+	case IOClass::METADATA:
+		return "metadata";
+	case IOClass::DATABASE_READ:
+		return "database_read";
+	case IOClass::DATABASE_WRITE:
+		return "database_write";
+	case IOClass::TEMPORARY:
+		return "temporary";
+	default:
+		throw InternalException("Unknown I/O class");
+	}
+}
+
+IOClass GetIOClass(IOCategory category, bool write) {
+	switch (category) {
+	case IOCategory::WAL:
+		return IOClass::WAL;
+	case IOCategory::METADATA:
+		return IOClass::METADATA;
+	case IOCategory::TEMPORARY:
+		return IOClass::TEMPORARY;
+	case IOCategory::DATABASE:
+	case IOCategory::GENERAL:
+		return write ? IOClass::DATABASE_WRITE : IOClass::DATABASE_READ;
+	default:
+		throw InternalException("Unknown I/O category");
+	}
+}
+
+NvmeSchedulerPolicy::NvmeSchedulerPolicy() : depth(16) {
+	// Every class gets twice the share of the next less latency sensitive class
+	classes[static_cast<idx_t>(IOClass::WAL)] = IOClassPolicy {16, 0, 0};
+	classes[static_cast<idx_t>(IOClass::METADATA)] = IOClassPolicy {8, 0, 0};
+	classes[static_cast<idx_t>(IOClass::DATABASE_READ)] = IOClassPolicy {4, 0, 0};
+	classes[static_cast<idx_t>(IOClass::DATABASE_WRITE)] = IOClassPolicy {2, 0, 0};
+	classes[static_cast<idx_t>(IOClass::TEMPORARY)] = IOClassPolicy {1, 0, 0};
+}
+
+NvmeSchedulerPolicy NvmeSchedulerPolicy::Parse(const string &policy) {
+	NvmeSchedulerPolicy result;
+	vector<bool> explicit_burst(NVMEFS_IO_CLASS_COUNT, false);
+
+	for (const auto &assignment : StringUtil::Split(policy, ',')) {
+		string trimmed = assignment;
+		StringUtil::Trim(trimmed);
+		if (trimmed.empty()) {
+			continue;
+		}
+
+		vector<string> parts = StringUtil::Split(trimmed, '=');
+		if (parts.size() != 2) {
+			throw InvalidInputException("Invalid scheduler policy entry '%s', expected <setting>=<value>", trimmed);
+		}
+		string key = StringUtil::Lower(parts[0]);
+		StringUtil::Trim(key);
+		string value = parts[1];
+		StringUtil::Trim(value);
+
+		idx_t limit_start = key.find(':');
+		if (limit_start != string::npos) {
+			idx_t class_index = static_cast<idx_t>(ParseClass(key.substr(0, limit_start)));
+			string limit = key.substr(limit_start + 1);
+			idx_t bytes = DBConfig::ParseMemoryLimit(value);
+			if (limit == "rate") {
+				result.classes[class_index].rate = bytes;
+			} else if (limit == "burst") {
+				result.classes[class_index].burst = bytes;
+				explicit_burst[class_index] = true;
+			} else {
+				throw InvalidInputException("Unknown limit '%s' in scheduler policy entry '%s', expected rate or burst",
+				                            limit, trimmed);
+			}
+			continue;
+		}
+
+		// Depths and weights beyond a few thousand are meaningless, which also keeps stoull from overflowing
+		if (value.empty() || value.length() > 6 || value.find_first_not_of("0123456789") != string::npos ||
+		    std::stoull(value) == 0) {
+			throw InvalidInputException("Invalid value '%s' for '%s', expected a positive number", value, key);
+		}
+		if (key == "depth") {
+			result.depth = std::stoull(value);
+		} else {
+			result.classes[static_cast<idx_t>(ParseClass(key))].weight = std::stoull(value);
+		}
+	}
+
+	for (idx_t i = 0; i < NVMEFS_IO_CLASS_COUNT; i++) {
+		IOClassPolicy &class_policy = result.classes[i];
+		if (class_policy.rate > 0 && !explicit_burst[i]) {
+			class_policy.burst =
+			    MaxValue<idx_t>(class_policy.rate / NVMEFS_SCHEDULER_BURST_DIVISOR, NVMEFS_SCHEDULER_MIN_BURST);
+		}
+	}
+
+	return result;
+}
+
+string NvmeSchedulerPolicy::ToString() const {
+	vector<string> settings {"depth=" + std::to_string(depth)};
+	for (idx_t i = 0; i < NVMEFS_IO_CLASS_COUNT; i++) {
+		string name = IOClassToString(static_cast<IOClass>(i));
+		settings.push_back(name + "=" + std::to_string(classes[i].weight));
+		if (classes[i].rate > 0) {
+			settings.push_back(name + ":rate=" + StringUtil::BytesToHumanReadableString(classes[i].rate) + "/s");
+			settings.push_back(name + ":burst=" + StringUtil::BytesToHumanReadableString(classes[i].burst));
+		}
+	}
+	return StringUtil::Join(settings, ",");
+}
+
+IOClass NvmeSchedulerPolicy::ParseClass(const string &name) {
+	for (idx_t i = 0; i < NVMEFS_IO_CLASS_COUNT; i++) {
+		if (name == IOClassToString(static_cast<IOClass>(i))) {
+			return static_cast<IOClass>(i);
+		}
+	}
+	throw InvalidInputException(
+	    "Unknown I/O class '%s', expected wal, metadata, database_read, database_write or temporary", name);
+}
+
+SchedulingDevice::SchedulingDevice(unique_ptr<Device> device, NvmeSchedulerPolicy policy)
+    : device(std::move(device)), policy(policy), in_flight(0), virtual_time(0),
+      last_refill(std::chrono::steady_clock::now()) {
+	for (idx_t i = 0; i < NVMEFS_IO_CLASS_COUNT; i++) {
+		classes[i].tokens = static_cast<double>(policy.GetClassPolicy(static_cast<IOClass>(i)).burst);
+	}
+}
+
+idx_t SchedulingDevice::Write(void *buffer, const CmdContext &context) {
+	Admit(GetIOClass(context.category, true), context.nr_bytes);
+	DispatchedCommand command(*this);
+	return device->Write(buffer, context);
+}
+
+idx_t SchedulingDevice::Read(void *buffer, const CmdContext &context) {
+	Admit(GetIOClass(context.category, false), context.nr_bytes);
+	DispatchedCommand command(*this);
+	return device->Read(buffer, context);
+}
+
+idx_t SchedulingDevice::Deallocate(const CmdContext &context) {
+	return device->Deallocate(context);
+}
+
+bool SchedulingDevice::Copy(const CmdContext &context, idx_t source_lba) {
+	Admit(GetIOClass(context.category, true), context.nr_bytes);
+	DispatchedCommand command(*this);
+	return device->Copy(context, source_lba);
+}
+
+DeviceGeometry SchedulingDevice::GetDeviceGeometry() {
+	return device->GetDeviceGeometry();
+}
+
+void SchedulingDevice::SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) {
+	Device::SetIOStatistics(statistics);
+	device->SetIOStatistics(statistics);
+}
+
+vector<pair<string, string>> SchedulingDevice::GetDeviceInfo() {
+	vector<pair<string, string>> info = device->GetDeviceInfo();
+	info.emplace_back("io_scheduler", policy.ToString());
+	return info;
+}
+
+vector<IOClassStatistics> SchedulingDevice::GetStatistics() {
+	std::lock_guard<std::mutex> guard(scheduler_lock);
+
+	vector<IOClassStatistics> statistics;
+	for (idx_t i = 0; i < NVMEFS_IO_CLASS_COUNT; i++) {
+		const ClassState &state = classes[i];
+		statistics.push_back(IOClassStatistics {static_cast<IOClass>(i), state.commands, state.queued, state.wait_ns,
+		                                        state.max_wait_ns});
+	}
+	return statistics;
+}
+
+idx_t SchedulingDevice::GetQueuedCommandCount() {
+	std::lock_guard<std::mutex> guard(scheduler_lock);
+
+	idx_t queued = 0;
+	for (const auto &state : classes) {
+		queued += state.queue.size();
+	}
+	return queued;
+}
+
+void SchedulingDevice::Admit(IOClass io_class, idx_t nr_bytes) {
+	std::unique_lock<std::mutex> guard(scheduler_lock);
+	ClassState &state = GetClassState(io_class);
+	RefillTokens();
+
+	// A class that starts waiting is served from the current virtual time, and not from whenever it was last served
+	if (state.queue.empty()) {
+		state.pass = MaxValue<double>(state.pass, virtual_time);
+	}
+
+	bool waiting = false;
+	for (const auto &other : classes) {
+		waiting = waiting || !other.queue.empty();
+	}
+	if (!waiting && in_flight < policy.GetDepth() && CanDispatch(io_class)) {
+		ChargeCommand(io_class, nr_bytes);
+		return;
+	}
+
+	auto enqueued = std::chrono::steady_clock::now();
+	QueuedCommand command(io_class, nr_bytes);
+	state.queue.push_back(&command);
+	state.queued++;
+	DispatchCommands();
+
+	// Completions wake the dispatched command, while tokens are earned over time and have to be checked for
+	while (!command.dispatched) {
+		command.ready.wait_for(guard, NVMEFS_SCHEDULER_REFILL_INTERVAL);
+		if (!command.dispatched) {
+			RefillTokens();
+			DispatchCommands();
+		}
+	}
+
+	idx_t wait_ns =
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - enqueued).count();
+	state.wait_ns += wait_ns;
+	state.max_wait_ns = MaxValue<idx_t>(state.max_wait_ns, wait_ns);
+}
+
+void SchedulingDevice::Complete() {
+	std::lock_guard<std::mutex> guard(scheduler_lock);
+	in_flight--;
+	RefillTokens();
+	DispatchCommands();
+}
+
+void SchedulingDevice::DispatchCommands() {
+	while (in_flight < policy.GetDepth()) {
+		optional_idx next_class;
+		for (idx_t i = 0; i < NVMEFS_IO_CLASS_COUNT; i++) {
+			if (classes[i].queue.empty() || !CanDispatch(static_cast<IOClass>(i))) {
+				continue;
+			}
+			// Classes are ordered by priority, hence the more latency sensitive class wins a tie
+			if (!next_class.IsValid() || classes[i].pass < classes[next_class.GetIndex()].pass) {
+				next_class = i;
+			}
+		}
+		if (!next_class.IsValid()) {
+			return;
+		}
+
+		ClassState &state = classes[next_class.GetIndex()];
+		QueuedCommand *command = state.queue.front();
+		state.queue.pop_front();
+		ChargeCommand(command->io_class, command->nr_bytes);
+
+		command->dispatched = true;
+		command->ready.notify_one();
+	}
+}
+
+bool SchedulingDevice::CanDispatch(IOClass io_class) {
+	// A command may overdraw the bucket, such that commands larger than the burst are not stuck forever
+	return policy.GetClassPolicy(io_class).rate == 0 || GetClassState(io_class).tokens > 0;
+}
+
+void SchedulingDevice::ChargeCommand(IOClass io_class, idx_t nr_bytes) {
+	ClassState &state = GetClassState(io_class);
+	const IOClassPolicy &class_policy = policy.GetClassPolicy(io_class);
+
+	in_flight++;
+	state.commands++;
+	virtual_time = state.pass;
+	state.pass += static_cast<double>(MaxValue<idx_t>(nr_bytes, 1)) / static_cast<double>(class_policy.weight);
+	if (class_policy.rate > 0) {
+		state.tokens -= static_cast<double>(nr_bytes);
+	}
+}
+
+void SchedulingDevice::RefillTokens() {
+	auto now = std::chrono::steady_clock::now();
+	double elapsed_seconds = std::chrono::duration<double>(now - last_refill).count();
+	last_refill = now;
+
+	for (idx_t i = 0; i < NVMEFS_IO_CLASS_COUNT; i++) {
+		const IOClassPolicy &class_policy = policy.GetClassPolicy(static_cast<IOClass>(i));
+		if (class_policy.rate > 0) {
+			classes[i].tokens = MinValue<double>(classes[i].tokens + elapsed_seconds * class_policy.rate,
+			                                     static_cast<double>(class_policy.burst));
+		}
+	}
+}
+
+} // namespace duckdb
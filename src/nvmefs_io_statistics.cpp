@@ -0,0 +1,182 @@
+#include "nvmefs_io_statistics.hpp"
+
+namespace duckdb {
+
+static std::atomic<idx_t> statistics_id_counter(0);
+
+optional_idx IOCategoryStatistics::GetLatencyPercentile(IODirection direction, double percentile) const {
+	const idx_t *histogram = latency_histogram[static_cast<idx_t>(direction)];
+	idx_t total = 0;
+	for (idx_t bucket = 0; bucket < NVMEFS_LATENCY_BUCKET_COUNT; bucket++) {
+		total += histogram[bucket];
+	}
+	if (total == 0) {
+		return optional_idx();
+	}
+
+	// The rank of the percentile, counted from one, such that p0 is the first command and p100 the last
+	double rank = MaxValue<double>(1.0, percentile * static_cast<double>(total));
+	idx_t counted = 0;
+	for (idx_t bucket = 0; bucket < NVMEFS_LATENCY_BUCKET_COUNT; bucket++) {
+		if (histogram[bucket] == 0 || static_cast<double>(counted + histogram[bucket]) < rank) {
+			counted += histogram[bucket];
+			continue;
+		}
+
+		idx_t lower = bucket == 0 ? 0 : 1ULL << bucket;
+		idx_t upper = 1ULL << (bucket + 1);
+		double fraction = (rank - static_cast<double>(counted)) / static_cast<double>(histogram[bucket]);
+		return lower + static_cast<idx_t>(fraction * static_cast<double>(upper - lower));
+	}
+	return 1ULL << NVMEFS_LATENCY_BUCKET_COUNT;
+}
+
+NvmeIOStatistics::NvmeIOStatistics() : id(++statistics_id_counter) {
+}
+
+void NvmeIOStatistics::RecordIO(IOCategory category, IODirection direction, idx_t nr_bytes, idx_t latency_ns) {
+	IOCategoryCounters &counters = GetCounters(category);
+	idx_t dir = static_cast<idx_t>(direction);
+
+	counters.ops[dir].fetch_add(1, std::memory_order_relaxed);
+	counters.bytes[dir].fetch_add(nr_bytes, std::memory_order_relaxed);
+	counters.latency_ns[dir].fetch_add(latency_ns, std::memory_order_relaxed);
+	counters.latency_histogram[dir][GetLatencyBucket(latency_ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void NvmeIOStatistics::RecordReadModifyWrite(IOCategory category) {
+	GetCounters(category).read_modify_writes.fetch_add(1, std::memory_order_relaxed);
+}
+
+void NvmeIOStatistics::RecordBounceCopy(IOCategory category) {
+	GetCounters(category).bounce_copies.fetch_add(1, std::memory_order_relaxed);
+}
+
+vector<IOCategoryStatistics> NvmeIOStatistics::GetStatistics() {
+	vector<IOCategoryStatistics> statistics(NVMEFS_IO_CATEGORY_COUNT);
+	for (idx_t category = 0; category < NVMEFS_IO_CATEGORY_COUNT; category++) {
+		statistics[category].category = static_cast<IOCategory>(category);
+	}
+
+	std::lock_guard<std::mutex> lock(threads_lock);
+	for (const auto &thread : threads) {
+		for (idx_t category = 0; category < NVMEFS_IO_CATEGORY_COUNT; category++) {
+			const IOCategoryCounters &counters = thread.second->categories[category];
+			IOCategoryStatistics &result = statistics[category];
+			for (idx_t dir = 0; dir < NVMEFS_IO_DIRECTION_COUNT; dir++) {
+				result.ops[dir] += counters.ops[dir].load(std::memory_order_relaxed);
+				result.bytes[dir] += counters.bytes[dir].load(std::memory_order_relaxed);
+				result.latency_ns[dir] += counters.latency_ns[dir].load(std::memory_order_relaxed);
+				for (idx_t bucket = 0; bucket < NVMEFS_LATENCY_BUCKET_COUNT; bucket++) {
+					result.latency_histogram[dir][bucket] +=
+					    counters.latency_histogram[dir][bucket].load(std::memory_order_relaxed);
+				}
+			}
+			result.read_modify_writes += counters.read_modify_writes.load(std::memory_order_relaxed);
+			result.bounce_copies += counters.bounce_copies.load(std::memory_order_relaxed);
+		}
+	}
+
+	return statistics;
+}
+
+void NvmeIOStatistics::Reset() {
+	std::lock_guard<std::mutex> lock(threads_lock);
+	for (const auto &thread : threads) {
+		for (auto &counters : thread.second->categories) {
+			for (idx_t dir = 0; dir < NVMEFS_IO_DIRECTION_COUNT; dir++) {
+				counters.ops[dir].store(0, std::memory_order_relaxed);
+				counters.bytes[dir].store(0, std::memory_order_relaxed);
+				counters.latency_ns[dir].store(0, std::memory_order_relaxed);
+				for (auto &bucket : counters.latency_histogram[dir]) {
+					bucket.store(0, std::memory_order_relaxed);
+				}
+			}
+			counters.read_modify_writes.store(0, std::memory_order_relaxed);
+			counters.bounce_copies.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+idx_t NvmeIOStatistics::GetLatencyBucket(idx_t latency_ns) {
+	if (latency_ns < 2) {
+		return 0;
+	}
+	idx_t bucket = 63 - __builtin_clzll(latency_ns);
+	return MinValue<idx_t>(bucket, NVMEFS_LATENCY_BUCKET_COUNT - 1);
+}
+
+/// @brief Subtracts a counter of an earlier snapshot, where a counter that was reset in between counts from zero
+static idx_t SubtractCounter(idx_t after, idx_t before) {
+	return after >= before ? after - before : after;
+}
+
+vector<IOCategoryStatistics> NvmeIOStatistics::Subtract(const vector<IOCategoryStatistics> &after,
+                                                        const vector<IOCategoryStatistics> &before) {
+	D_ASSERT(after.size() == before.size());
+	vector<IOCategoryStatistics> result(after);
+	for (idx_t category = 0; category < result.size(); category++) {
+		IOCategoryStatistics &difference = result[category];
+		const IOCategoryStatistics &start = before[category];
+		for (idx_t dir = 0; dir < NVMEFS_IO_DIRECTION_COUNT; dir++) {
+			difference.ops[dir] = SubtractCounter(difference.ops[dir], start.ops[dir]);
+			difference.bytes[dir] = SubtractCounter(difference.bytes[dir], start.bytes[dir]);
+			difference.latency_ns[dir] = SubtractCounter(difference.latency_ns[dir], start.latency_ns[dir]);
+			for (idx_t bucket = 0; bucket < NVMEFS_LATENCY_BUCKET_COUNT; bucket++) {
+				difference.latency_histogram[dir][bucket] =
+				    SubtractCounter(difference.latency_histogram[dir][bucket], start.latency_histogram[dir][bucket]);
+			}
+		}
+		difference.read_modify_writes = SubtractCounter(difference.read_modify_writes, start.read_modify_writes);
+		difference.bounce_copies = SubtractCounter(difference.bounce_copies, start.bounce_copies);
+	}
+	return result;
+}
+
+vector<string> NvmeIOStatistics::Describe(const vector<IOCategoryStatistics> &statistics) {
+	vector<string> lines;
+	for (const auto &category : statistics) {
+		for (auto direction : {IODirection::READ, IODirection::WRITE}) {
+			idx_t dir = static_cast<idx_t>(direction);
+			if (category.ops[dir] == 0) {
+				continue;
+			}
+			lines.push_back(StringUtil::Format("%s %s: %llu ops, %s, %.2f ms", IOCategoryToString(category.category),
+			                                   direction == IODirection::READ ? "read" : "write", category.ops[dir],
+			                                   StringUtil::BytesToHumanReadableString(category.bytes[dir]),
+			                                   static_cast<double>(category.latency_ns[dir]) / 1e6));
+		}
+		if (category.read_modify_writes > 0 || category.bounce_copies > 0) {
+			lines.push_back(StringUtil::Format("%s: %llu rmw, %llu bounce copies",
+			                                   IOCategoryToString(category.category), category.read_modify_writes,
+			                                   category.bounce_copies));
+		}
+	}
+	return lines;
+}
+
+IOCategoryCounters &NvmeIOStatistics::GetCounters(IOCategory category) {
+	// The counters of the statistics that the thread used last are cached, such that counting takes no lock
+	struct CachedCounters {
+		idx_t statistics_id;
+		IOThreadCounters *counters;
+	};
+	static thread_local CachedCounters cached {0, nullptr};
+
+	if (cached.statistics_id != id) {
+		cached.counters = &RegisterThread();
+		cached.statistics_id = id;
+	}
+	return cached.counters->categories[static_cast<idx_t>(category)];
+}
+
+IOThreadCounters &NvmeIOStatistics::RegisterThread() {
+	std::lock_guard<std::mutex> lock(threads_lock);
+	auto &counters = threads[std::this_thread::get_id()];
+	if (!counters) {
+		counters = make_uniq<IOThreadCounters>();
+	}
+	return *counters;
+}
+
+} // namespace duckdb
@@ -0,0 +1,46 @@
+#include "nvmefs_lifetime_estimator.hpp"
+
+namespace duckdb {
+
+NvmeLifetimeEstimator::NvmeLifetimeEstimator(idx_t range_lba_count) : range_lba_count(range_lba_count), epoch(0) {
+	D_ASSERT(range_lba_count > 0);
+}
+
+bool NvmeLifetimeEstimator::RecordWrite(idx_t lba_location, idx_t nr_lbas) {
+	idx_t first_range = lba_location / range_lba_count;
+	idx_t last_range = (lba_location + MaxValue<idx_t>(nr_lbas, 1) - 1) / range_lba_count;
+
+	std::lock_guard<std::mutex> lock(estimator_lock);
+
+	if (last_range >= rewrite_scores.size()) {
+		rewrite_scores.resize(last_range + 1, 0);
+		last_write_epochs.resize(last_range + 1, 0);
+	}
+
+	// A write spanning several ranges is as hot as the hottest of them, such that one write command is never split
+	// across placement handles
+	uint8_t max_score = 0;
+	for (idx_t range = first_range; range <= last_range; range++) {
+		uint32_t age = epoch - last_write_epochs[range];
+		idx_t score = age >= 8 ? 0 : rewrite_scores[range] >> age;
+		score = MinValue<idx_t>(score + NVMEFS_REWRITE_SCORE, NumericLimits<uint8_t>::Maximum());
+
+		rewrite_scores[range] = static_cast<uint8_t>(score);
+		last_write_epochs[range] = epoch;
+		max_score = MaxValue<uint8_t>(max_score, rewrite_scores[range]);
+	}
+
+	return max_score >= NVMEFS_HOT_REWRITE_THRESHOLD;
+}
+
+void NvmeLifetimeEstimator::AdvanceEpoch() {
+	std::lock_guard<std::mutex> lock(estimator_lock);
+	epoch++;
+}
+
+idx_t NvmeLifetimeEstimator::GetEpoch() {
+	std::lock_guard<std::mutex> lock(estimator_lock);
+	return epoch;
+}
+
+} // namespace duckdb
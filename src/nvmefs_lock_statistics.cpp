@@ -0,0 +1,81 @@
+#include "nvmefs_lock_statistics.hpp"
+
+namespace duckdb {
+
+string LockSiteToString(LockSite site) {
+	switch (site) {
+	case LockSite::TEMP_MUTEX:
+		return "temp_mutex";
+	case LockSite::FILE_MUTEX:
+		return "file_mutex";
+	case LockSite::DB_LOCATION:
+		return "db_location";
+	case LockSite::WAL_LOCATION:
+		return "wal_location";
+	case LockSite::DEVICE_QUEUE:
+		return "device_queue";
+	default:
+		throw InternalException("Unknown lock site");
+	}
+}
+
+NvmeLockStatistics &NvmeLockStatistics::Get() {
+	static NvmeLockStatistics statistics;
+	return statistics;
+}
+
+void NvmeLockStatistics::RecordContendedAcquisition(LockSite site, idx_t wait_ns) {
+	LockSiteCounters &counters = GetCounters(site);
+	counters.acquisitions.fetch_add(1, std::memory_order_relaxed);
+	counters.contended.fetch_add(1, std::memory_order_relaxed);
+	counters.wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+	if (wait_ns > counters.max_wait_ns.load(std::memory_order_relaxed)) {
+		counters.max_wait_ns.store(wait_ns, std::memory_order_relaxed);
+	}
+}
+
+vector<LockSiteStatistics> NvmeLockStatistics::GetStatistics() {
+	vector<LockSiteStatistics> statistics(NVMEFS_LOCK_SITE_COUNT);
+	for (idx_t site = 0; site < NVMEFS_LOCK_SITE_COUNT; site++) {
+		statistics[site].site = static_cast<LockSite>(site);
+	}
+
+	std::lock_guard<std::mutex> lock(threads_lock);
+	for (const auto &thread : threads) {
+		for (idx_t site = 0; site < NVMEFS_LOCK_SITE_COUNT; site++) {
+			const LockSiteCounters &counters = thread->sites[site];
+			LockSiteStatistics &result = statistics[site];
+			result.acquisitions += counters.acquisitions.load(std::memory_order_relaxed);
+			result.contended += counters.contended.load(std::memory_order_relaxed);
+			result.wait_ns += counters.wait_ns.load(std::memory_order_relaxed);
+			result.max_wait_ns = MaxValue<idx_t>(result.max_wait_ns, counters.max_wait_ns.load(std::memory_order_relaxed));
+		}
+	}
+
+	return statistics;
+}
+
+void NvmeLockStatistics::Reset() {
+	std::lock_guard<std::mutex> lock(threads_lock);
+	for (const auto &thread : threads) {
+		for (auto &counters : thread->sites) {
+			counters.acquisitions.store(0, std::memory_order_relaxed);
+			counters.contended.store(0, std::memory_order_relaxed);
+			counters.wait_ns.store(0, std::memory_order_relaxed);
+			counters.max_wait_ns.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+LockSiteCounters &NvmeLockStatistics::GetCounters(LockSite site) {
+	// The statistics live as long as the process and never free counters, hence the pointer stays valid
+	static thread_local LockThreadCounters *counters = nullptr;
+	if (!counters) {
+		std::lock_guard<std::mutex> lock(threads_lock);
+		threads.push_back(make_uniq<LockThreadCounters>());
+		counters = threads.back().get();
+	}
+	return counters->sites[static_cast<idx_t>(site)];
+}
+
+} // namespace duckdb
@@ -0,0 +1,143 @@
+#include "nvmefs_placement_policy.hpp"
+
+namespace duckdb {
+
+NvmePlacementPolicy::NvmePlacementPolicy() {
+	// Metadata and general files are rewritten rarely and live as long as the database, hence they share the handle
+	// of the database. Temporary data keeps handle 1 as before, and the WAL gets a handle of its own.
+	region_identifiers[static_cast<idx_t>(PlacementRegion::METADATA)] = 0;
+	region_identifiers[static_cast<idx_t>(PlacementRegion::DATABASE)] = 0;
+	region_identifiers[static_cast<idx_t>(PlacementRegion::WAL)] = 2;
+	region_identifiers[static_cast<idx_t>(PlacementRegion::TEMPORARY)] = 1;
+	region_identifiers[static_cast<idx_t>(PlacementRegion::GENERAL)] = 0;
+}
+
+NvmePlacementPolicy NvmePlacementPolicy::Parse(const string &policy) {
+	NvmePlacementPolicy result;
+
+	for (const auto &assignment : StringUtil::Split(policy, ',')) {
+		string trimmed = assignment;
+		StringUtil::Trim(trimmed);
+		if (trimmed.empty()) {
+			continue;
+		}
+
+		vector<string> parts = StringUtil::Split(trimmed, '=');
+		if (parts.size() != 2) {
+			throw InvalidInputException("Invalid placement policy entry '%s', expected <region>=<identifier>",
+			                            trimmed);
+		}
+		string key = StringUtil::Lower(parts[0]);
+		StringUtil::Trim(key);
+		string value = parts[1];
+		StringUtil::Trim(value);
+
+		if (value.empty() || value.find_first_not_of("0123456789") != string::npos || value.length() > 5) {
+			throw InvalidInputException("Invalid placement identifier '%s' for '%s'", value, key);
+		}
+		idx_t identifier = std::stoull(value);
+
+		idx_t class_start = key.find(':');
+		if (class_start == string::npos) {
+			result.region_identifiers[static_cast<idx_t>(ParseRegion(key))] = identifier;
+			continue;
+		}
+
+		PlacementRegion region = ParseRegion(key.substr(0, class_start));
+		string data_class = key.substr(class_start + 1);
+		if (region == PlacementRegion::DATABASE) {
+			if (data_class != "hot") {
+				throw InvalidInputException("Database blocks can only be separated by 'database:hot', got '%s'", key);
+			}
+			result.hot_database_identifier = identifier;
+		} else if (region == PlacementRegion::TEMPORARY) {
+			if (data_class.empty()) {
+				throw InvalidInputException("Missing size class in placement policy entry '%s'", trimmed);
+			}
+			result.temporary_size_class_identifiers[StringUtil::Upper(data_class)] = identifier;
+		} else {
+			throw InvalidInputException("Only temporary files can be placed per size class, got '%s'", key);
+		}
+	}
+
+	return result;
+}
+
+idx_t NvmePlacementPolicy::GetPlacementIdentifier(PlacementRegion region) const {
+	return region_identifiers[static_cast<idx_t>(region)];
+}
+
+idx_t NvmePlacementPolicy::GetTemporaryPlacementIdentifier(const string &path) const {
+	if (!temporary_size_class_identifiers.empty()) {
+		auto it = temporary_size_class_identifiers.find(GetTemporarySizeClass(path));
+		if (it != temporary_size_class_identifiers.end()) {
+			return it->second;
+		}
+	}
+	return GetPlacementIdentifier(PlacementRegion::TEMPORARY);
+}
+
+string NvmePlacementPolicy::GetTemporarySizeClass(const string &path) {
+	// Temporary files are named duckdb_temp_storage_<size class>-<index>.tmp
+	idx_t size_class_start = path.find_last_of('_');
+	if (size_class_start == string::npos) {
+		return string();
+	}
+	size_class_start++;
+
+	idx_t size_class_end = path.find('-', size_class_start);
+	if (size_class_end == string::npos) {
+		return string();
+	}
+	return path.substr(size_class_start, size_class_end - size_class_start);
+}
+
+string NvmePlacementPolicy::ToString() const {
+	vector<string> assignments;
+	for (idx_t region = 0; region < NVMEFS_PLACEMENT_REGION_COUNT; region++) {
+		assignments.push_back(StringUtil::Format("%s=%llu", GetRegionName(static_cast<PlacementRegion>(region)),
+		                                         region_identifiers[region]));
+	}
+	if (hot_database_identifier.IsValid()) {
+		assignments.push_back(StringUtil::Format("database:hot=%llu", hot_database_identifier.GetIndex()));
+	}
+	for (const auto &kv : temporary_size_class_identifiers) {
+		assignments.push_back(StringUtil::Format("temporary:%s=%llu", kv.first, kv.second));
+	}
+	return StringUtil::Join(assignments, ",");
+}
+
+PlacementRegion NvmePlacementPolicy::ParseRegion(const string &region) {
+	if (region == "metadata") {
+		return PlacementRegion::METADATA;
+	} else if (region == "database" || region == "db") {
+		return PlacementRegion::DATABASE;
+	} else if (region == "wal") {
+		return PlacementRegion::WAL;
+	} else if (region == "temporary" || region == "temp") {
+		return PlacementRegion::TEMPORARY;
+	} else if (region == "general") {
+		return PlacementRegion::GENERAL;
+	}
+	throw InvalidInputException("Unknown placement region '%s'. Expected metadata, database, wal, temporary or general",
+	                            region);
+}
+
+string NvmePlacementPolicy::GetRegionName(PlacementRegion region) {
+	switch (region) {
+	case PlacementRegion::METADATA:
+		return "metadata";
+	case PlacementRegion::DATABASE:
+		return "database";
+	case PlacementRegion::WAL:
+		return "wal";
+	case PlacementRegion::TEMPORARY:
+		return "temporary";
+	case PlacementRegion::GENERAL:
+		return "general";
+	default:
+		throw InternalException("Unknown placement region");
+	}
+}
+
+} // namespace duckdb
@@ -0,0 +1,17 @@
+#include "nvmefs_probes.hpp"
+
+#ifdef NVMEFS_USDT
+// A tracer that attaches to a probe increments its semaphore, such that the probe can tell whether its arguments are
+// needed. The semaphores are placed in the section that the tracers look for them in.
+#define NVMEFS_PROBE_SEMAPHORE(name)                                                                                   \
+	unsigned short nvmefs_##name##_semaphore __attribute__((unused)) __attribute__((section(".probes"))) = 0
+
+extern "C" {
+NVMEFS_PROBE_SEMAPHORE(read);
+NVMEFS_PROBE_SEMAPHORE(write);
+NVMEFS_PROBE_SEMAPHORE(submit);
+NVMEFS_PROBE_SEMAPHORE(complete);
+NVMEFS_PROBE_SEMAPHORE(temp__alloc);
+NVMEFS_PROBE_SEMAPHORE(temp__free);
+}
+#endif
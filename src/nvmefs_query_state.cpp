@@ -0,0 +1,82 @@
+#include "nvmefs_query_state.hpp"
+
+#include "duckdb/main/client_context.hpp"
+#include "duckdb/main/query_profiler.hpp"
+
+namespace duckdb {
+
+NvmefsQueryState::NvmefsQueryState(NvmeIOStatistics &statistics, shared_ptr<NvmefsQueryTracker> tracker)
+    : statistics(statistics), tracker(std::move(tracker)), running(false), started_queries(0),
+      last_query_shared(false) {
+	last_query.resize(NVMEFS_IO_CATEGORY_COUNT);
+}
+
+void NvmefsQueryState::QueryBegin(ClientContext &context) {
+	vector<IOCategoryStatistics> snapshot = statistics.GetStatistics();
+
+	std::lock_guard<std::mutex> lock(state_lock);
+	tracker->running_queries++;
+	started_queries = ++tracker->started_queries;
+	query_start = std::move(snapshot);
+	running = true;
+}
+
+void NvmefsQueryState::QueryEnd(ClientContext &context) {
+	std::lock_guard<std::mutex> lock(state_lock);
+	if (!running) {
+		return;
+	}
+
+	// Done while the query still counts as running, such that a query that overlapped with itself is not shared
+	bool shared = tracker->running_queries.load() > 1 || tracker->started_queries.load() != started_queries;
+	last_query = NvmeIOStatistics::Subtract(statistics.GetStatistics(), query_start);
+	last_query_shared = shared;
+	tracker->running_queries--;
+	running = false;
+}
+
+vector<IOCategoryStatistics> NvmefsQueryState::GetQueryStatistics(bool &shared) {
+	std::lock_guard<std::mutex> lock(state_lock);
+	if (!running) {
+		shared = false;
+		return vector<IOCategoryStatistics>(NVMEFS_IO_CATEGORY_COUNT);
+	}
+
+	shared = tracker->running_queries.load() > 1 || tracker->started_queries.load() != started_queries;
+	return NvmeIOStatistics::Subtract(statistics.GetStatistics(), query_start);
+}
+
+vector<IOCategoryStatistics> NvmefsQueryState::GetLastQueryStatistics(bool &shared) {
+	std::lock_guard<std::mutex> lock(state_lock);
+	shared = last_query_shared;
+	return last_query;
+}
+
+void NvmefsQueryState::WriteProfilingInformation(std::ostream &ss) {
+	bool shared;
+	vector<string> lines = NvmeIOStatistics::Describe(GetQueryStatistics(shared));
+	if (lines.empty()) {
+		lines.push_back("no I/O");
+	}
+	if (shared) {
+		lines.push_back("(includes concurrent queries)");
+	}
+
+	constexpr idx_t TOTAL_BOX_WIDTH = 59;
+	ss << "┌─────────────────────────────────────────────────────────┐\n";
+	ss << "│┌───────────────────────────────────────────────────────┐│\n";
+	ss << "││" + QueryProfiler::DrawPadded("nvmefs I/O Stats", TOTAL_BOX_WIDTH - 4) + "││\n";
+	ss << "││                                                       ││\n";
+	for (const auto &line : lines) {
+		ss << "││" + QueryProfiler::DrawPadded(line, TOTAL_BOX_WIDTH - 4) + "││\n";
+	}
+	ss << "│└───────────────────────────────────────────────────────┘│\n";
+	ss << "└─────────────────────────────────────────────────────────┘\n";
+}
+
+NvmefsQueryState &NvmefsQueryState::Register(ClientContext &context, NvmeIOStatistics &statistics,
+                                             shared_ptr<NvmefsQueryTracker> tracker) {
+	return *context.registered_state->GetOrCreate<NvmefsQueryState>("nvmefs", statistics, std::move(tracker));
+}
+
+} // namespace duckdb
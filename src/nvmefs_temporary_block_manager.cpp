@@ -1,4 +1,7 @@
 #include "nvmefs_temporary_block_manager.hpp"
+#include "nvmefs_tracer.hpp"
+#include "nvmefs_probes.hpp"
+#include "duckdb/common/set.hpp"
 #include <optional>
 
 namespace duckdb {
@@ -23,10 +26,20 @@ idx_t TemporaryBlock::GetEndLBA() {
 	return start_lba + lba_amount - 1;
 }
 
+idx_t TemporaryBlock::GetLBAAmount() {
+	return lba_amount;
+}
+
 bool TemporaryBlock::IsFree() {
 	return is_free;
 }
 
+NvmeTemporaryBlockManager::NvmeTemporaryBlockManager()
+    : blocks(nullptr), allocated_start_lba(0), allocated_end_lba(0) {
+	blocks_free =
+	    vector<TemporaryBlock *>(8, nullptr); // There are 8 different allocation sizes for the TemporaryBufferSize
+}
+
 NvmeTemporaryBlockManager::NvmeTemporaryBlockManager(idx_t allocated_lba_start, idx_t allocated_lba_end)
     : allocated_start_lba(allocated_lba_start), allocated_end_lba(allocated_lba_end) {
 	// Initialize the linked list of free blocks
@@ -36,6 +49,7 @@ NvmeTemporaryBlockManager::NvmeTemporaryBlockManager(idx_t allocated_lba_start,
 
 	blocks_free[7] = blocks.get(); // The largest block is the first one
 	blocks->is_free = true;        // Mark the block as free
+	ranges[allocated_lba_start] = allocated_lba_end - allocated_lba_start;
 }
 
 uint8_t NvmeTemporaryBlockManager::GetFreeListIndex(idx_t lba_amount) {
@@ -62,7 +76,17 @@ uint8_t NvmeTemporaryBlockManager::GetFreeListIndex(idx_t lba_amount) {
 }
 
 TemporaryBlock *NvmeTemporaryBlockManager::AllocateBlock(idx_t lba_amount) {
-	// auto start_time = std::chrono::high_resolution_clock::now();
+	TemporaryBlock *block = TryAllocateBlock(lba_amount);
+
+	if (block == nullptr) {
+		throw std::runtime_error("No free block available");
+	}
+
+	return block;
+}
+
+TemporaryBlock *NvmeTemporaryBlockManager::TryAllocateBlock(idx_t lba_amount) {
+	NvmeTraceSpan span("AllocateBlock", IOCategory::TEMPORARY);
 	// Get the free list index for the given size
 	uint8_t free_list_index = GetFreeListIndex(lba_amount);
 
@@ -71,8 +95,12 @@ TemporaryBlock *NvmeTemporaryBlockManager::AllocateBlock(idx_t lba_amount) {
 	// Get the free block from the free list
 	for (uint8_t i = free_list_index; i < 8; i++) {
 		if (blocks_free[i] != nullptr) {
-			// Get the block from the free list
-			block = PopFreeBlock(i);
+			// Get the block from the free list. Blocks of draining ranges are skipped, which is only needed while the
+			// temporary blocks are compacted.
+			block = draining_ranges.empty() ? PopFreeBlock(i) : TakeFreeBlock(i);
+			if (block == nullptr) {
+				continue;
+			}
 
 			// Check if the block is large enough
 			// Split the block if it is larger than the requested size
@@ -85,16 +113,13 @@ TemporaryBlock *NvmeTemporaryBlockManager::AllocateBlock(idx_t lba_amount) {
 	}
 
 	if (block == nullptr) {
-		throw std::runtime_error("No free block available");
+		return nullptr;
 	}
 
 	// Return the block
 	block->is_free = false; // Mark the block as used
-
-	// auto end_time = std::chrono::high_resolution_clock::now();
-	// auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-	// // Print the duration
-	// printf("AllocateBlock took %d milliseconds.\n", duration.count());
+	span.SetRange(block->GetStartLBA(), block->lba_amount);
+	NVMEFS_PROBE(temp__alloc, block->GetStartLBA(), block->lba_amount);
 
 	return block;
 }
@@ -130,7 +155,7 @@ TemporaryBlock *NvmeTemporaryBlockManager::SplitBlock(TemporaryBlock *block, idx
 	block->lba_amount -= lba_amount;
 
 	// Add the new block to the free list
-	if (new_block->GetStartLBA() != allocated_start_lba) {
+	if (block->previous_block != nullptr) {
 		auto prev = block->previous_block;
 		auto old_block = move(prev->next_block);
 
@@ -150,8 +175,9 @@ TemporaryBlock *NvmeTemporaryBlockManager::SplitBlock(TemporaryBlock *block, idx
 }
 
 void NvmeTemporaryBlockManager::FreeBlock(TemporaryBlock *block) {
-
-	// auto start_time = std::chrono::high_resolution_clock::now();
+	NvmeTraceSpan span("FreeBlock", IOCategory::TEMPORARY);
+	span.SetRange(block->GetStartLBA(), block->lba_amount);
+	NVMEFS_PROBE(temp__free, block->GetStartLBA(), block->lba_amount);
 
 	// Mark the block as free
 	block->is_free = true;
@@ -161,11 +187,6 @@ void NvmeTemporaryBlockManager::FreeBlock(TemporaryBlock *block) {
 
 	// Add the block to the free list
 	PushFreeBlock(block);
-
-	// auto end_time = std::chrono::high_resolution_clock::now();
-	// auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-	// // Print the duration
-	// printf("FreeBlock took %d milliseconds.\n", duration.count());
 }
 
 void NvmeTemporaryBlockManager::PushFreeBlock(TemporaryBlock *block) {
@@ -210,6 +231,18 @@ TemporaryBlock *NvmeTemporaryBlockManager::PopFreeBlock(uint8_t free_list_index)
 	return popped_block;
 }
 
+TemporaryBlock *NvmeTemporaryBlockManager::TakeFreeBlock(uint8_t free_list_index) {
+	for (TemporaryBlock *block = blocks_free[free_list_index]; block != nullptr; block = block->next_free_block) {
+		if (!IsDraining(block)) {
+			RemoveFreeBlock(block);
+			block->is_free = false;
+			return block;
+		}
+	}
+
+	return nullptr;
+}
+
 void NvmeTemporaryBlockManager::RemoveFreeBlock(TemporaryBlock *block) {
 
 	if (block->next_free_block != nullptr) {
@@ -233,8 +266,12 @@ void NvmeTemporaryBlockManager::RemoveFreeBlock(TemporaryBlock *block) {
 
 void NvmeTemporaryBlockManager::CoalesceFreeBlocks(TemporaryBlock *block) {
 	// Check if the previous block is free
-	if ((block->previous_block != nullptr && block->previous_block->IsFree()) &&
-	    (block->next_block != nullptr && block->next_block->IsFree())) {
+	bool merge_left = block->previous_block != nullptr && block->previous_block->IsFree() &&
+	                  CanMerge(block->previous_block, block);
+	bool merge_right =
+	    block->next_block != nullptr && block->next_block->IsFree() && CanMerge(block, block->next_block.get());
+
+	if (merge_left && merge_right) {
 
 		block->start_lba = block->previous_block->start_lba; // Set the start lba to the previous blocks start lba
 		block->lba_amount += block->previous_block->lba_amount + block->next_block->lba_amount;
@@ -267,7 +304,7 @@ void NvmeTemporaryBlockManager::CoalesceFreeBlocks(TemporaryBlock *block) {
 
 		RemoveFreeBlock(old_right_block.get()); // Remove the next block from the free list
 
-	} else if (block->previous_block != nullptr && block->previous_block->IsFree()) {
+	} else if (merge_left) {
 		block->start_lba = block->previous_block->start_lba; // Set the start lba to the previous blocks start lba
 		block->lba_amount += block->previous_block->lba_amount;
 
@@ -286,7 +323,7 @@ void NvmeTemporaryBlockManager::CoalesceFreeBlocks(TemporaryBlock *block) {
 			blocks = move(block->previous_block->next_block);
 			blocks->previous_block = nullptr; // Set the previous block to null
 		}
-	} else if (block->next_block != nullptr && block->next_block->IsFree()) {
+	} else if (merge_right) {
 		block->lba_amount += block->next_block->lba_amount;
 
 		unique_ptr<TemporaryBlock> old_right_block = move(block->next_block);
@@ -301,4 +338,144 @@ void NvmeTemporaryBlockManager::CoalesceFreeBlocks(TemporaryBlock *block) {
 	}
 }
 
+bool NvmeTemporaryBlockManager::CanMerge(TemporaryBlock *left, TemporaryBlock *right) {
+	// Blocks from different ranges are never merged, such that a fully free range can be released again
+	return left->GetEndLBA() + 1 == right->GetStartLBA() && ranges.find(right->GetStartLBA()) == ranges.end();
+}
+
+void NvmeTemporaryBlockManager::AddRange(idx_t start_lba, idx_t lba_amount) {
+	D_ASSERT(lba_amount > 0);
+
+	unique_ptr<TemporaryBlock> new_block = make_uniq<TemporaryBlock>(start_lba, lba_amount);
+	TemporaryBlock *new_block_ptr = new_block.get();
+
+	// Insert the range at the head of the list. The list does not need to be sorted since blocks are only merged
+	// when they are contiguous on the device.
+	if (blocks != nullptr) {
+		blocks->previous_block = new_block_ptr;
+	}
+	new_block->next_block = move(blocks);
+	blocks = move(new_block);
+
+	ranges[start_lba] = lba_amount;
+
+	new_block_ptr->is_free = true;
+	PushFreeBlock(new_block_ptr);
+}
+
+vector<pair<idx_t, idx_t>> NvmeTemporaryBlockManager::ReleaseFreeRanges() {
+	vector<TemporaryBlock *> releasable_blocks;
+
+	// A fully free range is a single free block, so only the free lists that can hold a whole range are searched
+	set<uint8_t> free_list_indexes;
+	for (const auto &range : ranges) {
+		free_list_indexes.insert(GetFreeListIndex(range.second));
+	}
+
+	for (uint8_t free_list_index : free_list_indexes) {
+		for (TemporaryBlock *block = blocks_free[free_list_index]; block != nullptr; block = block->next_free_block) {
+			auto range = ranges.find(block->GetStartLBA());
+			if (range != ranges.end() && range->second == block->lba_amount) {
+				releasable_blocks.push_back(block);
+			}
+		}
+	}
+
+	vector<pair<idx_t, idx_t>> released_ranges;
+	for (TemporaryBlock *block : releasable_blocks) {
+		released_ranges.emplace_back(block->GetStartLBA(), block->lba_amount);
+		ranges.erase(block->GetStartLBA());
+
+		RemoveFreeBlock(block);
+		UnlinkBlock(block);
+	}
+
+	return released_ranges;
+}
+
+idx_t NvmeTemporaryBlockManager::GetManagedLBACount() {
+	idx_t lba_count = 0;
+	for (const auto &range : ranges) {
+		lba_count += range.second;
+	}
+
+	return lba_count;
+}
+
+TemporaryFragmentationStatistics NvmeTemporaryBlockManager::GetFragmentationStatistics() {
+	TemporaryFragmentationStatistics statistics {ranges.size(), GetManagedLBACount(), 0, 0, 0,
+	                                             vector<idx_t>(NVMEFS_TEMP_FREE_SIZE_CLASSES, 0)};
+
+	for (TemporaryBlock *block = blocks.get(); block != nullptr; block = block->next_block.get()) {
+		if (!block->IsFree()) {
+			continue;
+		}
+
+		idx_t size_class = MinValue<idx_t>((block->lba_amount - 1) / 8, NVMEFS_TEMP_FREE_SIZE_CLASSES - 1);
+		statistics.free_block_histogram[size_class]++;
+		statistics.free_lbas += block->lba_amount;
+		statistics.free_blocks++;
+		statistics.largest_free_block = MaxValue<idx_t>(statistics.largest_free_block, block->lba_amount);
+	}
+
+	return statistics;
+}
+
+vector<TemporaryRangeUsage> NvmeTemporaryBlockManager::GetRangeUsage() {
+	map<idx_t, idx_t> used_lbas;
+	for (TemporaryBlock *block = blocks.get(); block != nullptr; block = block->next_block.get()) {
+		if (!block->IsFree()) {
+			used_lbas[GetRangeStart(block)] += block->lba_amount;
+		}
+	}
+
+	vector<TemporaryRangeUsage> usage;
+	for (const auto &range : ranges) {
+		usage.push_back(TemporaryRangeUsage {range.first, range.second, used_lbas[range.first]});
+	}
+
+	return usage;
+}
+
+void NvmeTemporaryBlockManager::SetDrainingRanges(const vector<idx_t> &range_starts) {
+	draining_ranges = set<idx_t>(range_starts.begin(), range_starts.end());
+}
+
+void NvmeTemporaryBlockManager::ClearDrainingRanges() {
+	draining_ranges.clear();
+}
+
+bool NvmeTemporaryBlockManager::IsDraining(TemporaryBlock *block) {
+	return !draining_ranges.empty() && draining_ranges.count(GetRangeStart(block)) > 0;
+}
+
+idx_t NvmeTemporaryBlockManager::GetRangeStart(TemporaryBlock *block) {
+	// Ranges never overlap, hence the range of a block is the last one that starts at or before the block
+	auto range = ranges.upper_bound(block->GetStartLBA());
+	D_ASSERT(range != ranges.begin());
+	return (--range)->first;
+}
+
+unique_ptr<TemporaryBlock> NvmeTemporaryBlockManager::UnlinkBlock(TemporaryBlock *block) {
+	unique_ptr<TemporaryBlock> unlinked_block;
+	TemporaryBlock *prev = block->previous_block;
+
+	if (prev == nullptr) {
+		unlinked_block = move(blocks);
+		blocks = move(unlinked_block->next_block);
+		if (blocks != nullptr) {
+			blocks->previous_block = nullptr;
+		}
+	} else {
+		unlinked_block = move(prev->next_block);
+		prev->next_block = move(unlinked_block->next_block);
+		if (prev->next_block != nullptr) {
+			prev->next_block->previous_block = prev;
+		}
+	}
+
+	unlinked_block->previous_block = nullptr;
+	return unlinked_block;
+}
+
 } // namespace duckdb
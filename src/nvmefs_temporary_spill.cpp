@@ -0,0 +1,66 @@
+#include "nvmefs_temporary_spill.hpp"
+
+namespace duckdb {
+
+NvmeTemporarySpillDirectory::NvmeTemporarySpillDirectory(const string &directory) : directory(directory) {
+	if (!fs.DirectoryExists(directory)) {
+		fs.CreateDirectory(directory);
+	}
+}
+
+void NvmeTemporarySpillDirectory::Read(const string &path, void *buffer, idx_t nr_bytes, idx_t location) {
+	fs.Read(*GetHandle(path, false), buffer, nr_bytes, location);
+}
+
+void NvmeTemporarySpillDirectory::Write(const string &path, void *buffer, idx_t nr_bytes, idx_t location) {
+	fs.Write(*GetHandle(path, true), buffer, nr_bytes, location);
+}
+
+void NvmeTemporarySpillDirectory::DeleteFile(const string &path) {
+	std::lock_guard<std::mutex> lock(handles_lock);
+
+	auto entry = handles.find(path);
+	if (entry == handles.end()) {
+		return;
+	}
+	handles.erase(entry);
+	fs.RemoveFile(GetSpillPath(path));
+}
+
+void NvmeTemporarySpillDirectory::Clear() {
+	std::lock_guard<std::mutex> lock(handles_lock);
+
+	for (auto &entry : handles) {
+		entry.second.reset();
+		fs.RemoveFile(GetSpillPath(entry.first));
+	}
+	handles.clear();
+}
+
+optional_idx NvmeTemporarySpillDirectory::GetAvailableSpace() {
+	return fs.GetAvailableDiskSpace(directory);
+}
+
+shared_ptr<FileHandle> NvmeTemporarySpillDirectory::GetHandle(const string &path, bool create) {
+	std::lock_guard<std::mutex> lock(handles_lock);
+
+	auto entry = handles.find(path);
+	if (entry != handles.end()) {
+		return entry->second;
+	}
+	if (!create) {
+		throw IOException("Temporary file \"%s\" has no spilled blocks", path);
+	}
+
+	// Spill files of an earlier run are stale, as the temporary files do not survive a restart
+	auto flags = FileFlags::FILE_FLAGS_READ | FileFlags::FILE_FLAGS_WRITE | FileFlags::FILE_FLAGS_FILE_CREATE_NEW;
+	shared_ptr<FileHandle> handle = fs.OpenFile(GetSpillPath(path), flags);
+	handles[path] = handle;
+	return handle;
+}
+
+string NvmeTemporarySpillDirectory::GetSpillPath(const string &path) {
+	return fs.JoinPath(directory, FileSystem::ExtractName(path));
+}
+
+} // namespace duckdb
@@ -0,0 +1,98 @@
+#include "nvmefs_tracer.hpp"
+
+#include <algorithm>
+
+namespace duckdb {
+
+NvmeTracer::NvmeTracer() : enabled(false), epoch(std::chrono::steady_clock::now()) {
+}
+
+NvmeTracer &NvmeTracer::Get() {
+	static NvmeTracer tracer;
+	return tracer;
+}
+
+void NvmeTracer::SetEnabled(bool enabled) {
+	this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t NvmeTracer::Now() const {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void NvmeTracer::Record(const NvmeTraceEvent &event) {
+	NvmeTraceRing &ring = GetThreadRing();
+	uint64_t head = ring.head.load(std::memory_order_relaxed);
+	ring.events[head & (NVMEFS_TRACE_RING_SIZE - 1)] = event;
+	ring.head.store(head + 1, std::memory_order_release);
+}
+
+NvmeTraceRing &NvmeTracer::GetThreadRing() {
+	// The tracer lives as long as the process and never frees a ring, hence the pointer stays valid
+	static thread_local NvmeTraceRing *ring = nullptr;
+	if (!ring) {
+		std::lock_guard<std::mutex> lock(rings_lock);
+		rings.push_back(make_uniq<NvmeTraceRing>(rings.size() + 1));
+		ring = rings.back().get();
+	}
+	return *ring;
+}
+
+vector<pair<idx_t, NvmeTraceEvent>> NvmeTracer::TakeEvents() {
+	vector<pair<idx_t, NvmeTraceEvent>> result;
+
+	std::lock_guard<std::mutex> lock(rings_lock);
+	for (auto &ring : rings) {
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+		uint64_t start = head > NVMEFS_TRACE_RING_SIZE ? MaxValue(ring->tail, head - NVMEFS_TRACE_RING_SIZE) : ring->tail;
+
+		vector<NvmeTraceEvent> events;
+		for (uint64_t i = start; i < head; i++) {
+			events.push_back(ring->events[i & (NVMEFS_TRACE_RING_SIZE - 1)]);
+		}
+
+		// The thread keeps recording while its events are copied. Copies of slots that it has reused since are torn.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t reused = ring->head.load(std::memory_order_relaxed);
+		uint64_t valid = reused > NVMEFS_TRACE_RING_SIZE ? reused - NVMEFS_TRACE_RING_SIZE : 0;
+		for (uint64_t i = MaxValue(start, valid); i < head; i++) {
+			result.emplace_back(ring->thread_index, events[i - start]);
+		}
+		ring->tail = head;
+	}
+
+	std::sort(result.begin(), result.end(),
+	          [](const pair<idx_t, NvmeTraceEvent> &left, const pair<idx_t, NvmeTraceEvent> &right) {
+		          return left.second.start_ns < right.second.start_ns;
+	          });
+	return result;
+}
+
+idx_t NvmeTracer::WriteChromeTrace(const string &path) {
+	FILE *trace_file = fopen(path.c_str(), "w");
+	if (!trace_file) {
+		throw IOException("Unable to open the trace file '%s' for writing", path);
+	}
+
+	auto events = TakeEvents();
+	fprintf(trace_file, "{\"traceEvents\":[\n");
+	for (idx_t i = 0; i < events.size(); i++) {
+		const NvmeTraceEvent &event = events[i].second;
+		// Chrome expects microseconds, fractions keep the nanosecond resolution
+		fprintf(trace_file,
+		        "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%llu,"
+		        "\"args\":{\"lba\":%llu,\"lbas\":%llu}}",
+		        i == 0 ? "" : ",\n", event.name, IOCategoryToString(event.category).c_str(),
+		        static_cast<double>(event.start_ns) / 1e3, static_cast<double>(event.duration_ns) / 1e3,
+		        static_cast<unsigned long long>(events[i].first), static_cast<unsigned long long>(event.lba),
+		        static_cast<unsigned long long>(event.nr_lbas));
+	}
+	fprintf(trace_file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+	if (fclose(trace_file) != 0) {
+		throw IOException("Unable to write the trace file '%s'", path);
+	}
+	return events.size();
+}
+
+} // namespace duckdb
@@ -0,0 +1,182 @@
+#include "recording_device.hpp"
+
+namespace duckdb {
+
+static_assert(sizeof(IOTraceRecord) == 32, "Trace records are stored as is, hence their layout must not change");
+
+RecordingDevice::RecordingDevice(unique_ptr<Device> device, const string &trace_path)
+    : device(std::move(device)), trace_path(trace_path), start(std::chrono::steady_clock::now()),
+      recorded_commands(0), thread_counter(0) {
+	trace_file = fopen(trace_path.c_str(), "wb");
+	if (!trace_file) {
+		throw IOException("Could not open trace file %s", trace_path);
+	}
+
+	DeviceGeometry geo = this->device->GetDeviceGeometry();
+	IOTraceHeader header {};
+	memcpy(header.magic, NVMEFS_TRACE_MAGIC_BYTES, sizeof(header.magic));
+	header.version = NVMEFS_TRACE_VERSION;
+	header.lba_size = static_cast<uint32_t>(geo.lba_size);
+	header.lba_count = geo.lba_count;
+	if (fwrite(&header, sizeof(header), 1, trace_file) != 1) {
+		fclose(trace_file);
+		throw IOException("Could not write header of trace file %s", trace_path);
+	}
+
+	buffer.reserve(NVMEFS_TRACE_BUFFER_RECORDS);
+}
+
+RecordingDevice::~RecordingDevice() {
+	try {
+		Close();
+	} catch (std::exception &ex) {
+		Printer::Print(ex.what());
+	}
+}
+
+idx_t RecordingDevice::Write(void *buffer, const CmdContext &context) {
+	auto submit = std::chrono::steady_clock::now();
+	idx_t written = device->Write(buffer, context);
+	Record(IOTraceOperation::WRITE, context, submit, std::chrono::steady_clock::now());
+	return written;
+}
+
+idx_t RecordingDevice::Read(void *buffer, const CmdContext &context) {
+	auto submit = std::chrono::steady_clock::now();
+	idx_t read = device->Read(buffer, context);
+	Record(IOTraceOperation::READ, context, submit, std::chrono::steady_clock::now());
+	return read;
+}
+
+idx_t RecordingDevice::Deallocate(const CmdContext &context) {
+	auto submit = std::chrono::steady_clock::now();
+	idx_t deallocated = device->Deallocate(context);
+	Record(IOTraceOperation::DEALLOCATE, context, submit, std::chrono::steady_clock::now());
+	return deallocated;
+}
+
+DeviceGeometry RecordingDevice::GetDeviceGeometry() {
+	return device->GetDeviceGeometry();
+}
+
+vector<pair<string, string>> RecordingDevice::GetDeviceInfo() {
+	vector<pair<string, string>> info = device->GetDeviceInfo();
+	info.emplace_back("trace_path", trace_path);
+	return info;
+}
+
+void RecordingDevice::SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) {
+	device->SetIOStatistics(statistics);
+}
+
+void RecordingDevice::Flush() {
+	std::lock_guard<std::mutex> lock(trace_lock);
+	if (!trace_file) {
+		return;
+	}
+	FlushBuffer();
+	fflush(trace_file);
+}
+
+void RecordingDevice::Close() {
+	std::lock_guard<std::mutex> lock(trace_lock);
+	if (!trace_file) {
+		return;
+	}
+
+	// The file is closed even if the last records cannot be written, such that closing never leaks it
+	FILE *file = trace_file;
+	trace_file = nullptr;
+	bool written = true;
+	if (!buffer.empty()) {
+		written = fwrite(buffer.data(), sizeof(IOTraceRecord), buffer.size(), file) == buffer.size();
+		buffer.clear();
+	}
+	if (fclose(file) != 0 || !written) {
+		throw IOException("Could not write to trace file %s", trace_path);
+	}
+}
+
+idx_t RecordingDevice::GetRecordedCommands() {
+	std::lock_guard<std::mutex> lock(trace_lock);
+	return recorded_commands;
+}
+
+void RecordingDevice::Record(IOTraceOperation operation, const CmdContext &context,
+                             std::chrono::steady_clock::time_point submit,
+                             std::chrono::steady_clock::time_point complete) {
+	IOTraceRecord record {};
+	record.submit_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(submit - start).count();
+	record.start_lba = context.start_lba;
+	record.nr_lbas = static_cast<uint32_t>(context.nr_lbas);
+	idx_t latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(complete - submit).count();
+	record.latency_ns = static_cast<uint32_t>(MinValue<idx_t>(latency_ns, NumericLimits<uint32_t>::Maximum()));
+	record.thread = GetThreadIndex();
+	record.category = context.category;
+	record.operation = operation;
+	record.placement_identifier = static_cast<uint16_t>(context.placement_identifier);
+
+	std::lock_guard<std::mutex> lock(trace_lock);
+	if (!trace_file) {
+		return;
+	}
+	buffer.push_back(record);
+	recorded_commands++;
+	if (buffer.size() == NVMEFS_TRACE_BUFFER_RECORDS) {
+		FlushBuffer();
+	}
+}
+
+uint16_t RecordingDevice::GetThreadIndex() {
+	// Threads are numbered per device, such that the numbers of a trace start at zero
+	struct ThreadIndex {
+		const RecordingDevice *device;
+		uint16_t index;
+	};
+	static thread_local ThreadIndex thread_index {nullptr, 0};
+
+	if (thread_index.device != this) {
+		thread_index.device = this;
+		thread_index.index = thread_counter++;
+	}
+	return thread_index.index;
+}
+
+void RecordingDevice::FlushBuffer() {
+	if (buffer.empty()) {
+		return;
+	}
+	if (fwrite(buffer.data(), sizeof(IOTraceRecord), buffer.size(), trace_file) != buffer.size()) {
+		throw IOException("Could not write to trace file %s", trace_path);
+	}
+	buffer.clear();
+}
+
+vector<IOTraceRecord> ReadIOTrace(const string &trace_path, IOTraceHeader &header) {
+	FILE *trace_file = fopen(trace_path.c_str(), "rb");
+	if (!trace_file) {
+		throw IOException("Could not open trace file %s", trace_path);
+	}
+
+	if (fread(&header, sizeof(header), 1, trace_file) != 1 ||
+	    memcmp(header.magic, NVMEFS_TRACE_MAGIC_BYTES, sizeof(header.magic)) != 0) {
+		fclose(trace_file);
+		throw IOException("%s is not an nvmefs trace file", trace_path);
+	}
+	if (header.version != NVMEFS_TRACE_VERSION) {
+		fclose(trace_file);
+		throw IOException("Trace file %s has unsupported version %llu", trace_path, header.version);
+	}
+
+	vector<IOTraceRecord> records;
+	vector<IOTraceRecord> chunk(NVMEFS_TRACE_BUFFER_RECORDS);
+	idx_t nr_read;
+	while ((nr_read = fread(chunk.data(), sizeof(IOTraceRecord), chunk.size(), trace_file)) > 0) {
+		records.insert(records.end(), chunk.begin(), chunk.begin() + nr_read);
+	}
+	fclose(trace_file);
+
+	return records;
+}
+
+} // namespace duckdb
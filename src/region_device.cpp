@@ -0,0 +1,152 @@
+#include "region_device.hpp"
+
+namespace duckdb {
+
+RegionDevice::RegionDevice(unique_ptr<Device> database_device, unique_ptr<Device> wal_device,
+                           unique_ptr<Device> temporary_device) {
+	D_ASSERT(database_device);
+	geometry = DeviceGeometry {database_device->GetDeviceGeometry().lba_size, 0};
+
+	auto add_member = [&](IOCategory category, unique_ptr<Device> device) {
+		if (!device) {
+			return;
+		}
+		DeviceGeometry member_geometry = device->GetDeviceGeometry();
+		if (member_geometry.lba_size != geometry.lba_size) {
+			throw InvalidInputException(
+			    "The %s device has LBAs of %llu bytes, while the database device has LBAs of %llu bytes",
+			    IOCategoryToString(category), member_geometry.lba_size, geometry.lba_size);
+		}
+		DeviceRegion region {category, geometry.lba_count, member_geometry.lba_count, device->GetDescription()};
+		members.push_back(RegionMember {region, std::move(device)});
+		geometry.lba_count += member_geometry.lba_count;
+	};
+
+	// The database device comes first, as the global metadata is stored at the start of the device
+	add_member(IOCategory::DATABASE, std::move(database_device));
+	add_member(IOCategory::WAL, std::move(wal_device));
+	add_member(IOCategory::TEMPORARY, std::move(temporary_device));
+}
+
+idx_t RegionDevice::Write(void *buffer, const CmdContext &context) {
+	data_ptr_t data = static_cast<data_ptr_t>(buffer);
+	Route(context, [data](Device &device, const CmdContext &member_context, idx_t buffer_offset) {
+		device.Write(data + buffer_offset, member_context);
+	});
+	return context.nr_lbas;
+}
+
+idx_t RegionDevice::Read(void *buffer, const CmdContext &context) {
+	data_ptr_t data = static_cast<data_ptr_t>(buffer);
+	Route(context, [data](Device &device, const CmdContext &member_context, idx_t buffer_offset) {
+		device.Read(data + buffer_offset, member_context);
+	});
+	return context.nr_lbas;
+}
+
+idx_t RegionDevice::Deallocate(const CmdContext &context) {
+	// Extents that straddle two regions are freed as a whole, hence deallocations may span several devices
+	NvmeCmdContext whole_lbas;
+	static_cast<CmdContext &>(whole_lbas) = context;
+	whole_lbas.offset = 0;
+	whole_lbas.nr_bytes = context.nr_lbas * geometry.lba_size;
+	Route(whole_lbas, [](Device &device, const CmdContext &member_context, idx_t buffer_offset) {
+		device.Deallocate(member_context);
+	});
+	return context.nr_lbas;
+}
+
+bool RegionDevice::Copy(const CmdContext &context, idx_t source_lba) {
+	RegionMember &destination = FindMember(context.start_lba);
+	RegionMember &source = FindMember(source_lba);
+	const DeviceRegion &region = destination.region;
+	if (&destination != &source || context.start_lba + context.nr_lbas > region.start_lba + region.lba_count ||
+	    source_lba + context.nr_lbas > region.start_lba + region.lba_count) {
+		return false;
+	}
+
+	NvmeCmdContext member_context;
+	static_cast<CmdContext &>(member_context) = context;
+	member_context.start_lba -= region.start_lba;
+	return destination.device->Copy(member_context, source_lba - region.start_lba);
+}
+
+DeviceGeometry RegionDevice::GetDeviceGeometry() {
+	return geometry;
+}
+
+void RegionDevice::SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) {
+	Device::SetIOStatistics(statistics);
+	for (auto &member : members) {
+		member.device->SetIOStatistics(statistics);
+	}
+}
+
+vector<pair<string, string>> RegionDevice::GetDeviceInfo() {
+	vector<pair<string, string>> info = Device::GetDeviceInfo();
+	for (auto &member : members) {
+		string category = IOCategoryToString(member.region.category);
+		info.emplace_back(category + "_device", member.device->GetDescription());
+		info.emplace_back(category + "_lbas", StringUtil::Format("%llu-%llu", member.region.start_lba,
+		                                                         member.region.start_lba + member.region.lba_count));
+	}
+	return info;
+}
+
+vector<DeviceRegion> RegionDevice::GetRegions() {
+	vector<DeviceRegion> regions;
+	for (auto &member : members) {
+		regions.push_back(member.region);
+	}
+	return regions;
+}
+
+optional_ptr<Device> RegionDevice::GetRegionDevice(IOCategory category) {
+	for (auto &member : members) {
+		if (member.region.category == category) {
+			return member.device.get();
+		}
+	}
+	return nullptr;
+}
+
+void RegionDevice::Route(const CmdContext &context,
+                         const std::function<void(Device &, const CmdContext &, idx_t)> &execute) {
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+	idx_t byte_start = context.start_lba * geometry.lba_size + context.offset;
+	idx_t byte_end = byte_start + context.nr_bytes;
+	idx_t end_lba = context.start_lba + context.nr_lbas;
+
+	for (idx_t lba = context.start_lba; lba < end_lba;) {
+		RegionMember &member = FindMember(lba);
+		idx_t region_end = member.region.start_lba + member.region.lba_count;
+		idx_t nr_lbas = MinValue<idx_t>(region_end, end_lba) - lba;
+		idx_t part_start = lba * geometry.lba_size;
+		idx_t data_start = MaxValue<idx_t>(part_start, byte_start);
+		idx_t data_end = MinValue<idx_t>(part_start + nr_lbas * geometry.lba_size, byte_end);
+
+		// The members of NvmeDevices expect an NvmeCmdContext
+		if (data_start < data_end) {
+			NvmeCmdContext member_context;
+			member_context.nr_bytes = data_end - data_start;
+			member_context.nr_lbas = nr_lbas;
+			member_context.start_lba = lba - member.region.start_lba;
+			member_context.offset = data_start - part_start;
+			member_context.placement_identifier = context.placement_identifier;
+			member_context.category = context.category;
+			execute(*member.device, member_context, data_start - byte_start);
+		}
+		lba += nr_lbas;
+	}
+}
+
+RegionDevice::RegionMember &RegionDevice::FindMember(idx_t lba) {
+	for (auto &member : members) {
+		if (lba < member.region.start_lba + member.region.lba_count) {
+			return member;
+		}
+	}
+	throw InternalException("LBA %llu lies beyond the regions of the device", lba);
+}
+
+} // namespace duckdb
@@ -0,0 +1,200 @@
+#include "striped_device.hpp"
+
+namespace duckdb {
+
+StripedDevice::StripedDevice(vector<unique_ptr<Device>> members_p, idx_t stripe_size, idx_t threads)
+    : members(std::move(members_p)), pool(threads) {
+	if (members.size() < 2) {
+		throw InvalidInputException("A striped device needs at least two devices, but got %llu", members.size());
+	}
+
+	DeviceGeometry member_geometry = members[0]->GetDeviceGeometry();
+	idx_t min_lba_count = member_geometry.lba_count;
+	for (idx_t i = 1; i < members.size(); i++) {
+		DeviceGeometry other = members[i]->GetDeviceGeometry();
+		if (other.lba_size != member_geometry.lba_size) {
+			throw InvalidInputException("Cannot stripe over devices with LBA sizes of %llu and %llu bytes",
+			                            member_geometry.lba_size, other.lba_size);
+		}
+		min_lba_count = MinValue<idx_t>(min_lba_count, other.lba_count);
+	}
+	if (stripe_size == 0 || stripe_size % member_geometry.lba_size != 0) {
+		throw InvalidInputException("The stripe size of %llu bytes is not a multiple of the LBA size of %llu bytes",
+		                            stripe_size, member_geometry.lba_size);
+	}
+	stripe_lbas = stripe_size / member_geometry.lba_size;
+
+	// Every member holds as many stripe units as the smallest one, the rest of the larger members is left unused
+	idx_t rows = min_lba_count / stripe_lbas;
+	geometry = DeviceGeometry {member_geometry.lba_size, rows * stripe_lbas * members.size()};
+}
+
+idx_t StripedDevice::Write(void *buffer, const CmdContext &context) {
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+	data_ptr_t data = static_cast<data_ptr_t>(buffer);
+	Execute(Split(context), [this, data](const StripeSegment &segment) {
+		members[segment.member]->Write(data + segment.buffer_offset, segment.context);
+	});
+	return context.nr_lbas;
+}
+
+idx_t StripedDevice::Read(void *buffer, const CmdContext &context) {
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+	data_ptr_t data = static_cast<data_ptr_t>(buffer);
+	Execute(Split(context), [this, data](const StripeSegment &segment) {
+		members[segment.member]->Read(data + segment.buffer_offset, segment.context);
+	});
+	return context.nr_lbas;
+}
+
+idx_t StripedDevice::Deallocate(const CmdContext &context) {
+	D_ASSERT(context.nr_lbas > 0);
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+	const idx_t member_count = members.size();
+	idx_t first_unit = context.start_lba / stripe_lbas;
+	idx_t last_lba = context.start_lba + context.nr_lbas - 1;
+	idx_t last_unit = last_lba / stripe_lbas;
+
+	// The units of a member within the range are consecutive on the member, hence the range is contiguous there
+	for (idx_t member = 0; member < member_count; member++) {
+		idx_t member_first_unit = first_unit + (member + member_count - first_unit % member_count) % member_count;
+		if (member_first_unit > last_unit) {
+			continue;
+		}
+		idx_t member_last_unit = last_unit - (last_unit % member_count + member_count - member) % member_count;
+
+		idx_t start = member_first_unit == first_unit ? MapLBA(context.start_lba).second
+		                                              : member_first_unit / member_count * stripe_lbas;
+		idx_t end = member_last_unit == last_unit ? MapLBA(last_lba).second + 1
+		                                          : (member_last_unit / member_count + 1) * stripe_lbas;
+
+		NvmeCmdContext member_context;
+		member_context.nr_bytes = (end - start) * geometry.lba_size;
+		member_context.nr_lbas = end - start;
+		member_context.start_lba = start;
+		member_context.offset = 0;
+		member_context.placement_identifier = context.placement_identifier;
+		member_context.category = context.category;
+		members[member]->Deallocate(member_context);
+	}
+
+	return context.nr_lbas;
+}
+
+bool StripedDevice::Copy(const CmdContext &context, idx_t source_lba) {
+	// The source and destination units only lie on the same members if they are whole rows apart
+	idx_t row_lbas = stripe_lbas * members.size();
+	if (source_lba % row_lbas != context.start_lba % row_lbas) {
+		return false;
+	}
+
+	for (idx_t copied = 0; copied < context.nr_lbas;) {
+		idx_t lba = context.start_lba + copied;
+		idx_t nr_lbas = MinValue<idx_t>(stripe_lbas - lba % stripe_lbas, context.nr_lbas - copied);
+		pair<idx_t, idx_t> destination = MapLBA(lba);
+		pair<idx_t, idx_t> source = MapLBA(source_lba + copied);
+		D_ASSERT(destination.first == source.first);
+
+		NvmeCmdContext member_context;
+		member_context.nr_bytes = nr_lbas * geometry.lba_size;
+		member_context.nr_lbas = nr_lbas;
+		member_context.start_lba = destination.second;
+		member_context.offset = 0;
+		member_context.placement_identifier = context.placement_identifier;
+		member_context.category = context.category;
+		// Units that were already copied are copied again by the read and write of the caller
+		if (!members[destination.first]->Copy(member_context, source.second)) {
+			return false;
+		}
+		copied += nr_lbas;
+	}
+
+	return true;
+}
+
+DeviceGeometry StripedDevice::GetDeviceGeometry() {
+	return geometry;
+}
+
+void StripedDevice::SetIOStatistics(optional_ptr<NvmeIOStatistics> statistics) {
+	Device::SetIOStatistics(statistics);
+	for (auto &member : members) {
+		member->SetIOStatistics(statistics);
+	}
+}
+
+vector<pair<string, string>> StripedDevice::GetDeviceInfo() {
+	vector<pair<string, string>> info = Device::GetDeviceInfo();
+	info.emplace_back("stripe_size", StringUtil::BytesToHumanReadableString(stripe_lbas * geometry.lba_size));
+	DescribeMembers(members, info);
+	return info;
+}
+
+vector<StripedDevice::StripeSegment> StripedDevice::Split(const CmdContext &context) {
+	idx_t byte_start = context.start_lba * geometry.lba_size + context.offset;
+	idx_t byte_end = byte_start + context.nr_bytes;
+	idx_t end_lba = context.start_lba + context.nr_lbas;
+
+	vector<StripeSegment> segments;
+	for (idx_t lba = context.start_lba; lba < end_lba;) {
+		idx_t nr_lbas = MinValue<idx_t>(stripe_lbas - lba % stripe_lbas, end_lba - lba);
+		idx_t segment_start = lba * geometry.lba_size;
+		idx_t data_start = MaxValue<idx_t>(segment_start, byte_start);
+		idx_t data_end = MinValue<idx_t>(segment_start + nr_lbas * geometry.lba_size, byte_end);
+
+		// LBAs of the command that hold none of its bytes are left alone
+		if (data_start < data_end) {
+			pair<idx_t, idx_t> location = MapLBA(lba);
+			StripeSegment segment;
+			segment.member = location.first;
+			segment.context.nr_bytes = data_end - data_start;
+			segment.context.nr_lbas = nr_lbas;
+			segment.context.start_lba = location.second;
+			segment.context.offset = data_start - segment_start;
+			segment.context.placement_identifier = context.placement_identifier;
+			segment.context.category = context.category;
+			segment.buffer_offset = data_start - byte_start;
+			segments.push_back(std::move(segment));
+		}
+		lba += nr_lbas;
+	}
+	return segments;
+}
+
+void StripedDevice::Execute(const vector<StripeSegment> &segments,
+                            const std::function<void(const StripeSegment &)> &execute) {
+	vector<vector<const StripeSegment *>> member_segments(members.size());
+	idx_t used_members = 0;
+	for (auto &segment : segments) {
+		used_members += member_segments[segment.member].empty();
+		member_segments[segment.member].push_back(&segment);
+	}
+
+	if (used_members <= 1) {
+		for (auto &segment : segments) {
+			execute(segment);
+		}
+		return;
+	}
+
+	// The calling thread runs the segments of the first member, and the pool runs those of the other members
+	vector<std::function<void()>> member_tasks;
+	for (auto &part : member_segments) {
+		if (part.empty()) {
+			continue;
+		}
+		member_tasks.push_back([&part, &execute]() {
+			for (auto segment : part) {
+				execute(*segment);
+			}
+		});
+	}
+	pool.RunAll(member_tasks);
+}
+
+pair<idx_t, idx_t> StripedDevice::MapLBA(idx_t lba) const {
+	idx_t unit = lba / stripe_lbas;
+	return make_pair(unit % members.size(), unit / members.size() * stripe_lbas + lba % stripe_lbas);
+}
+
+} // namespace duckdb
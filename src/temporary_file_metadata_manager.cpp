@@ -1,4 +1,7 @@
 #include "temporary_file_metadata_manager.hpp"
+#include "nvmefs_tracer.hpp"
+
+#include <algorithm>
 
 namespace duckdb {
 
@@ -55,13 +58,25 @@ inline unique_ptr<TempFileMetadata> CreateTempFileMetadata(const string &filenam
 	return std::move(tfmeta);
 }
 
-boost::shared_mutex TemporaryFileMetadataManager::temp_mutex;
+/// @brief Number of blocks up to the last block of a file, as blocks can be written in any order
+inline idx_t GetBlockCount(const TempFileMetadata &tfmeta) {
+	idx_t nr_blocks = 0;
+	if (!tfmeta.block_map.empty()) {
+		nr_blocks = tfmeta.block_map.rbegin()->first + 1;
+	}
+	if (!tfmeta.spilled_blocks.empty()) {
+		nr_blocks = MaxValue<idx_t>(nr_blocks, *tfmeta.spilled_blocks.rbegin() + 1);
+	}
+	return nr_blocks;
+}
+
+InstrumentedSharedMutex TemporaryFileMetadataManager::temp_mutex(LockSite::TEMP_MUTEX);
 
 const TempFileMetadata *TemporaryFileMetadataManager::GetOrCreateFile(const string &filename) {
 
 	// Lock the shared mutex for writing
 	{
-		boost::shared_lock<boost::shared_mutex> alloc_lock(temp_mutex);
+		boost::shared_lock<InstrumentedSharedMutex> alloc_lock(temp_mutex);
 
 		// Check if the file already exists
 		if (file_to_temp_meta.count(filename)) {
@@ -69,7 +84,7 @@ const TempFileMetadata *TemporaryFileMetadataManager::GetOrCreateFile(const stri
 		}
 	}
 
-	boost::unique_lock<boost::shared_mutex> lock(temp_mutex);
+	boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
 	// Create a new TempFileMetadata object
 	unique_ptr<TempFileMetadata> tfmeta = CreateTempFileMetadata(filename);
 	tfmeta->is_active.store(true);
@@ -86,11 +101,27 @@ void TemporaryFileMetadataManager::CreateFile(const string &filename) {
 }
 
 idx_t TemporaryFileMetadataManager::GetLBA(const string &filename, idx_t location, idx_t nr_lbas) {
+	TemporaryBlockPin pin;
+	return GetLBA(filename, location, nr_lbas, pin);
+}
+
+idx_t TemporaryFileMetadataManager::GetLBA(const string &filename, idx_t location, idx_t nr_lbas,
+                                           TemporaryBlockPin &pin) {
+	optional_idx lba = LocateBlock(filename, location, nr_lbas, true, pin);
+	if (!lba.IsValid()) {
+		throw std::runtime_error("No free block available");
+	}
+	return lba.GetIndex();
+}
+
+optional_idx TemporaryFileMetadataManager::LocateBlock(const string &filename, idx_t location, idx_t nr_lbas,
+                                                       bool write, TemporaryBlockPin &pin) {
+	NvmeTraceSpan span("TemporaryLookup", IOCategory::TEMPORARY);
 	{
-		boost::shared_lock<boost::shared_mutex> lock(temp_mutex);
+		boost::shared_lock<InstrumentedSharedMutex> lock(temp_mutex);
 
 		TempFileMetadata *tfmeta = file_to_temp_meta[filename].get();
-		boost::shared_lock<boost::shared_mutex> file_lock(tfmeta->file_mutex);
+		boost::shared_lock<InstrumentedSharedMutex> file_lock(tfmeta->file_mutex);
 
 		idx_t block_index = location / tfmeta->block_size;
 
@@ -99,35 +130,99 @@ idx_t TemporaryFileMetadataManager::GetLBA(const string &filename, idx_t locatio
 		}
 
 		if (tfmeta->block_map.count(block_index)) {
-
-			return tfmeta->block_map[block_index]->GetStartLBA();
+			TemporaryBlock *block = tfmeta->block_map[block_index];
+			if (write && spiller) {
+				TouchBlock(filename, *tfmeta, block_index);
+			}
+			if (write) {
+				CancelRelocation(*tfmeta, block_index);
+			}
+			pin.Pin(GetPinStripe(block));
+			idx_t lba = block->GetStartLBA();
+			span.SetRange(lba, nr_lbas);
+			return lba;
+		}
+		// Spilled blocks are read where they are, only writing them moves them back onto the device
+		if (!write && tfmeta->spilled_blocks.count(block_index)) {
+			return optional_idx();
 		}
 	}
 
-	boost::unique_lock<boost::shared_mutex> lock(temp_mutex);
-	boost::unique_lock<boost::shared_mutex> file_lock(file_to_temp_meta[filename]->file_mutex);
+	bool made_room = true;
+	bool compacted = false;
+	while (true) {
+		{
+			boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
+			boost::unique_lock<InstrumentedSharedMutex> file_lock(file_to_temp_meta[filename]->file_mutex);
+
+			TempFileMetadata *tfmeta = file_to_temp_meta[filename].get();
+			idx_t block_index = location / tfmeta->block_size;
+
+			if (!tfmeta->block_map.count(block_index)) {
+				if (!write && tfmeta->spilled_blocks.count(block_index)) {
+					return optional_idx();
+				}
+				TemporaryBlock *block = AllocateBlock(nr_lbas);
+				if (block != nullptr) {
+					tfmeta->spilled_blocks.erase(block_index);
+					tfmeta->block_map[block_index] = block;
+					if (spiller) {
+						TouchBlock(filename, *tfmeta, block_index);
+					}
+				} else if (!compacted) {
+					// The temporary blocks are compacted below, before giving up or spilling a block
+				} else if (!spiller || (!made_room && !write)) {
+					throw std::runtime_error("No free block available");
+				} else if (!made_room) {
+					// Every block on the device is in use, hence this block is written to the spill tier right away
+					tfmeta->spilled_blocks.insert(block_index);
+					return optional_idx();
+				}
+			}
+			if (tfmeta->block_map.count(block_index)) {
+				TemporaryBlock *block = tfmeta->block_map[block_index];
+				if (write) {
+					CancelRelocation(*tfmeta, block_index);
+				}
+				pin.Pin(GetPinStripe(block));
+				idx_t lba = block->GetStartLBA();
+				span.SetRange(lba, nr_lbas);
+				return lba;
+			}
+		}
 
-	TempFileMetadata *tfmeta = file_to_temp_meta[filename].get();
-	idx_t block_index = location / tfmeta->block_size;
+		// The free blocks can be too small for the block even though enough LBAs are free in total. Compacting the
+		// temporary blocks merges the holes that the moved blocks leave behind, and releases the extents that were
+		// emptied, which can then be taken again as a whole.
+		if (!compacted) {
+			compacted = true;
+			CompactBlocks();
+			continue;
+		}
 
-	if (!tfmeta->block_map.count(block_index)) {
-		TemporaryBlock *block = block_manager->AllocateBlock(nr_lbas);
-		tfmeta->block_map[block_index] = block;
+		// The temporary space is full, hence the least recently written blocks make room for the block. DuckDB tends
+		// to read the blocks it wrote last first, e.g. the runs of a sort that are merged next, hence those stay fast.
+		made_room = SpillBlock(nr_lbas);
 	}
-	idx_t lba = tfmeta->block_map[block_index]->GetStartLBA();
+}
 
-	return lba;
+TemporaryBlock *TemporaryFileMetadataManager::AllocateBlock(idx_t nr_lbas) {
+	TemporaryBlock *block = block_manager->TryAllocateBlock(nr_lbas);
+	while (block == nullptr && GrowTemporarySpace()) {
+		block = block_manager->TryAllocateBlock(nr_lbas);
+	}
+	return block;
 }
 
 void TemporaryFileMetadataManager::MoveLBALocation(const string &filename, idx_t lba_location) {
-	// boost::shared_lock<boost::shared_mutex> lock(temp_mutex);
+	// boost::shared_lock<InstrumentedSharedMutex> lock(temp_mutex);
 
 	// if (!file_to_temp_meta.count(filename)) {
 	// 	return;
 	// }
 
 	// TempFileMetadata *tfmeta = file_to_temp_meta[filename].get();
-	// boost::shared_lock<boost::shared_mutex> file_lock(tfmeta->file_mutex);
+	// boost::shared_lock<InstrumentedSharedMutex> file_lock(tfmeta->file_mutex);
 
 	// // Use atomic compare-and-swap to update lba_location if the new location is larger
 	// idx_t current_lba = tfmeta->lba_location.load();
@@ -144,41 +239,43 @@ void TemporaryFileMetadataManager::MoveLBALocation(const string &filename, idx_t
 }
 
 void TemporaryFileMetadataManager::TruncateFile(const string &filename, idx_t new_size) {
-	boost::unique_lock<boost::shared_mutex> lock(temp_mutex);
+	boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
 
 	TempFileMetadata *tfmeta = file_to_temp_meta[filename].get();
 
-	boost::unique_lock<boost::shared_mutex> file_lock(tfmeta->file_mutex);
+	boost::unique_lock<InstrumentedSharedMutex> file_lock(tfmeta->file_mutex);
 
 	idx_t to_block_index = new_size / tfmeta->block_size;
-	idx_t from_block_index = tfmeta->block_map.size();
 
-	for (idx_t i = from_block_index; i > to_block_index; i--) {
-		idx_t block_index = i - 1;
-		TemporaryBlock *block = tfmeta->block_map[block_index];
-		block_manager->FreeBlock(block);
-		tfmeta->block_map.erase(block_index);
+	tfmeta->spilled_blocks.erase(tfmeta->spilled_blocks.lower_bound(to_block_index), tfmeta->spilled_blocks.end());
+	auto truncated_blocks = tfmeta->block_map.lower_bound(to_block_index);
+	for (auto it = truncated_blocks; it != tfmeta->block_map.end(); it++) {
+		block_manager->FreeBlock(it->second);
+		ForgetBlock(*tfmeta, it->first);
 	}
+	tfmeta->block_map.erase(truncated_blocks, tfmeta->block_map.end());
 
-	// file_to_temp_meta[nvme_handle.path] = tfmeta;
+	ReleaseFreeExtents();
 }
 
 void TemporaryFileMetadataManager::DeleteFile(const string &filename) {
-	boost::unique_lock<boost::shared_mutex> lock(temp_mutex);
+	boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
 
 	TempFileMetadata *tfmeta = file_to_temp_meta[filename].get();
 	{
-		boost::unique_lock<boost::shared_mutex> file_lock(tfmeta->file_mutex);
+		boost::unique_lock<InstrumentedSharedMutex> file_lock(tfmeta->file_mutex);
 		for (const auto &kv : tfmeta->block_map) {
 			block_manager->FreeBlock(kv.second);
+			ForgetBlock(*tfmeta, kv.first);
 		}
 	}
 
 	file_to_temp_meta.erase(filename);
+	ReleaseFreeExtents();
 }
 
 bool TemporaryFileMetadataManager::FileExists(const string &filename) {
-	boost::shared_lock<boost::shared_mutex> lock(temp_mutex);
+	boost::shared_lock<InstrumentedSharedMutex> lock(temp_mutex);
 
 	if (file_to_temp_meta.count(filename)) {
 		return true;
@@ -188,21 +285,21 @@ bool TemporaryFileMetadataManager::FileExists(const string &filename) {
 }
 
 idx_t TemporaryFileMetadataManager::GetFileSizeLBA(const string &filename) {
-	boost::shared_lock<boost::shared_mutex> lock(temp_mutex);
+	boost::shared_lock<InstrumentedSharedMutex> lock(temp_mutex);
 	TempFileMetadata *tfmeta = file_to_temp_meta[filename].get();
-	boost::shared_lock<boost::shared_mutex> file_lock(tfmeta->file_mutex);
+	boost::shared_lock<InstrumentedSharedMutex> file_lock(tfmeta->file_mutex);
 
-	idx_t nr_lbas = (tfmeta->block_size * tfmeta->block_map.size()) / lba_size;
+	idx_t nr_lbas = (tfmeta->block_size * GetBlockCount(*tfmeta)) / lba_size;
 
 	return nr_lbas;
 }
 
 void TemporaryFileMetadataManager::Clear() {
-	boost::unique_lock<boost::shared_mutex> alloc_lock(temp_mutex);
+	boost::unique_lock<InstrumentedSharedMutex> alloc_lock(temp_mutex);
 
 	for (const auto &kv : file_to_temp_meta) {
 		TempFileMetadata *tfmeta = kv.second.get();
-		boost::unique_lock<boost::shared_mutex> file_lock(tfmeta->file_mutex);
+		boost::unique_lock<InstrumentedSharedMutex> file_lock(tfmeta->file_mutex);
 
 		for (const auto &block : tfmeta->block_map) {
 			block_manager->FreeBlock(block.second);
@@ -210,36 +307,413 @@ void TemporaryFileMetadataManager::Clear() {
 	}
 
 	file_to_temp_meta.clear();
+	{
+		std::lock_guard<std::mutex> order_lock(write_order_lock);
+		write_order.clear();
+	}
+	ReleaseFreeExtents();
 }
 
 idx_t TemporaryFileMetadataManager::GetSeekBound(const string &filename) {
-	boost::shared_lock<boost::shared_mutex> lock(temp_mutex);
+	boost::shared_lock<InstrumentedSharedMutex> lock(temp_mutex);
 
 	TempFileMetadata *tfmeta = file_to_temp_meta[filename].get();
 
-	boost::shared_lock<boost::shared_mutex> file_lock(tfmeta->file_mutex);
+	boost::shared_lock<InstrumentedSharedMutex> file_lock(tfmeta->file_mutex);
+
+	return tfmeta->block_size * GetBlockCount(*tfmeta);
+}
+
+idx_t TemporaryFileMetadataManager::GetAvailableSpace() {
+	boost::unique_lock<InstrumentedSharedMutex> temp_lock(temp_mutex);
+	idx_t temp_max_bytes = lba_amount * lba_size;
+	idx_t temp_used_bytes = GetUsedLBACount() * lba_size;
+
+	return (temp_max_bytes - temp_used_bytes);
+}
+
+idx_t TemporaryFileMetadataManager::GetUnusedAllocatedLBACount() {
+	boost::unique_lock<InstrumentedSharedMutex> temp_lock(temp_mutex);
 
-	return tfmeta->block_size * tfmeta->block_map.size();
+	return block_manager->GetManagedLBACount() - GetUsedLBACount();
 }
 
-idx_t TemporaryFileMetadataManager::GetAvailableSpace(idx_t lba_count, idx_t lba_start) {
-	boost::unique_lock<boost::shared_mutex> temp_lock(temp_mutex);
-	idx_t temp_max_bytes = ((lba_count - 1) - lba_start) * lba_size;
+void TemporaryFileMetadataManager::Scan(const std::function<void(const string &, idx_t, idx_t)> &callback) {
+	boost::shared_lock<InstrumentedSharedMutex> lock(temp_mutex);
+
+	for (const auto &kv : file_to_temp_meta) {
+		TempFileMetadata *tfmeta = kv.second.get();
+		boost::shared_lock<InstrumentedSharedMutex> file_lock(tfmeta->file_mutex);
+		callback(kv.first, tfmeta->block_size, tfmeta->block_size * GetBlockCount(*tfmeta));
+	}
+}
+
+idx_t TemporaryFileMetadataManager::GetUsedLBACount() {
 	idx_t temp_used_bytes {};
 
 	for (const auto &kv : file_to_temp_meta) {
 		TempFileMetadata *tfmeta = kv.second.get();
-		boost::shared_lock<boost::shared_mutex> file_lock(tfmeta->file_mutex);
+		boost::shared_lock<InstrumentedSharedMutex> file_lock(tfmeta->file_mutex);
 
 		temp_used_bytes += kv.second->block_size * kv.second->block_map.size();
 	}
 
-	return (temp_max_bytes - temp_used_bytes);
+	return temp_used_bytes / lba_size;
+}
+
+bool TemporaryFileMetadataManager::GrowTemporarySpace() {
+	if (!extent_allocator) {
+		return false;
+	}
+
+	// Temporary files may not occupy more than the maximum temporary size
+	idx_t managed_lbas = block_manager->GetManagedLBACount();
+	if (managed_lbas >= lba_amount) {
+		return false;
+	}
+
+	optional_idx extent = extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_TEMPORARY, 0);
+	if (!extent.IsValid()) {
+		return false;
+	}
+
+	idx_t extent_lbas = extent_allocator->GetExtentLBACount();
+	block_manager->AddRange(extent_allocator->GetExtentStartLBA(extent.GetIndex()), extent_lbas);
+
+	return true;
+}
+
+idx_t TemporaryFileMetadataManager::ReleaseFreeExtents() {
+	if (!extent_allocator) {
+		return 0;
+	}
+
+	idx_t extent_lbas = extent_allocator->GetExtentLBACount();
+	vector<pair<idx_t, idx_t>> released_ranges = block_manager->ReleaseFreeRanges();
+	for (const auto &range : released_ranges) {
+		D_ASSERT(range.first % extent_lbas == 0 && range.second == extent_lbas);
+		extent_allocator->FreeExtent(range.first / extent_lbas);
+	}
+
+	return released_ranges.size();
+}
+
+TemporaryFragmentationStatistics TemporaryFileMetadataManager::GetFragmentationStatistics() {
+	boost::shared_lock<InstrumentedSharedMutex> lock(temp_mutex);
+
+	return block_manager->GetFragmentationStatistics();
+}
+
+void TemporaryFileMetadataManager::SetBlockRelocator(temporary_block_relocator_t relocator) {
+	boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
+
+	this->relocator = std::move(relocator);
+}
+
+TemporaryCompactionResult TemporaryFileMetadataManager::Compact() {
+	return CompactBlocks();
+}
+
+TemporaryCompactionResult TemporaryFileMetadataManager::CompactBlocks() {
+	TemporaryCompactionResult result {0, 0, 0, 0};
+	vector<unique_ptr<PendingRelocation>> relocations;
+	{
+		boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
+		// Only extents can be released, hence blocks are not moved inside a fixed temporary range
+		if (!extent_allocator || !relocator) {
+			return result;
+		}
+		if (!SelectBlocksToRelocate(relocations, result)) {
+			result.released_extents = ReleaseFreeExtents();
+			return result;
+		}
+	}
+
+	// The blocks are copied while other temporary I/O continues. Reads of a block are served from its old LBAs
+	// meanwhile, as it is only moved once it was copied.
+	idx_t copied = 0;
+	try {
+		for (; copied < relocations.size(); copied++) {
+			PendingRelocation &relocation = *relocations[copied];
+			relocator(relocation.filename, relocation.lba, relocation.target->GetStartLBA(), relocation.nr_lbas);
+		}
+	} catch (...) {
+		boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
+		FinishRelocations(relocations, copied, result);
+		throw;
+	}
+
+	boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
+	FinishRelocations(relocations, copied, result);
+	return result;
+}
+
+bool TemporaryFileMetadataManager::SelectBlocksToRelocate(vector<unique_ptr<PendingRelocation>> &relocations,
+                                                          TemporaryCompactionResult &result) {
+	vector<idx_t> drained_ranges = SelectRangesToDrain();
+	if (drained_ranges.empty()) {
+		return false;
+	}
+
+	// The targets are taken from the ranges that are kept. Other blocks can be allocated in the drained ranges again
+	// once the targets are chosen, which at worst keeps a range from being released this time.
+	block_manager->SetDrainingRanges(drained_ranges);
+	for (const auto &kv : file_to_temp_meta) {
+		TempFileMetadata *tfmeta = kv.second.get();
+		boost::unique_lock<InstrumentedSharedMutex> file_lock(tfmeta->file_mutex);
+
+		for (const auto &entry : tfmeta->block_map) {
+			TemporaryBlock *block = entry.second;
+			if (!block_manager->IsDraining(block)) {
+				continue;
+			}
+
+			// Pins are only taken while holding the temp_mutex, hence no new I/O can start on the block. A pinned
+			// stripe can also belong to another block, which then stays in place needlessly until the next time.
+			if (GetPinStripe(block).pins.load(std::memory_order_acquire) > 0) {
+				result.skipped_blocks++;
+				continue;
+			}
+
+			TemporaryBlock *target = block_manager->TryAllocateBlock(block->GetLBAAmount());
+			if (target == nullptr) {
+				result.skipped_blocks++;
+				continue;
+			}
+
+			relocations.push_back(make_uniq<PendingRelocation>());
+			PendingRelocation &relocation = *relocations.back();
+			relocation.filename = kv.first;
+			relocation.block_index = entry.first;
+			relocation.lba = block->GetStartLBA();
+			relocation.nr_lbas = block->GetLBAAmount();
+			relocation.target = target;
+			relocation.pin.Pin(GetPinStripe(block));
+			std::lock_guard<std::mutex> order_lock(write_order_lock);
+			tfmeta->relocating_blocks.insert(entry.first);
+		}
+	}
+	block_manager->ClearDrainingRanges();
+	pending_relocations.fetch_add(relocations.size(), std::memory_order_relaxed);
+
+	return !relocations.empty();
+}
+
+void TemporaryFileMetadataManager::FinishRelocations(vector<unique_ptr<PendingRelocation>> &relocations,
+                                                     idx_t copied, TemporaryCompactionResult &result) {
+	// No new pins are taken while the temp_mutex is held exclusively, hence a stripe that is still pinned once the
+	// pins of the compaction are released has I/O running on the old LBAs
+	for (auto &relocation : relocations) {
+		relocation->pin.Release();
+	}
+	pending_relocations.fetch_sub(relocations.size(), std::memory_order_relaxed);
+
+	for (idx_t i = 0; i < relocations.size(); i++) {
+		PendingRelocation &relocation = *relocations[i];
+		bool moved = false;
+		auto entry = file_to_temp_meta.find(relocation.filename);
+		if (entry != file_to_temp_meta.end()) {
+			TempFileMetadata &file = *entry->second;
+			boost::unique_lock<InstrumentedSharedMutex> file_lock(file.file_mutex);
+			bool unchanged;
+			{
+				std::lock_guard<std::mutex> order_lock(write_order_lock);
+				unchanged = file.relocating_blocks.erase(relocation.block_index) > 0;
+			}
+
+			// A block that was written, truncated or deleted while it was copied stays where it is
+			if (i < copied && unchanged) {
+				TemporaryBlock *block = file.block_map[relocation.block_index];
+				if (GetPinStripe(block).pins.load(std::memory_order_acquire) == 0) {
+					file.block_map[relocation.block_index] = relocation.target;
+					block_manager->FreeBlock(block);
+					moved = true;
+				}
+			}
+		}
+
+		if (moved) {
+			result.relocated_blocks++;
+			result.relocated_lbas += relocation.nr_lbas;
+		} else {
+			block_manager->FreeBlock(relocation.target);
+			result.skipped_blocks++;
+		}
+	}
+
+	result.released_extents = ReleaseFreeExtents();
+}
+
+void TemporaryFileMetadataManager::CancelRelocation(TempFileMetadata &file, idx_t block_index) {
+	if (pending_relocations.load(std::memory_order_relaxed) == 0) {
+		return;
+	}
+	std::lock_guard<std::mutex> order_lock(write_order_lock);
+	file.relocating_blocks.erase(block_index);
+}
+
+void TemporaryFileMetadataManager::SetBlockSpiller(temporary_block_spiller_t spiller) {
+	boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
+
+	this->spiller = std::move(spiller);
+}
+
+idx_t TemporaryFileMetadataManager::GetSpilledBlockCount() {
+	boost::shared_lock<InstrumentedSharedMutex> lock(temp_mutex);
+
+	idx_t spilled_blocks = 0;
+	for (const auto &kv : file_to_temp_meta) {
+		boost::shared_lock<InstrumentedSharedMutex> file_lock(kv.second->file_mutex);
+		spilled_blocks += kv.second->spilled_blocks.size();
+	}
+	return spilled_blocks;
+}
+
+bool TemporaryFileMetadataManager::SpillBlock(idx_t nr_lbas) {
+	PendingSpill spill;
+	{
+		boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
+		if (!SelectBlockToSpill(nr_lbas, spill)) {
+			return false;
+		}
+	}
+
+	// The block is read from the device and written to the spill tier while other temporary I/O continues. Reads of
+	// the block are served from the device meanwhile, as it is only freed once it was copied.
+	try {
+		spiller(spill.filename, spill.block_index, spill.lba, spill.nr_lbas);
+	} catch (...) {
+		boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
+		FinishSpill(spill, false);
+		throw;
+	}
+
+	boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
+	FinishSpill(spill, true);
+	return true;
+}
+
+bool TemporaryFileMetadataManager::SelectBlockToSpill(idx_t nr_lbas, PendingSpill &spill) {
+	std::lock_guard<std::mutex> order_lock(write_order_lock);
+
+	// Blocks that are read or written stay, like during a compaction
+	auto victim = write_order.end();
+	for (auto it = write_order.begin(); it != write_order.end(); it++) {
+		TemporaryBlock *block = it->second.file->block_map[it->second.block_index];
+		if (GetPinStripe(block).pins.load(std::memory_order_acquire) > 0) {
+			continue;
+		}
+		if (victim == write_order.end()) {
+			victim = it;
+		}
+		// Freeing a block that is large enough makes room for the new block on its own
+		if (block->GetLBAAmount() >= nr_lbas) {
+			victim = it;
+			break;
+		}
+	}
+	if (victim == write_order.end()) {
+		return false;
+	}
+
+	// Writing the block again takes it out of the spilling blocks, which keeps it on the device
+	WrittenBlock written = victim->second;
+	TemporaryBlock *block = written.file->block_map[written.block_index];
+	spill.filename = *written.filename;
+	spill.block_index = written.block_index;
+	spill.lba = block->GetStartLBA();
+	spill.nr_lbas = block->GetLBAAmount();
+	spill.pin.Pin(GetPinStripe(block));
+	written.file->write_sequences.erase(written.block_index);
+	written.file->spilling_blocks.insert(written.block_index);
+	write_order.erase(victim);
+	return true;
+}
+
+void TemporaryFileMetadataManager::FinishSpill(PendingSpill &spill, bool copied) {
+	spill.pin.Release();
+
+	auto entry = file_to_temp_meta.find(spill.filename);
+	if (entry == file_to_temp_meta.end()) {
+		return;
+	}
+	TempFileMetadata &file = *entry->second;
+	boost::unique_lock<InstrumentedSharedMutex> file_lock(file.file_mutex);
+	{
+		std::lock_guard<std::mutex> order_lock(write_order_lock);
+		if (!file.spilling_blocks.erase(spill.block_index)) {
+			return;
+		}
+	}
+
+	if (!copied) {
+		TouchBlock(entry->first, file, spill.block_index);
+		return;
+	}
+	block_manager->FreeBlock(file.block_map[spill.block_index]);
+	file.block_map.erase(spill.block_index);
+	file.spilled_blocks.insert(spill.block_index);
+}
+
+void TemporaryFileMetadataManager::TouchBlock(const string &filename, TempFileMetadata &file, idx_t block_index) {
+	std::lock_guard<std::mutex> order_lock(write_order_lock);
+
+	// The write order keeps the path of the file, which lives as long as the entry of the file in the manager
+	auto file_entry = file_to_temp_meta.find(filename);
+	D_ASSERT(file_entry != file_to_temp_meta.end());
+	auto sequence = file.write_sequences.find(block_index);
+	if (sequence != file.write_sequences.end()) {
+		write_order.erase(sequence->second);
+	}
+	file.spilling_blocks.erase(block_index);
+	write_sequence++;
+	file.write_sequences[block_index] = write_sequence;
+	write_order[write_sequence] = WrittenBlock {&file_entry->first, &file, block_index};
+}
+
+void TemporaryFileMetadataManager::ForgetBlock(TempFileMetadata &file, idx_t block_index) {
+	std::lock_guard<std::mutex> order_lock(write_order_lock);
+
+	auto sequence = file.write_sequences.find(block_index);
+	if (sequence != file.write_sequences.end()) {
+		write_order.erase(sequence->second);
+		file.write_sequences.erase(sequence);
+	}
+	file.spilling_blocks.erase(block_index);
+	file.relocating_blocks.erase(block_index);
+}
+
+vector<idx_t> TemporaryFileMetadataManager::SelectRangesToDrain() {
+	vector<TemporaryRangeUsage> usage = block_manager->GetRangeUsage();
+	std::sort(usage.begin(), usage.end(), [](const TemporaryRangeUsage &left, const TemporaryRangeUsage &right) {
+		return left.used_lbas < right.used_lbas;
+	});
+
+	idx_t free_lbas = 0;
+	for (const auto &range : usage) {
+		free_lbas += range.lba_amount - range.used_lbas;
+	}
+
+	// Emptying a range moves its used LBAs into the free LBAs of the ranges that are kept. The emptiest ranges are the
+	// cheapest to empty, and ranges are added as long as the kept ranges have room for everything that is moved.
+	vector<idx_t> drained_ranges;
+	idx_t moved_lbas = 0;
+	for (const auto &range : usage) {
+		idx_t range_free_lbas = range.lba_amount - range.used_lbas;
+		if (moved_lbas + range.used_lbas > free_lbas - range_free_lbas) {
+			break;
+		}
+		drained_ranges.push_back(range.start_lba);
+		moved_lbas += range.used_lbas;
+		free_lbas -= range_free_lbas;
+	}
+
+	return drained_ranges;
 }
 
 void TemporaryFileMetadataManager::ListFiles(const string &directory,
                                              const std::function<void(const string &, bool)> &callback) {
-	boost::unique_lock<boost::shared_mutex> lock(temp_mutex);
+	boost::unique_lock<InstrumentedSharedMutex> lock(temp_mutex);
 
 	for (const auto &kv : file_to_temp_meta) {
 		callback(StringUtil::GetFileName(kv.first), false);
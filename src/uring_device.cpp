@@ -0,0 +1,810 @@
+#include "uring_device.hpp"
+#include "file_backed_lbas.hpp"
+#include "nvmefs_io_statistics.hpp"
+#include "nvmefs_tracer.hpp"
+#include "nvmefs_probes.hpp"
+
+#include "duckdb/main/config.hpp"
+
+#ifdef NVMEFS_LIBURING
+#include <liburing.h>
+#include <linux/fs.h>
+#include <linux/nvme_ioctl.h>
+#include <condition_variable>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace duckdb {
+
+/// Depths and counts beyond this are meaningless, which also keeps stoull from overflowing
+constexpr idx_t NVMEFS_URING_MAX_OPTION_VALUE = 1ULL << 16;
+
+static idx_t ParseUringCount(const string &key, const string &value) {
+	if (value.empty() || value.length() > 6 || value.find_first_not_of("0123456789") != string::npos ||
+	    std::stoull(value) > NVMEFS_URING_MAX_OPTION_VALUE) {
+		throw InvalidInputException("Invalid value '%s' for '%s', expected a number of at most %llu", value, key,
+		                            NVMEFS_URING_MAX_OPTION_VALUE);
+	}
+	return std::stoull(value);
+}
+
+UringDeviceOptions UringDeviceOptions::Parse(const string &options) {
+	UringDeviceOptions result;
+
+	for (const auto &option : StringUtil::Split(options, ',')) {
+		string trimmed = option;
+		StringUtil::Trim(trimmed);
+		if (trimmed.empty()) {
+			continue;
+		}
+
+		vector<string> parts = StringUtil::Split(trimmed, '=');
+		string key = StringUtil::Lower(parts[0]);
+		StringUtil::Trim(key);
+		if (parts.size() == 1 && key == "sqpoll") {
+			result.sqpoll = true;
+			continue;
+		}
+		if (parts.size() == 1 && key == "iopoll") {
+			result.iopoll = true;
+			continue;
+		}
+		if (parts.size() != 2) {
+			throw InvalidInputException("Invalid liburing option '%s', expected sqpoll, iopoll or <option>=<value>",
+			                            trimmed);
+		}
+
+		string value = parts[1];
+		StringUtil::Trim(value);
+		if (key == "rings") {
+			result.rings = ParseUringCount(key, value);
+		} else if (key == "queue_depth") {
+			result.queue_depth = ParseUringCount(key, value);
+			if (result.queue_depth == 0) {
+				throw InvalidInputException("The queue_depth of the liburing backend must be positive");
+			}
+		} else if (key == "sqpoll_idle") {
+			result.sqpoll_idle_ms = ParseUringCount(key, value);
+		} else if (key == "fixed_buffers") {
+			result.fixed_buffers = ParseUringCount(key, value);
+		} else if (key == "fixed_buffer_size") {
+			result.fixed_buffer_size = DBConfig::ParseMemoryLimit(value);
+			if (result.fixed_buffer_size == 0) {
+				throw InvalidInputException("The fixed_buffer_size of the liburing backend must be positive");
+			}
+		} else {
+			throw InvalidInputException("Unknown liburing option '%s', expected rings, queue_depth, sqpoll, "
+			                            "sqpoll_idle, iopoll, fixed_buffers or fixed_buffer_size",
+			                            key);
+		}
+	}
+
+	return result;
+}
+
+string UringDeviceOptions::ToString() const {
+	vector<string> settings;
+	settings.push_back("rings=" + (rings == 0 ? string("per_thread") : std::to_string(rings)));
+	settings.push_back("queue_depth=" + std::to_string(queue_depth));
+	if (sqpoll) {
+		settings.push_back("sqpoll");
+		settings.push_back("sqpoll_idle=" + std::to_string(sqpoll_idle_ms));
+	}
+	if (iopoll) {
+		settings.push_back("iopoll");
+	}
+	settings.push_back("fixed_buffers=" + std::to_string(fixed_buffers));
+	settings.push_back("fixed_buffer_size=" + StringUtil::BytesToHumanReadableString(fixed_buffer_size));
+	return StringUtil::Join(settings, ",");
+}
+
+#ifdef NVMEFS_LIBURING
+
+/// Block devices and files are read and written in commands of at most this size
+constexpr idx_t NVMEFS_URING_MAX_TRANSFER_BYTES = 1ULL << 26;
+/// Passthrough commands are mapped by the NVMe driver, which handles at most 127 pages of a buffer that is not
+/// physically contiguous. Commands are kept below that, and below the MDTS of the controller.
+constexpr idx_t NVMEFS_URING_MAX_PASSTHROUGH_BYTES = 1ULL << 18;
+/// Completions reaped in one batch
+constexpr idx_t NVMEFS_URING_REAP_BATCH = 64;
+
+constexpr uint8_t NVMEFS_NVME_OPC_WRITE = 0x01;
+constexpr uint8_t NVMEFS_NVME_OPC_READ = 0x02;
+constexpr uint8_t NVMEFS_NVME_OPC_DSM = 0x09;
+constexpr uint8_t NVMEFS_NVME_OPC_IO_MGMT_RECV = 0x12;
+constexpr uint8_t NVMEFS_NVME_ADMIN_OPC_IDENTIFY = 0x06;
+constexpr uint8_t NVMEFS_NVME_ADMIN_OPC_GET_FEATURES = 0x0A;
+constexpr uint32_t NVMEFS_NVME_FEATURE_FDP = 0x1D;
+constexpr uint32_t NVMEFS_NVME_DATA_PLACEMENT_MODE = 2;
+
+/// @brief A range of a dataset management command, as laid out by the NVMe specification
+struct NvmeDsmRange {
+	uint32_t context_attributes;
+	uint32_t nr_lbas;
+	uint64_t start_lba;
+};
+
+struct UringRequest {
+	bool write = false;
+	data_ptr_t buffer = nullptr;
+	idx_t nr_bytes = 0;
+	/// The byte offset of a read or write on a block device or file
+	idx_t offset = 0;
+	optional_idx buffer_index;
+	/// The command of a passthrough request
+	uint8_t opcode = 0;
+	uint32_t cdw10 = 0;
+	uint32_t cdw11 = 0;
+	uint32_t cdw12 = 0;
+	uint32_t cdw13 = 0;
+	/// Set by the thread that reaps the completion, while it holds the completion_lock of the ring
+	bool done = false;
+	int32_t result = 0;
+};
+
+struct UringRing {
+	UringRing() : submit_lock(LockSite::DEVICE_QUEUE) {
+	}
+
+	~UringRing() {
+		if (initialized) {
+			io_uring_queue_exit(&ring);
+		}
+		free(buffers);
+	}
+
+	/// @brief Takes a free fixed buffer that holds at least nr_bytes, if there is one
+	optional_idx AcquireFixedBuffer(idx_t nr_bytes) {
+		if (nr_bytes > buffer_size) {
+			return optional_idx();
+		}
+		std::lock_guard<std::mutex> guard(buffer_lock);
+		if (free_buffers.empty()) {
+			return optional_idx();
+		}
+		idx_t buffer_index = free_buffers.back();
+		free_buffers.pop_back();
+		return buffer_index;
+	}
+
+	void ReleaseFixedBuffer(idx_t buffer_index) {
+		std::lock_guard<std::mutex> guard(buffer_lock);
+		free_buffers.push_back(buffer_index);
+	}
+
+	data_ptr_t GetFixedBuffer(idx_t buffer_index) {
+		return buffers + buffer_index * buffer_size;
+	}
+
+	io_uring ring;
+	bool initialized = false;
+	InstrumentedMutex<std::mutex> submit_lock;
+
+	/// The thread that reaps completes the requests of all threads, while the others wait for it
+	std::mutex completion_lock;
+	std::condition_variable completed;
+	bool reaping = false;
+
+	std::mutex buffer_lock;
+	data_ptr_t buffers = nullptr;
+	idx_t buffer_size = 0;
+	vector<idx_t> free_buffers;
+};
+
+/// @brief A buffer that stages a command, which is a fixed buffer of the ring if one is free
+class UringStagingBuffer {
+public:
+	UringStagingBuffer(UringRing &ring, idx_t nr_bytes) : ring(ring) {
+		buffer_index = ring.AcquireFixedBuffer(nr_bytes);
+		if (buffer_index.IsValid()) {
+			data = ring.GetFixedBuffer(buffer_index.GetIndex());
+			return;
+		}
+		allocation = make_uniq<AlignedBuffer>(nr_bytes);
+		data = allocation->Get();
+	}
+
+	~UringStagingBuffer() {
+		if (buffer_index.IsValid()) {
+			ring.ReleaseFixedBuffer(buffer_index.GetIndex());
+		}
+	}
+
+	data_ptr_t Get() {
+		return data;
+	}
+
+	optional_idx GetIndex() const {
+		return buffer_index;
+	}
+
+private:
+	UringRing &ring;
+	data_ptr_t data;
+	optional_idx buffer_index;
+	unique_ptr<AlignedBuffer> allocation;
+};
+
+static string DescribeResult(int32_t result) {
+	if (result < 0) {
+		return strerror(-result);
+	}
+	return StringUtil::Format("NVMe status 0x%x", result);
+}
+
+UringDevice::UringDevice(const string &device_path, const UringDeviceOptions &options, idx_t max_threads)
+    : device_path(device_path), options(options), max_threads(MaxValue<idx_t>(max_threads, 1)),
+      mode(UringDeviceMode::FILE), fd(-1), direct(true), geometry {0, 0}, max_transfer_lbas(0), nsid(0), fdp(false) {
+	try {
+		OpenDevice();
+		CreateRings();
+	} catch (...) {
+		rings.clear();
+		if (fd >= 0) {
+			close(fd);
+		}
+		throw;
+	}
+}
+
+UringDevice::~UringDevice() {
+	rings.clear();
+	close(fd);
+}
+
+void UringDevice::OpenDevice() {
+	struct stat path_stat;
+	if (stat(device_path.c_str(), &path_stat) != 0) {
+		throw IOException("Could not open %s: %s", device_path, strerror(errno));
+	}
+
+	if (S_ISCHR(path_stat.st_mode)) {
+		mode = UringDeviceMode::PASSTHROUGH;
+		fd = open(device_path.c_str(), O_RDWR);
+		if (fd < 0) {
+			throw IOException("Could not open %s: %s", device_path, strerror(errno));
+		}
+	} else if (S_ISBLK(path_stat.st_mode) || S_ISREG(path_stat.st_mode)) {
+		mode = S_ISBLK(path_stat.st_mode) ? UringDeviceMode::BLOCK : UringDeviceMode::FILE;
+		fd = FileBackedLBAs::Open(device_path, direct);
+		// Polled rings only complete commands that bypass the page cache
+		if (options.iopoll && !direct) {
+			throw IOException("%s does not support direct I/O, which polling for completions with iopoll requires",
+			                  device_path);
+		}
+	} else {
+		throw IOException("%s is neither an NVMe character device, a block device nor a file", device_path);
+	}
+
+	switch (mode) {
+	case UringDeviceMode::PASSTHROUGH:
+		IdentifyNamespace();
+		break;
+	case UringDeviceMode::BLOCK: {
+		int lba_size = 0;
+		uint64_t device_bytes = 0;
+		if (ioctl(fd, BLKSSZGET, &lba_size) != 0 || ioctl(fd, BLKGETSIZE64, &device_bytes) != 0) {
+			throw IOException("Could not determine the geometry of %s: %s", device_path, strerror(errno));
+		}
+		geometry = DeviceGeometry {static_cast<idx_t>(lba_size), device_bytes / lba_size};
+		max_transfer_lbas = NVMEFS_URING_MAX_TRANSFER_BYTES / lba_size;
+		break;
+	}
+	case UringDeviceMode::FILE:
+		geometry = FileBackedLBAs::GetFileGeometry(path_stat.st_size);
+		max_transfer_lbas = NVMEFS_URING_MAX_TRANSFER_BYTES / geometry.lba_size;
+		break;
+	}
+
+	if (geometry.lba_count == 0) {
+		throw IOException("%s has no LBAs. Files have to be created with the size of the namespace they emulate.",
+		                  device_path);
+	}
+}
+
+/// @brief Sends an admin command, or an I/O command without data transfer through the queue, with the ioctl of the
+/// NVMe driver
+/// @return True if the command completed successfully
+static bool SendNvmeCommand(int fd, bool admin, nvme_passthru_cmd &command) {
+	return ioctl(fd, admin ? NVME_IOCTL_ADMIN_CMD : NVME_IOCTL_IO_CMD, &command) == 0;
+}
+
+void UringDevice::IdentifyNamespace() {
+	int namespace_id = ioctl(fd, NVME_IOCTL_ID);
+	if (namespace_id < 0) {
+		throw IOException("%s is not an NVMe namespace: %s", device_path, strerror(errno));
+	}
+	nsid = namespace_id;
+
+	vector<uint8_t> identify(4096, 0);
+	nvme_passthru_cmd command;
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVMEFS_NVME_ADMIN_OPC_IDENTIFY;
+	command.nsid = nsid;
+	command.addr = reinterpret_cast<uintptr_t>(identify.data());
+	command.data_len = identify.size();
+	// CNS 0 identifies the namespace
+	command.cdw10 = 0;
+	if (!SendNvmeCommand(fd, true, command)) {
+		throw IOException("Could not identify namespace %u of %s", nsid, device_path);
+	}
+
+	// The namespace size is at byte 0, the formatted LBA size at byte 26 and the LBA formats start at byte 128
+	uint64_t namespace_size;
+	memcpy(&namespace_size, identify.data(), sizeof(namespace_size));
+	uint8_t formatted_lba_size = identify[26];
+	idx_t format = (formatted_lba_size & 0xF) | (((formatted_lba_size >> 5) & 0x3) << 4);
+	uint8_t lba_data_size = identify[128 + format * 4 + 2];
+	geometry = DeviceGeometry {1ULL << lba_data_size, namespace_size};
+
+	// The MDTS of the controller is at byte 77, in units of the minimum page size, which is assumed to be 4 KiB
+	identify.assign(identify.size(), 0);
+	command.nsid = 0;
+	command.cdw10 = 1;
+	idx_t max_transfer_bytes = NVMEFS_URING_MAX_PASSTHROUGH_BYTES;
+	if (SendNvmeCommand(fd, true, command) && identify[77] != 0) {
+		max_transfer_bytes = MinValue<idx_t>(max_transfer_bytes, 4096ULL << identify[77]);
+	}
+	// The number of LBAs of a command is a 16 bit field
+	max_transfer_lbas = MinValue<idx_t>(MaxValue<idx_t>(max_transfer_bytes / geometry.lba_size, 1), 1ULL << 16);
+
+	memset(&command, 0, sizeof(command));
+	command.opcode = NVMEFS_NVME_ADMIN_OPC_GET_FEATURES;
+	command.nsid = nsid;
+	command.cdw10 = NVMEFS_NVME_FEATURE_FDP;
+	// The first bit of the result tells whether data placement is enabled
+	fdp = SendNvmeCommand(fd, true, command) && (command.result & 0x1);
+	if (!fdp) {
+		return;
+	}
+
+	// The reclaim unit handle status starts with a 16 byte header that holds the number of descriptors at byte 14,
+	// followed by a 32 byte descriptor per handle with the placement identifier at byte 0
+	auto receive_handles = [&](vector<uint8_t> &status) {
+		memset(&command, 0, sizeof(command));
+		command.opcode = NVMEFS_NVME_OPC_IO_MGMT_RECV;
+		command.nsid = nsid;
+		command.addr = reinterpret_cast<uintptr_t>(status.data());
+		command.data_len = status.size();
+		command.cdw10 = 1;
+		command.cdw11 = status.size() / 4 - 1;
+		return SendNvmeCommand(fd, false, command);
+	};
+	vector<uint8_t> status(16, 0);
+	if (!receive_handles(status)) {
+		fdp = false;
+		return;
+	}
+	uint16_t nr_handles;
+	memcpy(&nr_handles, status.data() + 14, sizeof(nr_handles));
+	status.assign(16 + nr_handles * 32, 0);
+	if (nr_handles == 0 || !receive_handles(status)) {
+		fdp = false;
+		return;
+	}
+	for (idx_t i = 0; i < nr_handles; i++) {
+		uint16_t placement_identifier;
+		memcpy(&placement_identifier, status.data() + 16 + i * 32, sizeof(placement_identifier));
+		placement_handles.push_back(placement_identifier);
+	}
+}
+
+void UringDevice::CreateRings() {
+	idx_t ring_count = options.rings == 0 ? max_threads : MinValue<idx_t>(options.rings, max_threads);
+	ring_count = MaxValue<idx_t>(ring_count, 1);
+	// Every thread has at most one command in flight, hence a ring needs at least an entry per thread that uses it
+	idx_t threads_per_ring = (max_threads + ring_count - 1) / ring_count;
+	unsigned entries = MaxValue<idx_t>(options.queue_depth, threads_per_ring);
+	idx_t buffer_size = (options.fixed_buffer_size + NVMEFS_DIRECT_BUFFER_ALIGNMENT - 1) /
+	                    NVMEFS_DIRECT_BUFFER_ALIGNMENT * NVMEFS_DIRECT_BUFFER_ALIGNMENT;
+
+	for (idx_t i = 0; i < ring_count; i++) {
+		auto ring = make_uniq<UringRing>();
+
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		if (mode == UringDeviceMode::PASSTHROUGH) {
+			// NVMe commands do not fit into the regular entries, and their completions carry the NVMe result
+			params.flags |= IORING_SETUP_SQE128 | IORING_SETUP_CQE32;
+		}
+		if (options.iopoll) {
+			params.flags |= IORING_SETUP_IOPOLL;
+		}
+		if (options.sqpoll) {
+			params.flags |= IORING_SETUP_SQPOLL;
+			params.sq_thread_idle = options.sqpoll_idle_ms;
+			// All rings share the submission thread of the first ring
+			if (!rings.empty()) {
+				params.flags |= IORING_SETUP_ATTACH_WQ;
+				params.wq_fd = rings.front()->ring.ring_fd;
+			}
+		}
+
+		int err = io_uring_queue_init_params(entries, &ring->ring, &params);
+		if (err < 0) {
+			throw IOException("Could not set up an io_uring for %s: %s", device_path, strerror(-err));
+		}
+		ring->initialized = true;
+
+		err = io_uring_register_files(&ring->ring, &fd, 1);
+		if (err < 0) {
+			throw IOException("Could not register %s with io_uring: %s", device_path, strerror(-err));
+		}
+
+		if (options.fixed_buffers > 0) {
+			void *allocation = nullptr;
+			if (posix_memalign(&allocation, NVMEFS_DIRECT_BUFFER_ALIGNMENT, options.fixed_buffers * buffer_size) != 0) {
+				throw std::bad_alloc();
+			}
+			ring->buffers = static_cast<data_ptr_t>(allocation);
+			ring->buffer_size = buffer_size;
+
+			vector<iovec> iovecs(options.fixed_buffers);
+			for (idx_t buffer_index = 0; buffer_index < options.fixed_buffers; buffer_index++) {
+				iovecs[buffer_index].iov_base = ring->GetFixedBuffer(buffer_index);
+				iovecs[buffer_index].iov_len = buffer_size;
+				ring->free_buffers.push_back(buffer_index);
+			}
+			err = io_uring_register_buffers(&ring->ring, iovecs.data(), iovecs.size());
+			if (err < 0) {
+				throw IOException("Could not register the fixed buffers of %s with io_uring, which may exceed "
+				                  "RLIMIT_MEMLOCK: %s",
+				                  device_path, strerror(-err));
+			}
+		}
+
+		rings.push_back(std::move(ring));
+	}
+}
+
+idx_t UringDevice::Write(void *buffer, const CmdContext &context) {
+	D_ASSERT(context.nr_lbas > 0);
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+	UringRing &ring = GetRing();
+
+	if (IsDirectTransfer(buffer, context)) {
+		Transfer(ring, true, static_cast<data_ptr_t>(buffer), context.start_lba, context.nr_lbas, optional_idx(),
+		         context);
+		return context.nr_lbas;
+	}
+
+	UringStagingBuffer staging(ring, context.nr_lbas * geometry.lba_size);
+	FileBackedLBAs::StageWrite(buffer, context, geometry.lba_size, staging.Get(),
+	                           GetTransfer(ring, staging.GetIndex(), context), io_statistics);
+
+	return context.nr_lbas;
+}
+
+idx_t UringDevice::Read(void *buffer, const CmdContext &context) {
+	D_ASSERT(context.nr_lbas > 0);
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+	UringRing &ring = GetRing();
+
+	if (IsDirectTransfer(buffer, context)) {
+		Transfer(ring, false, static_cast<data_ptr_t>(buffer), context.start_lba, context.nr_lbas, optional_idx(),
+		         context);
+		return context.nr_lbas;
+	}
+
+	UringStagingBuffer staging(ring, context.nr_lbas * geometry.lba_size);
+	FileBackedLBAs::StageRead(buffer, context, geometry.lba_size, staging.Get(),
+	                          GetTransfer(ring, staging.GetIndex(), context), io_statistics);
+
+	return context.nr_lbas;
+}
+
+idx_t UringDevice::Deallocate(const CmdContext &context) {
+	D_ASSERT(context.nr_lbas > 0);
+	idx_t offset = context.start_lba * geometry.lba_size;
+	idx_t nr_bytes = context.nr_lbas * geometry.lba_size;
+
+	switch (mode) {
+	case UringDeviceMode::PASSTHROUGH: {
+		// The length of a single range is limited to 32 bits, hence large deallocations are split over several ranges
+		const idx_t max_range_lbas = NumericLimits<uint32_t>::Maximum();
+		const idx_t nr_ranges = (context.nr_lbas + max_range_lbas - 1) / max_range_lbas;
+		if (nr_ranges > 256) {
+			throw IOException("Cannot deallocate %llu LBAs with a single dataset management command", context.nr_lbas);
+		}
+		vector<NvmeDsmRange> ranges(nr_ranges);
+		for (idx_t i = 0; i < nr_ranges; i++) {
+			idx_t range_start = i * max_range_lbas;
+			ranges[i].context_attributes = 0;
+			ranges[i].nr_lbas = MinValue<idx_t>(max_range_lbas, context.nr_lbas - range_start);
+			ranges[i].start_lba = context.start_lba + range_start;
+		}
+
+		UringRequest request;
+		request.opcode = NVMEFS_NVME_OPC_DSM;
+		request.buffer = reinterpret_cast<data_ptr_t>(ranges.data());
+		request.nr_bytes = nr_ranges * sizeof(NvmeDsmRange);
+		// The number of ranges is 0-based, and only the deallocate attribute is set
+		request.cdw10 = nr_ranges - 1;
+		request.cdw11 = 1 << 2;
+		int32_t result = SubmitAndWait(GetRing(), request);
+		if (result != 0) {
+			throw IOException("Could not deallocate LBAs of %s: %s", device_path, DescribeResult(result));
+		}
+		break;
+	}
+	case UringDeviceMode::BLOCK:
+	case UringDeviceMode::FILE:
+		FileBackedLBAs::Deallocate(fd, mode == UringDeviceMode::BLOCK, device_path, offset, nr_bytes);
+		break;
+	}
+
+	return context.nr_lbas;
+}
+
+DeviceGeometry UringDevice::GetDeviceGeometry() {
+	return geometry;
+}
+
+vector<pair<string, string>> UringDevice::GetDeviceInfo() {
+	vector<pair<string, string>> info = Device::GetDeviceInfo();
+	info.emplace_back("device_path", device_path);
+	info.emplace_back("backend", NVMEFS_URING_BACKEND);
+	switch (mode) {
+	case UringDeviceMode::PASSTHROUGH:
+		info.emplace_back("mode", "passthrough");
+		break;
+	case UringDeviceMode::BLOCK:
+		info.emplace_back("mode", "block");
+		break;
+	case UringDeviceMode::FILE:
+		info.emplace_back("mode", "file");
+		break;
+	}
+	info.emplace_back("direct", direct ? "true" : "false");
+	info.emplace_back("fdp", fdp ? "true" : "false");
+
+	vector<string> handles;
+	for (auto handle : placement_handles) {
+		handles.push_back(std::to_string(handle));
+	}
+	info.emplace_back("placement_handles", StringUtil::Join(handles, ","));
+	info.emplace_back("rings", std::to_string(rings.size()));
+	info.emplace_back("uring_options", options.ToString());
+	info.emplace_back("max_transfer_lbas", std::to_string(max_transfer_lbas));
+	return info;
+}
+
+bool UringDevice::IsDirectTransfer(void *buffer, const CmdContext &context) const {
+	// The NVMe driver maps buffers with dword alignment, while direct I/O needs buffers aligned to the LBA size
+	idx_t alignment = mode == UringDeviceMode::PASSTHROUGH ? 4 : (direct ? geometry.lba_size : 1);
+	return FileBackedLBAs::IsDirectTransfer(buffer, context, geometry.lba_size, alignment);
+}
+
+FileBackedLBAs::transfer_t UringDevice::GetTransfer(UringRing &ring, optional_idx buffer_index,
+                                                    const CmdContext &context) {
+	return [this, &ring, buffer_index, &context](bool write, data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas) {
+		Transfer(ring, write, buffer, start_lba, nr_lbas, buffer_index, context);
+	};
+}
+
+void UringDevice::Transfer(UringRing &ring, bool write, data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas,
+                           optional_idx buffer_index, const CmdContext &context) {
+	NvmeTraceSpan span(write ? "UringWrite" : "UringRead", context.category);
+	span.SetRange(start_lba, nr_lbas);
+	NvmeCommandProbe probe(context, write);
+	probe.Submitted();
+
+	for (idx_t done_lbas = 0; done_lbas < nr_lbas;) {
+		idx_t command_lbas = MinValue<idx_t>(nr_lbas - done_lbas, max_transfer_lbas);
+		idx_t lba = start_lba + done_lbas;
+
+		UringRequest request;
+		request.write = write;
+		request.buffer = buffer + done_lbas * geometry.lba_size;
+		request.nr_bytes = command_lbas * geometry.lba_size;
+		request.offset = lba * geometry.lba_size;
+		request.buffer_index = buffer_index;
+		if (mode == UringDeviceMode::PASSTHROUGH) {
+			request.opcode = write ? NVMEFS_NVME_OPC_WRITE : NVMEFS_NVME_OPC_READ;
+			request.cdw10 = lba & 0xFFFFFFFF;
+			request.cdw11 = lba >> 32;
+			// The number of LBAs is 0-based. Writes carry the directive type and placement handle on FDP devices.
+			request.cdw12 = command_lbas - 1;
+			if (write && fdp && !placement_handles.empty()) {
+				request.cdw12 |= NVMEFS_NVME_DATA_PLACEMENT_MODE << 20;
+				request.cdw13 = GetPlacementHandle(context.placement_identifier) << 16;
+			}
+		}
+
+		int32_t result = SubmitAndWait(ring, request);
+		if (mode == UringDeviceMode::FILE && !write && result >= 0 && static_cast<idx_t>(result) < request.nr_bytes) {
+			FileBackedLBAs::ZeroPastEndOfFile(request.buffer, result, request.nr_bytes);
+			result = request.nr_bytes;
+		}
+		// Passthrough commands complete with the NVMe status, while reads and writes return the transferred bytes
+		int32_t expected = mode == UringDeviceMode::PASSTHROUGH ? 0 : static_cast<int32_t>(request.nr_bytes);
+		if (result != expected) {
+			string reason =
+			    result >= 0 && mode != UringDeviceMode::PASSTHROUGH ? "short transfer" : DescribeResult(result);
+			throw IOException("Could not %s %llu LBAs at LBA %llu of %s: %s", write ? "write" : "read", command_lbas,
+			                  lba, device_path, reason);
+		}
+
+		done_lbas += command_lbas;
+	}
+
+	probe.Completed();
+}
+
+void UringDevice::PrepareSubmission(io_uring_sqe *sqe, UringRequest &request) {
+	if (mode == UringDeviceMode::PASSTHROUGH) {
+		// The NVMe command lives in the second half of the 128 byte entry, hence the whole entry is cleared
+		memset(sqe, 0, 2 * sizeof(io_uring_sqe));
+		sqe->opcode = IORING_OP_URING_CMD;
+		sqe->fd = 0;
+		sqe->flags = IOSQE_FIXED_FILE;
+		sqe->cmd_op = NVME_URING_CMD_IO;
+		if (request.buffer_index.IsValid()) {
+			sqe->uring_cmd_flags = IORING_URING_CMD_FIXED;
+			sqe->buf_index = request.buffer_index.GetIndex();
+		}
+
+		nvme_uring_cmd *command = reinterpret_cast<nvme_uring_cmd *>(sqe->cmd);
+		command->opcode = request.opcode;
+		command->nsid = nsid;
+		command->addr = reinterpret_cast<uintptr_t>(request.buffer);
+		command->data_len = request.nr_bytes;
+		command->cdw10 = request.cdw10;
+		command->cdw11 = request.cdw11;
+		command->cdw12 = request.cdw12;
+		command->cdw13 = request.cdw13;
+	} else if (request.buffer_index.IsValid()) {
+		int buffer_index = request.buffer_index.GetIndex();
+		if (request.write) {
+			io_uring_prep_write_fixed(sqe, 0, request.buffer, request.nr_bytes, request.offset, buffer_index);
+		} else {
+			io_uring_prep_read_fixed(sqe, 0, request.buffer, request.nr_bytes, request.offset, buffer_index);
+		}
+		sqe->flags |= IOSQE_FIXED_FILE;
+	} else {
+		if (request.write) {
+			io_uring_prep_write(sqe, 0, request.buffer, request.nr_bytes, request.offset);
+		} else {
+			io_uring_prep_read(sqe, 0, request.buffer, request.nr_bytes, request.offset);
+		}
+		sqe->flags |= IOSQE_FIXED_FILE;
+	}
+	io_uring_sqe_set_data(sqe, &request);
+}
+
+/// @brief Checks if a failed submission can be retried, as the kernel was interrupted, short on memory or needs the
+/// completion queue to be drained first
+static bool IsTransientSubmitError(int err) {
+	return err == -EINTR || err == -EAGAIN || err == -EBUSY;
+}
+
+int32_t UringDevice::SubmitAndWait(UringRing &ring, UringRequest &request) {
+	// The ring refers to the request until its completion is reaped, hence nothing may throw between the submission
+	// and the completion
+	bool submitted = false;
+	{
+		std::lock_guard<InstrumentedMutex<std::mutex>> guard(ring.submit_lock);
+		io_uring_sqe *sqe = io_uring_get_sqe(&ring.ring);
+		while (!sqe) {
+			// The submission queue is full. The polling thread consumes it on its own, otherwise it is submitted here.
+			int err = options.sqpoll ? io_uring_sqring_wait(&ring.ring) : io_uring_submit(&ring.ring);
+			if (err < 0 && !IsTransientSubmitError(err)) {
+				throw IOException("Could not submit a command for %s: %s", device_path, strerror(-err));
+			}
+			sqe = io_uring_get_sqe(&ring.ring);
+		}
+		PrepareSubmission(sqe, request);
+		int err = io_uring_submit(&ring.ring);
+		// The polling thread takes the entry even if it could not be woken up
+		submitted = err >= 0 || options.sqpoll;
+		if (!submitted && !IsTransientSubmitError(err)) {
+			// The entry cannot be taken back from the ring. Without a polling thread the kernel only reads entries
+			// while this lock is held, hence it becomes a no-op whose completion is ignored.
+			memset(sqe, 0, mode == UringDeviceMode::PASSTHROUGH ? 2 * sizeof(io_uring_sqe) : sizeof(io_uring_sqe));
+			io_uring_prep_nop(sqe);
+			io_uring_sqe_set_data(sqe, nullptr);
+			throw IOException("Could not submit a command for %s: %s", device_path, strerror(-err));
+		}
+	}
+
+	// One thread at a time waits for completions, and completes the requests of all threads that are ready. The other
+	// threads sleep until their request is done, or until the reaping thread leaves and one of them takes over.
+	std::unique_lock<std::mutex> completion_guard(ring.completion_lock);
+	while (!request.done) {
+		if (ring.reaping) {
+			ring.completed.wait(completion_guard);
+			continue;
+		}
+		ring.reaping = true;
+		completion_guard.unlock();
+
+		io_uring_cqe *cqes[NVMEFS_URING_REAP_BATCH];
+		unsigned count = 0;
+		if (!submitted) {
+			// The entry is still in the submission queue after a transient failure. Draining the completions makes
+			// room for it, and it is submitted again until the kernel takes it.
+			count = io_uring_peek_batch_cqe(&ring.ring, cqes, NVMEFS_URING_REAP_BATCH);
+			if (count == 0) {
+				std::lock_guard<InstrumentedMutex<std::mutex>> guard(ring.submit_lock);
+				submitted = io_uring_submit(&ring.ring) >= 0;
+			}
+		} else {
+			// A wait that fails, e.g. when interrupted, is retried, as the request must not go out of scope before its
+			// completion arrives
+			io_uring_cqe *cqe;
+			if (io_uring_wait_cqe(&ring.ring, &cqe) == 0) {
+				count = io_uring_peek_batch_cqe(&ring.ring, cqes, NVMEFS_URING_REAP_BATCH);
+			}
+		}
+
+		completion_guard.lock();
+		for (unsigned i = 0; i < count; i++) {
+			UringRequest *completed = static_cast<UringRequest *>(io_uring_cqe_get_data(cqes[i]));
+			// No-ops of submissions that failed have no request
+			if (completed) {
+				completed->result = cqes[i]->res;
+				completed->done = true;
+			}
+		}
+		io_uring_cq_advance(&ring.ring, count);
+		ring.reaping = false;
+		ring.completed.notify_all();
+	}
+
+	return request.result;
+}
+
+uint16_t UringDevice::GetPlacementHandle(idx_t placement_identifier) {
+	// Identifiers beyond the handles of the device wrap around, like on the NvmeDevice
+	return placement_handles[placement_identifier % placement_handles.size()];
+}
+
+UringRing &UringDevice::GetRing() {
+	// Threads keep their ring, and are spread over the rings in the order in which they first use a device
+	static atomic<idx_t> thread_counter {0};
+	static thread_local optional_idx thread_index;
+	if (!thread_index.IsValid()) {
+		thread_index = thread_counter++;
+	}
+	return *rings[thread_index.GetIndex() % rings.size()];
+}
+
+#else
+
+struct UringRing {};
+
+UringDevice::UringDevice(const string &device_path, const UringDeviceOptions &options, idx_t max_threads)
+    : device_path(device_path), options(options), max_threads(max_threads) {
+	throw IOException("Cannot open %s with the %s backend, as nvmefs was built without liburing", device_path,
+	                  NVMEFS_URING_BACKEND);
+}
+
+UringDevice::~UringDevice() {
+}
+
+idx_t UringDevice::Write(void *buffer, const CmdContext &context) {
+	throw InternalException("nvmefs was built without liburing");
+}
+
+idx_t UringDevice::Read(void *buffer, const CmdContext &context) {
+	throw InternalException("nvmefs was built without liburing");
+}
+
+idx_t UringDevice::Deallocate(const CmdContext &context) {
+	throw InternalException("nvmefs was built without liburing");
+}
+
+DeviceGeometry UringDevice::GetDeviceGeometry() {
+	throw InternalException("nvmefs was built without liburing");
+}
+
+vector<pair<string, string>> UringDevice::GetDeviceInfo() {
+	throw InternalException("nvmefs was built without liburing");
+}
+
+#endif
+
+} // namespace duckdb
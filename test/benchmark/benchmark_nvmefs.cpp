@@ -0,0 +1,268 @@
+#include <benchmark/benchmark.h>
+#include "nvmefs.hpp"
+#include "nvmefs_temporary_block_manager.hpp"
+#include "temporary_file_metadata_manager.hpp"
+#include "utils/fake_device.hpp"
+#include <mutex>
+
+/// Number of heap allocations made by the current thread
+static thread_local uint64_t thread_allocations = 0;
+
+#ifdef __GLIBC__
+// Every heap allocation of the benchmark goes through malloc, including operator new and the default allocator of
+// DuckDB. Counting the calls here therefore counts all allocations, without changing how memory is allocated.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+	thread_allocations++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+	thread_allocations++;
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	thread_allocations++;
+	return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+namespace duckdb {
+
+/// The benchmarks scale from a single thread up to this many threads
+constexpr idx_t BENCHMARK_MAX_THREADS = 64;
+/// Every thread reads and writes its own slots of a file, such that threads never touch the same data
+constexpr idx_t BENCHMARK_SLOTS_PER_THREAD = 16;
+/// A 4 TiB namespace. The fake device only allocates memory for the LBAs that are written.
+constexpr idx_t BENCHMARK_DEVICE_LBA_COUNT = (4ULL << 40) / DEFAULT_BLOCK_SIZE;
+
+/// @brief Reports the number of allocations per operation of the calling thread since the counter was created
+class AllocationCounter {
+public:
+	AllocationCounter() : start(thread_allocations) {
+	}
+
+	void Report(benchmark::State &state) {
+		// Counters are summed over all threads, hence dividing by the iterations of all threads gives the average
+		state.counters["allocs/op"] = benchmark::Counter(static_cast<double>(thread_allocations - start),
+		                                                 benchmark::Counter::kAvgIterations);
+	}
+
+private:
+	uint64_t start;
+};
+
+/// @brief A file of each category that DuckDB places on the device, with the size of a typical I/O to it
+struct BenchmarkFile {
+	const char *name;
+	const char *path;
+	idx_t io_size;
+};
+
+static const BenchmarkFile BENCHMARK_FILES[] = {
+    {"database", "nvmefs://bench.db", 1ULL << 18},
+    {"wal", "nvmefs://bench.db.wal", 1ULL << 12},
+    {"temporary", "nvmefs:///tmp/duckdb_temp_storage_DEFAULT-0.tmp", 1ULL << 18},
+    {"general", "nvmefs:///exports/bench.parquet", 1ULL << 16},
+};
+constexpr idx_t BENCHMARK_FILE_COUNT = sizeof(BENCHMARK_FILES) / sizeof(BenchmarkFile);
+
+/// @brief A file system on a fake device with one open file of each category. It is shared by all benchmarks and
+/// threads, and is created the first time it is used.
+class FileSystemEnvironment {
+public:
+	static FileSystemEnvironment &Get() {
+		static FileSystemEnvironment environment;
+		return environment;
+	}
+
+	NvmeFileSystem &GetFileSystem() {
+		return *file_system;
+	}
+
+	FileHandle &GetHandle(idx_t file) {
+		return *handles[file];
+	}
+
+private:
+	FileSystemEnvironment() {
+		NvmeConfig config {.device_path = "/dev/ng1n1", .max_temp_size = 200ULL << 30, .max_wal_size = 1ULL << 30};
+		file_system = make_uniq<NvmeFileSystem>(config, make_uniq<FakeDevice>(BENCHMARK_DEVICE_LBA_COUNT));
+
+		FileOpenFlags flags =
+		    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+		for (const auto &file : BENCHMARK_FILES) {
+			handles.push_back(file_system->OpenFile(file.path, flags));
+
+			// Every slot is written once up front, such that reads return written data and writes never grow a file
+			vector<char> buffer(file.io_size, 'p');
+			for (idx_t slot = 0; slot < BENCHMARK_MAX_THREADS * BENCHMARK_SLOTS_PER_THREAD; slot++) {
+				handles.back()->Write(buffer.data(), file.io_size, slot * file.io_size);
+			}
+			file_system->FileSync(*handles.back());
+		}
+	}
+
+private:
+	unique_ptr<NvmeFileSystem> file_system;
+	vector<unique_ptr<FileHandle>> handles;
+};
+
+static idx_t GetSlotLocation(const benchmark::State &state, idx_t iteration, idx_t io_size) {
+	idx_t slot = state.thread_index() * BENCHMARK_SLOTS_PER_THREAD + iteration % BENCHMARK_SLOTS_PER_THREAD;
+	return slot * io_size;
+}
+
+static void BM_FileSystemWrite(benchmark::State &state) {
+	const BenchmarkFile &file = BENCHMARK_FILES[state.range(0)];
+	FileHandle &handle = FileSystemEnvironment::Get().GetHandle(state.range(0));
+	vector<char> buffer(file.io_size, 'w');
+
+	idx_t iteration = 0;
+	AllocationCounter allocations;
+	for (auto _ : state) {
+		handle.Write(buffer.data(), file.io_size, GetSlotLocation(state, iteration++, file.io_size));
+	}
+	allocations.Report(state);
+
+	state.SetBytesProcessed(state.iterations() * file.io_size);
+	state.SetLabel(file.name);
+}
+
+static void BM_FileSystemRead(benchmark::State &state) {
+	const BenchmarkFile &file = BENCHMARK_FILES[state.range(0)];
+	FileHandle &handle = FileSystemEnvironment::Get().GetHandle(state.range(0));
+	vector<char> buffer(file.io_size);
+
+	idx_t iteration = 0;
+	AllocationCounter allocations;
+	for (auto _ : state) {
+		handle.Read(buffer.data(), file.io_size, GetSlotLocation(state, iteration++, file.io_size));
+		benchmark::DoNotOptimize(buffer.data());
+	}
+	allocations.Report(state);
+
+	state.SetBytesProcessed(state.iterations() * file.io_size);
+	state.SetLabel(file.name);
+}
+
+static void BM_WriteMetadata(benchmark::State &state) {
+	// WriteMetadata itself only runs when the device is formatted and when the file system is destroyed. Every
+	// checkpoint of a database writes its metadata through FileSync, i.e. the changed part of the extent table and
+	// the catalog entry of the database.
+	FileSystemEnvironment &environment = FileSystemEnvironment::Get();
+	FileHandle &handle = environment.GetHandle(0);
+
+	AllocationCounter allocations;
+	for (auto _ : state) {
+		environment.GetFileSystem().FileSync(handle);
+	}
+	allocations.Report(state);
+}
+
+/// Number of DEFAULT sized blocks of the temporary file used by the GetLBA benchmark
+constexpr idx_t BENCHMARK_TEMPORARY_BLOCKS = 4096;
+/// Number of LBAs of a DEFAULT sized temporary block
+constexpr idx_t BENCHMARK_TEMPORARY_BLOCK_LBAS = (1ULL << 18) / DEFAULT_BLOCK_SIZE;
+static const string BENCHMARK_TEMPORARY_FILE = "nvmefs:///tmp/duckdb_temp_storage_DEFAULT-0.tmp";
+
+static void BM_TemporaryGetLBA(benchmark::State &state) {
+	static TemporaryFileMetadataManager manager(0, BENCHMARK_TEMPORARY_BLOCKS * BENCHMARK_TEMPORARY_BLOCK_LBAS,
+	                                            DEFAULT_BLOCK_SIZE);
+	static std::once_flag initialized;
+	std::call_once(initialized, []() {
+		// All blocks are allocated up front, such that the benchmark measures the lookup of existing blocks
+		manager.CreateFile(BENCHMARK_TEMPORARY_FILE);
+		for (idx_t block = 0; block < BENCHMARK_TEMPORARY_BLOCKS; block++) {
+			manager.GetLBA(BENCHMARK_TEMPORARY_FILE, block * (1ULL << 18), BENCHMARK_TEMPORARY_BLOCK_LBAS);
+		}
+	});
+
+	// Threads look up blocks in a different order, such that they do not touch the same blocks in lockstep
+	idx_t block = state.thread_index();
+	AllocationCounter allocations;
+	for (auto _ : state) {
+		block = (block + 7919) % BENCHMARK_TEMPORARY_BLOCKS;
+		benchmark::DoNotOptimize(
+		    manager.GetLBA(BENCHMARK_TEMPORARY_FILE, block * (1ULL << 18), BENCHMARK_TEMPORARY_BLOCK_LBAS));
+	}
+	allocations.Report(state);
+}
+
+/// Number of LBAs managed by the block manager of the allocation benchmark
+constexpr idx_t BENCHMARK_BLOCK_MANAGER_LBAS = 1ULL << 22;
+/// Number of blocks that every thread keeps allocated while allocating and freeing blocks
+constexpr idx_t BENCHMARK_LIVE_BLOCKS_PER_THREAD = 16;
+/// Temporary blocks come in the sizes of the size classes of DuckDB, i.e. 32 KiB to 256 KiB
+static const idx_t BENCHMARK_BLOCK_LBAS[] = {8, 16, 24, 32, 40, 48, 56, 64};
+constexpr idx_t BENCHMARK_BLOCK_SIZE_COUNT = sizeof(BENCHMARK_BLOCK_LBAS) / sizeof(idx_t);
+
+static void BM_TemporaryAllocateFreeBlock(benchmark::State &state) {
+	// The block manager is not thread-safe. The file system protects it with a single lock, and so does the benchmark.
+	static std::mutex block_manager_lock;
+	static NvmeTemporaryBlockManager block_manager(0, BENCHMARK_BLOCK_MANAGER_LBAS);
+	static std::once_flag fragmented;
+	std::call_once(fragmented, []() {
+		// Fill the blocks with blocks of mixed sizes and free every other block, such that the free space is split
+		// into many small blocks that cannot be coalesced
+		vector<TemporaryBlock *> blocks;
+		for (idx_t i = 0;; i++) {
+			TemporaryBlock *block = block_manager.TryAllocateBlock(BENCHMARK_BLOCK_LBAS[i % BENCHMARK_BLOCK_SIZE_COUNT]);
+			if (!block) {
+				break;
+			}
+			blocks.push_back(block);
+		}
+		for (idx_t i = 0; i < blocks.size(); i += 2) {
+			block_manager.FreeBlock(blocks[i]);
+		}
+	});
+
+	vector<TemporaryBlock *> live_blocks(BENCHMARK_LIVE_BLOCKS_PER_THREAD, nullptr);
+	idx_t iteration = state.thread_index();
+	AllocationCounter allocations;
+	for (auto _ : state) {
+		idx_t slot = iteration % BENCHMARK_LIVE_BLOCKS_PER_THREAD;
+		idx_t lba_amount = BENCHMARK_BLOCK_LBAS[iteration % BENCHMARK_BLOCK_SIZE_COUNT];
+		iteration++;
+
+		std::lock_guard<std::mutex> lock(block_manager_lock);
+		if (live_blocks[slot]) {
+			block_manager.FreeBlock(live_blocks[slot]);
+		}
+		live_blocks[slot] = block_manager.TryAllocateBlock(lba_amount);
+	}
+	allocations.Report(state);
+
+	// Return the blocks of this run, such that every run starts from the same fragmentation
+	std::lock_guard<std::mutex> lock(block_manager_lock);
+	for (auto block : live_blocks) {
+		if (block) {
+			block_manager.FreeBlock(block);
+		}
+	}
+}
+
+BENCHMARK(BM_FileSystemWrite)
+    ->ArgName("file")
+    ->DenseRange(0, BENCHMARK_FILE_COUNT - 1)
+    ->ThreadRange(1, BENCHMARK_MAX_THREADS)
+    ->UseRealTime();
+BENCHMARK(BM_FileSystemRead)
+    ->ArgName("file")
+    ->DenseRange(0, BENCHMARK_FILE_COUNT - 1)
+    ->ThreadRange(1, BENCHMARK_MAX_THREADS)
+    ->UseRealTime();
+BENCHMARK(BM_WriteMetadata)->ThreadRange(1, BENCHMARK_MAX_THREADS)->UseRealTime();
+BENCHMARK(BM_TemporaryGetLBA)->ThreadRange(1, BENCHMARK_MAX_THREADS)->UseRealTime();
+BENCHMARK(BM_TemporaryAllocateFreeBlock)->ThreadRange(1, BENCHMARK_MAX_THREADS)->UseRealTime();
+
+} // namespace duckdb
+
+BENCHMARK_MAIN();
@@ -0,0 +1,164 @@
+#include "direct_device.hpp"
+#include "io_trace_replayer.hpp"
+#include "mirrored_device.hpp"
+#include "nvme_device.hpp"
+#include "striped_device.hpp"
+#include "uring_device.hpp"
+#include "utils/emulated_device.hpp"
+#include "utils/fake_device.hpp"
+
+#include <cstdio>
+#include <sys/resource.h>
+#include <thread>
+
+namespace duckdb {
+
+static const char *REPLAY_USAGE =
+    "Usage: nvmefs_replay <trace> [--device fake|emulated|<path>] [--backend <xnvme backend>|liburing|direct]\n"
+    "                     [--async] [--uring-options <options>] [--stripe-size <bytes>] [--mode closed|open]\n"
+    "                     [--workers <n>] [--speed <factor>] [--no-deallocate] [--mirror [--hedge-reads p99]]\n"
+    "\n"
+    "Replays a trace recorded with the nvme_trace_path setting on a device. The device is either a fake device in\n"
+    "memory, an emulated device that models the latency and bandwidth of an SSD, or an NVMe device or file that is\n"
+    "opened with xNVMe, or with liburing or pread and pwrite if the backend is liburing or direct. The data on the\n"
+    "device is overwritten. A comma-separated list of devices is striped over, or mirrored with --mirror.\n"
+    "The CPU time per command compares the overhead of the backends.\n";
+
+struct ReplayArguments {
+	string trace_path;
+	string device = "fake";
+	string backend = "nvme";
+	bool async = false;
+	string uring_options;
+	idx_t stripe_size = NVMEFS_DEFAULT_STRIPE_SIZE;
+	bool mirror = false;
+	string hedge_reads;
+	IOTraceReplayConfig config;
+};
+
+static ReplayArguments ParseArguments(int argc, char **argv) {
+	ReplayArguments arguments;
+	for (int i = 1; i < argc; i++) {
+		string argument = argv[i];
+		bool has_value = i + 1 < argc;
+		if (argument == "--device" && has_value) {
+			arguments.device = argv[++i];
+		} else if (argument == "--backend" && has_value) {
+			arguments.backend = argv[++i];
+		} else if (argument == "--async") {
+			arguments.async = true;
+		} else if (argument == "--uring-options" && has_value) {
+			arguments.uring_options = argv[++i];
+		} else if (argument == "--stripe-size" && has_value) {
+			arguments.stripe_size = std::stoull(argv[++i]);
+		} else if (argument == "--mirror") {
+			arguments.mirror = true;
+		} else if (argument == "--hedge-reads" && has_value) {
+			arguments.hedge_reads = argv[++i];
+		} else if (argument == "--mode" && has_value) {
+			arguments.config.mode = ParseIOTraceReplayMode(argv[++i]);
+		} else if (argument == "--workers" && has_value) {
+			arguments.config.workers = std::stoull(argv[++i]);
+		} else if (argument == "--speed" && has_value) {
+			arguments.config.speed = std::stod(argv[++i]);
+		} else if (argument == "--no-deallocate") {
+			arguments.config.deallocate = false;
+		} else if (argument[0] != '-' && arguments.trace_path.empty()) {
+			arguments.trace_path = argument;
+		} else {
+			throw InvalidInputException("Unknown argument '%s'", argument);
+		}
+	}
+	if (arguments.trace_path.empty()) {
+		throw InvalidInputException("No trace given");
+	}
+	return arguments;
+}
+
+static unique_ptr<Device> OpenDevice(const ReplayArguments &arguments, const string &device_path) {
+	if (arguments.backend == NVMEFS_DIRECT_BACKEND) {
+		return make_uniq<DirectDevice>(device_path);
+	}
+	if (arguments.backend == NVMEFS_URING_BACKEND) {
+		return make_uniq<UringDevice>(device_path, UringDeviceOptions::Parse(arguments.uring_options),
+		                              std::thread::hardware_concurrency());
+	}
+	return make_uniq<NvmeDevice>(device_path, arguments.backend, arguments.async, std::thread::hardware_concurrency());
+}
+
+static unique_ptr<Device> OpenDevice(const ReplayArguments &arguments, const IOTraceHeader &header) {
+	if (arguments.device == "fake") {
+		return make_uniq<FakeDevice>(header.lba_count, header.lba_size);
+	}
+	if (arguments.device == "emulated") {
+		EmulatedDeviceConfig config;
+		// Commands take as long as on the emulated SSD, such that the replay takes as long as it would on one
+		config.sleep = true;
+		return make_uniq<EmulatedDevice>(header.lba_count, config, header.lba_size);
+	}
+
+	vector<string> device_paths = StringUtil::Split(arguments.device, ',');
+	if (device_paths.size() <= 1) {
+		return OpenDevice(arguments, arguments.device);
+	}
+	vector<unique_ptr<Device>> members;
+	for (auto &device_path : device_paths) {
+		members.push_back(OpenDevice(arguments, device_path));
+	}
+	if (arguments.mirror) {
+		double hedge_percentile = MirroredDevice::ParseHedgePercentile(arguments.hedge_reads);
+		return make_uniq<MirroredDevice>(std::move(members), hedge_percentile, std::thread::hardware_concurrency());
+	}
+	return make_uniq<StripedDevice>(std::move(members), arguments.stripe_size, std::thread::hardware_concurrency());
+}
+
+/// @brief The user and system CPU time that the process has used so far
+static double GetCPUTimeMicros() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static int Replay(int argc, char **argv) {
+	ReplayArguments arguments = ParseArguments(argc, argv);
+
+	IOTraceHeader header;
+	vector<IOTraceRecord> records = ReadIOTrace(arguments.trace_path, header);
+	unique_ptr<Device> device = OpenDevice(arguments, header);
+
+	IOTraceReplayer replayer(header, std::move(records));
+	double cpu_start_us = GetCPUTimeMicros();
+	IOTraceReplayResult result = replayer.Replay(*device, arguments.config);
+	double cpu_us = GetCPUTimeMicros() - cpu_start_us;
+
+	double elapsed_s = static_cast<double>(result.elapsed_ns) / 1e9;
+	printf("device:         %s\n", device->GetName().c_str());
+	printf("mode:           %s\n", arguments.config.mode == IOTraceReplayMode::CLOSED_LOOP ? "closed" : "open");
+	printf("commands:       %llu\n", static_cast<unsigned long long>(result.commands));
+	printf("elapsed:        %.3f s\n", elapsed_s);
+	printf("iops:           %.0f\n", elapsed_s > 0 ? result.commands / elapsed_s : 0.0);
+	printf("read:           %.1f MiB/s\n", elapsed_s > 0 ? result.read_bytes / elapsed_s / (1 << 20) : 0.0);
+	printf("written:        %.1f MiB/s\n", elapsed_s > 0 ? result.written_bytes / elapsed_s / (1 << 20) : 0.0);
+	printf("avg latency:    %.1f us\n", result.GetAverageLatencyNanos() / 1000);
+	printf("max latency:    %.1f us\n", static_cast<double>(result.max_latency_ns) / 1000);
+	printf("cpu/command:    %.2f us\n", result.commands > 0 ? cpu_us / result.commands : 0.0);
+	if (arguments.config.mode == IOTraceReplayMode::OPEN_LOOP) {
+		printf("late commands:  %llu\n", static_cast<unsigned long long>(result.late_commands));
+	}
+	auto mirrored_device = dynamic_cast<MirroredDevice *>(device.get());
+	if (mirrored_device) {
+		printf("hedged reads:   %llu\n", static_cast<unsigned long long>(mirrored_device->GetHedgedReadCount()));
+	}
+	return 0;
+}
+
+} // namespace duckdb
+
+int main(int argc, char **argv) {
+	try {
+		return duckdb::Replay(argc, argv);
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s\n\n%s", e.what(), duckdb::REPLAY_USAGE);
+		return 1;
+	}
+}
@@ -0,0 +1,201 @@
+"""
+Spill benchmark for nvmefs.
+
+Runs TPC-H and/or TPC-DS queries under tight memory limits, such that DuckDB spills to temporary storage, and records
+the time of every query as JSON lines. Every configuration runs twice:
+
+- nvmefs on a regular file that xNVMe opens through one of its file backends (psync, posix, emu, thrpool, ...), such
+  that no NVMe device is needed.
+- DuckDB with a local database file and its default temporary directory next to the device file, as the baseline.
+
+Both use the same directory, hence the same underlying storage, such that the comparison is like-for-like.
+
+Example:
+    python3 test/benchmark/spill_benchmark.py --extension_dir_path build/release/extension/nvmefs \\
+        --work_dir /mnt/scratch/spill --backends psync,thrpool --threads 1,4 --memory_limits 75MB,500MB \\
+        --output results.jsonl
+"""
+
+import argparse
+import json
+import os
+import platform
+import shutil
+import sys
+import time
+
+import duckdb
+
+BENCHMARKS = {
+    "tpch": {"extension": "tpch", "generate": "CALL dbgen(sf={sf});", "query": "PRAGMA tpch({query});",
+             "queries": list(range(1, 23))},
+    "tpcds": {"extension": "tpcds", "generate": "CALL dsdgen(sf={sf});", "query": "PRAGMA tpcds({query});",
+              "queries": list(range(1, 100))},
+}
+
+
+def parse_list(value, convert=str):
+    return [convert(item.strip()) for item in value.split(",") if item.strip()]
+
+
+def parse_size(value):
+    units = {"K": 1 << 10, "M": 1 << 20, "G": 1 << 30, "T": 1 << 40}
+    value = value.strip().upper().rstrip("IB").rstrip("B")
+    if value and value[-1] in units:
+        return int(float(value[:-1]) * units[value[-1]])
+    return int(value)
+
+
+class System:
+    """
+    A way of storing the database and its temporary data. Creates fresh storage for every benchmark.
+    """
+
+    def __init__(self, name, backend, args):
+        self.name = name
+        self.backend = backend
+        self.args = args
+        self.directory = os.path.join(args.work_dir, f"{name}_{backend}" if backend else name)
+
+    def prepare(self):
+        shutil.rmtree(self.directory, ignore_errors=True)
+        os.makedirs(self.directory)
+
+    def connect(self, benchmark):
+        raise NotImplementedError
+
+    def cleanup(self):
+        shutil.rmtree(self.directory, ignore_errors=True)
+
+
+class NvmefsSystem(System):
+    def prepare(self):
+        super().prepare()
+        # A sparse file of the requested size acts as the namespace. An all-zero file is formatted by nvmefs.
+        self.device_path = os.path.join(self.directory, "device.img")
+        with open(self.device_path, "wb") as device:
+            device.truncate(self.args.device_size)
+
+        # The device is configured through a persistent secret that is read when the extension loads. The secret is
+        # stored in the work directory, such that the secrets of the user are left alone.
+        connection = self._open()
+        connection.execute(f"""CREATE OR REPLACE PERSISTENT SECRET nvmefs (
+                                   TYPE NVMEFS,
+                                   nvme_device_path '{self.device_path}',
+                                   backend          '{self.backend}'
+                               );""")
+        connection.close()
+
+    def _open(self):
+        connection = duckdb.connect(config={"allow_unsigned_extensions": "true",
+                                            "secret_directory": os.path.join(self.directory, "secrets")})
+        connection.load_extension("nvmefs")
+        return connection
+
+    def connect(self, benchmark):
+        connection = self._open()
+        connection.load_extension(BENCHMARKS[benchmark]["extension"])
+        connection.execute(f"ATTACH DATABASE 'nvmefs:///{benchmark}.db' AS bench (READ_WRITE);")
+        connection.execute("USE bench;")
+        return connection
+
+
+class LocalSystem(System):
+    def connect(self, benchmark):
+        connection = duckdb.connect(os.path.join(self.directory, f"{benchmark}.db"))
+        connection.execute(f"SET temp_directory = '{os.path.join(self.directory, 'tmp')}';")
+        connection.load_extension(BENCHMARKS[benchmark]["extension"])
+        return connection
+
+
+def run_benchmark(system, benchmark, args, emit):
+    definition = BENCHMARKS[benchmark]
+    queries = args.queries if args.queries else definition["queries"]
+
+    system.prepare()
+    try:
+        connection = system.connect(benchmark)
+        # Data is generated without a memory limit, such that only the queries spill
+        start = time.perf_counter()
+        connection.execute(definition["generate"].format(sf=args.scale_factor))
+        connection.execute("CHECKPOINT;")
+        emit(system, benchmark, {"phase": "generate", "elapsed_ms": (time.perf_counter() - start) * 1000})
+
+        for threads in args.threads:
+            for memory_limit in args.memory_limits:
+                connection.execute(f"SET threads = {threads};")
+                connection.execute(f"SET memory_limit = '{memory_limit}';")
+                for query in queries:
+                    for repetition in range(args.repetitions):
+                        record = {"phase": "query", "threads": threads, "memory_limit": memory_limit,
+                                  "query": query, "repetition": repetition}
+                        start = time.perf_counter()
+                        try:
+                            rows = connection.execute(definition["query"].format(query=query)).fetchall()
+                            record["elapsed_ms"] = (time.perf_counter() - start) * 1000
+                            record["rows"] = len(rows)
+                        except duckdb.Error as error:
+                            record["elapsed_ms"] = (time.perf_counter() - start) * 1000
+                            record["error"] = str(error)
+                        emit(system, benchmark, record)
+        connection.close()
+    finally:
+        if not args.keep:
+            system.cleanup()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--extension_dir_path", default="build/release/extension/nvmefs",
+                        help="Directory of the built nvmefs extension")
+    parser.add_argument("--work_dir", default="/tmp/nvmefs_spill_benchmark",
+                        help="Directory that holds the device files and the baseline databases")
+    parser.add_argument("--benchmarks", default="tpch", type=parse_list, help="tpch and/or tpcds")
+    parser.add_argument("--scale_factor", default=1, type=float)
+    parser.add_argument("--queries", default="", type=lambda value: parse_list(value, int),
+                        help="Queries to run. Defaults to all queries of the benchmark.")
+    parser.add_argument("--backends", default="psync,thrpool", type=parse_list,
+                        help="xNVMe file backends, e.g. psync, posix, emu, thrpool, io_uring or libaio")
+    parser.add_argument("--threads", default="1,4", type=lambda value: parse_list(value, int))
+    parser.add_argument("--memory_limits", default="75MB,500MB", type=parse_list)
+    parser.add_argument("--repetitions", default=3, type=int)
+    parser.add_argument("--device_size", default="64GiB", type=parse_size, help="Size of the device file")
+    parser.add_argument("--no_baseline", action="store_true", help="Skip the local temporary directory baseline")
+    parser.add_argument("--keep", action="store_true", help="Keep the device files and databases after a run")
+    parser.add_argument("--output", default="-", help="File to append the JSON lines to. Defaults to stdout.")
+    args = parser.parse_args()
+
+    for benchmark in args.benchmarks:
+        if benchmark not in BENCHMARKS:
+            parser.error(f"Unknown benchmark '{benchmark}', expected one of {', '.join(BENCHMARKS)}")
+
+    # Makes 'LOAD nvmefs' find the extension that was built from this repository
+    duckdb.sql(f"INSTALL nvmefs FROM '{args.extension_dir_path}';")
+    for benchmark in args.benchmarks:
+        duckdb.sql(f"INSTALL {BENCHMARKS[benchmark]['extension']};")
+
+    systems = [NvmefsSystem("nvmefs", backend, args) for backend in args.backends]
+    if not args.no_baseline:
+        systems.append(LocalSystem("local", None, args))
+
+    output = sys.stdout if args.output == "-" else open(args.output, "a")
+    environment = {"duckdb_version": duckdb.__version__, "host": platform.node(), "scale_factor": args.scale_factor,
+                   "started": time.strftime("%Y-%m-%dT%H:%M:%S")}
+
+    def emit(system, benchmark, record):
+        result = dict(environment, benchmark=benchmark, system=system.name, backend=system.backend, **record)
+        output.write(json.dumps(result) + "\n")
+        output.flush()
+
+    try:
+        for benchmark in args.benchmarks:
+            for system in systems:
+                print(f"Running {benchmark} on {system.name} {system.backend or ''}", file=sys.stderr)
+                run_benchmark(system, benchmark, args, emit)
+    finally:
+        if output is not sys.stdout:
+            output.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -5,6 +5,23 @@
 #include "nvmefs_temporary_block_manager.hpp"
 #include "utils/gtest_utils.hpp"
 #include "utils/fake_device.hpp"
+#include "utils/fdp_simulator_device.hpp"
+#include "utils/emulated_device.hpp"
+#include "io_trace_replayer.hpp"
+#include "nvmefs_tracer.hpp"
+#include "nvmefs_lock_statistics.hpp"
+#include "nvmefs_io_scheduler.hpp"
+#include "uring_device.hpp"
+#include "direct_device.hpp"
+#include "file_backed_lbas.hpp"
+#include "striped_device.hpp"
+#include "region_device.hpp"
+#include "mirrored_device.hpp"
+#include "nvmefs_probes.hpp"
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <thread>
 
 using ::testing::UnorderedElementsAre;
 
@@ -102,11 +119,43 @@ TEST_F(DiskInteractionTest, FileExistGivenValidWALFileReturnsTrue) {
 	EXPECT_TRUE(exists);
 }
 
-TEST_F(DiskInteractionTest, FileExistsThrowsIOExceptionIfMultipleDatabases) {
+TEST_F(DiskInteractionTest, FileExistsReturnFalseForDatabaseThatHasNotBeenCreated) {
 	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE;
 	unique_ptr<FileHandle> fh = file_system->OpenFile("nvmefs://test.db", flags);
 
-	EXPECT_THROW(file_system->FileExists("nvmefs://xyz.db"), IOException);
+	EXPECT_FALSE(file_system->FileExists("nvmefs://xyz.db"));
+	EXPECT_FALSE(file_system->FileExists("nvmefs://xyz.db.wal"));
+}
+
+TEST_F(DiskInteractionTest, WriteAndReadDataOfMultipleDatabasesOnOneDevice) {
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE;
+	unique_ptr<FileHandle> first_fh = file_system->OpenFile("nvmefs://first.db", flags);
+	unique_ptr<FileHandle> second_fh = file_system->OpenFile("nvmefs:///second.db", flags);
+	unique_ptr<FileHandle> second_wal_fh = file_system->OpenFile("nvmefs:///second.db.wal", flags);
+
+	vector<char> first_buf(4096 * 2, 'A');
+	vector<char> second_buf(4096, 'B');
+	vector<char> second_wal_buf(4096, 'C');
+	first_fh->Write(first_buf.data(), first_buf.size(), 0);
+	second_fh->Write(second_buf.data(), second_buf.size(), 0);
+	second_wal_fh->Write(second_wal_buf.data(), second_wal_buf.size(), 0);
+
+	// Each database has its own size and data even though they are written at the same locations
+	EXPECT_EQ(file_system->GetFileSize(*first_fh), first_buf.size());
+	EXPECT_EQ(file_system->GetFileSize(*second_fh), second_buf.size());
+	EXPECT_TRUE(file_system->FileExists("nvmefs://second.db"));
+
+	vector<char> first_res(first_buf.size());
+	vector<char> second_res(second_buf.size());
+	first_fh->Read(first_res.data(), first_res.size(), 0);
+	second_fh->Read(second_res.data(), second_res.size(), 0);
+	EXPECT_EQ(first_res, first_buf);
+	EXPECT_EQ(second_res, second_buf);
+
+	// Removing the WAL of one database leaves the others untouched
+	file_system->RemoveFile("nvmefs://second.db.wal");
+	EXPECT_EQ(file_system->GetFileSize(*second_wal_fh), 0);
+	EXPECT_EQ(file_system->GetFileSize(*first_fh), first_buf.size());
 }
 
 TEST_F(DiskInteractionTest, FileExistsReturnFalseWhenTemporaryFileDoNotExists) {
@@ -326,16 +375,46 @@ TEST_F(DiskInteractionTest, RemoveFileGivenValidTempFileRemovesIt) {
 	EXPECT_FALSE(file_system->FileExists(temp_filename));
 }
 
-TEST_F(DiskInteractionTest, RemoveFileGivenPathBesidesTMPOrWALDoesNothing) {
+TEST_F(DiskInteractionTest, RemoveFileGivenDatabaseReturnsItsAndItsWALExtentsToTheDevice) {
 	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE;
-	unique_ptr<FileHandle> fh = file_system->OpenFile("nvmefs://test.db", flags);
+	unique_ptr<FileHandle> db_fh = file_system->OpenFile("nvmefs://test.db", flags);
+	NvmeExtentAllocator &extent_allocator = file_system->GetExtentAllocator();
+	idx_t free_extents = extent_allocator.GetFreeExtentCount();
 
-	EXPECT_NO_THROW(file_system->RemoveFile("nvmefs://test.db"));
+	vector<char> buf(NVMEFS_MIN_EXTENT_SIZE + DEFAULT_BLOCK_SIZE, 'd');
+	db_fh->Write(buf.data(), buf.size(), 0);
+	unique_ptr<FileHandle> wal_fh = file_system->OpenFile("nvmefs://test.db.wal", flags);
+	wal_fh->Write(buf.data(), DEFAULT_BLOCK_SIZE, 0);
+	file_system->FileSync(*db_fh);
+	EXPECT_EQ(extent_allocator.GetFreeExtentCount(), free_extents - 3);
+	NvmeDatabase &database = *file_system->GetDatabaseCatalog().GetDatabase("test.db");
+	idx_t slot = database.slot;
+
+	file_system->RemoveFile("nvmefs://test.db");
+	EXPECT_EQ(extent_allocator.GetFreeExtentCount(), free_extents);
+	EXPECT_FALSE(file_system->FileExists("nvmefs://test.db"));
+	EXPECT_FALSE(file_system->FileExists("nvmefs://test.db.wal"));
+	EXPECT_THROW(db_fh->Write(buf.data(), DEFAULT_BLOCK_SIZE, 0), IOException);
+	EXPECT_THROW(wal_fh->Write(buf.data(), DEFAULT_BLOCK_SIZE, DEFAULT_BLOCK_SIZE), IOException);
+	EXPECT_THROW(file_system->RemoveFile("nvmefs://test.db"), IOException);
+
+	// The next database takes over the slot, and starts out empty
+	unique_ptr<FileHandle> other_fh = file_system->OpenFile("nvmefs://other.db", flags);
+	EXPECT_EQ(file_system->GetDatabaseCatalog().GetDatabase("other.db")->slot, slot);
+	EXPECT_EQ(file_system->GetFileSize(*other_fh), 0);
+}
+
+TEST_F(DiskInteractionTest, OpenFileOfMissingGeneralFileThrowIOException) {
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE;
+	ASSERT_THROW(file_system->OpenFile("nvmefs://test", flags), IOException);
 }
 
-TEST_F(DiskInteractionTest, OpenFileCompleteInvalidPathThrowInvalidInputException) {
-	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE;
-	ASSERT_THROW(file_system->OpenFile("nvmefs://test", flags), InvalidInputException);
+TEST_F(DiskInteractionTest, OpenFileOfMissingGeneralFileReturnsNullIfRequested) {
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE;
+	unique_ptr<FileHandle> fh = file_system->OpenFile("nvmefs://test.db", flags);
+
+	flags = FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_NULL_IF_NOT_EXISTS;
+	EXPECT_EQ(file_system->OpenFile("nvmefs:///exports/missing.csv", flags), nullptr);
 }
 
 TEST_F(DiskInteractionTest, OpenFileInvalidDBPathThrowIOException) {
@@ -590,7 +669,8 @@ TEST_F(DiskInteractionTest, ReadWithReturnOfBytesAfterSettingSeek) {
 TEST_F(DiskInteractionTest, WriteOutOfMetadataAssignedLBARangeForDBFile) {
 	// Create a file
 	const string file_path = "nvmefs://test.db";
-	const uint64_t max_lba = 253311;
+	// The database can grow to the size of the device minus the extent reserved for metadata
+	const uint64_t max_lba = (1ULL << 30) / 4096 - NVMEFS_MIN_EXTENT_SIZE / 4096;
 	unique_ptr<FileHandle> file =
 	    file_system->OpenFile(file_path, FileFlags::FILE_FLAGS_WRITE | FileFlags::FILE_FLAGS_READ);
 	ASSERT_TRUE(file != nullptr);
@@ -602,6 +682,67 @@ TEST_F(DiskInteractionTest, WriteOutOfMetadataAssignedLBARangeForDBFile) {
 	EXPECT_THROW(file->Write(data_ptr.data(), data_size, max_lba * 4096), std::runtime_error);
 }
 
+TEST_F(DiskInteractionTest, WriteDBFileGrowsIntoSpaceNotUsedByTemporaryFiles) {
+	const string file_path = "nvmefs://test.db";
+	// Beyond the fixed database region of earlier versions, where the WAL and temporary region started
+	const uint64_t lba = 253311;
+	unique_ptr<FileHandle> file =
+	    file_system->OpenFile(file_path, FileFlags::FILE_FLAGS_WRITE | FileFlags::FILE_FLAGS_READ);
+
+	string hello = "Hello, World!";
+	vector<char> data_ptr {hello.begin(), hello.end()};
+	int data_size = data_ptr.size();
+	file->Write(data_ptr.data(), data_size, lba * 4096);
+
+	vector<char> buffer(data_size);
+	file->Read(buffer.data(), data_size, lba * 4096);
+
+	EXPECT_EQ(string(buffer.data(), data_size), hello);
+	EXPECT_EQ(file->GetFileSize(), (lba + 1) * 4096);
+}
+
+TEST_F(DiskInteractionTest, WriteAndReadDataAcrossExtentBoundary) {
+	const string file_path = "nvmefs://test.db";
+	unique_ptr<FileHandle> file =
+	    file_system->OpenFile(file_path, FileFlags::FILE_FLAGS_WRITE | FileFlags::FILE_FLAGS_READ);
+
+	// Force the WAL to take the extent after the first database extent, such that the database is not contiguous
+	unique_ptr<FileHandle> wal_file =
+	    file_system->OpenFile("nvmefs://test.db.wal", FileFlags::FILE_FLAGS_WRITE | FileFlags::FILE_FLAGS_READ);
+	vector<char> first_block(4096, 'A');
+	file->Write(first_block.data(), first_block.size(), 0);
+	wal_file->Write(first_block.data(), first_block.size(), 0);
+
+	// A DuckDB block that starts three LBAs before the end of the first extent
+	idx_t location = NVMEFS_MIN_EXTENT_SIZE - 3 * 4096;
+	vector<char> write_buffer(4096 * 64);
+	for (idx_t i = 0; i < write_buffer.size(); i++) {
+		write_buffer[i] = 'a' + (i / 4096) % 26;
+	}
+	file->Write(write_buffer.data(), write_buffer.size(), location);
+
+	vector<char> read_buffer(write_buffer.size());
+	file->Read(read_buffer.data(), read_buffer.size(), location);
+
+	EXPECT_EQ(read_buffer, write_buffer);
+}
+
+TEST_F(DiskInteractionTest, TruncateDBFileReturnsExtentsToTheDevice) {
+	const string file_path = "nvmefs://test.db";
+	unique_ptr<FileHandle> file =
+	    file_system->OpenFile(file_path, FileFlags::FILE_FLAGS_WRITE | FileFlags::FILE_FLAGS_READ);
+	NvmeExtentAllocator &extent_allocator = file_system->GetExtentAllocator();
+	idx_t free_extents = extent_allocator.GetFreeExtentCount();
+
+	vector<char> buffer(4096, 'A');
+	file->Write(buffer.data(), buffer.size(), NVMEFS_MIN_EXTENT_SIZE * 3);
+	EXPECT_EQ(extent_allocator.GetFreeExtentCount(), free_extents - 4);
+
+	file->Truncate(4096);
+	EXPECT_EQ(extent_allocator.GetFreeExtentCount(), free_extents - 1);
+	EXPECT_EQ(file->GetFileSize(), 4096);
+}
+
 TEST_F(DiskInteractionTest, WriteOutOfMetadataAssignedLBARangeForWALFile) {
 	// Create a file
 	const string file_path = "nvmefs://test.db.wal";
@@ -833,6 +974,25 @@ TEST_F(DiskInteractionTest, ListFilesOfPrefixDirectoryYieldsCorrectFilesAndDirSt
 	                                 std::make_tuple(wal_filename, false)));
 }
 
+TEST_F(DiskInteractionTest, ListFilesOfPrefixDirectoryYieldsAllDatabases) {
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE;
+	unique_ptr<FileHandle> fh = file_system->OpenFile("nvmefs://test.db", flags);
+	unique_ptr<FileHandle> other_fh = file_system->OpenFile("nvmefs://other.db", flags);
+
+	vector<std::tuple<string, bool>> results;
+
+	std::function<void(const string &, bool)> lister = [&results](const string &directory, bool is_dir) {
+		results.push_back(std::make_tuple(directory, is_dir));
+	};
+
+	bool dir = file_system->ListFiles("nvmefs://", lister);
+
+	EXPECT_EQ(dir, true);
+	EXPECT_THAT(results, UnorderedElementsAre(std::make_tuple("test.db", false), std::make_tuple("test.db.wal", false),
+	                                          std::make_tuple("other.db", false),
+	                                          std::make_tuple("other.db.wal", false), std::make_tuple("/tmp", true)));
+}
+
 TEST_F(DiskInteractionTest, ListFilesOfTemporaryDirectoryWithFilesYieldCorrectListOfFiles) {
 	const string tmp_dir_filepath = "nvmefs:///tmp";
 
@@ -922,10 +1082,9 @@ TEST_F(DiskInteractionTest, GetAvailableDiskSpaceDefaultDirWithNoAllocationRetur
 
 	DeviceGeometry geo = file_system->GetDevice().GetDeviceGeometry();
 
-	// We allocate 1 LBA for global metadata and
-	// SingleFileBlockManager::CreateNewDatabase() writes 3 headers (3 LBAs)
+	// The first extent is reserved for the global metadata and the extent table
 
-	idx_t expected_size = geo.lba_count * geo.lba_size - (4 * geo.lba_size);
+	idx_t expected_size = geo.lba_count * geo.lba_size - NVMEFS_MIN_EXTENT_SIZE;
 	optional_idx result = file_system->GetAvailableDiskSpace("nvmefs://");
 	ASSERT_TRUE(result.IsValid());
 	EXPECT_EQ(result.GetIndex(), expected_size);
@@ -938,11 +1097,10 @@ TEST_F(DiskInteractionTest, GetAvailableDiskSpaceDefaultDirWritesInTmpAndWalRetu
 
 	DeviceGeometry geo = file_system->GetDevice().GetDeviceGeometry();
 
-	// We allocate 1 LBA for global metadata and
-	// SingleFileBlockManager::CreateNewDatabase() writes 3 headers (3 LBAs)
+	// The first extent is reserved for the global metadata and the extent table
 
-	// Temp file with 2 LBAs and WAL with 1 LBA written
-	idx_t expected_size = (geo.lba_count * geo.lba_size) - (32768) - geo.lba_size - (4 * geo.lba_size);
+	// Temp file with 8 LBAs and WAL with 1 LBA written
+	idx_t expected_size = (geo.lba_count * geo.lba_size) - (32768) - geo.lba_size - NVMEFS_MIN_EXTENT_SIZE;
 
 	// Allocate files and write to them
 	string tmp_file_path1 = StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0);
@@ -990,6 +1148,300 @@ TEST_F(DiskInteractionTest, GetAvailableDiskSpaceTmpDirectoryWithTwoFilesReturnC
 	EXPECT_EQ(result_size.GetIndex(), expected_size);
 }
 
+TEST_F(DiskInteractionTest, RemoveFileGivenTempFileReturnsTemporaryExtentsToTheDevice) {
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> fh = file_system->OpenFile("nvmefs://test.db", flags);
+	NvmeExtentAllocator &extent_allocator = file_system->GetExtentAllocator();
+	idx_t free_extents = extent_allocator.GetFreeExtentCount();
+
+	string temp_filename = StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0);
+	vector<char> buf = vector<char>(32768);
+	fh = file_system->OpenFile(temp_filename, flags);
+	fh->Write(buf.data(), buf.size());
+
+	// Temporary space is only taken from the device when it is needed
+	EXPECT_EQ(extent_allocator.GetFreeExtentCount(), free_extents - 1);
+
+	file_system->RemoveFile(temp_filename);
+	EXPECT_EQ(extent_allocator.GetFreeExtentCount(), free_extents);
+}
+
+TEST_F(DiskInteractionTest, WriteAndReadGeneralFileWithUnalignedAppends) {
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE_NEW;
+	unique_ptr<FileHandle> fh = file_system->OpenFile("nvmefs:///exports/lineitem.csv", flags);
+	DeviceGeometry geo = file_system->GetDevice().GetDeviceGeometry();
+
+	// Appends of odd sizes that start and end inside LBAs, like the rows of a CSV file
+	string expected;
+	for (idx_t i = 0; i < 300; i++) {
+		string row = StringUtil::Format("%llu,row-%llu,%s\n", i, i * 7, string(i % 37, 'x'));
+		fh->Write((void *)row.data(), row.length());
+		expected += row;
+	}
+	ASSERT_GT(expected.length(), 2 * geo.lba_size);
+	EXPECT_EQ(file_system->GetFileSize(*fh), expected.length());
+
+	fh = file_system->OpenFile("nvmefs:///exports/lineitem.csv", FileOpenFlags::FILE_FLAGS_READ);
+	string result(expected.length(), '\0');
+	EXPECT_EQ(fh->Read((void *)result.data(), result.length() + 100), expected.length());
+	EXPECT_EQ(result, expected);
+
+	// Read at an offset that spans an LBA boundary
+	idx_t location = geo.lba_size - 10;
+	string part(geo.lba_size + 20, '\0');
+	fh->Read((void *)part.data(), part.length(), location);
+	EXPECT_EQ(part, expected.substr(location, part.length()));
+
+	EXPECT_THROW(fh->Read((void *)part.data(), part.length(), expected.length() - 1), IOException);
+}
+
+TEST_F(DiskInteractionTest, GeneralFilesInANestedTmpDirectoryAreNotTemporary) {
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE_NEW;
+	unique_ptr<FileHandle> fh = file_system->OpenFile("nvmefs:///data/tmp/x.csv", flags);
+	string data = "id,name\n1,nested\n";
+	fh->Write((void *)data.data(), data.length());
+	fh.reset();
+
+	EXPECT_TRUE(file_system->FileExists("nvmefs:///data/tmp/x.csv"));
+	vector<string> temporary_files;
+	file_system->ListFiles("nvmefs:///tmp", [&](const string &name, bool) { temporary_files.push_back(name); });
+	EXPECT_TRUE(temporary_files.empty());
+	vector<string> nested_files;
+	file_system->ListFiles("nvmefs:///data/tmp", [&](const string &name, bool) { nested_files.push_back(name); });
+	EXPECT_THAT(nested_files, testing::ElementsAre("x.csv"));
+
+	fh = file_system->OpenFile("nvmefs:///data/tmp/x.csv", FileOpenFlags::FILE_FLAGS_READ);
+	string result(data.length(), '\0');
+	EXPECT_EQ(fh->Read((void *)result.data(), result.length()), data.length());
+	EXPECT_EQ(result, data);
+}
+
+TEST_F(DiskInteractionTest, AppendToGeneralFileContinuesAtEndOfFile) {
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> fh = file_system->OpenFile("nvmefs://out.csv", flags);
+	string first = "a,b,c\n";
+	fh->Write((void *)first.data(), first.length());
+
+	fh = file_system->OpenFile("nvmefs://out.csv", flags | FileOpenFlags::FILE_FLAGS_APPEND);
+	string second = "1,2,3\n";
+	fh->Write((void *)second.data(), second.length());
+
+	string result(first.length() + second.length(), '\0');
+	fh->Read((void *)result.data(), result.length(), 0);
+	EXPECT_EQ(result, first + second);
+	EXPECT_TRUE(file_system->FileExists("nvmefs:///out.csv"));
+}
+
+TEST_F(DiskInteractionTest, ListFilesOfGeneralDirectoryYieldsFilesAndSubdirectories) {
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	string data = "data";
+	for (const string path : {"nvmefs:///exports/a.parquet", "nvmefs:///exports/b.parquet",
+	                          "nvmefs:///exports/year=2024/c.parquet", "nvmefs:///other.csv"}) {
+		unique_ptr<FileHandle> fh = file_system->OpenFile(path, flags);
+		fh->Write((void *)data.data(), data.length());
+	}
+
+	vector<std::tuple<string, bool>> results;
+	auto lister = [&results](const string &name, bool is_dir) {
+		results.push_back(std::make_tuple(name, is_dir));
+	};
+
+	EXPECT_TRUE(file_system->ListFiles("nvmefs:///exports/", lister));
+	EXPECT_THAT(results, UnorderedElementsAre(std::make_tuple("a.parquet", false), std::make_tuple("b.parquet", false),
+	                                          std::make_tuple("year=2024", true)));
+
+	EXPECT_THAT(file_system->Glob("nvmefs:///exports/*.parquet"),
+	            UnorderedElementsAre("nvmefs:///exports/a.parquet", "nvmefs:///exports/b.parquet"));
+	EXPECT_THAT(file_system->Glob("nvmefs:///exports/*/*.parquet"),
+	            UnorderedElementsAre("nvmefs:///exports/year=2024/c.parquet"));
+}
+
+TEST_F(DiskInteractionTest, RemoveGeneralFileReturnsExtentsToTheDevice) {
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> fh = file_system->OpenFile("nvmefs:///exports/big.parquet", flags);
+	NvmeExtentAllocator &extent_allocator = file_system->GetExtentAllocator();
+	idx_t free_extents = extent_allocator.GetFreeExtentCount();
+
+	vector<char> buf(NVMEFS_MIN_EXTENT_SIZE + 100, 'p');
+	fh->Write(buf.data(), buf.size());
+	EXPECT_EQ(extent_allocator.GetFreeExtentCount(), free_extents - 2);
+
+	file_system->RemoveFile("nvmefs:///exports/big.parquet");
+	EXPECT_EQ(extent_allocator.GetFreeExtentCount(), free_extents);
+	EXPECT_FALSE(file_system->FileExists("nvmefs:///exports/big.parquet"));
+	EXPECT_THROW(fh->Write(buf.data(), buf.size()), IOException);
+	EXPECT_THROW(file_system->RemoveFile("nvmefs:///exports/big.parquet"), IOException);
+}
+
+TEST_F(DiskInteractionTest, ProductionSizedDeviceOnlyAllocatesWrittenMemory) {
+	// A 4 TiB namespace with the default 200 GiB temporary region
+	NvmeConfig config {.device_path = "/dev/ng1n1", .max_temp_size = 200ULL << 30, .max_wal_size = 1ULL << 30};
+	unique_ptr<FakeDevice> fake_device = make_uniq<FakeDevice>((4ULL << 40) / DEFAULT_BLOCK_SIZE);
+	FakeDevice &device = *fake_device;
+	file_system = make_uniq<NvmeFileSystem>(config, std::move(fake_device));
+
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> db_fh = file_system->OpenFile("nvmefs://test.db", flags);
+	unique_ptr<FileHandle> tmp_fh =
+	    file_system->OpenFile("nvmefs:///tmp/duckdb_temp_storage_S32K-0.tmp", flags);
+
+	vector<char> buf(1ULL << 18, 'x');
+	db_fh->Write(buf.data(), buf.size(), 0);
+	tmp_fh->Write(buf.data(), 32768, 0);
+	file_system->FileSync(*db_fh);
+
+	EXPECT_GT(file_system->GetAvailableDiskSpace("nvmefs://").GetIndex(), 3ULL << 40);
+	EXPECT_LT(device.GetAllocatedBytes(), 64ULL << 20);
+
+	vector<char> result(buf.size());
+	db_fh->Read(result.data(), result.size(), 0);
+	EXPECT_EQ(result, buf);
+}
+
+TEST_F(DiskInteractionTest, RemovedFilesAreDeallocatedOnTheDevice) {
+	NvmeConfig config {.device_path = "/dev/ng1n1", .max_temp_size = 1ULL << 28, .max_wal_size = 1ULL << 25};
+	unique_ptr<FdpSimulatorDevice> simulator = make_uniq<FdpSimulatorDevice>((1ULL << 30) / DEFAULT_BLOCK_SIZE);
+	FdpSimulatorDevice &device = *simulator;
+	file_system = make_uniq<NvmeFileSystem>(config, std::move(simulator));
+
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> fh = file_system->OpenFile("nvmefs:///exports/big.parquet", flags);
+	vector<char> buf(NVMEFS_MIN_EXTENT_SIZE + 100, 'p');
+	fh->Write(buf.data(), buf.size());
+	EXPECT_EQ(device.GetStats().deallocated_lbas, 0);
+
+	// The extents are only deallocated once the extent table no longer refers to them
+	file_system->RemoveFile("nvmefs:///exports/big.parquet");
+	idx_t written_lbas = (buf.size() + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+	EXPECT_EQ(device.GetStats().deallocated_lbas, written_lbas);
+}
+
+TEST_F(DiskInteractionTest, WritesAreTaggedWithThePlacementIdentifierOfTheirRegion) {
+	NvmeConfig config {.device_path = "/dev/ng1n1",
+	                   .max_temp_size = 1ULL << 28,
+	                   .max_wal_size = 1ULL << 25,
+	                   .placement_policy = "database=1,wal=2,temporary=3,temporary:S32K=4,general=5,metadata=6"};
+	unique_ptr<FakeDevice> fake_device = make_uniq<FakeDevice>((1ULL << 30) / DEFAULT_BLOCK_SIZE);
+	FakeDevice &device = *fake_device;
+	file_system = make_uniq<NvmeFileSystem>(config, std::move(fake_device));
+
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	vector<char> buf(262144, 'x');
+	idx_t lba_size = DEFAULT_BLOCK_SIZE;
+
+	auto write_and_get_placement = [&](const string &path, idx_t nr_bytes) {
+		unique_ptr<FileHandle> fh = file_system->OpenFile(path, flags);
+		idx_t writes = device.GetWrites().size();
+		fh->Write(buf.data(), nr_bytes, 0);
+
+		vector<FakeDeviceWrite> all_writes = device.GetWrites();
+		EXPECT_GT(all_writes.size(), writes);
+		return all_writes[writes].placement_identifier;
+	};
+
+	EXPECT_EQ(write_and_get_placement("nvmefs://test.db", lba_size), 1);
+	EXPECT_EQ(write_and_get_placement("nvmefs://test.db.wal", lba_size), 2);
+	EXPECT_EQ(write_and_get_placement("nvmefs:///tmp/duckdb_temp_storage_DEFAULT-0.tmp", 262144), 3);
+	EXPECT_EQ(write_and_get_placement("nvmefs:///tmp/duckdb_temp_storage_S32K-0.tmp", 32768), 4);
+	EXPECT_EQ(write_and_get_placement("nvmefs:///exports/out.csv", 100), 5);
+
+	// The superblock is written when the device is formatted
+	EXPECT_EQ(device.GetPlacementIdentifier(NVMEFS_GLOBAL_METADATA_LOCATION).GetIndex(), 6);
+}
+
+/// @brief Simulates checkpoints that rewrite the same few blocks (e.g. the header and metadata) while appending new
+/// blocks to the database, and returns the write amplification of the simulated device
+static double RunCheckpointWorkload(const string &placement_policy) {
+	NvmeConfig config {.device_path = "/dev/ng1n1",
+	                   .max_temp_size = 1ULL << 24,
+	                   .max_wal_size = 1ULL << 25,
+	                   .placement_policy = placement_policy};
+	// 64 MiB device with 1 MiB reclaim units and 10% over-provisioning
+	FdpSimulatorConfig simulator_config {.erase_block_lba_count = 64,
+	                                     .erase_blocks_per_reclaim_unit = 4,
+	                                     .over_provisioning = 0.1};
+	unique_ptr<FdpSimulatorDevice> simulator = make_uniq<FdpSimulatorDevice>(16384, simulator_config);
+	FdpSimulatorDevice &device = *simulator;
+	NvmeFileSystem file_system(config, std::move(simulator));
+
+	FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE;
+	unique_ptr<FileHandle> fh = file_system.OpenFile("nvmefs://test.db", flags);
+
+	idx_t block_size = 1ULL << 18;
+	idx_t hot_blocks = 4;
+	idx_t max_blocks = 200;
+	vector<char> block(block_size, 'b');
+
+	idx_t next_block = hot_blocks;
+	for (idx_t checkpoint = 0; checkpoint < 400; checkpoint++) {
+		for (idx_t i = 0; i < hot_blocks; i++) {
+			fh->Write(block.data(), block_size, i * block_size);
+		}
+		// The database grows until it is full, after which old cold blocks are rewritten
+		fh->Write(block.data(), block_size, next_block * block_size);
+		next_block = next_block + 1 == max_blocks ? hot_blocks : next_block + 1;
+
+		file_system.FileSync(*fh);
+	}
+
+	return device.GetWriteAmplification();
+}
+
+TEST_F(DiskInteractionTest, SeparatingHotDatabaseBlocksLowersWriteAmplification) {
+	double mixed_waf = RunCheckpointWorkload("database=0");
+	double separated_waf = RunCheckpointWorkload("database=0,database:hot=3");
+
+	EXPECT_GT(mixed_waf, 1.2);
+	EXPECT_LT(separated_waf, mixed_waf);
+	EXPECT_LT(separated_waf, 1.1);
+}
+
+TEST_F(DiskInteractionTest, CompactionEmptiesSparseTemporaryExtentsAndKeepsTheirData) {
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> db = file_system->OpenFile("nvmefs://test.db", flags);
+	string kept_path = StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0);
+	string deleted_path = StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 1);
+	unique_ptr<FileHandle> kept = file_system->OpenFile(kept_path, flags);
+	unique_ptr<FileHandle> deleted = file_system->OpenFile(deleted_path, flags);
+
+	// The blocks of both files alternate on the device and fill two extents of 1 MiB
+	vector<char> buf(32768);
+	for (idx_t i = 0; i < 32; i++) {
+		memset(buf.data(), 'a' + i % 26, buf.size());
+		kept->Write(buf.data(), buf.size(), i * buf.size());
+		deleted->Write(buf.data(), buf.size(), i * buf.size());
+	}
+	deleted.reset();
+	file_system->RemoveFile(deleted_path);
+
+	TemporaryFileMetadataManager &temp_manager = file_system->GetTemporaryFileMetadataManager();
+	TemporaryFragmentationStatistics before = temp_manager.GetFragmentationStatistics();
+	EXPECT_EQ(before.range_count, 2);
+	EXPECT_EQ(before.free_blocks, 32);
+	EXPECT_EQ(before.largest_free_block, 8);
+
+	TemporaryCompactionResult result = file_system->CompactTemporaryFiles();
+	EXPECT_EQ(result.relocated_blocks, 16);
+	EXPECT_EQ(result.relocated_lbas, 16 * 8);
+	EXPECT_EQ(result.skipped_blocks, 0);
+	EXPECT_EQ(result.released_extents, 1);
+
+	TemporaryFragmentationStatistics after = temp_manager.GetFragmentationStatistics();
+	EXPECT_EQ(after.range_count, 1);
+	EXPECT_EQ(after.free_lbas, 0);
+
+	vector<char> read_buf(32768);
+	for (idx_t i = 0; i < 32; i++) {
+		kept->Read(read_buf.data(), read_buf.size(), i * read_buf.size());
+		memset(buf.data(), 'a' + i % 26, buf.size());
+		EXPECT_EQ(memcmp(read_buf.data(), buf.data(), buf.size()), 0) << "block " << i;
+	}
+}
+
 class BlockManagerTest : public testing::Test {
 protected:
 	BlockManagerTest() {
@@ -1232,6 +1684,1965 @@ TEST_F(BlockManagerTest, FreelistCoalesceLeftInTheMiddleOfTheList) {
 	EXPECT_EQ(block11->IsFree(), false);
 }
 
+TEST_F(BlockManagerTest, AddRangeAllocatesFromNonAdjacentRangeWhenFull) {
+	NvmeTemporaryBlockManager manager;
+	manager.AddRange(1024, 16);
+
+	TemporaryBlock *block1 = manager.AllocateBlock(16);
+	EXPECT_EQ(block1->GetStartLBA(), 1024);
+	EXPECT_EQ(manager.TryAllocateBlock(8), nullptr);
+
+	manager.AddRange(4096, 16);
+	TemporaryBlock *block2 = manager.AllocateBlock(8);
+	EXPECT_EQ(block2->GetStartLBA(), 4096);
+	EXPECT_EQ(manager.GetManagedLBACount(), 32);
+}
+
+TEST_F(BlockManagerTest, FreeBlocksAreNotMergedAcrossRanges) {
+	NvmeTemporaryBlockManager manager;
+	manager.AddRange(0, 16);
+	manager.AddRange(16, 16);
+
+	TemporaryBlock *block1 = manager.AllocateBlock(16);
+	TemporaryBlock *block2 = manager.AllocateBlock(16);
+	manager.FreeBlock(block1);
+	manager.FreeBlock(block2);
+
+	// The ranges are contiguous on the device, but a block may never span two ranges
+	EXPECT_EQ(manager.TryAllocateBlock(32), nullptr);
+}
+
+TEST_F(BlockManagerTest, ReleaseFreeRangesOnlyReleasesRangesWithoutUsedBlocks) {
+	NvmeTemporaryBlockManager manager;
+	manager.AddRange(0, 16);
+	manager.AddRange(1024, 16);
+
+	TemporaryBlock *block1 = manager.AllocateBlock(8);
+	TemporaryBlock *block2 = manager.AllocateBlock(8);
+	TemporaryBlock *block3 = manager.AllocateBlock(8);
+	manager.FreeBlock(block1);
+	manager.FreeBlock(block2);
+
+	vector<pair<idx_t, idx_t>> released = manager.ReleaseFreeRanges();
+	ASSERT_EQ(released.size(), 1);
+	// The last added range is used first, and it is the range that is fully free again
+	EXPECT_EQ(released[0].first, 1024);
+	EXPECT_EQ(released[0].second, 16);
+	EXPECT_EQ(manager.GetManagedLBACount(), 16);
+
+	manager.FreeBlock(block3);
+	EXPECT_EQ(manager.ReleaseFreeRanges().size(), 1);
+	EXPECT_EQ(manager.GetManagedLBACount(), 0);
+}
+
+TEST_F(BlockManagerTest, FragmentationStatisticsDescribeTheFreeBlocks) {
+	TemporaryBlock *block1 = block_manager->AllocateBlock(8);
+	TemporaryBlock *block2 = block_manager->AllocateBlock(16);
+	TemporaryBlock *block3 = block_manager->AllocateBlock(8);
+	block_manager->FreeBlock(block2);
+	// The freed block leaves a hole of 16 LBAs between the two blocks that are kept
+	EXPECT_EQ(block1->GetStartLBA(), 0);
+	EXPECT_EQ(block3->GetStartLBA(), 24);
+
+	TemporaryFragmentationStatistics statistics = block_manager->GetFragmentationStatistics();
+	EXPECT_EQ(statistics.range_count, 1);
+	EXPECT_EQ(statistics.managed_lbas, 1024);
+	EXPECT_EQ(statistics.free_lbas, 1024 - 16);
+	EXPECT_EQ(statistics.free_blocks, 2);
+	EXPECT_EQ(statistics.largest_free_block, 1024 - 32);
+	EXPECT_THAT(statistics.free_block_histogram, testing::ElementsAre(0, 1, 0, 0, 0, 0, 0, 0, 1));
+
+	vector<TemporaryRangeUsage> usage = block_manager->GetRangeUsage();
+	ASSERT_EQ(usage.size(), 1);
+	EXPECT_EQ(usage[0].used_lbas, 16);
+}
+
+TEST_F(BlockManagerTest, NoBlocksAreAllocatedFromDrainingRanges) {
+	NvmeTemporaryBlockManager manager;
+	manager.AddRange(0, 16);
+	manager.AddRange(1024, 16);
+
+	manager.SetDrainingRanges({1024});
+	TemporaryBlock *block = manager.AllocateBlock(8);
+	EXPECT_EQ(block->GetStartLBA(), 0);
+	EXPECT_FALSE(manager.IsDraining(block));
+	EXPECT_EQ(manager.AllocateBlock(8)->GetStartLBA(), 8);
+	EXPECT_EQ(manager.TryAllocateBlock(8), nullptr);
+
+	manager.ClearDrainingRanges();
+	EXPECT_EQ(manager.AllocateBlock(8)->GetStartLBA(), 1024);
+}
+
+class ExtentAllocatorTest : public testing::Test {
+protected:
+	ExtentAllocatorTest() {
+		extent_allocator = make_uniq<NvmeExtentAllocator>(16, 256, 4096);
+	}
+
+	unique_ptr<NvmeExtentAllocator> extent_allocator;
+};
+
+TEST_F(ExtentAllocatorTest, FirstExtentIsReservedForMetadata) {
+	EXPECT_EQ(extent_allocator->GetFreeExtentCount(), 15);
+	EXPECT_EQ(extent_allocator->GetDataLBACount(), 15 * 256);
+
+	optional_idx extent = extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_DATABASE, 0);
+	ASSERT_TRUE(extent.IsValid());
+	EXPECT_EQ(extent.GetIndex(), 1);
+}
+
+TEST_F(ExtentAllocatorTest, AllocationsAreTracedWithTheCategoryOfTheirOwner) {
+	EXPECT_EQ(GetExtentOwnerCategory(GetDatabaseExtentOwner(3)), IOCategory::DATABASE);
+	EXPECT_EQ(GetExtentOwnerCategory(GetWALExtentOwner(3)), IOCategory::WAL);
+	EXPECT_EQ(GetExtentOwnerCategory(NVMEFS_EXTENT_OWNER_TEMPORARY), IOCategory::TEMPORARY);
+	EXPECT_EQ(GetExtentOwnerCategory(GetFileExtentOwner(0)), IOCategory::GENERAL);
+	EXPECT_EQ(GetExtentOwnerCategory(NVMEFS_EXTENT_OWNER_METADATA), IOCategory::METADATA);
+
+	NvmeTracer &tracer = NvmeTracer::Get();
+	tracer.SetEnabled(true);
+	tracer.TakeEvents();
+	extent_allocator->TryAllocateExtent(GetWALExtentOwner(0), 0);
+	extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_TEMPORARY, 0);
+	tracer.SetEnabled(false);
+
+	vector<IOCategory> categories;
+	for (const auto &event : tracer.TakeEvents()) {
+		if (string(event.second.name) == "AllocateExtent") {
+			categories.push_back(event.second.category);
+		}
+	}
+	EXPECT_THAT(categories, testing::ElementsAre(IOCategory::WAL, IOCategory::TEMPORARY));
+}
+
+TEST_F(ExtentAllocatorTest, AllocateExtentReturnsInvalidIndexWhenDeviceIsFull) {
+	for (idx_t i = 0; i < 15; i++) {
+		EXPECT_TRUE(extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_TEMPORARY, 0).IsValid());
+	}
+
+	EXPECT_FALSE(extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_DATABASE, 0).IsValid());
+}
+
+TEST_F(ExtentAllocatorTest, ExtentMapKeepsLogicalOrderOfInterleavedExtents) {
+	NvmeExtentMap db_map(*extent_allocator, NVMEFS_EXTENT_OWNER_DATABASE);
+	NvmeExtentMap wal_map(*extent_allocator, NVMEFS_EXTENT_OWNER_WAL);
+
+	db_map.Map(0, 1, true);
+	wal_map.Map(0, 1, true);
+	vector<ExtentRun> runs = db_map.Map(200, 112, true);
+
+	// The range spans the first database extent and the extent after the WAL extent
+	ASSERT_EQ(runs.size(), 2);
+	EXPECT_EQ(runs[0].start_lba, 256 + 200);
+	EXPECT_EQ(runs[0].nr_lbas, 56);
+	EXPECT_EQ(runs[1].start_lba, 3 * 256);
+	EXPECT_EQ(runs[1].nr_lbas, 56);
+
+	// A reloaded map resolves to the same extents
+	NvmeExtentMap reloaded_map(*extent_allocator, NVMEFS_EXTENT_OWNER_DATABASE);
+	reloaded_map.Load();
+	vector<ExtentRun> reloaded_runs = reloaded_map.Map(200, 112, false);
+	ASSERT_EQ(reloaded_runs.size(), 2);
+	EXPECT_EQ(reloaded_runs[1].start_lba, 3 * 256);
+}
+
+TEST_F(ExtentAllocatorTest, ExtentMapReportsUnmappedRangeWithoutAllocating) {
+	NvmeExtentMap db_map(*extent_allocator, NVMEFS_EXTENT_OWNER_DATABASE);
+
+	vector<ExtentRun> runs = db_map.Map(0, 8, false);
+	ASSERT_EQ(runs.size(), 1);
+	EXPECT_FALSE(runs[0].mapped);
+	EXPECT_EQ(extent_allocator->GetFreeExtentCount(), 15);
+}
+
+TEST_F(ExtentAllocatorTest, AllocatingMapNeverReturnsUnmappedRunsDuringTruncation) {
+	NvmeExtentMap db_map(*extent_allocator, NVMEFS_EXTENT_OWNER_DATABASE);
+
+	std::atomic<bool> done(false);
+	std::thread truncater([&]() {
+		while (!done) {
+			db_map.Truncate(0);
+		}
+	});
+	for (idx_t i = 0; i < 2000; i++) {
+		for (const auto &run : db_map.Map(i % 4 * 256, 300, true)) {
+			EXPECT_TRUE(run.mapped);
+		}
+	}
+	done = true;
+	truncater.join();
+}
+
+TEST_F(ExtentAllocatorTest, SerializedTableRestoresOwnership) {
+	extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_DATABASE, 0);
+	extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_WAL, 0);
+	extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_DATABASE, 1);
+
+	vector<data_t> buffer(extent_allocator->GetTableLBACount() * 4096);
+	extent_allocator->SerializeTable(buffer.data());
+
+	NvmeExtentAllocator loaded_allocator(16, 256, 4096);
+	loaded_allocator.DeserializeTable(buffer.data());
+
+	EXPECT_EQ(loaded_allocator.GetFreeExtentCount(), 12);
+	EXPECT_THAT(loaded_allocator.GetOwnedExtents(NVMEFS_EXTENT_OWNER_DATABASE), testing::ElementsAre(1, 3));
+	EXPECT_THAT(loaded_allocator.GetOwnedExtents(NVMEFS_EXTENT_OWNER_WAL), testing::ElementsAre(2));
+}
+
+TEST_F(ExtentAllocatorTest, ExtentsAreNotHandedOutWhileTheyAreDeallocated) {
+	extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_FILE, 0);
+	extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_FILE, 1);
+	extent_allocator->FreeOwner(NVMEFS_EXTENT_OWNER_FILE);
+
+	// The allocator lock is not held by the callback, which allocates around the extents it deallocates
+	vector<pair<idx_t, idx_t>> deallocated;
+	extent_allocator->DeallocateFreedExtents([&](idx_t start_lba, idx_t nr_lbas) {
+		deallocated.emplace_back(start_lba, nr_lbas);
+		optional_idx extent = extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_DATABASE, 0);
+		ASSERT_TRUE(extent.IsValid());
+		EXPECT_EQ(extent.GetIndex(), 3);
+	});
+	EXPECT_THAT(deallocated, testing::ElementsAre(pair<idx_t, idx_t>(256, 512)));
+	EXPECT_EQ(extent_allocator->TryAllocateExtent(NVMEFS_EXTENT_OWNER_WAL, 0).GetIndex(), 1);
+
+	// A failed deallocation is not retried, and its extents are free again
+	extent_allocator->FreeOwner(NVMEFS_EXTENT_OWNER_WAL);
+	EXPECT_THROW(extent_allocator->DeallocateFreedExtents(
+	                 [](idx_t start_lba, idx_t nr_lbas) { throw IOException("The device cannot deallocate"); }),
+	             IOException);
+	EXPECT_EQ(extent_allocator->GetFreeExtentCount(), 14);
+	deallocated.clear();
+	extent_allocator->DeallocateFreedExtents(
+	    [&](idx_t start_lba, idx_t nr_lbas) { deallocated.emplace_back(start_lba, nr_lbas); });
+	EXPECT_TRUE(deallocated.empty());
+}
+
+class DatabaseCatalogTest : public testing::Test {
+protected:
+	DatabaseCatalogTest() {
+		extent_allocator = make_uniq<NvmeExtentAllocator>(16, 256, 4096);
+		catalog = make_uniq<NvmeDatabaseCatalog>(*extent_allocator, 2);
+	}
+
+	unique_ptr<NvmeExtentAllocator> extent_allocator;
+	unique_ptr<NvmeDatabaseCatalog> catalog;
+};
+
+TEST_F(DatabaseCatalogTest, DatabaseAndWALPathsResolveToTheSameDatabase) {
+	EXPECT_EQ(NvmeDatabaseCatalog::GetDatabaseName("nvmefs://test.db"), "test.db");
+	EXPECT_EQ(NvmeDatabaseCatalog::GetDatabaseName("nvmefs:///test.db"), "test.db");
+	EXPECT_EQ(NvmeDatabaseCatalog::GetDatabaseName("nvmefs:///test.db.wal"), "test.db");
+}
+
+TEST_F(DatabaseCatalogTest, DatabasesGetSeparateSlotsAndExtentOwners) {
+	bool created = false;
+	NvmeDatabase &first = *catalog->GetOrCreateDatabase("first.db", created);
+	EXPECT_TRUE(created);
+	NvmeDatabase &second = *catalog->GetOrCreateDatabase("second.db", created);
+	EXPECT_TRUE(created);
+	NvmeDatabase &first_again = *catalog->GetOrCreateDatabase("first.db", created);
+	EXPECT_FALSE(created);
+
+	EXPECT_EQ(&first, &first_again);
+	EXPECT_EQ(first.slot, 0);
+	EXPECT_EQ(second.slot, 1);
+
+	first.db_extents.Map(0, 1, true);
+	second.db_extents.Map(0, 1, true);
+	EXPECT_THAT(extent_allocator->GetOwnedExtents(GetDatabaseExtentOwner(0)), testing::ElementsAre(1));
+	EXPECT_THAT(extent_allocator->GetOwnedExtents(GetDatabaseExtentOwner(1)), testing::ElementsAre(2));
+
+	EXPECT_THROW(catalog->GetOrCreateDatabase("third.db", created), IOException);
+}
+
+TEST_F(DatabaseCatalogTest, LoadedDatabaseRestoresLocationsAndExtents) {
+	bool created = false;
+	NvmeDatabase &database = *catalog->GetOrCreateDatabase("test.db", created);
+	database.db_extents.Map(0, 300, true);
+	database.db_location.store(300);
+	database.wal_location.store(2);
+
+	DatabaseCatalogEntry entry = database.GetCatalogEntry();
+
+	NvmeDatabaseCatalog loaded_catalog(*extent_allocator, 2);
+	loaded_catalog.LoadDatabase(database.slot, entry);
+
+	shared_ptr<NvmeDatabase> loaded = loaded_catalog.GetDatabase("test.db");
+	ASSERT_NE(loaded, nullptr);
+	EXPECT_EQ(loaded->slot, database.slot);
+	EXPECT_EQ(loaded->db_extents.GetAllocatedLBACount(), 2 * 256);
+	EXPECT_EQ(loaded->db_location.load(), 300);
+	EXPECT_EQ(loaded->wal_location.load(), 2);
+	EXPECT_EQ(loaded_catalog.GetDatabase("other.db"), nullptr);
+}
+
+TEST_F(DatabaseCatalogTest, RemovedDatabaseReleasesItsSlotAndExtents) {
+	bool created = false;
+	shared_ptr<NvmeDatabase> database = catalog->GetOrCreateDatabase("first.db", created);
+	catalog->GetOrCreateDatabase("second.db", created);
+	database->db_extents.Map(0, 300, true);
+	database->wal_extents.Map(0, 1, true);
+	database->db_location.store(300);
+
+	shared_ptr<NvmeDatabase> removed = catalog->RemoveDatabase("first.db");
+	ASSERT_EQ(removed, database);
+	EXPECT_TRUE(removed->removed.load());
+	EXPECT_EQ(removed->GetCatalogEntry().in_use, 0);
+	EXPECT_EQ(catalog->GetDatabase("first.db"), nullptr);
+	EXPECT_EQ(catalog->RemoveDatabase("first.db"), nullptr);
+
+	// The slot stays reserved until the database is released
+	EXPECT_THROW(catalog->GetOrCreateDatabase("third.db", created), IOException);
+	EXPECT_EQ(extent_allocator->GetOwnedExtents(GetDatabaseExtentOwner(0)).size(), 2);
+
+	catalog->ReleaseDatabase(*removed);
+	EXPECT_TRUE(extent_allocator->GetOwnedExtents(GetDatabaseExtentOwner(0)).empty());
+	EXPECT_TRUE(extent_allocator->GetOwnedExtents(GetWALExtentOwner(0)).empty());
+
+	shared_ptr<NvmeDatabase> third = catalog->GetOrCreateDatabase("third.db", created);
+	EXPECT_TRUE(created);
+	EXPECT_EQ(third->slot, 0);
+	EXPECT_EQ(third->db_location.load(), 0);
+}
+
+class FileDirectoryTest : public testing::Test {
+protected:
+	FileDirectoryTest() {
+		extent_allocator = make_uniq<NvmeExtentAllocator>(16, 256, 4096);
+		directory = make_uniq<NvmeFileDirectory>(*extent_allocator, 32, 4096);
+	}
+
+	unique_ptr<NvmeExtentAllocator> extent_allocator;
+	unique_ptr<NvmeFileDirectory> directory;
+};
+
+TEST_F(FileDirectoryTest, FilePathsResolveToTheSameName) {
+	EXPECT_EQ(NvmeFileDirectory::GetFileName("nvmefs://out.csv"), "out.csv");
+	EXPECT_EQ(NvmeFileDirectory::GetFileName("nvmefs:///exports/out.csv"), "exports/out.csv");
+	EXPECT_EQ(NvmeFileDirectory::GetFileName("nvmefs:///exports/"), "exports");
+}
+
+TEST_F(FileDirectoryTest, OnlyChangedIndexLBAsAreWritten) {
+	vector<data_t> buffer(directory->GetIndexLBACount() * 4096);
+
+	// A new directory is written as a whole, such that stale entries on the device are cleared
+	EXPECT_THAT(directory->SerializeDirtyIndex(buffer.data()), testing::ElementsAre(std::make_pair(0, 2)));
+	EXPECT_TRUE(directory->SerializeDirtyIndex(buffer.data()).empty());
+
+	for (idx_t i = 0; i < 17; i++) {
+		directory->GetOrCreateFile(StringUtil::Format("file-%llu", i));
+	}
+	directory->SerializeDirtyIndex(buffer.data());
+
+	// Slot 16 is the first entry of the second LBA
+	directory->GetFile("file-16")->size.store(10);
+	directory->GetFile("file-16")->dirty.store(true);
+	EXPECT_THAT(directory->SerializeDirtyIndex(buffer.data()), testing::ElementsAre(std::make_pair(1, 1)));
+}
+
+TEST_F(FileDirectoryTest, LoadedIndexRestoresFilesAndExtents) {
+	shared_ptr<NvmeFile> file = directory->GetOrCreateFile("exports/a.parquet");
+	file->extents.Map(0, 300, true);
+	file->size.store(300 * 4096 - 5);
+	directory->GetOrCreateFile("exports/b.parquet");
+	directory->RemoveFile("exports/b.parquet");
+
+	vector<data_t> buffer(directory->GetIndexLBACount() * 4096);
+	directory->SerializeDirtyIndex(buffer.data());
+
+	NvmeFileDirectory loaded_directory(*extent_allocator, 32, 4096);
+	loaded_directory.DeserializeIndex(buffer.data());
+
+	shared_ptr<NvmeFile> loaded = loaded_directory.GetFile("exports/a.parquet");
+	ASSERT_NE(loaded, nullptr);
+	EXPECT_EQ(loaded->slot, file->slot);
+	EXPECT_EQ(loaded->size.load(), 300 * 4096 - 5);
+	EXPECT_EQ(loaded->extents.GetAllocatedLBACount(), 2 * 256);
+	EXPECT_EQ(loaded_directory.GetFile("exports/b.parquet"), nullptr);
+}
+
+TEST(PlacementPolicyTest, DefaultPolicySeparatesTemporaryDataAndWAL) {
+	NvmePlacementPolicy policy = NvmePlacementPolicy::Parse("");
+
+	EXPECT_EQ(policy.GetPlacementIdentifier(PlacementRegion::DATABASE), 0);
+	EXPECT_EQ(policy.GetPlacementIdentifier(PlacementRegion::TEMPORARY), 1);
+	EXPECT_EQ(policy.GetPlacementIdentifier(PlacementRegion::WAL), 2);
+	EXPECT_EQ(policy.GetTemporaryPlacementIdentifier("nvmefs:///tmp/duckdb_temp_storage_S32K-0.tmp"), 1);
+}
+
+TEST(PlacementPolicyTest, ParsedPolicyOverridesRegionsAndTemporarySizeClasses) {
+	NvmePlacementPolicy policy = NvmePlacementPolicy::Parse(" wal=3, temp:s32k=4 ,temporary:DEFAULT=5");
+
+	EXPECT_EQ(policy.GetPlacementIdentifier(PlacementRegion::WAL), 3);
+	EXPECT_EQ(policy.GetPlacementIdentifier(PlacementRegion::DATABASE), 0);
+	EXPECT_EQ(policy.GetTemporaryPlacementIdentifier("nvmefs:///tmp/duckdb_temp_storage_S32K-0.tmp"), 4);
+	EXPECT_EQ(policy.GetTemporaryPlacementIdentifier("nvmefs:///tmp/duckdb_temp_storage_DEFAULT-2.tmp"), 5);
+	EXPECT_EQ(policy.GetTemporaryPlacementIdentifier("nvmefs:///tmp/duckdb_temp_storage_S64K-0.tmp"), 1);
+	EXPECT_EQ(policy.ToString(),
+	          "metadata=0,database=0,wal=3,temporary=1,general=0,temporary:DEFAULT=5,temporary:S32K=4");
+}
+
+TEST(PlacementPolicyTest, MalformedPolicyThrowsInvalidInputException) {
+	EXPECT_THROW(NvmePlacementPolicy::Parse("database"), InvalidInputException);
+	EXPECT_THROW(NvmePlacementPolicy::Parse("index=1"), InvalidInputException);
+	EXPECT_THROW(NvmePlacementPolicy::Parse("wal=-1"), InvalidInputException);
+	EXPECT_THROW(NvmePlacementPolicy::Parse("wal:S32K=1"), InvalidInputException);
+}
+
+TEST(LifetimeEstimatorTest, RangesRewrittenByConsecutiveCheckpointsAreHot) {
+	NvmeLifetimeEstimator estimator(64);
+
+	// First writes are cold
+	EXPECT_FALSE(estimator.RecordWrite(0, 64));
+	EXPECT_FALSE(estimator.RecordWrite(64, 64));
+	estimator.AdvanceEpoch();
+
+	EXPECT_TRUE(estimator.RecordWrite(0, 64));
+	estimator.AdvanceEpoch();
+	EXPECT_TRUE(estimator.RecordWrite(0, 64));
+
+	// A range that has not been written for several checkpoints cools down again
+	for (idx_t i = 0; i < 4; i++) {
+		estimator.AdvanceEpoch();
+	}
+	EXPECT_FALSE(estimator.RecordWrite(64, 64));
+	EXPECT_FALSE(estimator.RecordWrite(0, 1));
+}
+
+TEST(LifetimeEstimatorTest, WriteSpanningRangesIsAsHotAsTheHottestRange) {
+	NvmeLifetimeEstimator estimator(64);
+
+	estimator.RecordWrite(0, 1);
+	estimator.AdvanceEpoch();
+	EXPECT_TRUE(estimator.RecordWrite(32, 64));
+}
+
+TEST(FakeDeviceTest, TerabyteDeviceOnlyAllocatesWrittenPages) {
+	idx_t lba_count = (1ULL << 40) / DEFAULT_BLOCK_SIZE;
+	FakeDevice device(lba_count);
+	idx_t page_size = FAKE_DEVICE_PAGE_LBA_COUNT * DEFAULT_BLOCK_SIZE;
+	vector<char> buf(DEFAULT_BLOCK_SIZE, 'x');
+
+	device.Write(buf.data(), CmdContext {buf.size(), 1, 0, 0});
+	device.Write(buf.data(), CmdContext {buf.size(), 1, lba_count - 1, 0});
+	EXPECT_EQ(device.GetAllocatedBytes(), 2 * page_size);
+
+	// Unwritten LBAs, including the rest of a written page, read as zeros
+	vector<char> result(DEFAULT_BLOCK_SIZE, 'r');
+	device.Read(result.data(), CmdContext {result.size(), 1, lba_count / 2, 0});
+	EXPECT_EQ(result, vector<char>(DEFAULT_BLOCK_SIZE, 0));
+	device.Read(result.data(), CmdContext {result.size(), 1, 1, 0});
+	EXPECT_EQ(result, vector<char>(DEFAULT_BLOCK_SIZE, 0));
+	device.Read(result.data(), CmdContext {result.size(), 1, lba_count - 1, 0});
+	EXPECT_EQ(result, buf);
+}
+
+TEST(FakeDeviceTest, DeallocatedLBAsReadAsZeros) {
+	FakeDevice device(1024);
+	idx_t page_size = FAKE_DEVICE_PAGE_LBA_COUNT * DEFAULT_BLOCK_SIZE;
+	vector<char> buf(2 * page_size, 'x');
+	device.Write(buf.data(), CmdContext {buf.size(), 2 * FAKE_DEVICE_PAGE_LBA_COUNT, 0, 0});
+
+	// The first page is freed, while only a single LBA of the second page is zeroed
+	device.Deallocate(CmdContext {0, FAKE_DEVICE_PAGE_LBA_COUNT + 1, 0, 0});
+	EXPECT_EQ(device.GetAllocatedBytes(), page_size);
+
+	vector<char> result(buf.size());
+	device.Read(result.data(), CmdContext {result.size(), 2 * FAKE_DEVICE_PAGE_LBA_COUNT, 0, 0});
+	idx_t zeroed_bytes = page_size + DEFAULT_BLOCK_SIZE;
+	EXPECT_EQ(vector<char>(result.begin(), result.begin() + zeroed_bytes), vector<char>(zeroed_bytes, 0));
+	EXPECT_EQ(vector<char>(result.begin() + zeroed_bytes, result.end()), vector<char>(buf.size() - zeroed_bytes, 'x'));
+}
+
+TEST(FakeDeviceTest, ConcurrentWritesToDifferentPagesAreNotLost) {
+	FakeDevice device(1ULL << 20);
+	idx_t thread_count = 8;
+	idx_t writes_per_thread = 256;
+
+	vector<std::thread> threads;
+	for (idx_t t = 0; t < thread_count; t++) {
+		threads.emplace_back([&device, t, writes_per_thread]() {
+			vector<char> buf(DEFAULT_BLOCK_SIZE, 'a' + t);
+			for (idx_t i = 0; i < writes_per_thread; i++) {
+				device.Write(buf.data(), CmdContext {buf.size(), 1, (i * 8 + t) * 3, 0});
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	vector<char> result(DEFAULT_BLOCK_SIZE);
+	for (idx_t t = 0; t < thread_count; t++) {
+		for (idx_t i = 0; i < writes_per_thread; i++) {
+			device.Read(result.data(), CmdContext {result.size(), 1, (i * 8 + t) * 3, 0});
+			ASSERT_EQ(result, vector<char>(DEFAULT_BLOCK_SIZE, 'a' + t));
+		}
+	}
+	EXPECT_EQ(device.GetWrites().size(), thread_count * writes_per_thread);
+}
+
+/// 64 LBA reclaim units of four erase blocks each and 10% over-provisioning
+static const FdpSimulatorConfig SMALL_SIMULATOR_CONFIG {
+    .erase_block_lba_count = 16, .erase_blocks_per_reclaim_unit = 4, .over_provisioning = 0.1};
+
+TEST(FdpSimulatorDeviceTest, SequentialOverwritesHaveNoWriteAmplification) {
+	FdpSimulatorDevice device(1024, SMALL_SIMULATOR_CONFIG);
+	vector<char> buf(64 * DEFAULT_BLOCK_SIZE);
+
+	for (idx_t pass = 0; pass < 5; pass++) {
+		for (idx_t lba = 0; lba < 1024; lba += 64) {
+			device.Write(buf.data(), CmdContext {buf.size(), 64, lba, 0});
+		}
+	}
+
+	EXPECT_EQ(device.GetHostWrites(), 5 * 1024);
+	EXPECT_DOUBLE_EQ(device.GetWriteAmplification(), 1.0);
+}
+
+TEST(FdpSimulatorDeviceTest, MixingShortAndLongLivedDataAmplifiesWrites) {
+	FdpSimulatorDevice device(1024, SMALL_SIMULATOR_CONFIG);
+	vector<char> buf(DEFAULT_BLOCK_SIZE);
+
+	// Long-lived data fills most of the device, interleaved with a small set of LBAs that is overwritten constantly
+	for (idx_t pass = 0; pass < 20; pass++) {
+		for (idx_t lba = 64; lba < 1024; lba++) {
+			device.Write(buf.data(), CmdContext {buf.size(), 1, lba, 0, 0});
+			device.Write(buf.data(), CmdContext {buf.size(), 1, lba % 64, 0, static_cast<idx_t>(pass % 2)});
+		}
+	}
+
+	EXPECT_GT(device.GetWriteAmplification(), 1.0);
+	EXPECT_EQ(device.GetHostWrites(), 2 * 20 * 960);
+
+	// Every reclaimed unit erases all of its erase blocks, and every relocation is an extra media write
+	FdpSimulatorStats stats = device.GetStats();
+	EXPECT_GT(stats.erases, 0);
+	EXPECT_EQ(stats.erases % SMALL_SIMULATOR_CONFIG.erase_blocks_per_reclaim_unit, 0);
+	EXPECT_EQ(stats.media_writes, stats.host_writes + stats.relocated_lbas);
+}
+
+/// Writes a random set of LBAs filling half of the device, after which the previous set is discarded
+static FdpSimulatorStats RunChurnWorkload(bool deallocate) {
+	FdpSimulatorDevice device(1024, SMALL_SIMULATOR_CONFIG);
+	vector<char> buf(DEFAULT_BLOCK_SIZE);
+	std::mt19937 random(42);
+
+	vector<idx_t> lbas(1024);
+	std::iota(lbas.begin(), lbas.end(), 0);
+	vector<idx_t> previous;
+	for (idx_t pass = 0; pass < 40; pass++) {
+		std::shuffle(lbas.begin(), lbas.end(), random);
+		vector<idx_t> current(lbas.begin(), lbas.begin() + 512);
+		for (idx_t lba : current) {
+			device.Write(buf.data(), CmdContext {buf.size(), 1, lba, 0});
+		}
+		if (deallocate) {
+			for (idx_t lba : previous) {
+				device.Deallocate(CmdContext {buf.size(), 1, lba, 0});
+			}
+		}
+		previous = current;
+	}
+
+	return device.GetStats();
+}
+
+TEST(FdpSimulatorDeviceTest, DeallocatedLBAsAreNotRelocated) {
+	FdpSimulatorStats kept = RunChurnWorkload(false);
+	FdpSimulatorStats deallocated = RunChurnWorkload(true);
+
+	EXPECT_EQ(kept.deallocated_lbas, 0);
+	EXPECT_GT(deallocated.deallocated_lbas, 0);
+	EXPECT_LT(deallocated.relocated_lbas, kept.relocated_lbas);
+	EXPECT_LT(deallocated.write_amplification, kept.write_amplification);
+}
+
+TEST(FdpSimulatorDeviceTest, PlacementIdentifiersBeyondTheHandlesWrapAround) {
+	FdpSimulatorConfig config = SMALL_SIMULATOR_CONFIG;
+	config.placement_handle_count = 2;
+	FdpSimulatorDevice device(1024, config);
+	vector<char> buf(DEFAULT_BLOCK_SIZE);
+
+	// Identifier 2 shares the handle of identifier 0, hence hot and cold data are mixed again
+	for (idx_t pass = 0; pass < 20; pass++) {
+		for (idx_t lba = 64; lba < 1024; lba++) {
+			device.Write(buf.data(), CmdContext {buf.size(), 1, lba, 0, 0});
+			device.Write(buf.data(), CmdContext {buf.size(), 1, lba % 64, 0, 2});
+		}
+	}
+
+	EXPECT_GT(device.GetWriteAmplification(), 1.0);
+}
+
+/// A device without latency jitter, such that emulated times can be compared exactly
+static EmulatedDeviceConfig FixedLatencyConfig() {
+	EmulatedDeviceConfig config;
+	config.latency_sigma = 0;
+	config.queue_depth_penalty = 0;
+	return config;
+}
+
+TEST(EmulatedDeviceTest, BatchedReadsAreServedByAllChannels) {
+	EmulatedDeviceConfig config = FixedLatencyConfig();
+	EmulatedDevice sync_device(1024, config);
+	EmulatedDevice async_device(1024, config);
+	vector<char> buf(8 * DEFAULT_BLOCK_SIZE);
+
+	vector<EmulatedCommand> batch;
+	for (idx_t i = 0; i < 8; i++) {
+		CmdContext context {DEFAULT_BLOCK_SIZE, 1, i, 0};
+		sync_device.Read(buf.data() + i * DEFAULT_BLOCK_SIZE, context);
+		batch.push_back(EmulatedCommand {false, buf.data() + i * DEFAULT_BLOCK_SIZE, context, 0});
+	}
+	async_device.SubmitBatch(batch);
+
+	// Eight synchronous reads wait for each other, while a batch of eight is served by eight channels at once
+	idx_t transfer_ns = DEFAULT_BLOCK_SIZE * 1000000000ULL / config.read_bandwidth;
+	EXPECT_EQ(sync_device.GetElapsedNanos(), 8 * (config.read_latency_ns + transfer_ns));
+	EXPECT_EQ(async_device.GetElapsedNanos(), config.read_latency_ns + 8 * transfer_ns);
+	EXPECT_EQ(async_device.GetCompletedCommands(), 8);
+}
+
+TEST(EmulatedDeviceTest, LargeTransfersAreLimitedByBandwidth) {
+	EmulatedDeviceConfig config = FixedLatencyConfig();
+	config.write_bandwidth = 1ULL << 30;
+	EmulatedDevice device(1024, config);
+	vector<char> buf(256 * DEFAULT_BLOCK_SIZE, 'w');
+
+	device.Write(buf.data(), CmdContext {buf.size(), 256, 0, 0});
+
+	// 1 MiB at 1 GiB/s takes 1/1024 of a second on top of the command latency
+	EXPECT_EQ(device.GetElapsedNanos(), config.write_latency_ns + 1000000000ULL / 1024);
+
+	// The emulation does not change the data
+	vector<char> result(buf.size());
+	device.Read(result.data(), CmdContext {result.size(), 256, 0, 0});
+	EXPECT_EQ(result, buf);
+}
+
+TEST(EmulatedDeviceTest, LatencyGrowsWithQueueDepthBeyondTheChannels) {
+	EmulatedDeviceConfig config;
+	config.channel_count = 4;
+	config.queue_depth_penalty = 0.1;
+	EmulatedDevice shallow_device(1024, config);
+	EmulatedDevice deep_device(1024, config);
+	vector<char> buf(64 * DEFAULT_BLOCK_SIZE);
+
+	auto submit = [&](EmulatedDevice &device, idx_t queue_depth) {
+		vector<EmulatedCommand> batch;
+		for (idx_t i = 0; i < queue_depth; i++) {
+			CmdContext context {DEFAULT_BLOCK_SIZE, 1, i, 0};
+			batch.push_back(EmulatedCommand {false, buf.data() + i * DEFAULT_BLOCK_SIZE, context, 0});
+		}
+		device.SubmitBatch(batch);
+	};
+	for (idx_t i = 0; i < 16; i++) {
+		submit(shallow_device, 4);
+	}
+	submit(deep_device, 64);
+
+	// Both devices complete the same amount of commands, but the deep queue keeps them waiting for longer
+	EXPECT_EQ(shallow_device.GetCompletedCommands(), deep_device.GetCompletedCommands());
+	EXPECT_GT(deep_device.GetAverageLatencyNanos(), 4 * shallow_device.GetAverageLatencyNanos());
+
+	// Latencies are drawn from a seeded distribution, hence runs are reproducible
+	EmulatedDevice repeated_device(1024, config);
+	submit(repeated_device, 64);
+	EXPECT_EQ(repeated_device.GetElapsedNanos(), deep_device.GetElapsedNanos());
+}
+
+TEST(IOTraceTest, FileSystemCommandsAreRecordedWithTheirCategory) {
+	string trace_path = testing::TempDir() + "nvmefs_file_system.trace";
+	NvmeConfig config = gtestutils::TEST_CONFIG;
+	config.trace_path = trace_path;
+	idx_t lba_count = (1ULL << 30) / DEFAULT_BLOCK_SIZE;
+	{
+		NvmeFileSystem file_system(config, make_uniq<FakeDevice>(lba_count));
+		FileOpenFlags flags = FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE |
+		                      FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+		unique_ptr<FileHandle> db_handle = file_system.OpenFile("nvmefs://test.db", flags);
+		unique_ptr<FileHandle> wal_handle = file_system.OpenFile("nvmefs://test.db.wal", flags);
+
+		vector<char> buf(4 * DEFAULT_BLOCK_SIZE, 'd');
+		db_handle->Write(buf.data(), buf.size(), 0);
+		db_handle->Read(buf.data(), buf.size(), 0);
+		wal_handle->Write(buf.data(), DEFAULT_BLOCK_SIZE, 0);
+	}
+
+	IOTraceHeader header;
+	vector<IOTraceRecord> records = ReadIOTrace(trace_path, header);
+	EXPECT_EQ(header.lba_size, DEFAULT_BLOCK_SIZE);
+	EXPECT_EQ(header.lba_count, lba_count);
+
+	map<IOCategory, idx_t> written_lbas;
+	idx_t database_reads = 0;
+	for (const auto &record : records) {
+		EXPECT_EQ(record.thread, 0);
+		if (record.operation == IOTraceOperation::WRITE) {
+			written_lbas[record.category] += record.nr_lbas;
+		} else if (record.operation == IOTraceOperation::READ && record.category == IOCategory::DATABASE) {
+			database_reads++;
+		}
+	}
+	EXPECT_EQ(written_lbas[IOCategory::DATABASE], 4);
+	EXPECT_EQ(written_lbas[IOCategory::WAL], 1);
+	EXPECT_GT(written_lbas[IOCategory::METADATA], 0);
+	EXPECT_EQ(database_reads, 1);
+}
+
+TEST(IOTraceTest, FailingToWriteTheTraceIsReportedByCloseButNotByTheDestructor) {
+	// Writes to /dev/full fail once the buffer of the file is flushed, as if the disk was full
+	vector<char> buf(DEFAULT_BLOCK_SIZE, 'w');
+	{
+		RecordingDevice device(make_uniq<FakeDevice>(1ULL << 16), "/dev/full");
+		device.Write(buf.data(), CmdContext {buf.size(), 1, 0, 0});
+		EXPECT_THROW(device.Close(), IOException);
+
+		// Commands are still forwarded after the trace is closed
+		EXPECT_NO_THROW(device.Read(buf.data(), CmdContext {buf.size(), 1, 0, 0}));
+		EXPECT_EQ(device.GetRecordedCommands(), 1);
+	}
+	{
+		RecordingDevice device(make_uniq<FakeDevice>(1ULL << 16), "/dev/full");
+		device.Write(buf.data(), CmdContext {buf.size(), 1, 0, 0});
+	}
+}
+
+/// @brief Records a workload of several threads that write, read and deallocate their own LBAs
+static vector<IOTraceRecord> RecordThreadedWorkload(const string &trace_path, IOTraceHeader &header) {
+	idx_t thread_count = 4;
+	idx_t commands_per_thread = 64;
+	{
+		RecordingDevice device(make_uniq<FakeDevice>(1ULL << 16), trace_path);
+		vector<std::thread> threads;
+		for (idx_t thread = 0; thread < thread_count; thread++) {
+			threads.emplace_back([&, thread]() {
+				vector<char> buf(4 * DEFAULT_BLOCK_SIZE, 'w');
+				for (idx_t i = 0; i < commands_per_thread; i++) {
+					idx_t lba = (thread * commands_per_thread + i) * 4;
+					device.Write(buf.data(), CmdContext {buf.size(), 4, lba, 0, thread});
+					device.Read(buf.data(), CmdContext {buf.size(), 4, lba, 0, thread});
+				}
+				// The first half of the LBAs of every thread is deallocated again
+				idx_t first_lba = thread * commands_per_thread * 4;
+				device.Deallocate(CmdContext {0, commands_per_thread * 2, first_lba, 0});
+			});
+		}
+		for (auto &thread : threads) {
+			thread.join();
+		}
+		EXPECT_EQ(device.GetRecordedCommands(), thread_count * (2 * commands_per_thread + 1));
+	}
+	return ReadIOTrace(trace_path, header);
+}
+
+TEST(IOTraceTest, ClosedLoopReplayIssuesTheRecordedCommands) {
+	IOTraceHeader header;
+	vector<IOTraceRecord> records = RecordThreadedWorkload(testing::TempDir() + "nvmefs_closed_loop.trace", header);
+	// Threads are numbered in the order of their first command, and every thread tagged its writes with its own index
+	map<uint16_t, idx_t> thread_placement;
+	for (const auto &record : records) {
+		if (record.operation == IOTraceOperation::DEALLOCATE) {
+			EXPECT_EQ(record.placement_identifier, 0);
+			continue;
+		}
+		auto entry = thread_placement.emplace(record.thread, record.placement_identifier);
+		EXPECT_EQ(entry.first->second, record.placement_identifier);
+	}
+	set<uint16_t> threads;
+	set<idx_t> placement_identifiers;
+	for (const auto &entry : thread_placement) {
+		threads.insert(entry.first);
+		placement_identifiers.insert(entry.second);
+	}
+	EXPECT_EQ(threads, set<uint16_t>({0, 1, 2, 3}));
+	EXPECT_EQ(placement_identifiers, set<idx_t>({0, 1, 2, 3}));
+
+	FakeDevice device(1ULL << 16);
+	IOTraceReplayer replayer(header, records);
+	IOTraceReplayResult result = replayer.Replay(device);
+
+	EXPECT_EQ(result.commands, records.size());
+	EXPECT_EQ(result.written_bytes, 4 * 64 * 4 * DEFAULT_BLOCK_SIZE);
+	EXPECT_EQ(result.read_bytes, result.written_bytes);
+	EXPECT_EQ(result.late_commands, 0);
+	// Only the written LBAs that were not deallocated afterwards are left on the device
+	EXPECT_EQ(device.GetAllocatedBytes(), result.written_bytes / 2);
+}
+
+TEST(IOTraceTest, OpenLoopReplayKeepsTheRecordedPace) {
+	IOTraceHeader header;
+	vector<IOTraceRecord> records = RecordThreadedWorkload(testing::TempDir() + "nvmefs_open_loop.trace", header);
+
+	// The same command is recorded once every millisecond
+	for (idx_t i = 0; i < records.size(); i++) {
+		records[i].submit_ns = i * 1000000;
+	}
+	records.resize(16);
+
+	EmulatedDevice device(1ULL << 16);
+	IOTraceReplayer replayer(header, records);
+	IOTraceReplayConfig config;
+	config.mode = IOTraceReplayMode::OPEN_LOOP;
+	config.workers = 2;
+	IOTraceReplayResult result = replayer.Replay(device, config);
+	EXPECT_EQ(result.commands, 16);
+	EXPECT_GE(result.elapsed_ns, 15 * 1000000);
+
+	// Replaying twice as fast halves the time the trace takes
+	config.speed = 2.0;
+	result = replayer.Replay(device, config);
+	EXPECT_GE(result.elapsed_ns, 15 * 1000000 / 2);
+	EXPECT_LT(result.elapsed_ns, 15 * 1000000);
+
+	// A smaller device than the traced one cannot hold the LBAs of the trace
+	FakeDevice small_device(1024);
+	EXPECT_THROW(replayer.Replay(small_device, config), InvalidInputException);
+}
+
+TEST(SchedulerPolicyTest, PolicyOverridesTheDefaults) {
+	NvmeSchedulerPolicy default_policy = NvmeSchedulerPolicy::Parse("");
+	EXPECT_EQ(default_policy.GetDepth(), 16);
+	EXPECT_GT(default_policy.GetClassPolicy(IOClass::WAL).weight,
+	          default_policy.GetClassPolicy(IOClass::DATABASE_READ).weight);
+	EXPECT_GT(default_policy.GetClassPolicy(IOClass::DATABASE_READ).weight,
+	          default_policy.GetClassPolicy(IOClass::TEMPORARY).weight);
+	EXPECT_EQ(default_policy.GetClassPolicy(IOClass::TEMPORARY).rate, 0);
+
+	NvmeSchedulerPolicy policy =
+	    NvmeSchedulerPolicy::Parse("depth=4, wal=64, temporary:rate=200MiB, database_write:rate=10MiB, "
+	                               "database_write:burst=4MiB");
+	EXPECT_EQ(policy.GetDepth(), 4);
+	EXPECT_EQ(policy.GetClassPolicy(IOClass::WAL).weight, 64);
+	EXPECT_EQ(policy.GetClassPolicy(IOClass::METADATA).weight, default_policy.GetClassPolicy(IOClass::METADATA).weight);
+	EXPECT_EQ(policy.GetClassPolicy(IOClass::TEMPORARY).rate, 200ULL << 20);
+	// Without a burst the bucket holds a tenth of a second worth of tokens, but at least 1 MiB
+	EXPECT_EQ(policy.GetClassPolicy(IOClass::TEMPORARY).burst, (200ULL << 20) / 10);
+	EXPECT_EQ(policy.GetClassPolicy(IOClass::DATABASE_WRITE).rate, 10ULL << 20);
+	EXPECT_EQ(policy.GetClassPolicy(IOClass::DATABASE_WRITE).burst, 4ULL << 20);
+
+	EXPECT_THROW(NvmeSchedulerPolicy::Parse("depth=0"), InvalidInputException);
+	EXPECT_THROW(NvmeSchedulerPolicy::Parse("wal"), InvalidInputException);
+	EXPECT_THROW(NvmeSchedulerPolicy::Parse("wal=fast"), InvalidInputException);
+	EXPECT_THROW(NvmeSchedulerPolicy::Parse("logs=2"), InvalidInputException);
+	EXPECT_THROW(NvmeSchedulerPolicy::Parse("temporary:limit=1MiB"), InvalidInputException);
+}
+
+/// @brief Records the class of every command, and blocks commands while the test holds the gate
+class GatedDevice : public FakeDevice {
+public:
+	explicit GatedDevice(idx_t lba_count) : FakeDevice(lba_count) {
+	}
+
+	idx_t Write(void *buffer, const CmdContext &context) override {
+		std::lock_guard<std::mutex> guard(gate);
+		order.push_back(GetIOClass(context.category, true));
+		return FakeDevice::Write(buffer, context);
+	}
+
+	idx_t Read(void *buffer, const CmdContext &context) override {
+		std::lock_guard<std::mutex> guard(gate);
+		order.push_back(GetIOClass(context.category, false));
+		return FakeDevice::Read(buffer, context);
+	}
+
+	std::mutex gate;
+	vector<IOClass> order;
+};
+
+/// @brief Issues a command of the given class on its own thread, and returns once the scheduler has queued it
+static void QueueCommand(SchedulingDevice &device, vector<std::thread> &threads, IOClass io_class) {
+	idx_t queued = device.GetQueuedCommandCount();
+	threads.emplace_back([&device, io_class]() {
+		vector<char> buf(DEFAULT_BLOCK_SIZE);
+		IOCategory category = io_class == IOClass::WAL        ? IOCategory::WAL
+		                      : io_class == IOClass::METADATA  ? IOCategory::METADATA
+		                      : io_class == IOClass::TEMPORARY ? IOCategory::TEMPORARY
+		                                                       : IOCategory::DATABASE;
+		CmdContext context {buf.size(), 1, 0, 0, 0, category};
+		if (io_class == IOClass::DATABASE_READ) {
+			device.Read(buf.data(), context);
+		} else {
+			device.Write(buf.data(), context);
+		}
+	});
+	while (device.GetQueuedCommandCount() == queued) {
+		std::this_thread::yield();
+	}
+}
+
+TEST(SchedulingDeviceTest, WaitingCommandsAreDispatchedByPriority) {
+	auto gated_device = make_uniq<GatedDevice>(1024);
+	GatedDevice &gated = *gated_device;
+	SchedulingDevice device(std::move(gated_device), NvmeSchedulerPolicy::Parse("depth=1"));
+
+	// A temporary write takes the only slot of the device and waits at the gate
+	gated.gate.lock();
+	vector<std::thread> threads;
+	threads.emplace_back([&device]() {
+		vector<char> buf(DEFAULT_BLOCK_SIZE);
+		device.Write(buf.data(), CmdContext {buf.size(), 1, 0, 0, 0, IOCategory::TEMPORARY});
+	});
+	while (device.GetStatistics()[static_cast<idx_t>(IOClass::TEMPORARY)].commands == 0) {
+		std::this_thread::yield();
+	}
+
+	for (IOClass io_class : {IOClass::TEMPORARY, IOClass::DATABASE_WRITE, IOClass::DATABASE_READ, IOClass::METADATA,
+	                         IOClass::WAL}) {
+		QueueCommand(device, threads, io_class);
+	}
+	gated.gate.unlock();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	// The waiting classes are served from the most latency sensitive one, and temporary I/O, which was just served,
+	// comes last
+	EXPECT_EQ(gated.order, vector<IOClass>({IOClass::TEMPORARY, IOClass::WAL, IOClass::METADATA, IOClass::DATABASE_READ,
+	                                        IOClass::DATABASE_WRITE, IOClass::TEMPORARY}));
+	vector<IOClassStatistics> statistics = device.GetStatistics();
+	EXPECT_EQ(statistics[static_cast<idx_t>(IOClass::TEMPORARY)].commands, 2);
+	EXPECT_EQ(statistics[static_cast<idx_t>(IOClass::TEMPORARY)].queued, 1);
+	EXPECT_EQ(statistics[static_cast<idx_t>(IOClass::WAL)].queued, 1);
+	EXPECT_GT(statistics[static_cast<idx_t>(IOClass::WAL)].wait_ns, 0);
+	EXPECT_EQ(device.GetQueuedCommandCount(), 0);
+}
+
+TEST(SchedulingDeviceTest, BusyClassesShareTheDeviceByWeight) {
+	auto gated_device = make_uniq<GatedDevice>(1024);
+	GatedDevice &gated = *gated_device;
+	SchedulingDevice device(std::move(gated_device), NvmeSchedulerPolicy::Parse("depth=1,database_write=2"));
+
+	gated.gate.lock();
+	vector<std::thread> threads;
+	threads.emplace_back([&device]() {
+		vector<char> buf(DEFAULT_BLOCK_SIZE);
+		device.Read(buf.data(), CmdContext {buf.size(), 1, 0, 0, 0, IOCategory::DATABASE});
+	});
+	while (device.GetStatistics()[static_cast<idx_t>(IOClass::DATABASE_READ)].commands == 0) {
+		std::this_thread::yield();
+	}
+	for (idx_t i = 0; i < 6; i++) {
+		QueueCommand(device, threads, IOClass::TEMPORARY);
+		QueueCommand(device, threads, IOClass::DATABASE_WRITE);
+	}
+	gated.gate.unlock();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	// While both classes are waiting, database writes get two slots for every slot of the temporary writes
+	idx_t database_writes = std::count(gated.order.begin() + 1, gated.order.begin() + 7, IOClass::DATABASE_WRITE);
+	EXPECT_EQ(database_writes, 4);
+	EXPECT_EQ(gated.order.size(), 13);
+}
+
+TEST(SchedulingDeviceTest, RateLimitedClassesWaitForTokens) {
+	SchedulingDevice device(make_uniq<FakeDevice>(1ULL << 16),
+	                        NvmeSchedulerPolicy::Parse("temporary:rate=64MiB,temporary:burst=1MiB"));
+	vector<char> buf(1ULL << 20);
+	idx_t nr_lbas = buf.size() / DEFAULT_BLOCK_SIZE;
+
+	auto start = std::chrono::steady_clock::now();
+	for (idx_t i = 0; i < 9; i++) {
+		device.Write(buf.data(), CmdContext {buf.size(), nr_lbas, i * nr_lbas, 0, 0, IOCategory::TEMPORARY});
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	// The burst covers the first MiB, and every further MiB has to wait for 1/64 of a second worth of tokens
+	EXPECT_GE(elapsed, std::chrono::milliseconds(100));
+	vector<IOClassStatistics> statistics = device.GetStatistics();
+	EXPECT_EQ(statistics[static_cast<idx_t>(IOClass::TEMPORARY)].commands, 9);
+	EXPECT_GE(statistics[static_cast<idx_t>(IOClass::TEMPORARY)].queued, 7);
+
+	// Classes without a rate are not limited by the tokens of other classes
+	device.Write(buf.data(), CmdContext {buf.size(), nr_lbas, 0, 0, 0, IOCategory::WAL});
+	EXPECT_EQ(device.GetStatistics()[static_cast<idx_t>(IOClass::WAL)].queued, 0);
+}
+
+TEST(SchedulingDeviceTest, FileSystemCommandsAreScheduledByTheirCategory) {
+	NvmeConfig config = gtestutils::TEST_CONFIG;
+	config.io_scheduler = "depth=4";
+	NvmeFileSystem file_system(config, make_uniq<FakeDevice>((1ULL << 30) / DEFAULT_BLOCK_SIZE));
+	ASSERT_TRUE(file_system.GetScheduler());
+
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> db_handle = file_system.OpenFile("nvmefs://test.db", flags);
+	unique_ptr<FileHandle> wal_handle = file_system.OpenFile("nvmefs://test.db.wal", flags);
+	vector<char> buf(4 * DEFAULT_BLOCK_SIZE, 'd');
+	db_handle->Write(buf.data(), buf.size(), 0);
+	db_handle->Read(buf.data(), buf.size(), 0);
+	wal_handle->Write(buf.data(), DEFAULT_BLOCK_SIZE, 0);
+
+	vector<IOClassStatistics> statistics = file_system.GetScheduler()->GetStatistics();
+	EXPECT_GT(statistics[static_cast<idx_t>(IOClass::METADATA)].commands, 0);
+	EXPECT_GE(statistics[static_cast<idx_t>(IOClass::DATABASE_WRITE)].commands, 1);
+	EXPECT_GE(statistics[static_cast<idx_t>(IOClass::DATABASE_READ)].commands, 1);
+	EXPECT_GE(statistics[static_cast<idx_t>(IOClass::WAL)].commands, 1);
+
+	vector<pair<string, string>> info = file_system.GetDevice().GetDeviceInfo();
+	EXPECT_EQ(info.front(), make_pair(string("device"), string("FakeDevice")));
+	EXPECT_EQ(info.back().first, "io_scheduler");
+	EXPECT_EQ(info.back().second.find("depth=4,"), 0);
+
+	// Without a policy the commands go straight to the device
+	NvmeFileSystem unscheduled(gtestutils::TEST_CONFIG, make_uniq<FakeDevice>(1024));
+	EXPECT_FALSE(unscheduled.GetScheduler());
+}
+
+/// @brief Creates a sparse file of the given size in the temporary directory of the test
+static string CreateDeviceFile(const string &name, idx_t size) {
+	string path = testing::TempDir() + name;
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.seekp(size - 1);
+	file.put(0);
+	return path;
+}
+
+TEST(UringDeviceTest, OptionsOverrideTheDefaults) {
+	UringDeviceOptions defaults = UringDeviceOptions::Parse("");
+	EXPECT_EQ(defaults.rings, 0);
+	EXPECT_FALSE(defaults.sqpoll);
+	EXPECT_FALSE(defaults.iopoll);
+	EXPECT_GT(defaults.fixed_buffers, 0);
+
+	UringDeviceOptions options =
+	    UringDeviceOptions::Parse("rings=2, queue_depth=128, sqpoll, sqpoll_idle=50, fixed_buffers=4, "
+	                              "fixed_buffer_size=1MiB");
+	EXPECT_EQ(options.rings, 2);
+	EXPECT_EQ(options.queue_depth, 128);
+	EXPECT_TRUE(options.sqpoll);
+	EXPECT_EQ(options.sqpoll_idle_ms, 50);
+	EXPECT_FALSE(options.iopoll);
+	EXPECT_EQ(options.fixed_buffers, 4);
+	EXPECT_EQ(options.fixed_buffer_size, 1ULL << 20);
+	EXPECT_EQ(options.ToString(), "rings=2,queue_depth=128,sqpoll,sqpoll_idle=50,fixed_buffers=4,"
+	                              "fixed_buffer_size=1.0 MiB");
+
+	EXPECT_THROW(UringDeviceOptions::Parse("queue_depth=0"), InvalidInputException);
+	EXPECT_THROW(UringDeviceOptions::Parse("rings=many"), InvalidInputException);
+	EXPECT_THROW(UringDeviceOptions::Parse("polling"), InvalidInputException);
+	EXPECT_THROW(UringDeviceOptions::Parse("ring_size=8"), InvalidInputException);
+}
+
+#ifdef NVMEFS_LIBURING
+TEST(UringDeviceTest, FileBackedDeviceKeepsTheDataOfPartialWrites) {
+	const idx_t lba_count = 64;
+	string path = CreateDeviceFile("nvmefs_uring_device", lba_count * 4096);
+
+	unique_ptr<UringDevice> device;
+	try {
+		device = make_uniq<UringDevice>(path, UringDeviceOptions::Parse("rings=1,fixed_buffers=2"), 2);
+	} catch (IOException &e) {
+		std::remove(path.c_str());
+		GTEST_SKIP() << "io_uring is not available: " << e.what();
+	}
+	DeviceGeometry geometry = device->GetDeviceGeometry();
+	ASSERT_EQ(geometry.lba_size, 4096);
+	ASSERT_EQ(geometry.lba_count, lba_count);
+
+	// Whole LBAs, larger than a fixed buffer and from a buffer that is not aligned for direct I/O
+	vector<char> data(8 * geometry.lba_size + 1);
+	for (idx_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<char>('a' + i % 26);
+	}
+	device->Write(data.data() + 1, CmdContext {8 * geometry.lba_size, 8, 4, 0});
+	vector<char> result(8 * geometry.lba_size);
+	device->Read(result.data(), CmdContext {result.size(), 8, 4, 0});
+	EXPECT_EQ(memcmp(result.data(), data.data() + 1, result.size()), 0);
+
+	// A write within an LBA keeps the bytes around it
+	string hello = "hello";
+	device->Write(&hello[0], CmdContext {hello.size(), 1, 5, 100});
+	vector<char> lba(geometry.lba_size);
+	device->Read(lba.data(), CmdContext {lba.size(), 1, 5, 0});
+	EXPECT_EQ(string(lba.data() + 100, hello.size()), hello);
+	EXPECT_EQ(memcmp(lba.data(), data.data() + 1 + geometry.lba_size, 100), 0);
+	EXPECT_EQ(lba[105], data[1 + geometry.lba_size + 105]);
+
+	// Deallocated LBAs read as zeros
+	device->Deallocate(CmdContext {geometry.lba_size, 1, 4, 0});
+	device->Read(lba.data(), CmdContext {lba.size(), 1, 4, 0});
+	EXPECT_EQ(std::count(lba.begin(), lba.end(), 0), geometry.lba_size);
+
+	// Threads that share a ring complete the commands of each other
+	vector<std::thread> threads;
+	for (idx_t t = 0; t < 4; t++) {
+		threads.emplace_back([&device, &geometry, t]() {
+			vector<char> buffer(geometry.lba_size, static_cast<char>('0' + t));
+			vector<char> check(geometry.lba_size);
+			for (idx_t i = 0; i < 50; i++) {
+				device->Write(buffer.data(), CmdContext {buffer.size(), 1, 20 + t, 0});
+				device->Read(check.data(), CmdContext {check.size(), 1, 20 + t, 0});
+				EXPECT_EQ(check, buffer);
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	std::remove(path.c_str());
+}
+
+TEST(UringDeviceTest, StagedCommandsWithoutFixedBuffersKeepTheSurroundingData) {
+	const idx_t lba_count = 32;
+	string path = CreateDeviceFile("nvmefs_uring_staged", lba_count * 4096);
+
+	unique_ptr<UringDevice> device;
+	try {
+		device = make_uniq<UringDevice>(path, UringDeviceOptions::Parse("rings=1,fixed_buffers=0"), 1);
+	} catch (IOException &e) {
+		std::remove(path.c_str());
+		GTEST_SKIP() << "io_uring is not available: " << e.what();
+	}
+	idx_t lba_size = device->GetDeviceGeometry().lba_size;
+
+	vector<char> background(4 * lba_size, 'b');
+	device->Write(background.data(), CmdContext {background.size(), 4, 8, 0});
+
+	// From the middle of LBA 8 to the middle of LBA 11, which reads the head and tail LBAs before writing
+	string data(3 * lba_size, 'd');
+	device->Write(&data[0], CmdContext {data.size(), 4, 8, lba_size / 2});
+	vector<char> result(4 * lba_size);
+	device->Read(result.data(), CmdContext {result.size(), 4, 8, 0});
+	EXPECT_EQ(string(result.data(), lba_size / 2), string(lba_size / 2, 'b'));
+	EXPECT_EQ(string(result.data() + lba_size / 2, data.size()), data);
+	EXPECT_EQ(string(result.data() + lba_size / 2 + data.size(), lba_size / 2), string(lba_size / 2, 'b'));
+
+	// A read that does not start at an LBA boundary
+	string part(10, ' ');
+	device->Read(&part[0], CmdContext {part.size(), 1, 8, lba_size / 2 - 5});
+	EXPECT_EQ(part, "bbbbbddddd");
+
+	// A file that shrinks after it was opened reads as zeros past its end
+	ASSERT_EQ(truncate(path.c_str(), 9 * lba_size + lba_size / 2), 0);
+	device->Read(result.data(), CmdContext {result.size(), 4, 8, 0});
+	EXPECT_EQ(string(result.data(), lba_size / 2), string(lba_size / 2, 'b'));
+	EXPECT_EQ(string(result.data() + lba_size / 2, lba_size), string(lba_size, 'd'));
+	EXPECT_EQ(std::count(result.begin() + lba_size + lba_size / 2, result.end(), 0), 2 * lba_size + lba_size / 2);
+
+	// Deallocating LBAs within the file
+	device->Deallocate(CmdContext {lba_size, 1, 8, 0});
+	device->Read(result.data(), CmdContext {lba_size, 1, 8, 0});
+	EXPECT_EQ(std::count(result.begin(), result.begin() + lba_size, 0), lba_size);
+
+	std::remove(path.c_str());
+}
+
+TEST(UringDeviceTest, PollingRequiresDirectIO) {
+	string path = CreateDeviceFile("nvmefs_uring_iopoll", 16 * 4096);
+	bool direct = false;
+	close(FileBackedLBAs::Open(path, direct));
+	if (direct) {
+		std::remove(path.c_str());
+		GTEST_SKIP() << "The file system of the test files supports direct I/O";
+	}
+	EXPECT_THROW(UringDevice(path, UringDeviceOptions::Parse("iopoll"), 1), IOException);
+	std::remove(path.c_str());
+}
+#endif
+
+TEST(FileBackedLBAsTest, StagedWritesOnlyReadTheLBAsTheyCoverPartially) {
+	const idx_t lba_size = 16;
+	vector<char> lbas(8 * lba_size, 'x');
+	vector<pair<idx_t, idx_t>> reads;
+	FileBackedLBAs::transfer_t transfer = [&](bool write, data_ptr_t buffer, idx_t start_lba, idx_t nr_lbas) {
+		if (write) {
+			memcpy(lbas.data() + start_lba * lba_size, buffer, nr_lbas * lba_size);
+		} else {
+			reads.emplace_back(start_lba, nr_lbas);
+			memcpy(buffer, lbas.data() + start_lba * lba_size, nr_lbas * lba_size);
+		}
+	};
+	NvmeIOStatistics statistics;
+	vector<data_t> staging(4 * lba_size);
+
+	// From the middle of LBA 2 to the middle of LBA 5, which covers LBAs 3 and 4 whole
+	string data(3 * lba_size, 'd');
+	FileBackedLBAs::StageWrite(data.data(), CmdContext {data.size(), 4, 2, lba_size / 2}, lba_size, staging.data(),
+	                           transfer, &statistics);
+	EXPECT_THAT(reads, testing::ElementsAre(pair<idx_t, idx_t>(2, 1), pair<idx_t, idx_t>(5, 1)));
+	EXPECT_EQ(string(lbas.data() + 2 * lba_size, lba_size / 2), string(lba_size / 2, 'x'));
+	EXPECT_EQ(string(lbas.data() + 2 * lba_size + lba_size / 2, data.size()), data);
+	EXPECT_EQ(string(lbas.data() + 5 * lba_size + lba_size / 2, lba_size / 2), string(lba_size / 2, 'x'));
+
+	// A write inside a single LBA reads that LBA
+	reads.clear();
+	FileBackedLBAs::StageWrite("hi", CmdContext {2, 1, 7, 3}, lba_size, staging.data(), transfer, &statistics);
+	EXPECT_THAT(reads, testing::ElementsAre(pair<idx_t, idx_t>(7, 1)));
+	EXPECT_EQ(string(lbas.data() + 7 * lba_size, 6), "xxxhix");
+
+	string result(5, ' ');
+	FileBackedLBAs::StageRead(&result[0], CmdContext {5, 1, 7, 1}, lba_size, staging.data(), transfer, &statistics);
+	EXPECT_EQ(result, "xxhix");
+
+	vector<IOCategoryStatistics> totals = statistics.GetStatistics();
+	EXPECT_EQ(totals[static_cast<idx_t>(IOCategory::GENERAL)].read_modify_writes, 2);
+	EXPECT_EQ(totals[static_cast<idx_t>(IOCategory::GENERAL)].bounce_copies, 3);
+}
+
+TEST(FileBackedLBAsTest, OnlyWholeAlignedLBAsAreTransferredDirectly) {
+	alignas(64) char buffer[128];
+	EXPECT_TRUE(FileBackedLBAs::IsDirectTransfer(buffer, CmdContext {64, 1, 0, 0}, 64, 64));
+	EXPECT_FALSE(FileBackedLBAs::IsDirectTransfer(buffer + 4, CmdContext {64, 1, 0, 0}, 64, 64));
+	EXPECT_TRUE(FileBackedLBAs::IsDirectTransfer(buffer + 4, CmdContext {64, 1, 0, 0}, 64, 4));
+	EXPECT_FALSE(FileBackedLBAs::IsDirectTransfer(buffer, CmdContext {32, 1, 0, 0}, 64, 1));
+	EXPECT_FALSE(FileBackedLBAs::IsDirectTransfer(buffer, CmdContext {64, 2, 0, 32}, 64, 1));
+
+	// A file that ends inside a transfer reads as zeros past its end
+	memset(buffer, 'f', sizeof(buffer));
+	FileBackedLBAs::ZeroPastEndOfFile(reinterpret_cast<data_ptr_t>(buffer), 100, sizeof(buffer));
+	EXPECT_EQ(std::count(buffer, buffer + 100, 'f'), 100);
+	EXPECT_EQ(std::count(buffer + 100, buffer + sizeof(buffer), 0), 28);
+	EXPECT_EQ(FileBackedLBAs::GetFileGeometry(10 * NVMEFS_FILE_LBA_SIZE + 1).lba_count, 10);
+}
+
+TEST(DirectDeviceTest, FileBackedDeviceKeepsTheDataOfPartialWrites) {
+	string path = CreateDeviceFile("nvmefs_direct_device", 64 * 4096);
+	DirectDevice device(path);
+	DeviceGeometry geometry = device.GetDeviceGeometry();
+	ASSERT_EQ(geometry.lba_size, 4096);
+	ASSERT_EQ(geometry.lba_count, 64);
+
+	// Whole LBAs from a buffer that is not aligned for direct I/O
+	vector<char> data(4 * geometry.lba_size + 1);
+	for (idx_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<char>('a' + i % 26);
+	}
+	device.Write(data.data() + 1, CmdContext {4 * geometry.lba_size, 4, 8, 0});
+	vector<char> result(4 * geometry.lba_size);
+	device.Read(result.data(), CmdContext {result.size(), 4, 8, 0});
+	EXPECT_EQ(memcmp(result.data(), data.data() + 1, result.size()), 0);
+
+	// A write that spans the boundary of two LBAs keeps the bytes around it
+	string hello = "hello";
+	device.Write(&hello[0], CmdContext {hello.size(), 2, 9, geometry.lba_size - 2});
+	device.Read(result.data(), CmdContext {2 * geometry.lba_size, 2, 9, 0});
+	EXPECT_EQ(string(result.data() + geometry.lba_size - 2, hello.size()), hello);
+	EXPECT_EQ(memcmp(result.data(), data.data() + 1 + geometry.lba_size, geometry.lba_size - 2), 0);
+	EXPECT_EQ(result[geometry.lba_size + 3], data[1 + 2 * geometry.lba_size + 3]);
+
+	// Deallocated and never written LBAs read as zeros
+	device.Deallocate(CmdContext {geometry.lba_size, 1, 8, 0});
+	device.Read(result.data(), CmdContext {geometry.lba_size, 1, 8, 0});
+	EXPECT_EQ(std::count(result.begin(), result.begin() + geometry.lba_size, 0), geometry.lba_size);
+	device.Read(result.data(), CmdContext {geometry.lba_size, 1, 63, 0});
+	EXPECT_EQ(std::count(result.begin(), result.begin() + geometry.lba_size, 0), geometry.lba_size);
+
+	EXPECT_THROW(DirectDevice(testing::TempDir() + "nvmefs_missing_device"), IOException);
+	std::remove(path.c_str());
+}
+
+TEST(DirectDeviceTest, FileSystemRunsOnAFile) {
+	string path = CreateDeviceFile("nvmefs_direct_file_system", 1ULL << 30);
+	{
+		NvmeFileSystem file_system(gtestutils::TEST_CONFIG, make_uniq<DirectDevice>(path));
+		FileOpenFlags flags =
+		    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+		unique_ptr<FileHandle> db_handle = file_system.OpenFile("nvmefs://test.db", flags);
+		vector<char> buf(3 * DEFAULT_BLOCK_SIZE, 'd');
+		db_handle->Write(buf.data(), buf.size(), 0);
+	}
+
+	// The layout is read back from the file by a new file system
+	NvmeFileSystem file_system(gtestutils::TEST_CONFIG, make_uniq<DirectDevice>(path));
+	EXPECT_TRUE(file_system.FileExists("nvmefs://test.db"));
+	unique_ptr<FileHandle> db_handle = file_system.OpenFile("nvmefs://test.db", FileOpenFlags::FILE_FLAGS_READ);
+	vector<char> buf(3 * DEFAULT_BLOCK_SIZE);
+	db_handle->Read(buf.data(), buf.size(), 0);
+	EXPECT_EQ(std::count(buf.begin(), buf.end(), 'd'), buf.size());
+	std::remove(path.c_str());
+}
+
+/// @brief Creates a striped device over fake devices of the given size
+static unique_ptr<StripedDevice> CreateStripedDevice(idx_t member_count, idx_t lba_count, idx_t stripe_lbas) {
+	vector<unique_ptr<Device>> members;
+	for (idx_t i = 0; i < member_count; i++) {
+		members.push_back(make_uniq<FakeDevice>(lba_count));
+	}
+	return make_uniq<StripedDevice>(std::move(members), stripe_lbas * DEFAULT_BLOCK_SIZE, 2);
+}
+
+TEST(StripedDeviceTest, LBAsAreStripedRoundRobinOverTheMembers) {
+	// The smallest member decides how many stripe rows the device holds
+	vector<unique_ptr<Device>> members;
+	members.push_back(make_uniq<FakeDevice>(101));
+	members.push_back(make_uniq<FakeDevice>(120));
+	members.push_back(make_uniq<FakeDevice>(110));
+	StripedDevice device(std::move(members), 2 * DEFAULT_BLOCK_SIZE, 2);
+	EXPECT_EQ(device.GetDeviceGeometry().lba_size, DEFAULT_BLOCK_SIZE);
+	EXPECT_EQ(device.GetDeviceGeometry().lba_count, 50 * 2 * 3);
+
+	vector<char> data(7 * DEFAULT_BLOCK_SIZE);
+	for (idx_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<char>('a' + i % 26);
+	}
+	device.Write(data.data(), CmdContext {data.size(), 7, 1, 0, 3});
+	vector<char> result(data.size());
+	device.Read(result.data(), CmdContext {result.size(), 7, 1, 0});
+	EXPECT_EQ(result, data);
+
+	// LBAs 1 to 7 are the units 0 to 3, which are on members 0, 1, 2 and 0 again in the next row
+	auto writes_of = [&device](idx_t member) {
+		return static_cast<FakeDevice &>(device.GetMember(member)).GetWrites();
+	};
+	ASSERT_EQ(writes_of(0).size(), 2);
+	EXPECT_EQ(writes_of(0)[0].start_lba, 1);
+	EXPECT_EQ(writes_of(0)[0].nr_lbas, 1);
+	EXPECT_EQ(writes_of(0)[1].start_lba, 2);
+	EXPECT_EQ(writes_of(0)[1].nr_lbas, 2);
+	EXPECT_EQ(writes_of(0)[1].placement_identifier, 3);
+	ASSERT_EQ(writes_of(1).size(), 1);
+	EXPECT_EQ(writes_of(1)[0].start_lba, 0);
+	EXPECT_EQ(writes_of(1)[0].nr_lbas, 2);
+	ASSERT_EQ(writes_of(2).size(), 1);
+	EXPECT_EQ(writes_of(2)[0].start_lba, 0);
+
+	// A write within LBAs that spans a stripe unit keeps the bytes around it
+	string hello = "hello";
+	device.Write(&hello[0], CmdContext {hello.size(), 2, 2, DEFAULT_BLOCK_SIZE - 2});
+	device.Read(result.data(), CmdContext {result.size(), 7, 1, 0});
+	EXPECT_EQ(string(result.data() + 2 * DEFAULT_BLOCK_SIZE - 2, hello.size()), hello);
+	EXPECT_EQ(memcmp(result.data(), data.data(), 2 * DEFAULT_BLOCK_SIZE - 2), 0);
+	EXPECT_EQ(memcmp(result.data() + 2 * DEFAULT_BLOCK_SIZE + 3, data.data() + 2 * DEFAULT_BLOCK_SIZE + 3,
+	                 5 * DEFAULT_BLOCK_SIZE - 3),
+	          0);
+
+	vector<pair<string, string>> info = device.GetDeviceInfo();
+	EXPECT_THAT(info, testing::Contains(make_pair(string("members"), string("3"))));
+	EXPECT_THAT(info, testing::Contains(make_pair(string("member_2"), string("FakeDevice"))));
+
+	vector<unique_ptr<Device>> mismatched;
+	mismatched.push_back(make_uniq<FakeDevice>(100));
+	mismatched.push_back(make_uniq<FakeDevice>(100, 512));
+	EXPECT_THROW(StripedDevice(std::move(mismatched), DEFAULT_BLOCK_SIZE, 1), InvalidInputException);
+}
+
+/// @brief Blocks every read until the given number of reads have started, which only happens if they run concurrently
+class RendezvousDevice : public FakeDevice {
+public:
+	RendezvousDevice(idx_t lba_count, std::atomic<idx_t> &arrived, idx_t expected)
+	    : FakeDevice(lba_count), arrived(arrived), expected(expected) {
+	}
+
+	idx_t Read(void *buffer, const CmdContext &context) override {
+		arrived++;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (arrived < expected && std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::yield();
+		}
+		return FakeDevice::Read(buffer, context);
+	}
+
+	std::atomic<idx_t> &arrived;
+	const idx_t expected;
+};
+
+TEST(StripedDeviceTest, LargeCommandsRunOnAllMembersConcurrently) {
+	std::atomic<idx_t> arrived {0};
+	vector<unique_ptr<Device>> members;
+	for (idx_t i = 0; i < 4; i++) {
+		members.push_back(make_uniq<RendezvousDevice>(64, arrived, 4));
+	}
+	StripedDevice device(std::move(members), DEFAULT_BLOCK_SIZE, 3);
+
+	vector<char> buf(4 * DEFAULT_BLOCK_SIZE);
+	auto start = std::chrono::steady_clock::now();
+	device.Read(buf.data(), CmdContext {buf.size(), 4, 0, 0});
+	EXPECT_EQ(arrived, 4);
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(StripedDeviceTest, DeallocationsFreeTheRangeOnEveryMember) {
+	auto device = CreateStripedDevice(2, 64, 16);
+	vector<char> buf(64 * DEFAULT_BLOCK_SIZE, 'x');
+	device->Write(buf.data(), CmdContext {buf.size(), 64, 32, 0});
+	EXPECT_GT(static_cast<FakeDevice &>(device->GetMember(0)).GetAllocatedBytes(), 0);
+
+	device->Deallocate(CmdContext {buf.size(), 64, 32, 0});
+	EXPECT_EQ(static_cast<FakeDevice &>(device->GetMember(0)).GetAllocatedBytes(), 0);
+	EXPECT_EQ(static_cast<FakeDevice &>(device->GetMember(1)).GetAllocatedBytes(), 0);
+}
+
+TEST(StripedDeviceTest, FileSystemRunsOnStripedDevices) {
+	NvmeFileSystem file_system(gtestutils::TEST_CONFIG,
+	                           CreateStripedDevice(4, (1ULL << 28) / DEFAULT_BLOCK_SIZE, 64));
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> db_handle = file_system.OpenFile("nvmefs://test.db", flags);
+	vector<char> buf(16 * 64 * DEFAULT_BLOCK_SIZE);
+	for (idx_t i = 0; i < buf.size(); i++) {
+		buf[i] = static_cast<char>(i % 251);
+	}
+	db_handle->Write(buf.data(), buf.size(), 0);
+	vector<char> result(buf.size());
+	db_handle->Read(result.data(), result.size(), 0);
+	EXPECT_EQ(result, buf);
+	EXPECT_EQ(file_system.GetDevice().GetDeviceGeometry().lba_count, 4 * ((1ULL << 28) / DEFAULT_BLOCK_SIZE));
+}
+
+TEST(MirroredDeviceTest, HedgingIsParsedAsAPercentile) {
+	EXPECT_EQ(MirroredDevice::ParseHedgePercentile(""), 0);
+	EXPECT_EQ(MirroredDevice::ParseHedgePercentile("off"), 0);
+	EXPECT_DOUBLE_EQ(MirroredDevice::ParseHedgePercentile("p99"), 0.99);
+	EXPECT_DOUBLE_EQ(MirroredDevice::ParseHedgePercentile(" P99.9 "), 0.999);
+	EXPECT_THROW(MirroredDevice::ParseHedgePercentile("p100"), InvalidInputException);
+	EXPECT_THROW(MirroredDevice::ParseHedgePercentile("p99x"), InvalidInputException);
+	EXPECT_THROW(MirroredDevice::ParseHedgePercentile("fast"), InvalidInputException);
+}
+
+/// @brief Holds every read while the test stalls the device, like a drive in the middle of garbage collection
+class StallingDevice : public FakeDevice {
+public:
+	explicit StallingDevice(idx_t lba_count) : FakeDevice(lba_count), stalled(false), started_reads(0) {
+	}
+
+	idx_t Read(void *buffer, const CmdContext &context) override {
+		started_reads++;
+		while (stalled) {
+			std::this_thread::yield();
+		}
+		return FakeDevice::Read(buffer, context);
+	}
+
+	std::atomic<bool> stalled;
+	std::atomic<idx_t> started_reads;
+};
+
+static unique_ptr<MirroredDevice> CreateMirroredDevice(double hedge_percentile) {
+	vector<unique_ptr<Device>> members;
+	members.push_back(make_uniq<StallingDevice>(1024));
+	members.push_back(make_uniq<StallingDevice>(1024));
+	return make_uniq<MirroredDevice>(std::move(members), hedge_percentile, 4);
+}
+
+TEST(MirroredDeviceTest, WritesGoToAllMembersAndReadsToTheLeastBusy) {
+	auto device = CreateMirroredDevice(0);
+	auto &first = static_cast<StallingDevice &>(device->GetMember(0));
+	auto &second = static_cast<StallingDevice &>(device->GetMember(1));
+	vector<char> data(16 * DEFAULT_BLOCK_SIZE, 'm');
+	device->Write(data.data(), CmdContext {data.size(), 16, 16, 0, 1});
+	ASSERT_EQ(first.GetWrites().size(), 1);
+	ASSERT_EQ(second.GetWrites().size(), 1);
+	EXPECT_EQ(second.GetWrites()[0].start_lba, 16);
+	EXPECT_EQ(second.GetWrites()[0].placement_identifier, 1);
+
+	// The member that holds the first read has a command outstanding, hence the second read goes to the other one
+	first.stalled = true;
+	second.stalled = true;
+	vector<std::thread> readers;
+	vector<vector<char>> results(2, vector<char>(data.size()));
+	for (idx_t i = 0; i < 2; i++) {
+		readers.emplace_back([&device, &results, i]() {
+			device->Read(results[i].data(), CmdContext {results[i].size(), 16, 16, 0});
+		});
+		while (first.started_reads + second.started_reads == i) {
+			std::this_thread::yield();
+		}
+	}
+	EXPECT_EQ(first.started_reads, 1);
+	EXPECT_EQ(second.started_reads, 1);
+	first.stalled = false;
+	second.stalled = false;
+	for (auto &reader : readers) {
+		reader.join();
+	}
+	EXPECT_EQ(results[0], data);
+	EXPECT_EQ(results[1], data);
+
+	device->Deallocate(CmdContext {data.size(), 16, 16, 0});
+	EXPECT_EQ(first.GetAllocatedBytes(), 0);
+	EXPECT_EQ(second.GetAllocatedBytes(), 0);
+	EXPECT_THAT(device->GetDeviceInfo(), testing::Contains(make_pair(string("hedge_reads"), string("off"))));
+}
+
+TEST(MirroredDeviceTest, SlowReadsAreHedgedToAnotherMember) {
+	auto device = CreateMirroredDevice(0.99);
+	auto &first = static_cast<StallingDevice &>(device->GetMember(0));
+	vector<char> data(DEFAULT_BLOCK_SIZE, 'h');
+	device->Write(data.data(), CmdContext {data.size(), 1, 0, 0});
+
+	// Reads are only hedged once the latency of enough reads is known
+	vector<char> result(data.size());
+	EXPECT_FALSE(device->GetHedgeThreshold().IsValid());
+	for (idx_t i = 0; i < NVMEFS_MIRROR_HEDGE_MIN_SAMPLES; i++) {
+		device->Read(result.data(), CmdContext {result.size(), 1, 0, 0});
+	}
+	ASSERT_TRUE(device->GetHedgeThreshold().IsValid());
+
+	// A stalled member no longer delays the reads, which complete on the other member
+	idx_t hedged_reads = device->GetHedgedReadCount();
+	first.stalled = true;
+	auto start = std::chrono::steady_clock::now();
+	for (idx_t i = 0; i < 8; i++) {
+		std::fill(result.begin(), result.end(), 0);
+		device->Read(result.data(), CmdContext {result.size(), 1, 0, 0});
+		EXPECT_EQ(result, data);
+	}
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+	EXPECT_GT(device->GetHedgedReadCount(), hedged_reads);
+	first.stalled = false;
+}
+
+TEST(RegionDeviceTest, CommandsAreRoutedToTheDeviceOfTheirRegion) {
+	RegionDevice device(make_uniq<FakeDevice>(100), make_uniq<FakeDevice>(50), make_uniq<FakeDevice>(30));
+	EXPECT_EQ(device.GetDeviceGeometry().lba_count, 180);
+	vector<DeviceRegion> regions = device.GetRegions();
+	ASSERT_EQ(regions.size(), 3);
+	EXPECT_EQ(regions[1].category, IOCategory::WAL);
+	EXPECT_EQ(regions[1].start_lba, 100);
+	EXPECT_EQ(regions[1].lba_count, 50);
+	EXPECT_EQ(regions[2].start_lba, 150);
+
+	// A write across the end of the database region is split between the database and the WAL device
+	vector<char> data(4 * DEFAULT_BLOCK_SIZE - 10);
+	for (idx_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<char>('a' + i % 26);
+	}
+	device.Write(data.data(), CmdContext {data.size(), 4, 98, 10, 2});
+	vector<char> result(data.size());
+	device.Read(result.data(), CmdContext {result.size(), 4, 98, 10});
+	EXPECT_EQ(result, data);
+
+	auto writes_of = [&device](IOCategory category) {
+		return static_cast<FakeDevice &>(*device.GetRegionDevice(category)).GetWrites();
+	};
+	ASSERT_EQ(writes_of(IOCategory::DATABASE).size(), 1);
+	EXPECT_EQ(writes_of(IOCategory::DATABASE)[0].start_lba, 98);
+	EXPECT_EQ(writes_of(IOCategory::DATABASE)[0].nr_lbas, 2);
+	ASSERT_EQ(writes_of(IOCategory::WAL).size(), 1);
+	EXPECT_EQ(writes_of(IOCategory::WAL)[0].start_lba, 0);
+	EXPECT_EQ(writes_of(IOCategory::WAL)[0].nr_lbas, 2);
+	EXPECT_EQ(writes_of(IOCategory::WAL)[0].placement_identifier, 2);
+	EXPECT_TRUE(writes_of(IOCategory::TEMPORARY).empty());
+
+	device.Deallocate(CmdContext {DEFAULT_BLOCK_SIZE, 1, 150, 0});
+	EXPECT_THAT(device.GetDeviceInfo(), testing::Contains(make_pair(string("temporary_lbas"), string("150-180"))));
+
+	// Regions that are not given stay on the database device
+	RegionDevice wal_only(make_uniq<FakeDevice>(100), make_uniq<FakeDevice>(50), nullptr);
+	EXPECT_EQ(wal_only.GetRegions().size(), 2);
+	EXPECT_FALSE(wal_only.GetRegionDevice(IOCategory::TEMPORARY));
+
+	EXPECT_THROW(RegionDevice(make_uniq<FakeDevice>(100), make_uniq<FakeDevice>(100, 512), nullptr),
+	             InvalidInputException);
+}
+
+TEST(RegionDeviceTest, FileSystemPlacesTheWALAndTemporaryFilesOnTheirDevices) {
+	idx_t region_lbas = (1ULL << 26) / DEFAULT_BLOCK_SIZE;
+	NvmeFileSystem file_system(gtestutils::TEST_CONFIG,
+	                           make_uniq<RegionDevice>(make_uniq<FakeDevice>(4 * region_lbas),
+	                                                   make_uniq<FakeDevice>(region_lbas),
+	                                                   make_uniq<FakeDevice>(region_lbas)));
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> db_handle = file_system.OpenFile("nvmefs://test.db", flags);
+	unique_ptr<FileHandle> wal_handle = file_system.OpenFile("nvmefs://test.db.wal", flags);
+	unique_ptr<FileHandle> tmp_handle =
+	    file_system.OpenFile(StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0), flags);
+
+	auto &device = static_cast<RegionDevice &>(file_system.GetDevice());
+	auto written_bytes = [&device](IOCategory category) {
+		return static_cast<FakeDevice &>(*device.GetRegionDevice(category)).GetAllocatedBytes();
+	};
+	idx_t database_bytes = written_bytes(IOCategory::DATABASE);
+
+	vector<char> buf(32768, 'w');
+	wal_handle->Write(buf.data(), buf.size(), 0);
+	EXPECT_GT(written_bytes(IOCategory::WAL), 0);
+	tmp_handle->Write(buf.data(), buf.size(), 0);
+	EXPECT_GT(written_bytes(IOCategory::TEMPORARY), 0);
+
+	// The extents of the WAL and temporary files are allocated outside of the database device
+	vector<char> result(buf.size());
+	wal_handle->Read(result.data(), result.size(), 0);
+	EXPECT_EQ(result, buf);
+	tmp_handle->Read(result.data(), result.size(), 0);
+	EXPECT_EQ(result, buf);
+	db_handle->Write(buf.data(), buf.size(), 0);
+	EXPECT_GT(written_bytes(IOCategory::DATABASE), database_bytes);
+}
+
+TEST(RegionDeviceTest, DeviceMustBeOpenedWithTheRegionsItWasFormattedWith) {
+	idx_t region_bytes = 1ULL << 26;
+	string database_path = CreateDeviceFile("nvmefs_region_database", 4 * region_bytes);
+	string wal_path = CreateDeviceFile("nvmefs_region_wal", region_bytes);
+	string temporary_path = CreateDeviceFile("nvmefs_region_temporary", region_bytes);
+	auto open_regions = [&](bool wal, bool temporary) {
+		return make_uniq<RegionDevice>(make_uniq<DirectDevice>(database_path),
+		                               wal ? make_uniq<DirectDevice>(wal_path) : nullptr,
+		                               temporary ? make_uniq<DirectDevice>(temporary_path) : nullptr);
+	};
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	{
+		NvmeFileSystem file_system(gtestutils::TEST_CONFIG, open_regions(true, false));
+		unique_ptr<FileHandle> db_handle = file_system.OpenFile("nvmefs://test.db", flags);
+		vector<char> buf(DEFAULT_BLOCK_SIZE, 'd');
+		db_handle->Write(buf.data(), buf.size(), 0);
+	}
+
+	// Adding a device or leaving one out would move the extents of the regions
+	NvmeFileSystem added(gtestutils::TEST_CONFIG, open_regions(true, true));
+	EXPECT_THROW(added.FileExists("nvmefs://test.db"), IOException);
+	NvmeFileSystem removed(gtestutils::TEST_CONFIG, make_uniq<DirectDevice>(database_path));
+	EXPECT_THROW(removed.FileExists("nvmefs://test.db"), IOException);
+
+	NvmeFileSystem file_system(gtestutils::TEST_CONFIG, open_regions(true, false));
+	EXPECT_TRUE(file_system.FileExists("nvmefs://test.db"));
+
+	std::remove(database_path.c_str());
+	std::remove(wal_path.c_str());
+	std::remove(temporary_path.c_str());
+}
+
+TEST(IOStatisticsTest, LatenciesAreCountedInPowerOfTwoBuckets) {
+	EXPECT_EQ(NvmeIOStatistics::GetLatencyBucket(0), 0);
+	EXPECT_EQ(NvmeIOStatistics::GetLatencyBucket(1), 0);
+	EXPECT_EQ(NvmeIOStatistics::GetLatencyBucket(2), 1);
+	EXPECT_EQ(NvmeIOStatistics::GetLatencyBucket(1023), 9);
+	EXPECT_EQ(NvmeIOStatistics::GetLatencyBucket(1024), 10);
+	EXPECT_EQ(NvmeIOStatistics::GetLatencyBucket(NumericLimits<idx_t>::Maximum()), NVMEFS_LATENCY_BUCKET_COUNT - 1);
+
+	NvmeIOStatistics statistics;
+	EXPECT_FALSE(statistics.GetStatistics()[0].GetLatencyPercentile(IODirection::READ, 0.5).IsValid());
+
+	// 990 fast reads and 10 slow reads, such that only the tail percentile sees the slow reads
+	for (idx_t i = 0; i < 990; i++) {
+		statistics.RecordIO(IOCategory::TEMPORARY, IODirection::READ, 4096, 1000);
+	}
+	for (idx_t i = 0; i < 10; i++) {
+		statistics.RecordIO(IOCategory::TEMPORARY, IODirection::READ, 4096, 1000000);
+	}
+
+	IOCategoryStatistics temporary = statistics.GetStatistics()[static_cast<idx_t>(IOCategory::TEMPORARY)];
+	EXPECT_EQ(temporary.ops[static_cast<idx_t>(IODirection::READ)], 1000);
+	EXPECT_EQ(temporary.bytes[static_cast<idx_t>(IODirection::READ)], 1000 * 4096);
+	idx_t p50 = temporary.GetLatencyPercentile(IODirection::READ, 0.5).GetIndex();
+	idx_t p99 = temporary.GetLatencyPercentile(IODirection::READ, 0.99).GetIndex();
+	idx_t p999 = temporary.GetLatencyPercentile(IODirection::READ, 0.999).GetIndex();
+	EXPECT_GE(p50, 512);
+	EXPECT_LT(p50, 1024);
+	EXPECT_LE(p99, 1024);
+	EXPECT_GE(p999, 1ULL << 19);
+	EXPECT_LT(p999, 1ULL << 20);
+}
+
+TEST(IOStatisticsTest, CountersOfAllThreadsAreSummedAndReset) {
+	NvmeIOStatistics statistics;
+	idx_t thread_count = 8;
+	idx_t writes_per_thread = 10000;
+
+	vector<std::thread> threads;
+	for (idx_t thread = 0; thread < thread_count; thread++) {
+		threads.emplace_back([&]() {
+			for (idx_t i = 0; i < writes_per_thread; i++) {
+				statistics.RecordIO(IOCategory::WAL, IODirection::WRITE, 512, 20000);
+				statistics.RecordBounceCopy(IOCategory::WAL);
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	IOCategoryStatistics wal = statistics.GetStatistics()[static_cast<idx_t>(IOCategory::WAL)];
+	EXPECT_EQ(wal.ops[static_cast<idx_t>(IODirection::WRITE)], thread_count * writes_per_thread);
+	EXPECT_EQ(wal.bounce_copies, thread_count * writes_per_thread);
+	EXPECT_EQ(wal.ops[static_cast<idx_t>(IODirection::READ)], 0);
+
+	statistics.Reset();
+	wal = statistics.GetStatistics()[static_cast<idx_t>(IOCategory::WAL)];
+	EXPECT_EQ(wal.ops[static_cast<idx_t>(IODirection::WRITE)], 0);
+	EXPECT_EQ(wal.bounce_copies, 0);
+	EXPECT_FALSE(wal.GetLatencyPercentile(IODirection::WRITE, 0.5).IsValid());
+}
+
+TEST(IOStatisticsTest, SnapshotsAreSubtractedToAttributeIOToAQuery) {
+	NvmeIOStatistics statistics;
+	statistics.RecordIO(IOCategory::DATABASE, IODirection::READ, 1ULL << 20, 100000);
+	vector<IOCategoryStatistics> query_start = statistics.GetStatistics();
+
+	// The query spills 2 MiB and reads it back
+	statistics.RecordIO(IOCategory::TEMPORARY, IODirection::WRITE, 1ULL << 21, 2000000);
+	statistics.RecordIO(IOCategory::TEMPORARY, IODirection::READ, 1ULL << 21, 1000000);
+	vector<IOCategoryStatistics> query = NvmeIOStatistics::Subtract(statistics.GetStatistics(), query_start);
+
+	EXPECT_EQ(query[static_cast<idx_t>(IOCategory::DATABASE)].ops[static_cast<idx_t>(IODirection::READ)], 0);
+	const IOCategoryStatistics &temporary = query[static_cast<idx_t>(IOCategory::TEMPORARY)];
+	EXPECT_EQ(temporary.bytes[static_cast<idx_t>(IODirection::WRITE)], 1ULL << 21);
+	EXPECT_EQ(temporary.latency_ns[static_cast<idx_t>(IODirection::WRITE)], 2000000);
+	EXPECT_THAT(NvmeIOStatistics::Describe(query), testing::ElementsAre("temporary read: 1 ops, 2.0 MiB, 1.00 ms",
+	                                                                    "temporary write: 1 ops, 2.0 MiB, 2.00 ms"));
+
+	// Counters that were reset during the query count from zero
+	statistics.Reset();
+	statistics.RecordIO(IOCategory::TEMPORARY, IODirection::WRITE, 4096, 1000);
+	query = NvmeIOStatistics::Subtract(statistics.GetStatistics(), query_start);
+	EXPECT_EQ(query[static_cast<idx_t>(IOCategory::TEMPORARY)].bytes[static_cast<idx_t>(IODirection::WRITE)], 4096);
+	EXPECT_EQ(query[static_cast<idx_t>(IOCategory::DATABASE)].ops[static_cast<idx_t>(IODirection::READ)], 0);
+}
+
+TEST_F(DiskInteractionTest, IOStatisticsAreCountedPerCategory) {
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> db_handle = file_system->OpenFile("nvmefs://test.db", flags);
+	unique_ptr<FileHandle> csv_handle = file_system->OpenFile("nvmefs:///exports/out.csv", flags);
+	file_system->GetIOStatistics().Reset();
+
+	vector<char> buf(8 * DEFAULT_BLOCK_SIZE, 'x');
+	db_handle->Write(buf.data(), buf.size(), 0);
+	db_handle->Read(buf.data(), buf.size(), 0);
+	// Both ends of the write are inside an LBA, hence two LBAs are read, modified and written back
+	csv_handle->Write(buf.data(), 2 * DEFAULT_BLOCK_SIZE, 100);
+
+	vector<IOCategoryStatistics> statistics = file_system->GetIOStatistics().GetStatistics();
+	const IOCategoryStatistics &database = statistics[static_cast<idx_t>(IOCategory::DATABASE)];
+	EXPECT_EQ(database.ops[static_cast<idx_t>(IODirection::WRITE)], 1);
+	EXPECT_EQ(database.bytes[static_cast<idx_t>(IODirection::WRITE)], buf.size());
+	EXPECT_EQ(database.ops[static_cast<idx_t>(IODirection::READ)], 1);
+	EXPECT_EQ(database.read_modify_writes, 0);
+	EXPECT_TRUE(database.GetLatencyPercentile(IODirection::WRITE, 0.99).IsValid());
+
+	const IOCategoryStatistics &general = statistics[static_cast<idx_t>(IOCategory::GENERAL)];
+	EXPECT_EQ(general.read_modify_writes, 2);
+	EXPECT_EQ(general.bounce_copies, 2);
+	EXPECT_EQ(statistics[static_cast<idx_t>(IOCategory::WAL)].ops[static_cast<idx_t>(IODirection::WRITE)], 0);
+}
+
+#ifndef NVMEFS_DISABLE_TRACING
+TEST(TracerTest, RingsKeepTheMostRecentEventsOfTheirThread) {
+	NvmeTracer &tracer = NvmeTracer::Get();
+	tracer.SetEnabled(true);
+	tracer.TakeEvents();
+
+	// A new thread records into a ring of its own, which wraps around
+	idx_t event_count = NVMEFS_TRACE_RING_SIZE + 10;
+	std::thread thread([&]() {
+		for (idx_t i = 0; i < event_count; i++) {
+			NvmeTraceSpan span("RingTest");
+			span.SetRange(i, 1);
+		}
+	});
+	thread.join();
+	tracer.SetEnabled(false);
+
+	idx_t recorded = 0;
+	idx_t min_lba = NumericLimits<idx_t>::Maximum();
+	for (const auto &event : tracer.TakeEvents()) {
+		if (StringUtil::Equals(event.second.name, "RingTest")) {
+			recorded++;
+			min_lba = MinValue<idx_t>(min_lba, event.second.lba);
+		}
+	}
+	EXPECT_EQ(recorded, NVMEFS_TRACE_RING_SIZE);
+	EXPECT_EQ(min_lba, 10);
+
+	// Events are only taken once
+	EXPECT_TRUE(tracer.TakeEvents().empty());
+}
+
+TEST_F(DiskInteractionTest, TraceDumpContainsTheSpansOfFileSystemCalls) {
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> db_handle = file_system->OpenFile("nvmefs://test.db", flags);
+
+	NvmeTracer &tracer = NvmeTracer::Get();
+	tracer.SetEnabled(true);
+	tracer.TakeEvents();
+	vector<char> buf(4 * DEFAULT_BLOCK_SIZE, 'x');
+	db_handle->Write(buf.data(), buf.size(), 0);
+	db_handle->Read(buf.data(), buf.size(), 0);
+	tracer.SetEnabled(false);
+
+	string path = testing::TempDir() + "nvmefs_trace.json";
+	EXPECT_GE(tracer.WriteChromeTrace(path), 4);
+
+	std::ifstream file(path);
+	string trace((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	EXPECT_THAT(trace, testing::StartsWith("{\"traceEvents\":["));
+	EXPECT_THAT(trace, testing::HasSubstr("{\"name\":\"Write\",\"cat\":\"database\",\"ph\":\"X\""));
+	EXPECT_THAT(trace, testing::HasSubstr("{\"name\":\"Read\",\"cat\":\"database\""));
+	EXPECT_THAT(trace, testing::HasSubstr("{\"name\":\"GetLBA\""));
+	EXPECT_THAT(trace, testing::HasSubstr("\"args\":{\"lba\":"));
+
+	// Spans are not recorded while tracing is disabled
+	db_handle->Read(buf.data(), buf.size(), 0);
+	EXPECT_EQ(tracer.WriteChromeTrace(path), 0);
+	std::remove(path.c_str());
+}
+#endif
+
+#ifdef NVMEFS_USDT
+TEST(ProbeTest, ProbesAreCompiledIntoTheBinary) {
+	// Every probe has a note in the binary with the provider and the name of the probe, which tracers look for
+	std::ifstream file("/proc/self/exe", std::ios::binary);
+	string binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	for (const char *name : {"read", "write", "submit", "complete", "temp__alloc", "temp__free"}) {
+		string note = string("nvmefs") + '\0' + name + '\0';
+		EXPECT_NE(binary.find(note), string::npos) << name;
+	}
+}
+
+TEST(ProbeTest, AttachedProbesMeasureTheIOPath) {
+	NvmeFileSystem file_system(gtestutils::TEST_CONFIG, make_uniq<FakeDevice>((1ULL << 28) / DEFAULT_BLOCK_SIZE));
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> db_handle = file_system.OpenFile("nvmefs://test.db", flags);
+	unique_ptr<FileHandle> tmp_handle =
+	    file_system.OpenFile(StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0), flags);
+
+	// A tracer increments the semaphores of the probes it attaches to, after which the latencies are measured
+	for (unsigned short *semaphore : {&nvmefs_read_semaphore, &nvmefs_write_semaphore, &nvmefs_submit_semaphore,
+	                                  &nvmefs_complete_semaphore, &nvmefs_temp__alloc_semaphore,
+	                                  &nvmefs_temp__free_semaphore}) {
+		(*semaphore)++;
+	}
+	vector<char> buf(32768, 'p');
+	vector<char> result(buf.size());
+	db_handle->Write(buf.data(), buf.size(), 0);
+	db_handle->Read(result.data(), result.size(), 0);
+	EXPECT_EQ(result, buf);
+	tmp_handle->Write(buf.data(), buf.size(), 0);
+	tmp_handle->Read(result.data(), result.size(), 0);
+	EXPECT_EQ(result, buf);
+	tmp_handle.reset();
+	file_system.RemoveFile(StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0));
+	for (unsigned short *semaphore : {&nvmefs_read_semaphore, &nvmefs_write_semaphore, &nvmefs_submit_semaphore,
+	                                  &nvmefs_complete_semaphore, &nvmefs_temp__alloc_semaphore,
+	                                  &nvmefs_temp__free_semaphore}) {
+		(*semaphore)--;
+	}
+}
+#endif
+
+TEST(LockStatisticsTest, WaitsForContendedLocksAreCounted) {
+	NvmeLockStatistics &lock_statistics = NvmeLockStatistics::Get();
+	lock_statistics.Reset();
+
+	InstrumentedSharedMutex mutex(LockSite::FILE_MUTEX);
+	mutex.lock();
+	std::thread reader([&]() {
+		boost::shared_lock<InstrumentedSharedMutex> lock(mutex);
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	mutex.unlock();
+	reader.join();
+	mutex.lock_shared();
+	mutex.unlock_shared();
+
+	// A compare-and-swap loop that retried twice
+	{
+		InstrumentedCASLoop cas_loop(LockSite::WAL_LOCATION);
+		cas_loop.Retry();
+		cas_loop.Retry();
+	}
+	{
+		// Succeeded at once
+		InstrumentedCASLoop cas_loop(LockSite::WAL_LOCATION);
+	}
+
+	vector<LockSiteStatistics> statistics = lock_statistics.GetStatistics();
+	const LockSiteStatistics &file_mutex = statistics[static_cast<idx_t>(LockSite::FILE_MUTEX)];
+	EXPECT_EQ(file_mutex.acquisitions, 3);
+	EXPECT_EQ(file_mutex.contended, 1);
+	EXPECT_GE(file_mutex.wait_ns, 5000000);
+	EXPECT_EQ(file_mutex.max_wait_ns, file_mutex.wait_ns);
+
+	const LockSiteStatistics &wal_location = statistics[static_cast<idx_t>(LockSite::WAL_LOCATION)];
+	EXPECT_EQ(wal_location.acquisitions, 2);
+	EXPECT_EQ(wal_location.contended, 1);
+	EXPECT_EQ(statistics[static_cast<idx_t>(LockSite::TEMP_MUTEX)].acquisitions, 0);
+
+	lock_statistics.Reset();
+	EXPECT_EQ(lock_statistics.GetStatistics()[static_cast<idx_t>(LockSite::FILE_MUTEX)].acquisitions, 0);
+}
+
+TEST_F(DiskInteractionTest, LockSitesOfTheFileSystemAreCounted) {
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> db_handle = file_system->OpenFile("nvmefs://test.db", flags);
+	string tmp_file_path = StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0);
+	unique_ptr<FileHandle> tmp_handle = file_system->OpenFile(tmp_file_path, flags);
+	NvmeLockStatistics::Get().Reset();
+
+	vector<char> buf(32768, 'x');
+	db_handle->Write(buf.data(), buf.size(), 0);
+	tmp_handle->Write(buf.data(), buf.size(), 0);
+	tmp_handle->Read(buf.data(), buf.size(), 0);
+
+	vector<LockSiteStatistics> statistics = NvmeLockStatistics::Get().GetStatistics();
+	EXPECT_EQ(statistics[static_cast<idx_t>(LockSite::DB_LOCATION)].acquisitions, 1);
+	EXPECT_EQ(statistics[static_cast<idx_t>(LockSite::DB_LOCATION)].contended, 0);
+	EXPECT_GE(statistics[static_cast<idx_t>(LockSite::TEMP_MUTEX)].acquisitions, 2);
+	EXPECT_GE(statistics[static_cast<idx_t>(LockSite::FILE_MUTEX)].acquisitions, 2);
+	EXPECT_EQ(statistics[static_cast<idx_t>(LockSite::WAL_LOCATION)].acquisitions, 0);
+}
+
+TEST_F(DiskInteractionTest, RegionsReportTheSpaceOfEachKindOfFile) {
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	vector<char> buf(8 * DEFAULT_BLOCK_SIZE, 'x');
+	file_system->OpenFile("nvmefs://test.db", flags)->Write(buf.data(), buf.size(), 0);
+	string tmp_file_path = StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0);
+	file_system->OpenFile(tmp_file_path, flags)->Write(buf.data(), 32768, 0);
+	file_system->OpenFile("nvmefs:///exports/out.csv", flags)->Write(buf.data(), 5000, 0);
+
+	// The 1 GiB device is divided into 1024 extents of 1 MiB
+	vector<NvmeRegionInfo> regions = file_system->GetRegions();
+	vector<string> names;
+	idx_t total_lbas = 0;
+	for (const auto &region : regions) {
+		names.push_back(region.name);
+		total_lbas += region.lba_count;
+		EXPECT_LE(region.used_lbas, region.lba_count);
+	}
+	EXPECT_THAT(names, testing::ElementsAre("metadata", "database", "wal", "temporary", "general", "free"));
+	EXPECT_EQ(total_lbas, 1024 * 256);
+
+	const NvmeRegionInfo &metadata = regions[0];
+	EXPECT_EQ(metadata.start_lba.GetIndex(), 0);
+	EXPECT_EQ(metadata.extent_count, 1);
+	EXPECT_GT(metadata.used_lbas, 0);
+
+	const NvmeRegionInfo &database = regions[1];
+	EXPECT_FALSE(database.start_lba.IsValid());
+	EXPECT_EQ(database.extent_count, 1);
+	EXPECT_EQ(database.used_lbas, 8);
+	EXPECT_EQ(database.file_count, 1);
+
+	const NvmeRegionInfo &wal = regions[2];
+	EXPECT_EQ(wal.extent_count, 0);
+	EXPECT_EQ(wal.max_lbas.GetIndex(), (1ULL << 25) / DEFAULT_BLOCK_SIZE);
+
+	const NvmeRegionInfo &temporary = regions[3];
+	EXPECT_EQ(temporary.extent_count, 1);
+	EXPECT_EQ(temporary.used_lbas, 8);
+	EXPECT_EQ(temporary.file_count, 1);
+	EXPECT_EQ(temporary.max_lbas.GetIndex(), 96000);
+
+	const NvmeRegionInfo &general = regions[4];
+	EXPECT_EQ(general.used_lbas, 2);
+	EXPECT_EQ(general.file_count, 1);
+	EXPECT_EQ(regions[5].extent_count, 1024 - 4);
+	EXPECT_EQ(regions[5].used_lbas, 0);
+
+	vector<pair<string, string>> info = file_system->GetDeviceInfo();
+	EXPECT_THAT(info, testing::Contains(pair<string, string>("device", "FakeDevice")));
+	EXPECT_THAT(info, testing::Contains(pair<string, string>("lba_size", "4096")));
+	EXPECT_THAT(info, testing::Contains(pair<string, string>("extent_count", "1024")));
+	EXPECT_THAT(info, testing::Contains(pair<string, string>("max_databases", std::to_string(NVMEFS_MAX_DATABASES))));
+}
+
+TEST_F(DiskInteractionTest, RegionsCannotBeDescribedBeforeTheDeviceIsFormatted) {
+	EXPECT_THROW(file_system->GetRegions(), IOException);
+	EXPECT_THROW(file_system->GetDeviceInfo(), IOException);
+	EXPECT_THROW(file_system->GetTemporaryFileMetadataManager(), IOException);
+	EXPECT_THROW(file_system->CompactTemporaryFiles(), IOException);
+}
+
 class TemporaryMetadataManagerTest : public testing::Test {
 protected:
 	TemporaryMetadataManagerTest() {
@@ -1286,4 +3697,257 @@ TEST_F(TemporaryMetadataManagerTest, CreateFilesOfDifferentSizes) {
 	EXPECT_EQ(filedefault->block_size, 262144);
 }
 
+class TemporaryCompactionTest : public testing::Test {
+protected:
+	TemporaryCompactionTest()
+	    : extent_allocator(16, 256, 4096), manager(extent_allocator, 512, 4096),
+	      kept_path(StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0)),
+	      deleted_path(StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 1)),
+	      large_path(StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "DEFAULT", 0)) {
+		manager.SetBlockRelocator(
+		    [this](const string &path, idx_t source_lba, idx_t destination_lba, idx_t nr_lbas) {
+			    if (during_relocation) {
+				    during_relocation(relocations.size());
+			    }
+			    relocations.emplace_back(source_lba, destination_lba);
+		    });
+		manager.CreateFile(kept_path);
+		manager.CreateFile(deleted_path);
+		manager.CreateFile(large_path);
+
+		// Temporary files may take at most two extents, which are filled with blocks of both small files. Every
+		// other block of the first extent and every third block of the second extent are kept.
+		idx_t kept_blocks = 0;
+		idx_t deleted_blocks = 0;
+		for (idx_t i = 0; i < 16; i++) {
+			manager.GetLBA(kept_path, kept_blocks++ * 32768, 8);
+			manager.GetLBA(deleted_path, deleted_blocks++ * 32768, 8);
+		}
+		for (idx_t i = 0; i < 11; i++) {
+			manager.GetLBA(kept_path, kept_blocks++ * 32768, 8);
+			manager.GetLBA(deleted_path, deleted_blocks++ * 32768, 8);
+			if (i < 10) {
+				manager.GetLBA(deleted_path, deleted_blocks++ * 32768, 8);
+			}
+		}
+		manager.DeleteFile(deleted_path);
+	}
+
+	NvmeExtentAllocator extent_allocator;
+	TemporaryFileMetadataManager manager;
+	const string kept_path;
+	const string deleted_path;
+	const string large_path;
+	vector<pair<idx_t, idx_t>> relocations;
+	/// Runs before a block is copied, with the number of blocks copied before it
+	std::function<void(idx_t)> during_relocation;
+};
+
+TEST_F(TemporaryCompactionTest, FullTemporarySpaceIsCompactedBeforeAllocationFails) {
+	// Half of the temporary space is free, but only in holes of at most 16 LBAs
+	TemporaryFragmentationStatistics statistics = manager.GetFragmentationStatistics();
+	EXPECT_EQ(statistics.free_lbas, 512 - 27 * 8);
+	EXPECT_EQ(statistics.largest_free_block, 16);
+
+	// The kept blocks of the second extent fit into the holes of the first
+	EXPECT_NO_THROW(manager.GetLBA(large_path, 0, 64));
+	EXPECT_EQ(relocations.size(), 11);
+	for (const auto &relocation : relocations) {
+		EXPECT_LT(relocation.second, relocation.first);
+	}
+	EXPECT_EQ(manager.GetFileSizeLBA(kept_path), 27 * 8);
+	EXPECT_EQ(extent_allocator.GetExtentCountPerOwner()[NVMEFS_EXTENT_OWNER_TEMPORARY], 2);
+}
+
+TEST_F(TemporaryCompactionTest, PinnedBlocksAreNotRelocated) {
+	{
+		// The first kept block of the second extent is being read
+		TemporaryBlockPin pin;
+		idx_t pinned_lba = manager.GetLBA(kept_path, 16 * 32768, 8, pin);
+
+		// The other blocks leave enough room in the second extent, even though it cannot be released
+		EXPECT_NO_THROW(manager.GetLBA(large_path, 0, 64));
+		EXPECT_EQ(relocations.size(), 10);
+		EXPECT_EQ(manager.GetLBA(kept_path, 16 * 32768, 8), pinned_lba);
+		EXPECT_EQ(manager.GetFragmentationStatistics().range_count, 2);
+	}
+
+	manager.DeleteFile(large_path);
+	TemporaryCompactionResult result = manager.Compact();
+	EXPECT_EQ(result.relocated_blocks, 1);
+	EXPECT_EQ(result.released_extents, 1);
+}
+
+TEST_F(TemporaryCompactionTest, BlocksWrittenWhileTheyAreCopiedStayInPlace) {
+	// Temporary I/O continues while the blocks are copied, and the block written meanwhile keeps its LBAs
+	idx_t written_lba = manager.GetLBA(kept_path, 17 * 32768, 8);
+	during_relocation = [&](idx_t copied) {
+		if (copied == 0) {
+			EXPECT_EQ(manager.GetLBA(kept_path, 17 * 32768, 8), written_lba);
+		}
+	};
+	TemporaryCompactionResult result = manager.Compact();
+	EXPECT_EQ(relocations.size(), 11);
+	EXPECT_EQ(result.relocated_blocks, 10);
+	EXPECT_EQ(result.skipped_blocks, 1);
+	EXPECT_EQ(result.released_extents, 0);
+	EXPECT_EQ(manager.GetLBA(kept_path, 17 * 32768, 8), written_lba);
+	EXPECT_EQ(manager.GetFileSizeLBA(kept_path), 27 * 8);
+
+	// The next compaction moves it
+	during_relocation = nullptr;
+	result = manager.Compact();
+	EXPECT_EQ(result.relocated_blocks, 1);
+	EXPECT_EQ(result.released_extents, 1);
+	EXPECT_NE(manager.GetLBA(kept_path, 17 * 32768, 8), written_lba);
+}
+
+TEST_F(TemporaryCompactionTest, FailedCopiesFreeTheirTargets) {
+	idx_t free_lbas = manager.GetFragmentationStatistics().free_lbas;
+	idx_t first_lba = manager.GetLBA(kept_path, 16 * 32768, 8);
+	idx_t last_lba = manager.GetLBA(kept_path, 26 * 32768, 8);
+	during_relocation = [](idx_t copied) {
+		if (copied == 3) {
+			throw IOException("The device failed");
+		}
+	};
+	EXPECT_THROW(manager.Compact(), IOException);
+
+	// The blocks copied before the failure were moved, and the others keep their LBAs
+	EXPECT_NE(manager.GetLBA(kept_path, 16 * 32768, 8), first_lba);
+	EXPECT_EQ(manager.GetLBA(kept_path, 26 * 32768, 8), last_lba);
+	EXPECT_EQ(manager.GetFragmentationStatistics().free_lbas, free_lbas);
+	EXPECT_EQ(manager.GetFileSizeLBA(kept_path), 27 * 8);
+}
+
+TEST(TemporarySpillTest, LeastRecentlyWrittenBlocksAreSpilledOnceTheTemporarySpaceIsFull) {
+	NvmeExtentAllocator extent_allocator(16, 256, 4096);
+	TemporaryFileMetadataManager manager(extent_allocator, 256, 4096);
+	vector<idx_t> spilled;
+	manager.SetBlockSpiller([&spilled](const string &path, idx_t block_index, idx_t lba, idx_t nr_lbas) {
+		spilled.push_back(block_index);
+	});
+	string path = StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0);
+	manager.CreateFile(path);
+
+	// The temporary space holds 32 blocks, hence the first block is spilled for the 33rd
+	for (idx_t i = 0; i < 33; i++) {
+		manager.GetLBA(path, i * 32768, 8);
+	}
+	EXPECT_THAT(spilled, testing::ElementsAre(0));
+
+	// Rewriting a block keeps it on the device
+	manager.GetLBA(path, 1 * 32768, 8);
+	manager.GetLBA(path, 33 * 32768, 8);
+	EXPECT_THAT(spilled, testing::ElementsAre(0, 2));
+
+	// Spilled blocks are read from the spill tier, until they are written again
+	TemporaryBlockPin pin;
+	EXPECT_FALSE(manager.LocateBlock(path, 0, 8, false, pin).IsValid());
+	EXPECT_TRUE(manager.LocateBlock(path, 0, 8, true, pin).IsValid());
+	EXPECT_THAT(spilled, testing::ElementsAre(0, 2, 3));
+	EXPECT_EQ(manager.GetSpilledBlockCount(), 2);
+	EXPECT_EQ(manager.GetFileSizeLBA(path), 34 * 8);
+	EXPECT_EQ(extent_allocator.GetExtentCountPerOwner()[NVMEFS_EXTENT_OWNER_TEMPORARY], 1);
+
+	manager.TruncateFile(path, 3 * 32768);
+	EXPECT_EQ(manager.GetSpilledBlockCount(), 1);
+	EXPECT_EQ(manager.GetFileSizeLBA(path), 3 * 8);
+}
+
+TEST(TemporarySpillTest, BlocksAreCopiedToTheSpillTierWithoutHoldingTheLocks) {
+	NvmeExtentAllocator extent_allocator(16, 256, 4096);
+	TemporaryFileMetadataManager manager(extent_allocator, 256, 4096);
+	string path = StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0);
+	manager.CreateFile(path);
+	idx_t copies = 0;
+	manager.SetBlockSpiller([&](const string &spilled_path, idx_t block_index, idx_t lba, idx_t nr_lbas) {
+		// The block is still read from the device while it is copied
+		TemporaryBlockPin pin;
+		optional_idx located = manager.LocateBlock(spilled_path, block_index * 32768, nr_lbas, false, pin);
+		EXPECT_EQ(located.GetIndex(), lba);
+		copies++;
+	});
+
+	// Blocks are written in any order, hence the size of a file is given by its last block
+	for (idx_t i = 0; i < 32; i++) {
+		manager.GetLBA(path, (31 - i) * 32768, 8);
+	}
+	manager.GetLBA(path, 40 * 32768, 8);
+	EXPECT_EQ(copies, 1);
+	EXPECT_EQ(manager.GetSpilledBlockCount(), 1);
+	EXPECT_EQ(manager.GetFileSizeLBA(path), 41 * 8);
+	EXPECT_EQ(manager.GetSeekBound(path), 41 * 32768);
+
+	// Reading a block that was never written allocates it on the device, it is not taken for a spilled block
+	TemporaryBlockPin pin;
+	EXPECT_TRUE(manager.LocateBlock(path, 35 * 32768, 8, false, pin).IsValid());
+	EXPECT_EQ(copies, 2);
+	EXPECT_EQ(manager.GetSpilledBlockCount(), 2);
+	pin.Release();
+
+	manager.TruncateFile(path, 36 * 32768);
+	EXPECT_EQ(manager.GetFileSizeLBA(path), 36 * 8);
+	manager.TruncateFile(path, 0);
+	EXPECT_EQ(manager.GetFileSizeLBA(path), 0);
+	EXPECT_EQ(manager.GetSpilledBlockCount(), 0);
+}
+
+TEST(TemporarySpillTest, ReadingAnUnknownBlockFailsIfNoBlockCanBeSpilled) {
+	NvmeExtentAllocator extent_allocator(16, 256, 4096);
+	TemporaryFileMetadataManager manager(extent_allocator, 256, 4096);
+	manager.SetBlockSpiller([](const string &path, idx_t block_index, idx_t lba, idx_t nr_lbas) {});
+	string path = StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0);
+	manager.CreateFile(path);
+
+	// Every block is in use, hence none can be spilled
+	vector<unique_ptr<TemporaryBlockPin>> pins;
+	for (idx_t i = 0; i < 32; i++) {
+		pins.push_back(make_uniq<TemporaryBlockPin>());
+		manager.GetLBA(path, i * 32768, 8, *pins.back());
+	}
+
+	TemporaryBlockPin pin;
+	EXPECT_THROW(manager.LocateBlock(path, 32 * 32768, 8, false, pin), std::runtime_error);
+	EXPECT_EQ(manager.GetSpilledBlockCount(), 0);
+	EXPECT_FALSE(manager.LocateBlock(path, 32 * 32768, 8, true, pin).IsValid());
+	EXPECT_EQ(manager.GetSpilledBlockCount(), 1);
+}
+
+TEST(TemporarySpillTest, FileSystemSpillsTemporaryBlocksToTheSpillDirectory) {
+	string spill_directory = testing::TempDir() + "nvmefs_spill";
+	NvmeConfig config {.device_path = "/dev/ng1n1",
+	                   .max_temp_size = 1ULL << 20,
+	                   .max_wal_size = 1ULL << 25,
+	                   .temp_spill_directory = spill_directory};
+	NvmeFileSystem file_system(config, make_uniq<FakeDevice>((1ULL << 28) / 4096));
+	FileOpenFlags flags =
+	    FileOpenFlags::FILE_FLAGS_READ | FileOpenFlags::FILE_FLAGS_WRITE | FileOpenFlags::FILE_FLAGS_FILE_CREATE;
+	unique_ptr<FileHandle> db = file_system.OpenFile("nvmefs://test.db", flags);
+	string path = StringUtil::Format("nvmefs:///tmp/duckdb_temp_storage_%s-%llu.tmp", "S32K", 0);
+	unique_ptr<FileHandle> tmp = file_system.OpenFile(path, flags);
+
+	// 48 blocks of 32 KiB do not fit into 1 MiB of temporary space
+	vector<char> buf(32768);
+	for (idx_t i = 0; i < 48; i++) {
+		memset(buf.data(), 'a' + i % 26, buf.size());
+		tmp->Write(buf.data(), buf.size(), i * buf.size());
+	}
+	EXPECT_EQ(file_system.GetTemporaryFileMetadataManager().GetSpilledBlockCount(), 16);
+	EXPECT_EQ(file_system.GetFileSize(*tmp), 48 * 32768);
+
+	vector<char> read_buf(32768);
+	for (idx_t i = 0; i < 48; i++) {
+		tmp->Read(read_buf.data(), read_buf.size(), i * read_buf.size());
+		memset(buf.data(), 'a' + i % 26, buf.size());
+		EXPECT_EQ(memcmp(read_buf.data(), buf.data(), buf.size()), 0) << "block " << i;
+	}
+
+	string spill_path = spill_directory + "/duckdb_temp_storage_S32K-0.tmp";
+	EXPECT_TRUE(std::ifstream(spill_path).good());
+	tmp.reset();
+	file_system.RemoveFile(path);
+	EXPECT_FALSE(std::ifstream(spill_path).good());
+}
+
 } // namespace duckdb
@@ -0,0 +1,136 @@
+#include "emulated_device.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace duckdb {
+
+EmulatedDevice::EmulatedDevice(idx_t lba_count, EmulatedDeviceConfig config, idx_t lba_size)
+    : FakeDevice(lba_count, lba_size), config(config), random(config.seed),
+      latency_distribution(0.0, MaxValue<double>(config.latency_sigma, 1e-9)),
+      channel_free_ns(MaxValue<idx_t>(config.channel_count, 1), 0), bus_free_ns(0), completed_commands(0),
+      total_latency_ns(0), elapsed_ns(0) {
+}
+
+idx_t EmulatedDevice::Write(void *buffer, const CmdContext &context) {
+	idx_t written = FakeDevice::Write(buffer, context);
+
+	idx_t latency_ns;
+	{
+		std::lock_guard<std::mutex> lock(emulation_lock);
+		idx_t &clock = GetThreadClock();
+		idx_t completion_ns = Schedule(true, context.nr_lbas * GetDeviceGeometry().lba_size, clock);
+		latency_ns = completion_ns - clock;
+		clock = completion_ns;
+	}
+	Wait(latency_ns);
+
+	return written;
+}
+
+idx_t EmulatedDevice::Read(void *buffer, const CmdContext &context) {
+	idx_t read = FakeDevice::Read(buffer, context);
+
+	idx_t latency_ns;
+	{
+		std::lock_guard<std::mutex> lock(emulation_lock);
+		idx_t &clock = GetThreadClock();
+		idx_t completion_ns = Schedule(false, context.nr_lbas * GetDeviceGeometry().lba_size, clock);
+		latency_ns = completion_ns - clock;
+		clock = completion_ns;
+	}
+	Wait(latency_ns);
+
+	return read;
+}
+
+void EmulatedDevice::SubmitBatch(vector<EmulatedCommand> &commands) {
+	for (auto &command : commands) {
+		if (command.write) {
+			FakeDevice::Write(command.buffer, command.context);
+		} else {
+			FakeDevice::Read(command.buffer, command.context);
+		}
+	}
+
+	idx_t batch_latency_ns = 0;
+	{
+		std::lock_guard<std::mutex> lock(emulation_lock);
+		idx_t &clock = GetThreadClock();
+		idx_t lba_size = GetDeviceGeometry().lba_size;
+		for (auto &command : commands) {
+			idx_t completion_ns = Schedule(command.write, command.context.nr_lbas * lba_size, clock);
+			command.latency_ns = completion_ns - clock;
+			batch_latency_ns = MaxValue<idx_t>(batch_latency_ns, command.latency_ns);
+		}
+		clock += batch_latency_ns;
+	}
+	Wait(batch_latency_ns);
+}
+
+idx_t EmulatedDevice::GetElapsedNanos() {
+	std::lock_guard<std::mutex> lock(emulation_lock);
+	return elapsed_ns;
+}
+
+idx_t EmulatedDevice::GetCompletedCommands() {
+	std::lock_guard<std::mutex> lock(emulation_lock);
+	return completed_commands;
+}
+
+double EmulatedDevice::GetAverageLatencyNanos() {
+	std::lock_guard<std::mutex> lock(emulation_lock);
+	return completed_commands == 0 ? 0.0 : static_cast<double>(total_latency_ns) / completed_commands;
+}
+
+idx_t EmulatedDevice::Schedule(bool write, idx_t nr_bytes, idx_t submit_ns) {
+	// Commands that have completed by the time this one is submitted no longer count towards the queue depth
+	while (!in_flight_completions.empty() && *in_flight_completions.begin() <= submit_ns) {
+		in_flight_completions.erase(in_flight_completions.begin());
+	}
+	idx_t queue_depth = in_flight_completions.size() + 1;
+
+	// The command is served by the channel that becomes idle first
+	auto channel = std::min_element(channel_free_ns.begin(), channel_free_ns.end());
+	idx_t start_ns = MaxValue<idx_t>(submit_ns, *channel);
+
+	double latency = static_cast<double>(write ? config.write_latency_ns : config.read_latency_ns);
+	if (config.latency_sigma > 0) {
+		latency *= latency_distribution(random);
+	}
+	if (queue_depth > channel_free_ns.size()) {
+		latency *= 1.0 + config.queue_depth_penalty * static_cast<double>(queue_depth - channel_free_ns.size());
+	}
+	idx_t media_done_ns = start_ns + static_cast<idx_t>(latency);
+	*channel = media_done_ns;
+
+	// Transfers share the bandwidth of the device, hence they are serialized on a single bus
+	idx_t bandwidth = write ? config.write_bandwidth : config.read_bandwidth;
+	idx_t transfer_ns = static_cast<idx_t>(static_cast<double>(nr_bytes) * 1e9 / static_cast<double>(bandwidth));
+	idx_t completion_ns = MaxValue<idx_t>(media_done_ns, bus_free_ns) + transfer_ns;
+	bus_free_ns = completion_ns;
+
+	in_flight_completions.insert(completion_ns);
+	completed_commands++;
+	total_latency_ns += completion_ns - submit_ns;
+	elapsed_ns = MaxValue<idx_t>(elapsed_ns, completion_ns);
+
+	return completion_ns;
+}
+
+idx_t &EmulatedDevice::GetThreadClock() {
+	// Threads are assumed to progress at the same rate. A new thread starts at the current emulated time.
+	auto it = thread_clocks.find(std::this_thread::get_id());
+	if (it == thread_clocks.end()) {
+		it = thread_clocks.emplace(std::this_thread::get_id(), elapsed_ns).first;
+	}
+	return it->second;
+}
+
+void EmulatedDevice::Wait(idx_t latency_ns) {
+	if (config.sleep) {
+		std::this_thread::sleep_for(std::chrono::nanoseconds(latency_ns));
+	}
+}
+
+} // namespace duckdb
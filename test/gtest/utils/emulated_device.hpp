@@ -0,0 +1,95 @@
+#pragma once
+
+#include "fake_device.hpp"
+#include "duckdb/common/unordered_map.hpp"
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+
+namespace duckdb {
+
+/// @brief Performance characteristics of an emulated device. Latencies are in nanoseconds and bandwidths in bytes
+/// per second. The defaults roughly resemble a datacenter TLC SSD.
+struct EmulatedDeviceConfig {
+	/// Median latency of a read command, excluding the transfer time
+	idx_t read_latency_ns = 80000;
+	/// Median latency of a write command, excluding the transfer time
+	idx_t write_latency_ns = 20000;
+	/// Spread of the log-normal latency distribution. 0 makes every command take exactly the median latency.
+	double latency_sigma = 0.1;
+	/// Number of commands the device can serve in parallel
+	idx_t channel_count = 8;
+	idx_t read_bandwidth = 3ULL << 30;
+	idx_t write_bandwidth = 2ULL << 30;
+	/// Latency increase per command in flight beyond the channel count, e.g. 0.05 for 5%
+	double queue_depth_penalty = 0.05;
+	/// Seed of the latency distribution, such that runs are reproducible
+	uint64_t seed = 42;
+	/// Makes the submitting thread sleep for the emulated latency, such that wall clock benchmarks see it
+	bool sleep = false;
+};
+
+/// @brief A command of a batch submitted to an EmulatedDevice
+struct EmulatedCommand {
+	bool write;
+	void *buffer;
+	CmdContext context;
+	/// Emulated latency from submission to completion, set when the batch completes
+	idx_t latency_ns;
+};
+
+/// @brief A fake device that emulates how long commands take on an SSD, without waiting for it. Every thread has its
+/// own emulated clock. A command submitted at that clock waits for a free channel, is served with a latency drawn
+/// from a log-normal distribution that grows with the queue depth, and shares the bandwidth of the device with all
+/// other transfers. Synchronous commands advance the clock of the thread to their completion, while a batch is
+/// submitted at once and advances it to the completion of its last command, like an async queue that is poked until
+/// it is empty. The data itself is stored by the underlying FakeDevice.
+class EmulatedDevice : public FakeDevice {
+public:
+	EmulatedDevice(idx_t lba_count, EmulatedDeviceConfig config = EmulatedDeviceConfig(),
+	               idx_t lba_size = DEFAULT_BLOCK_SIZE);
+
+	idx_t Write(void *buffer, const CmdContext &context) override;
+	idx_t Read(void *buffer, const CmdContext &context) override;
+
+	/// @brief Submits all commands at the same time and completes once all of them have completed
+	void SubmitBatch(vector<EmulatedCommand> &commands);
+
+	string GetName() const override {
+		return "EmulatedDevice";
+	}
+
+	/// @brief The emulated time at which the last command of any thread completed
+	idx_t GetElapsedNanos();
+
+	/// @brief Number of completed commands
+	idx_t GetCompletedCommands();
+
+	/// @brief Average emulated latency of all completed commands
+	double GetAverageLatencyNanos();
+
+private:
+	/// @brief Schedules a command submitted at the given emulated time
+	/// @return The emulated completion time
+	idx_t Schedule(bool write, idx_t nr_bytes, idx_t submit_ns);
+	idx_t &GetThreadClock();
+	void Wait(idx_t latency_ns);
+
+private:
+	const EmulatedDeviceConfig config;
+	std::mutex emulation_lock;
+	std::mt19937_64 random;
+	std::lognormal_distribution<double> latency_distribution;
+	unordered_map<std::thread::id, idx_t> thread_clocks;
+	// The emulated time at which each channel becomes idle
+	vector<idx_t> channel_free_ns;
+	// The emulated time at which the bus has transferred everything scheduled so far
+	idx_t bus_free_ns;
+	std::multiset<idx_t> in_flight_completions;
+	idx_t completed_commands;
+	idx_t total_latency_ns;
+	idx_t elapsed_ns;
+};
+
+} // namespace duckdb
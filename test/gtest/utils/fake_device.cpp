@@ -2,22 +2,39 @@
 
 namespace duckdb {
 FakeDevice::FakeDevice(idx_t lba_count, idx_t lba_size)
-    : Device(), geometry(DeviceGeometry {lba_size, lba_count}), memory(new uint8_t[lba_size * lba_count]) {
-}
-
-FakeDevice::~FakeDevice() {
-	delete[] memory;
+    : Device(), geometry(DeviceGeometry {lba_size, lba_count}), page_size(lba_size * FAKE_DEVICE_PAGE_LBA_COUNT) {
 }
 
 idx_t FakeDevice::Write(void *buffer, const CmdContext &context) {
 	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
 
-	// Get pointer to the start of the requested memory location
-	idx_t start_location_bytes = context.start_lba * geometry.lba_size + context.offset;
-	uint8_t *mem_ptr = memory + start_location_bytes;
+	// Get the byte location of the start of the requested memory location
+	idx_t location = context.start_lba * geometry.lba_size + context.offset;
+	const uint8_t *source = static_cast<const uint8_t *>(buffer);
+
+	// Write the data page by page, allocating the pages that are written for the first time
+	for (idx_t remaining = context.nr_bytes; remaining > 0;) {
+		idx_t page = location / page_size;
+		idx_t page_offset = location % page_size;
+		idx_t nr_bytes = MinValue<idx_t>(remaining, page_size - page_offset);
 
-	// Write the data to in-memory device
-	memcpy(mem_ptr, buffer, context.nr_bytes);
+		PageStripe &stripe = GetStripe(page);
+		{
+			std::lock_guard<std::mutex> lock(stripe.lock);
+			unique_array<uint8_t> &memory = stripe.pages[page];
+			if (!memory) {
+				memory = make_uniq_array<uint8_t>(page_size);
+			}
+			memcpy(memory.get() + page_offset, source, nr_bytes);
+		}
+
+		location += nr_bytes;
+		source += nr_bytes;
+		remaining -= nr_bytes;
+	}
+
+	std::lock_guard<std::mutex> lock(write_log_lock);
+	write_log.push_back(FakeDeviceWrite {context.start_lba, context.nr_lbas, context.placement_identifier});
 
 	return context.nr_lbas;
 }
@@ -25,12 +42,61 @@ idx_t FakeDevice::Write(void *buffer, const CmdContext &context) {
 idx_t FakeDevice::Read(void *buffer, const CmdContext &context) {
 	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
 
-	// Get pointer to the start of the requested memory location
-	idx_t start_location_bytes = context.start_lba * geometry.lba_size + context.offset;
-	uint8_t *mem_ptr = memory + start_location_bytes;
+	// Get the byte location of the start of the requested memory location
+	idx_t location = context.start_lba * geometry.lba_size + context.offset;
+	uint8_t *destination = static_cast<uint8_t *>(buffer);
+
+	// Read the data page by page. Pages that have never been written read as zeros.
+	for (idx_t remaining = context.nr_bytes; remaining > 0;) {
+		idx_t page = location / page_size;
+		idx_t page_offset = location % page_size;
+		idx_t nr_bytes = MinValue<idx_t>(remaining, page_size - page_offset);
 
-	// Read the data from in-memory device to the buffer
-	memcpy(buffer, mem_ptr, context.nr_bytes);
+		PageStripe &stripe = GetStripe(page);
+		{
+			std::lock_guard<std::mutex> lock(stripe.lock);
+			auto it = stripe.pages.find(page);
+			if (it != stripe.pages.end()) {
+				memcpy(destination, it->second.get() + page_offset, nr_bytes);
+			} else {
+				memset(destination, 0, nr_bytes);
+			}
+		}
+
+		location += nr_bytes;
+		destination += nr_bytes;
+		remaining -= nr_bytes;
+	}
+
+	return context.nr_lbas;
+}
+
+idx_t FakeDevice::Deallocate(const CmdContext &context) {
+	D_ASSERT(context.start_lba + context.nr_lbas <= geometry.lba_count);
+
+	idx_t location = context.start_lba * geometry.lba_size;
+	for (idx_t remaining = context.nr_lbas * geometry.lba_size; remaining > 0;) {
+		idx_t page = location / page_size;
+		idx_t page_offset = location % page_size;
+		idx_t nr_bytes = MinValue<idx_t>(remaining, page_size - page_offset);
+
+		// Fully deallocated pages are freed, while partially deallocated pages are zeroed
+		PageStripe &stripe = GetStripe(page);
+		{
+			std::lock_guard<std::mutex> lock(stripe.lock);
+			auto it = stripe.pages.find(page);
+			if (it != stripe.pages.end()) {
+				if (nr_bytes == page_size) {
+					stripe.pages.erase(it);
+				} else {
+					memset(it->second.get() + page_offset, 0, nr_bytes);
+				}
+			}
+		}
+
+		location += nr_bytes;
+		remaining -= nr_bytes;
+	}
 
 	return context.nr_lbas;
 }
@@ -38,4 +104,28 @@ idx_t FakeDevice::Read(void *buffer, const CmdContext &context) {
 DeviceGeometry FakeDevice::GetDeviceGeometry() {
 	return geometry;
 }
+
+vector<FakeDeviceWrite> FakeDevice::GetWrites() {
+	std::lock_guard<std::mutex> lock(write_log_lock);
+	return write_log;
+}
+
+optional_idx FakeDevice::GetPlacementIdentifier(idx_t lba) {
+	std::lock_guard<std::mutex> lock(write_log_lock);
+	for (auto it = write_log.rbegin(); it != write_log.rend(); it++) {
+		if (lba >= it->start_lba && lba < it->start_lba + it->nr_lbas) {
+			return it->placement_identifier;
+		}
+	}
+	return optional_idx();
+}
+
+idx_t FakeDevice::GetAllocatedBytes() {
+	idx_t allocated_bytes = 0;
+	for (auto &stripe : stripes) {
+		std::lock_guard<std::mutex> lock(stripe.lock);
+		allocated_bytes += stripe.pages.size() * page_size;
+	}
+	return allocated_bytes;
+}
 } // namespace duckdb
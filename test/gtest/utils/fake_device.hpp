@@ -1,15 +1,34 @@
+#pragma once
+
 #include "device.hpp"
+#include "duckdb/common/optional_idx.hpp"
+#include "duckdb/common/unordered_map.hpp"
+#include <array>
+#include <mutex>
 
 namespace duckdb {
 constexpr idx_t DEFAULT_BLOCK_SIZE = 1ULL << 12;
+/// Memory of the fake device is allocated in pages of this many LBAs once they are written
+constexpr idx_t FAKE_DEVICE_PAGE_LBA_COUNT = 16;
+/// Pages are spread over this many independently locked stripes, such that concurrent I/O rarely contends
+constexpr idx_t FAKE_DEVICE_LOCK_STRIPES = 64;
+
+/// @brief A write that the fake device has received, together with the placement identifier it was tagged with
+struct FakeDeviceWrite {
+	idx_t start_lba;
+	idx_t nr_lbas;
+	idx_t placement_identifier;
+};
 
+/// @brief An in-memory device. Memory is only allocated for pages that have been written, hence the device can
+/// emulate namespaces far larger than the memory of the machine. Unwritten and deallocated LBAs read as zeros.
 class FakeDevice : public Device {
 public:
 	FakeDevice(idx_t lba_count, idx_t lba_size = DEFAULT_BLOCK_SIZE);
-	~FakeDevice();
 
 	idx_t Write(void *buffer, const CmdContext &context) override;
 	idx_t Read(void *buffer, const CmdContext &context) override;
+	idx_t Deallocate(const CmdContext &context) override;
 
 	DeviceGeometry GetDeviceGeometry() override;
 
@@ -17,8 +36,30 @@ public:
 		return "FakeDevice";
 	}
 
+	/// @brief Fetches all writes the device has received in the order they were received
+	vector<FakeDeviceWrite> GetWrites();
+
+	/// @brief Fetches the placement identifier of the last write to the given LBA
+	optional_idx GetPlacementIdentifier(idx_t lba);
+
+	/// @brief Number of bytes of memory allocated for written pages
+	idx_t GetAllocatedBytes();
+
+private:
+	struct PageStripe {
+		std::mutex lock;
+		unordered_map<idx_t, unique_array<uint8_t>> pages;
+	};
+
+	PageStripe &GetStripe(idx_t page) {
+		return stripes[page % FAKE_DEVICE_LOCK_STRIPES];
+	}
+
 private:
 	const DeviceGeometry geometry;
-	uint8_t *memory;
+	const idx_t page_size;
+	std::array<PageStripe, FAKE_DEVICE_LOCK_STRIPES> stripes;
+	std::mutex write_log_lock;
+	vector<FakeDeviceWrite> write_log;
 };
 } // namespace duckdb
@@ -0,0 +1,185 @@
+#include "fdp_simulator_device.hpp"
+
+namespace duckdb {
+
+/// Garbage collection keeps this many reclaim units free, such that relocated data always fits
+constexpr idx_t GC_FREE_RECLAIM_UNIT_THRESHOLD = 2;
+
+FdpSimulatorDevice::FdpSimulatorDevice(idx_t lba_count, FdpSimulatorConfig config, idx_t lba_size)
+    : FakeDevice(lba_count, lba_size), config(config),
+      ru_lba_count(config.erase_block_lba_count * config.erase_blocks_per_reclaim_unit), host_writes(0),
+      media_writes(0), relocated_lbas(0), deallocated_lbas(0), collecting(false) {
+	D_ASSERT(ru_lba_count > 0 && config.placement_handle_count > 0);
+
+	idx_t physical_lba_count = static_cast<idx_t>(lba_count * (1.0 + config.over_provisioning));
+	idx_t ru_count = (physical_lba_count + ru_lba_count - 1) / ru_lba_count;
+
+	reclaim_units.resize(ru_count, ReclaimUnit {ReclaimUnitState::FREE, 0, 0, 0});
+	for (idx_t ru = 0; ru < ru_count; ru++) {
+		free_reclaim_units.push_back(ru);
+	}
+
+	l2p.resize(lba_count, DConstants::INVALID_INDEX);
+	p2l.resize(ru_count * ru_lba_count, DConstants::INVALID_INDEX);
+	erase_counts.resize(ru_count * config.erase_blocks_per_reclaim_unit, 0);
+}
+
+idx_t FdpSimulatorDevice::Write(void *buffer, const CmdContext &context) {
+	idx_t written = FakeDevice::Write(buffer, context);
+	idx_t placement_handle = context.placement_identifier % config.placement_handle_count;
+
+	std::lock_guard<std::mutex> lock(ftl_lock);
+	for (idx_t lba = context.start_lba; lba < context.start_lba + context.nr_lbas; lba++) {
+		host_writes++;
+		InvalidateLBA(lba);
+		ProgramLBA(lba, placement_handle);
+	}
+
+	return written;
+}
+
+idx_t FdpSimulatorDevice::Deallocate(const CmdContext &context) {
+	FakeDevice::Deallocate(context);
+
+	std::lock_guard<std::mutex> lock(ftl_lock);
+	for (idx_t lba = context.start_lba; lba < context.start_lba + context.nr_lbas; lba++) {
+		if (InvalidateLBA(lba)) {
+			deallocated_lbas++;
+		}
+	}
+
+	return context.nr_lbas;
+}
+
+idx_t FdpSimulatorDevice::GetHostWrites() {
+	std::lock_guard<std::mutex> lock(ftl_lock);
+	return host_writes;
+}
+
+idx_t FdpSimulatorDevice::GetMediaWrites() {
+	std::lock_guard<std::mutex> lock(ftl_lock);
+	return media_writes;
+}
+
+double FdpSimulatorDevice::GetWriteAmplification() {
+	return GetStats().write_amplification;
+}
+
+FdpSimulatorStats FdpSimulatorDevice::GetStats() {
+	std::lock_guard<std::mutex> lock(ftl_lock);
+
+	FdpSimulatorStats stats {host_writes, media_writes, relocated_lbas, deallocated_lbas, 0, 0, 1.0};
+	for (idx_t erase_count : erase_counts) {
+		stats.erases += erase_count;
+		stats.max_erase_count = MaxValue<idx_t>(stats.max_erase_count, erase_count);
+	}
+	if (host_writes > 0) {
+		stats.write_amplification = static_cast<double>(media_writes) / static_cast<double>(host_writes);
+	}
+
+	return stats;
+}
+
+void FdpSimulatorDevice::ProgramLBA(idx_t lba, idx_t placement_handle) {
+	idx_t ru = GetOpenReclaimUnit(placement_handle);
+	ReclaimUnit &unit = reclaim_units[ru];
+
+	idx_t physical_lba = ru * ru_lba_count + unit.write_pointer;
+	p2l[physical_lba] = lba;
+	l2p[lba] = physical_lba;
+	unit.write_pointer++;
+	unit.valid_lbas++;
+	media_writes++;
+
+	if (unit.write_pointer == ru_lba_count) {
+		unit.state = ReclaimUnitState::FULL;
+		open_reclaim_units.erase(placement_handle);
+	}
+}
+
+bool FdpSimulatorDevice::InvalidateLBA(idx_t lba) {
+	idx_t physical_lba = l2p[lba];
+	if (physical_lba == DConstants::INVALID_INDEX) {
+		return false;
+	}
+
+	reclaim_units[physical_lba / ru_lba_count].valid_lbas--;
+	p2l[physical_lba] = DConstants::INVALID_INDEX;
+	l2p[lba] = DConstants::INVALID_INDEX;
+	return true;
+}
+
+idx_t FdpSimulatorDevice::GetOpenReclaimUnit(idx_t placement_handle) {
+	auto it = open_reclaim_units.find(placement_handle);
+	if (it != open_reclaim_units.end()) {
+		return it->second;
+	}
+
+	if (!collecting && free_reclaim_units.size() < GC_FREE_RECLAIM_UNIT_THRESHOLD) {
+		CollectGarbage();
+
+		// Garbage collection can have opened a reclaim unit for the relocated data of this placement handle
+		it = open_reclaim_units.find(placement_handle);
+		if (it != open_reclaim_units.end()) {
+			return it->second;
+		}
+	}
+	if (free_reclaim_units.empty()) {
+		throw IOException("%s: no free reclaim units left", GetName());
+	}
+
+	idx_t ru = free_reclaim_units.front();
+	free_reclaim_units.pop_front();
+	reclaim_units[ru] = ReclaimUnit {ReclaimUnitState::OPEN, placement_handle, 0, 0};
+	open_reclaim_units[placement_handle] = ru;
+
+	return ru;
+}
+
+void FdpSimulatorDevice::CollectGarbage() {
+	collecting = true;
+
+	while (free_reclaim_units.size() < GC_FREE_RECLAIM_UNIT_THRESHOLD) {
+		// Greedy victim selection: the full reclaim unit with the fewest valid LBAs
+		idx_t victim = DConstants::INVALID_INDEX;
+		for (idx_t ru = 0; ru < reclaim_units.size(); ru++) {
+			if (reclaim_units[ru].state != ReclaimUnitState::FULL) {
+				continue;
+			}
+			if (victim == DConstants::INVALID_INDEX ||
+			    reclaim_units[ru].valid_lbas < reclaim_units[victim].valid_lbas) {
+				victim = ru;
+			}
+		}
+		if (victim == DConstants::INVALID_INDEX || reclaim_units[victim].valid_lbas == ru_lba_count) {
+			break;
+		}
+
+		// Valid data stays with the placement handle it was written with
+		ReclaimUnit &unit = reclaim_units[victim];
+		for (idx_t offset = 0; offset < ru_lba_count; offset++) {
+			idx_t lba = p2l[victim * ru_lba_count + offset];
+			if (lba != DConstants::INVALID_INDEX) {
+				InvalidateLBA(lba);
+				ProgramLBA(lba, unit.placement_handle);
+				relocated_lbas++;
+			}
+		}
+
+		EraseReclaimUnit(victim);
+	}
+
+	collecting = false;
+}
+
+void FdpSimulatorDevice::EraseReclaimUnit(idx_t ru) {
+	idx_t first_erase_block = ru * config.erase_blocks_per_reclaim_unit;
+	for (idx_t block = 0; block < config.erase_blocks_per_reclaim_unit; block++) {
+		erase_counts[first_erase_block + block]++;
+	}
+
+	reclaim_units[ru] = ReclaimUnit {ReclaimUnitState::FREE, 0, 0, 0};
+	free_reclaim_units.push_back(ru);
+}
+
+} // namespace duckdb
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "fake_device.hpp"
+#include "duckdb/common/map.hpp"
+#include <deque>
+#include <mutex>
+
+namespace duckdb {
+
+/// @brief The flash layout of a simulated device
+struct FdpSimulatorConfig {
+	/// Number of LBAs in an erase block, the smallest unit the flash can erase
+	idx_t erase_block_lba_count = 64;
+	/// Number of erase blocks in a reclaim unit. A reclaim unit is always erased as a whole.
+	idx_t erase_blocks_per_reclaim_unit = 4;
+	/// Fraction of extra physical capacity, e.g. 0.07 for 7%
+	double over_provisioning = 0.07;
+	/// Number of reclaim unit handles. Placement identifiers beyond the handles wrap around, as on NvmeDevice.
+	idx_t placement_handle_count = 8;
+};
+
+/// @brief Counters of a simulated device. All counts are in LBAs, except for the erase counts.
+struct FdpSimulatorStats {
+	/// LBAs written by the host
+	idx_t host_writes;
+	/// LBAs programmed to the media, including the LBAs relocated by garbage collection
+	idx_t media_writes;
+	/// LBAs relocated by garbage collection
+	idx_t relocated_lbas;
+	/// LBAs the host has deallocated that were still mapped
+	idx_t deallocated_lbas;
+	/// Total number of erase block erases
+	idx_t erases;
+	/// Highest number of erases of a single erase block
+	idx_t max_erase_count;
+	/// Media writes divided by host writes
+	double write_amplification;
+};
+
+/// @brief A fake device that simulates the flash translation layer of an FDP SSD. Every placement handle writes into
+/// its own open reclaim unit (RU), and the device garbage collects the RU with the fewest valid LBAs when it runs out
+/// of free RUs. Deallocated LBAs are no longer valid, hence GC does not relocate them. The data itself is stored by
+/// the underlying FakeDevice.
+class FdpSimulatorDevice : public FakeDevice {
+public:
+	/// @brief Constructor for FdpSimulatorDevice
+	/// @param lba_count Number of LBAs exposed to the host
+	/// @param config The flash layout of the device
+	/// @param lba_size Size of a single LBA in bytes
+	FdpSimulatorDevice(idx_t lba_count, FdpSimulatorConfig config = FdpSimulatorConfig(),
+	                   idx_t lba_size = DEFAULT_BLOCK_SIZE);
+
+	idx_t Write(void *buffer, const CmdContext &context) override;
+	idx_t Deallocate(const CmdContext &context) override;
+
+	string GetName() const override {
+		return "FdpSimulatorDevice";
+	}
+
+	/// @brief Number of LBAs written by the host
+	idx_t GetHostWrites();
+
+	/// @brief Number of LBAs written to the media, including the LBAs relocated by garbage collection
+	idx_t GetMediaWrites();
+
+	/// @brief Media writes divided by host writes
+	double GetWriteAmplification();
+
+	/// @brief Fetches a snapshot of all counters of the device
+	FdpSimulatorStats GetStats();
+
+private:
+	enum class ReclaimUnitState : uint8_t { FREE, OPEN, FULL };
+
+	struct ReclaimUnit {
+		ReclaimUnitState state;
+		idx_t placement_handle;
+		idx_t write_pointer;
+		idx_t valid_lbas;
+	};
+
+	void ProgramLBA(idx_t lba, idx_t placement_handle);
+	bool InvalidateLBA(idx_t lba);
+	idx_t GetOpenReclaimUnit(idx_t placement_handle);
+	void CollectGarbage();
+	void EraseReclaimUnit(idx_t ru);
+
+private:
+	const FdpSimulatorConfig config;
+	const idx_t ru_lba_count;
+	std::mutex ftl_lock;
+	vector<ReclaimUnit> reclaim_units;
+	std::deque<idx_t> free_reclaim_units;
+	map<idx_t, idx_t> open_reclaim_units;
+	// Logical to physical and physical to logical mapping. Unmapped entries are INVALID_INDEX.
+	vector<idx_t> l2p;
+	vector<idx_t> p2l;
+	vector<idx_t> erase_counts;
+	idx_t host_writes;
+	idx_t media_writes;
+	idx_t relocated_lbas;
+	idx_t deallocated_lbas;
+	bool collecting;
+};
+
+} // namespace duckdb